@@ -23,6 +23,7 @@
 #include "bg-pictures-source.h"
 
 #include "cc-background-item.h"
+#include "bg-thumbnail-pool.h"
 
 #include <string.h>
 #include <gio/gio.h>
@@ -35,14 +36,38 @@ G_DEFINE_TYPE (BgPicturesSource, bg_pictures_source, BG_TYPE_SOURCE)
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), BG_TYPE_PICTURES_SOURCE, BgPicturesSourcePrivate))
 
 #define ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+	G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+	G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
 	G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
         G_FILE_ATTRIBUTE_TIME_MODIFIED
 
+/* Folders are read in batches, and the next batch is only asked for
+ * once there are few enough thumbnails left to make, so that large
+ * folders don't have all their pictures in memory at once */
+#define ENUMERATE_BATCH_SIZE 64
+#define MAX_PENDING_THUMBNAILS 128
+
+enum
+{
+  PROP_0,
+  PROP_RECURSIVE
+};
+
 struct _BgPicturesSourcePrivate
 {
   GCancellable *cancellable;
 
   GnomeDesktopThumbnailFactory *thumb_factory;
+  BgThumbnailPool *thumbnails;
+  /* Where the next picture is queued, for the thumbnails to be made in
+   * the order the pictures were found */
+  gint n_queued;
+  /* Thumbnails queued but not done yet */
+  guint n_pending;
+  /* Enumerators waiting for n_pending to go down */
+  GQueue waiting_enumerators;
+
+  gboolean recursive;
 
   GFileMonitor *picture_dir_monitor;
   GFileMonitor *cache_dir_monitor;
@@ -59,6 +84,8 @@ const char * const content_types[] = {
 };
 
 static char *bg_pictures_source_get_unique_filename (const char *uri);
+static void resume_enumeration (BgPicturesSource *bg_source);
+static void bg_pictures_source_constructed (GObject *object);
 
 static void
 bg_pictures_source_get_property (GObject    *object,
@@ -66,8 +93,14 @@ bg_pictures_source_get_property (GObject    *object,
                                   GValue     *value,
                                   GParamSpec *pspec)
 {
+  BgPicturesSource *bg_source = BG_PICTURES_SOURCE (object);
+
   switch (property_id)
     {
+    case PROP_RECURSIVE:
+      g_value_set_boolean (value, bg_source->priv->recursive);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -79,8 +112,14 @@ bg_pictures_source_set_property (GObject      *object,
                                   const GValue *value,
                                   GParamSpec   *pspec)
 {
+  BgPicturesSource *bg_source = BG_PICTURES_SOURCE (object);
+
   switch (property_id)
     {
+    case PROP_RECURSIVE:
+      bg_source->priv->recursive = g_value_get_boolean (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     }
@@ -98,6 +137,15 @@ bg_pictures_source_dispose (GObject *object)
       priv->cancellable = NULL;
     }
 
+  if (priv->thumbnails)
+    {
+      bg_thumbnail_pool_destroy (priv->thumbnails);
+      priv->thumbnails = NULL;
+    }
+
+  g_queue_foreach (&priv->waiting_enumerators, (GFunc) g_object_unref, NULL);
+  g_queue_clear (&priv->waiting_enumerators);
+
   if (priv->thumb_factory)
     {
       g_object_unref (priv->thumb_factory);
@@ -141,106 +189,127 @@ bg_pictures_source_class_init (BgPicturesSourceClass *klass)
   object_class->set_property = bg_pictures_source_set_property;
   object_class->dispose = bg_pictures_source_dispose;
   object_class->finalize = bg_pictures_source_finalize;
+  object_class->constructed = bg_pictures_source_constructed;
+
+  g_object_class_install_property (object_class,
+                                   PROP_RECURSIVE,
+                                   g_param_spec_boolean ("recursive",
+                                                         "Recursive",
+                                                         "Whether pictures in subfolders are shown too",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY |
+                                                         G_PARAM_STATIC_STRINGS));
+}
+
+/* Reads the chunks before the image data, which is where gnome-screenshot
+ * puts its name */
+static gboolean
+is_screenshot (const char *uri,
+               const char *mime_type)
+{
+  static const guchar png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  static const char software[] = "Software\0gnome-screenshot";
+  GFile *file;
+  GInputStream *stream;
+  guchar header[8];
+  char *data;
+  gsize n_read;
+  gboolean ret = FALSE;
+
+  if (!g_str_equal (mime_type, "image/png"))
+    return FALSE;
+
+  file = g_file_new_for_uri (uri);
+  stream = G_INPUT_STREAM (g_file_read (file, NULL, NULL));
+  g_object_unref (file);
+
+  if (stream == NULL)
+    return FALSE;
+
+  if (!g_input_stream_read_all (stream, header, sizeof (header), &n_read, NULL, NULL) ||
+      n_read != sizeof (header) ||
+      memcmp (header, png_signature, sizeof (png_signature)) != 0)
+    goto out;
+
+  /* Each chunk is its length, its type, its data and a CRC */
+  while (g_input_stream_read_all (stream, header, sizeof (header), &n_read, NULL, NULL) &&
+         n_read == sizeof (header))
+    {
+      guint32 length;
+
+      memcpy (&length, header, sizeof (length));
+      length = GUINT32_FROM_BE (length);
+
+      if (memcmp (header + 4, "IDAT", 4) == 0)
+        break;
+
+      if (memcmp (header + 4, "tEXt", 4) == 0 && length == sizeof (software) - 1)
+        {
+          data = g_malloc (length);
+          if (g_input_stream_read_all (stream, data, length, &n_read, NULL, NULL) &&
+              n_read == length &&
+              memcmp (data, software, length) == 0)
+            ret = TRUE;
+          g_free (data);
+
+          if (ret || n_read != length)
+            break;
+
+          length = 0;
+        }
+
+      if (g_input_stream_skip (stream, length + 4, NULL, NULL) != length + 4)
+        break;
+    }
+
+out:
+  g_object_unref (stream);
+  return ret;
+}
+
+static gboolean
+filter_picture (const char *uri,
+                const char *mime_type)
+{
+  if (is_screenshot (uri, mime_type))
+    {
+      g_debug ("Ignored URL '%s' as it's a screenshot from gnome-screenshot", uri);
+      return FALSE;
+    }
+
+  return TRUE;
 }
 
 static void
-picture_scaled (GObject *source_object,
-                GAsyncResult *res,
-                gpointer user_data)
+picture_ready (CcBackgroundItem *item,
+               GdkPixbuf        *thumbnail,
+               BgPicturesSource *bg_source)
 {
-  BgPicturesSource *bg_source;
-  CcBackgroundItem *item;
-  GError *error = NULL;
-  GdkPixbuf *pixbuf;
-  const char *software;
   const char *uri;
   GtkTreeIter iter;
   GtkListStore *store;
 
-  pixbuf = gdk_pixbuf_new_from_stream_finish (res, &error);
-  if (pixbuf == NULL)
-    {
-      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        g_warning ("Failed to load image: %s", error->message);
+  bg_source->priv->n_pending--;
+  resume_enumeration (bg_source);
 
-      g_error_free (error);
-      return;
-    }
+  if (thumbnail == NULL)
+    return;
 
-  /* since we were not cancelled, we can now cast user_data
-   * back to BgPicturesSource.
-   */
-  bg_source = BG_PICTURES_SOURCE (user_data);
   store = bg_source_get_liststore (BG_SOURCE (bg_source));
-  item = g_object_get_data (source_object, "item");
   uri = cc_background_item_get_uri (item);
 
-  /* Ignore screenshots */
-  software = gdk_pixbuf_get_option (pixbuf, "tEXt::Software");
-  if (software != NULL &&
-      g_str_equal (software, "gnome-screenshot"))
-    {
-      g_debug ("Ignored URL '%s' as it's a screenshot from gnome-screenshot",
-               cc_background_item_get_uri (item));
-      g_object_unref (pixbuf);
-      g_object_unref (item);
-      return;
-    }
-
   cc_background_item_load (item, NULL);
 
   /* insert the item into the liststore */
   gtk_list_store_insert_with_values (store, &iter, -1,
-                                     0, pixbuf,
+                                     0, thumbnail,
                                      1, item,
                                      -1);
 
   g_hash_table_insert (bg_source->priv->known_items,
                        bg_pictures_source_get_unique_filename (uri),
                        GINT_TO_POINTER (TRUE));
-
-
-  g_object_unref (pixbuf);
-}
-
-static void
-picture_opened_for_read (GObject *source_object,
-                         GAsyncResult *res,
-                         gpointer user_data)
-{
-  BgPicturesSource *bg_source;
-  CcBackgroundItem *item;
-  GFileInputStream *stream;
-  GError *error = NULL;
-
-  item = g_object_get_data (source_object, "item");
-  stream = g_file_read_finish (G_FILE (source_object), res, &error);
-  if (stream == NULL)
-    {
-      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-        {
-          char *filename = g_file_get_path (G_FILE (source_object));
-          g_warning ("Failed to load picture '%s': %s", filename, error->message);
-          g_free (filename);
-        }
-
-      g_error_free (error);
-      g_object_unref (item);
-      return;
-    }
-
-  /* since we were not cancelled, we can now cast user_data
-   * back to BgPicturesSource.
-   */
-  bg_source = BG_PICTURES_SOURCE (user_data);
-
-  g_object_set_data (G_OBJECT (stream), "item", item);
-  gdk_pixbuf_new_from_stream_at_scale_async (G_INPUT_STREAM (stream),
-                                             THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT,
-                                             TRUE,
-                                             bg_source->priv->cancellable,
-                                             picture_scaled, bg_source);
-  g_object_unref (stream);
 }
 
 static gboolean
@@ -287,11 +356,14 @@ add_single_file (BgPicturesSource *bg_source,
   if (source_uri != NULL)
     g_object_set (G_OBJECT (item), "source-url", source_uri, NULL);
 
-  g_object_set_data (G_OBJECT (file), "item", item);
-
-  g_file_read_async (file, G_PRIORITY_DEFAULT,
-                     bg_source->priv->cancellable,
-                     picture_opened_for_read, bg_source);
+  /* Only the thumbnail is loaded, from the cache unless the picture
+   * changed since it was made */
+  bg_source->priv->n_pending++;
+  bg_thumbnail_pool_add (bg_source->priv->thumbnails,
+                         cc_background_item_get_uri (item),
+                         content_type, mtime,
+                         bg_source->priv->n_queued++,
+                         item, g_object_unref);
   g_object_unref (file);
   return TRUE;
 }
@@ -363,33 +435,49 @@ file_sort_func (gconstpointer a,
 
   modified_b = g_file_info_get_attribute_uint64 (file_b, G_FILE_ATTRIBUTE_TIME_MODIFIED);
 
-  return modified_b - modified_a;
+  /* Newest first; the difference does not fit in an int */
+  return (modified_b > modified_a) - (modified_b < modified_a);
 }
 
+static void enumerate_dir (BgPicturesSource *bg_source,
+                           GFile            *dir);
+
 static void
 file_info_async_ready (GObject      *source,
                        GAsyncResult *res,
                        gpointer      user_data)
 {
-  BgPicturesSource *bg_source = BG_PICTURES_SOURCE (user_data);
+  BgPicturesSource *bg_source;
+  GFileEnumerator *enumerator = G_FILE_ENUMERATOR (source);
   GList *files, *l;
   GError *err = NULL;
   GFile *parent;
 
-  files = g_file_enumerator_next_files_finish (G_FILE_ENUMERATOR (source),
+  files = g_file_enumerator_next_files_finish (enumerator,
                                                res,
                                                &err);
   if (err)
     {
-      g_warning ("Could not get pictures file information: %s", err->message);
+      if (!g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("Could not get pictures file information: %s", err->message);
       g_error_free (err);
 
-      g_list_foreach (files, (GFunc) g_object_unref, NULL);
-      g_list_free (files);
+      g_object_unref (enumerator);
+      return;
+    }
+
+  /* The folder is done */
+  if (files == NULL)
+    {
+      g_object_unref (enumerator);
       return;
     }
 
-  parent = g_file_enumerator_get_container (G_FILE_ENUMERATOR (source));
+  /* since we were not cancelled, we can now cast user_data
+   * back to BgPicturesSource.
+   */
+  bg_source = BG_PICTURES_SOURCE (user_data);
+  parent = g_file_enumerator_get_container (enumerator);
 
   files = g_list_sort (files, file_sort_func);
 
@@ -401,11 +489,41 @@ file_info_async_ready (GObject      *source,
 
       file = g_file_get_child (parent, g_file_info_get_name (info));
 
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+          if (bg_source->priv->recursive && !g_file_info_get_is_hidden (info))
+            enumerate_dir (bg_source, file);
+          g_object_unref (file);
+          continue;
+        }
+
       add_single_file (bg_source, file, info, NULL);
     }
 
   g_list_foreach (files, (GFunc) g_object_unref, NULL);
   g_list_free (files);
+
+  /* Ask for the next batch, once the thumbnails caught up */
+  g_queue_push_tail (&bg_source->priv->waiting_enumerators, enumerator);
+  resume_enumeration (bg_source);
+}
+
+static void
+resume_enumeration (BgPicturesSource *bg_source)
+{
+  BgPicturesSourcePrivate *priv = bg_source->priv;
+  GFileEnumerator *enumerator;
+
+  while (priv->n_pending < MAX_PENDING_THUMBNAILS &&
+         (enumerator = g_queue_pop_head (&priv->waiting_enumerators)) != NULL)
+    {
+      g_file_enumerator_next_files_async (enumerator,
+                                          ENUMERATE_BATCH_SIZE,
+                                          G_PRIORITY_LOW,
+                                          priv->cancellable,
+                                          file_info_async_ready,
+                                          bg_source);
+    }
 }
 
 static void
@@ -413,7 +531,7 @@ dir_enum_async_ready (GObject      *source,
                       GAsyncResult *res,
                       gpointer      user_data)
 {
-  BgPicturesSourcePrivate *priv = BG_PICTURES_SOURCE (user_data)->priv;
+  BgPicturesSource *bg_source;
   GFileEnumerator *enumerator;
   GError *err = NULL;
 
@@ -421,19 +539,30 @@ dir_enum_async_ready (GObject      *source,
 
   if (err)
     {
-      if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) == FALSE)
+      if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) == FALSE &&
+          g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED) == FALSE)
         g_warning ("Could not fill pictures source: %s", err->message);
       g_error_free (err);
       return;
     }
 
+  bg_source = BG_PICTURES_SOURCE (user_data);
+
   /* get the files */
-  g_file_enumerator_next_files_async (enumerator,
-                                      G_MAXINT,
-                                      G_PRIORITY_LOW,
-                                      priv->cancellable,
-                                      file_info_async_ready,
-                                      user_data);
+  g_queue_push_tail (&bg_source->priv->waiting_enumerators, enumerator);
+  resume_enumeration (bg_source);
+}
+
+static void
+enumerate_dir (BgPicturesSource *bg_source,
+               GFile            *dir)
+{
+  g_file_enumerate_children_async (dir,
+                                   ATTRIBUTES,
+                                   G_FILE_QUERY_INFO_NONE,
+                                   G_PRIORITY_LOW,
+                                   bg_source->priv->cancellable,
+                                   dir_enum_async_ready, bg_source);
 }
 
 char *
@@ -516,7 +645,7 @@ sort_func (GtkTreeModel *model,
   modified_a = cc_background_item_get_modified (item_a);
   modified_b = cc_background_item_get_modified (item_b);
 
-  retval = modified_b - modified_a;
+  retval = (modified_b > modified_a) - (modified_b < modified_a);
 
   g_object_unref (item_a);
   g_object_unref (item_b);
@@ -598,29 +727,19 @@ files_changed_cb (GFileMonitor      *monitor,
 }
 
 static void
-bg_pictures_source_init (BgPicturesSource *self)
+bg_pictures_source_constructed (GObject *object)
 {
+  BgPicturesSource *self = BG_PICTURES_SOURCE (object);
+  BgPicturesSourcePrivate *priv = self->priv;
   const gchar *pictures_path;
-  BgPicturesSourcePrivate *priv;
   GFile *dir;
   char *cache_path;
-  GtkListStore *store;
 
-  priv = self->priv = PICTURES_SOURCE_PRIVATE (self);
-
-  priv->cancellable = g_cancellable_new ();
-  priv->known_items = g_hash_table_new_full (g_str_hash,
-					     g_str_equal,
-					     (GDestroyNotify) g_free,
-					     NULL);
+  G_OBJECT_CLASS (bg_pictures_source_parent_class)->constructed (object);
 
   pictures_path = g_get_user_special_dir (G_USER_DIRECTORY_PICTURES);
   dir = g_file_new_for_path (pictures_path);
-  g_file_enumerate_children_async (dir,
-				   ATTRIBUTES,
-                                   G_FILE_QUERY_INFO_NONE,
-                                   G_PRIORITY_LOW, priv->cancellable,
-                                   dir_enum_async_ready, self);
+  enumerate_dir (self, dir);
 
   priv->picture_dir_monitor = g_file_monitor_directory (dir,
                                                         G_FILE_MONITOR_NONE,
@@ -637,11 +756,8 @@ bg_pictures_source_init (BgPicturesSource *self)
 
   cache_path = bg_pictures_source_get_cache_path ();
   dir = g_file_new_for_path (cache_path);
-  g_file_enumerate_children_async (dir,
-				   ATTRIBUTES,
-                                   G_FILE_QUERY_INFO_NONE,
-                                   G_PRIORITY_LOW, priv->cancellable,
-                                   dir_enum_async_ready, self);
+  g_free (cache_path);
+  enumerate_dir (self, dir);
 
   priv->cache_dir_monitor = g_file_monitor_directory (dir,
                                                       G_FILE_MONITOR_NONE,
@@ -654,9 +770,28 @@ bg_pictures_source_init (BgPicturesSource *self)
                       self);
 
   g_object_unref (dir);
+}
 
+static void
+bg_pictures_source_init (BgPicturesSource *self)
+{
+  BgPicturesSourcePrivate *priv;
+  GtkListStore *store;
+
+  priv = self->priv = PICTURES_SOURCE_PRIVATE (self);
+
+  priv->cancellable = g_cancellable_new ();
   priv->thumb_factory =
     gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+  priv->thumbnails = bg_thumbnail_pool_new (priv->thumb_factory,
+                                            THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT,
+                                            filter_picture,
+                                            (BgThumbnailPoolFunc) picture_ready,
+                                            self);
+  priv->known_items = g_hash_table_new_full (g_str_hash,
+					     g_str_equal,
+					     (GDestroyNotify) g_free,
+					     NULL);
 
   store = bg_source_get_liststore (BG_SOURCE (self));
 
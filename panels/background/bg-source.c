@@ -128,3 +128,25 @@ bg_source_get_liststore (BgSource *source)
 
   return source->priv->store;
 }
+
+/**
+ * bg_source_set_visible_range:
+ * @source: a #BgSource
+ * @start: the index of the first row shown
+ * @end: the index of the last row shown
+ *
+ * Lets @source work on what is shown first, such as the thumbnails.
+ */
+void
+bg_source_set_visible_range (BgSource *source,
+                             gint      start,
+                             gint      end)
+{
+  BgSourceClass *klass;
+
+  g_return_if_fail (BG_IS_SOURCE (source));
+
+  klass = BG_SOURCE_GET_CLASS (source);
+  if (klass->set_visible_range)
+    klass->set_visible_range (source, start, end);
+}
@@ -65,12 +65,20 @@ struct _BgSource
 struct _BgSourceClass
 {
   GObjectClass parent_class;
+
+  void (* set_visible_range) (BgSource *source,
+                              gint      start,
+                              gint      end);
 };
 
 GType bg_source_get_type (void) G_GNUC_CONST;
 
 GtkListStore* bg_source_get_liststore (BgSource *source);
 
+void bg_source_set_visible_range (BgSource *source,
+                                  gint      start,
+                                  gint      end);
+
 G_END_DECLS
 
 #endif /* _BG_SOURCE_H */
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <unistd.h>
+
+#include "bg-thumbnail-pool.h"
+
+/* Making thumbnails is mostly decoding, more workers than cores would only
+ * compete with the main thread */
+#define MAX_WORKERS 8
+
+#define ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE "," \
+        G_FILE_ATTRIBUTE_TIME_MODIFIED
+
+struct _BgThumbnailPool
+{
+  volatile gint ref_count;
+
+  GThreadPool *workers;
+  GnomeDesktopThumbnailFactory *factory;
+  GCancellable *cancellable;
+
+  gint width;
+  gint height;
+  BgThumbnailPoolFilter filter;
+  BgThumbnailPoolFunc func;
+  gpointer user_data;
+
+  /* Read by the workers when sorting the queue */
+  volatile gint visible_start;
+  volatile gint visible_end;
+};
+
+typedef struct
+{
+  BgThumbnailPool *pool;
+  gint position;
+  char *uri;
+  char *mime_type;
+  guint64 mtime;
+  gpointer data;
+  GDestroyNotify data_free;
+  GdkPixbuf *thumbnail;
+} Job;
+
+static void
+pool_unref (BgThumbnailPool *pool)
+{
+  if (!g_atomic_int_dec_and_test (&pool->ref_count))
+    return;
+
+  g_object_unref (pool->factory);
+  g_object_unref (pool->cancellable);
+  g_slice_free (BgThumbnailPool, pool);
+}
+
+static void
+job_free (Job *job)
+{
+  if (job->data_free)
+    job->data_free (job->data);
+  g_clear_object (&job->thumbnail);
+  g_free (job->uri);
+  g_free (job->mime_type);
+  pool_unref (job->pool);
+  g_slice_free (Job, job);
+}
+
+static gboolean
+job_done (gpointer data)
+{
+  Job *job = data;
+  BgThumbnailPool *pool = job->pool;
+
+  if (!g_cancellable_is_cancelled (pool->cancellable))
+    pool->func (job->data, job->thumbnail, pool->user_data);
+
+  job_free (job);
+
+  return FALSE;
+}
+
+static gboolean
+query_info (Job          *job,
+            GCancellable *cancellable)
+{
+  GFile *file;
+  GFileInfo *info;
+
+  file = g_file_new_for_uri (job->uri);
+  info = g_file_query_info (file, ATTRIBUTES, G_FILE_QUERY_INFO_NONE,
+                            cancellable, NULL);
+  g_object_unref (file);
+
+  if (info == NULL)
+    return FALSE;
+
+  job->mime_type = g_strdup (g_file_info_get_content_type (info));
+  job->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+  g_object_unref (info);
+
+  return job->mime_type != NULL;
+}
+
+static char *
+ensure_thumbnail (GnomeDesktopThumbnailFactory *factory,
+                  const Job                    *job)
+{
+  GdkPixbuf *pixbuf;
+  char *path;
+
+  /* The thumbnail is only valid for the modification time it was made for */
+  path = gnome_desktop_thumbnail_factory_lookup (factory, job->uri, job->mtime);
+  if (path != NULL ||
+      gnome_desktop_thumbnail_factory_has_valid_failed_thumbnail (factory, job->uri, job->mtime) ||
+      !gnome_desktop_thumbnail_factory_can_thumbnail (factory, job->uri, job->mime_type, job->mtime))
+    return path;
+
+  pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (factory, job->uri, job->mime_type);
+  if (pixbuf == NULL)
+    {
+      gnome_desktop_thumbnail_factory_create_failed_thumbnail (factory, job->uri, job->mtime);
+      return NULL;
+    }
+
+  gnome_desktop_thumbnail_factory_save_thumbnail (factory, pixbuf, job->uri, job->mtime);
+  g_object_unref (pixbuf);
+
+  return gnome_desktop_thumbnail_factory_lookup (factory, job->uri, job->mtime);
+}
+
+static void
+make_thumbnail (Job *job)
+{
+  BgThumbnailPool *pool = job->pool;
+  char *path;
+
+  if (job->mime_type == NULL && !query_info (job, pool->cancellable))
+    return;
+
+  if (pool->filter != NULL && !pool->filter (job->uri, job->mime_type))
+    return;
+
+  path = ensure_thumbnail (pool->factory, job);
+
+  /* Without a thumbnail, because the image can't be or isn't allowed to
+   * be thumbnailed, the image itself is decoded, as before there was a
+   * thumbnail cache; only images which fail that too are skipped */
+  if (path == NULL && pool->width > 0)
+    path = g_filename_from_uri (job->uri, NULL, NULL);
+
+  if (path != NULL && pool->width > 0)
+    job->thumbnail = gdk_pixbuf_new_from_file_at_scale (path, pool->width, pool->height,
+                                                        TRUE, NULL);
+
+  g_free (path);
+}
+
+static void
+run_job (gpointer data,
+         gpointer user_data)
+{
+  Job *job = data;
+
+  /* Jobs which were still queued when the pool got destroyed are
+   * only freed */
+  if (!g_cancellable_is_cancelled (job->pool->cancellable))
+    make_thumbnail (job);
+
+  g_idle_add (job_done, job);
+}
+
+static gboolean
+is_visible (BgThumbnailPool *pool,
+            const Job       *job)
+{
+  return job->position >= g_atomic_int_get (&pool->visible_start) &&
+         job->position <= g_atomic_int_get (&pool->visible_end);
+}
+
+static gint
+compare_jobs (gconstpointer a,
+              gconstpointer b,
+              gpointer      user_data)
+{
+  BgThumbnailPool *pool = user_data;
+  const Job *job_a = a;
+  const Job *job_b = b;
+  gboolean visible_a, visible_b;
+
+  visible_a = is_visible (pool, job_a);
+  visible_b = is_visible (pool, job_b);
+
+  if (visible_a != visible_b)
+    return visible_a ? -1 : 1;
+
+  return job_a->position - job_b->position;
+}
+
+static gint
+get_n_workers (void)
+{
+  long n_processors;
+
+  n_processors = sysconf (_SC_NPROCESSORS_ONLN);
+
+  return CLAMP (n_processors, 1, MAX_WORKERS);
+}
+
+/**
+ * bg_thumbnail_pool_new:
+ * @factory: the factory to make the thumbnails with
+ * @width: the width to load the thumbnails at, or 0 to not load them
+ * @height: the height to load the thumbnails at
+ * @filter: (allow-none): called from the workers to skip images
+ * @func: called for each image once it is done
+ * @user_data: data for @func
+ *
+ * Returns: a new pool, to destroy with bg_thumbnail_pool_destroy()
+ */
+BgThumbnailPool *
+bg_thumbnail_pool_new (GnomeDesktopThumbnailFactory *factory,
+                       gint                          width,
+                       gint                          height,
+                       BgThumbnailPoolFilter         filter,
+                       BgThumbnailPoolFunc           func,
+                       gpointer                      user_data)
+{
+  BgThumbnailPool *pool;
+
+  pool = g_slice_new0 (BgThumbnailPool);
+  pool->ref_count = 1;
+  pool->factory = g_object_ref (factory);
+  pool->cancellable = g_cancellable_new ();
+  pool->width = width;
+  pool->height = height;
+  pool->filter = filter;
+  pool->func = func;
+  pool->user_data = user_data;
+  pool->visible_start = -1;
+  pool->visible_end = -1;
+
+  pool->workers = g_thread_pool_new (run_job, pool,
+                                     get_n_workers (), FALSE, NULL);
+  g_thread_pool_set_sort_function (pool->workers, compare_jobs, pool);
+
+  return pool;
+}
+
+/**
+ * bg_thumbnail_pool_destroy:
+ * @pool: a #BgThumbnailPool
+ *
+ * Cancels the images which are not done yet. This does not wait for the
+ * thumbnails being made, but they will not be called back.
+ */
+void
+bg_thumbnail_pool_destroy (BgThumbnailPool *pool)
+{
+  g_cancellable_cancel (pool->cancellable);
+
+  /* The queued jobs still go through the workers, to be freed */
+  g_thread_pool_free (pool->workers, FALSE, FALSE);
+  pool->workers = NULL;
+
+  pool_unref (pool);
+}
+
+/**
+ * bg_thumbnail_pool_add:
+ * @pool: a #BgThumbnailPool
+ * @uri: the image to make a thumbnail of
+ * @mime_type: (allow-none): the content type of the image, or %NULL to
+ *   look it up along with the modification time
+ * @mtime: the modification time of the image
+ * @position: where the image is shown
+ * @data: passed back to the function of the pool
+ * @data_free: (allow-none): frees @data on the main thread
+ *
+ * Queues a thumbnail for @uri.
+ */
+void
+bg_thumbnail_pool_add (BgThumbnailPool *pool,
+                       const char      *uri,
+                       const char      *mime_type,
+                       guint64          mtime,
+                       gint             position,
+                       gpointer         data,
+                       GDestroyNotify   data_free)
+{
+  Job *job;
+
+  job = g_slice_new0 (Job);
+  job->pool = pool;
+  job->position = position;
+  job->uri = g_strdup (uri);
+  job->mime_type = g_strdup (mime_type);
+  job->mtime = mtime;
+  job->data = data;
+  job->data_free = data_free;
+
+  g_atomic_int_inc (&pool->ref_count);
+  g_thread_pool_push (pool->workers, job, NULL);
+}
+
+/**
+ * bg_thumbnail_pool_set_visible_range:
+ * @pool: a #BgThumbnailPool
+ * @start: the first visible position
+ * @end: the last visible position
+ *
+ * Moves the queued images between @start and @end to the front of the
+ * queue.
+ */
+void
+bg_thumbnail_pool_set_visible_range (BgThumbnailPool *pool,
+                                     gint             start,
+                                     gint             end)
+{
+  if (g_atomic_int_get (&pool->visible_start) == start &&
+      g_atomic_int_get (&pool->visible_end) == end)
+    return;
+
+  g_atomic_int_set (&pool->visible_start, start);
+  g_atomic_int_set (&pool->visible_end, end);
+
+  /* Setting the sort function again sorts the queue */
+  g_thread_pool_set_sort_function (pool->workers, compare_jobs, pool);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _BG_THUMBNAIL_POOL_H
+#define _BG_THUMBNAIL_POOL_H
+
+#include <gtk/gtk.h>
+#include <libgnome-desktop/gnome-desktop-thumbnail.h>
+
+G_BEGIN_DECLS
+
+/* A pool of worker threads making sure that images have an up to date
+ * thumbnail in the freedesktop.org thumbnail cache: thumbnails are looked
+ * up first, validated by the modification time of the image, and the
+ * missing ones are generated and written back, or recorded as failed.
+ * Only the thumbnail factory is used from the workers, as gnome-bg is not
+ * thread safe.
+ *
+ * Each image is queued with the position it is shown at, and the visible
+ * positions are done first. Destroying the pool drops the images which
+ * are not done yet, without calling back. */
+
+typedef struct _BgThumbnailPool BgThumbnailPool;
+
+/* Called from the workers, to skip an image before making its thumbnail */
+typedef gboolean (* BgThumbnailPoolFilter) (const char *uri,
+                                            const char *mime_type);
+
+/* Called on the main thread once the thumbnail of an image is in the
+ * cache; @thumbnail is only loaded if the pool was given a size, and is
+ * NULL if the image was skipped or no thumbnail could be made. */
+typedef void (* BgThumbnailPoolFunc) (gpointer   data,
+                                      GdkPixbuf *thumbnail,
+                                      gpointer   user_data);
+
+BgThumbnailPool *bg_thumbnail_pool_new               (GnomeDesktopThumbnailFactory *factory,
+                                                      gint                          width,
+                                                      gint                          height,
+                                                      BgThumbnailPoolFilter         filter,
+                                                      BgThumbnailPoolFunc           func,
+                                                      gpointer                      user_data);
+void             bg_thumbnail_pool_destroy           (BgThumbnailPool              *pool);
+
+void             bg_thumbnail_pool_add               (BgThumbnailPool              *pool,
+                                                      const char                   *uri,
+                                                      const char                   *mime_type,
+                                                      guint64                       mtime,
+                                                      gint                          position,
+                                                      gpointer                      data,
+                                                      GDestroyNotify                data_free);
+void             bg_thumbnail_pool_set_visible_range (BgThumbnailPool              *pool,
+                                                      gint                          start,
+                                                      gint                          end);
+
+G_END_DECLS
+
+#endif /* _BG_THUMBNAIL_POOL_H */
@@ -25,6 +25,7 @@
 
 #include "cc-background-item.h"
 #include "cc-background-xml.h"
+#include "bg-thumbnail-pool.h"
 
 #include <libgnome-desktop/gnome-desktop-thumbnail.h>
 #include <gio/gio.h>
@@ -38,9 +39,17 @@ struct _BgWallpapersSourcePrivate
 {
   GnomeDesktopThumbnailFactory *thumb_factory;
   CcBackgroundXml *xml;
+
+  BgThumbnailPool *thumbnails;
+  /* Shown until the thumbnail is ready, so the rows keep their size */
+  GdkPixbuf *placeholder;
 };
 
 
+static void item_added (CcBackgroundXml    *xml,
+                        CcBackgroundItem   *item,
+                        BgWallpapersSource *self);
+
 static void
 bg_wallpapers_source_get_property (GObject    *object,
                                    guint       property_id,
@@ -72,6 +81,13 @@ bg_wallpapers_source_dispose (GObject *object)
 {
   BgWallpapersSourcePrivate *priv = BG_WALLPAPERS_SOURCE (object)->priv;
 
+  if (priv->thumbnails)
+    {
+      bg_thumbnail_pool_destroy (priv->thumbnails);
+      priv->thumbnails = NULL;
+    }
+  g_clear_object (&priv->placeholder);
+
   if (priv->thumb_factory)
     {
       g_object_unref (priv->thumb_factory);
@@ -79,6 +95,7 @@ bg_wallpapers_source_dispose (GObject *object)
     }
   if (priv->xml)
     {
+      g_signal_handlers_disconnect_by_func (priv->xml, item_added, object);
       g_object_unref (priv->xml);
       priv->xml = NULL;
     }
@@ -92,10 +109,21 @@ bg_wallpapers_source_finalize (GObject *object)
   G_OBJECT_CLASS (bg_wallpapers_source_parent_class)->finalize (object);
 }
 
+static void
+bg_wallpapers_source_set_visible_range (BgSource *source,
+                                        gint      start,
+                                        gint      end)
+{
+  BgWallpapersSourcePrivate *priv = BG_WALLPAPERS_SOURCE (source)->priv;
+
+  bg_thumbnail_pool_set_visible_range (priv->thumbnails, start, end);
+}
+
 static void
 bg_wallpapers_source_class_init (BgWallpapersSourceClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  BgSourceClass *source_class = BG_SOURCE_CLASS (klass);
 
   g_type_class_add_private (klass, sizeof (BgWallpapersSourcePrivate));
 
@@ -103,6 +131,51 @@ bg_wallpapers_source_class_init (BgWallpapersSourceClass *klass)
   object_class->set_property = bg_wallpapers_source_set_property;
   object_class->dispose = bg_wallpapers_source_dispose;
   object_class->finalize = bg_wallpapers_source_finalize;
+
+  source_class->set_visible_range = bg_wallpapers_source_set_visible_range;
+}
+
+static void
+set_thumbnail (BgWallpapersSource *source,
+               GtkTreeModel       *model,
+               GtkTreeIter        *iter)
+{
+  BgWallpapersSourcePrivate *priv = source->priv;
+  CcBackgroundItem *item;
+  GIcon *pixbuf;
+
+  gtk_tree_model_get (model, iter, 1, &item, -1);
+
+  /* For plain images, gnome-bg finds the thumbnail in the cache now */
+  pixbuf = cc_background_item_get_thumbnail (item, priv->thumb_factory,
+					     THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+  if (pixbuf)
+    {
+      gtk_list_store_set (GTK_LIST_STORE (model), iter, 0, pixbuf, -1);
+      g_object_unref (pixbuf);
+    }
+
+  g_object_unref (item);
+}
+
+static void
+thumbnail_ready (GtkTreeRowReference *row,
+                 GdkPixbuf           *thumbnail,
+                 BgWallpapersSource  *source)
+{
+  GtkTreeModel *model;
+  GtkTreePath *path;
+  GtkTreeIter iter;
+
+  path = gtk_tree_row_reference_get_path (row);
+  if (path == NULL)
+    return;
+
+  model = gtk_tree_row_reference_get_model (row);
+  if (gtk_tree_model_get_iter (model, &iter, path))
+    set_thumbnail (source, model, &iter);
+
+  gtk_tree_path_free (path);
 }
 
 static void
@@ -112,7 +185,6 @@ load_wallpapers (gchar              *key,
 {
   BgWallpapersSourcePrivate *priv = source->priv;
   GtkTreeIter iter;
-  GIcon *pixbuf;
   GtkListStore *store = bg_source_get_liststore (BG_SOURCE (source));
   gboolean deleted;
 
@@ -123,17 +195,28 @@ load_wallpapers (gchar              *key,
 
   gtk_list_store_append (store, &iter);
 
-  pixbuf = cc_background_item_get_thumbnail (item, priv->thumb_factory,
-					     THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
-
   gtk_list_store_set (store, &iter,
-                      0, pixbuf,
+                      0, priv->placeholder,
                       1, g_object_ref (item),
                       2, cc_background_item_get_name (item),
                       -1);
 
-  if (pixbuf)
-    g_object_unref (pixbuf);
+  if (cc_background_item_get_uri (item) != NULL)
+    {
+      GtkTreePath *path;
+
+      path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), &iter);
+      bg_thumbnail_pool_add (priv->thumbnails,
+                             cc_background_item_get_uri (item), NULL, 0,
+                             gtk_tree_path_get_indices (path)[0],
+                             gtk_tree_row_reference_new (GTK_TREE_MODEL (store), path),
+                             (GDestroyNotify) gtk_tree_row_reference_free);
+      gtk_tree_path_free (path);
+    }
+  else
+    {
+      set_thumbnail (source, GTK_TREE_MODEL (store), &iter);
+    }
 }
 
 static void
@@ -184,6 +267,13 @@ bg_wallpapers_source_init (BgWallpapersSource *self)
 
   priv->thumb_factory =
     gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
+  priv->thumbnails = bg_thumbnail_pool_new (priv->thumb_factory, 0, 0, NULL,
+                                            (BgThumbnailPoolFunc) thumbnail_ready,
+                                            self);
+  priv->placeholder = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                      THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+  gdk_pixbuf_fill (priv->placeholder, 0x00000000);
+
   priv->xml = cc_background_xml_new ();
   g_signal_connect (G_OBJECT (priv->xml), "added",
 		    G_CALLBACK (item_added), self);
@@ -66,6 +66,7 @@ struct _CcBackgroundChooserDialogPrivate
 
   GnomeDesktopThumbnailFactory *thumb_factory;
   gint current_source;
+  BgSource *shown_source;
 
   GCancellable *copy_cancellable;
 
@@ -81,6 +82,36 @@ enum
 
 G_DEFINE_TYPE (CcBackgroundChooserDialog, cc_background_chooser_dialog, GTK_TYPE_DIALOG)
 
+static void
+update_visible_range (CcBackgroundChooserDialog *chooser)
+{
+  CcBackgroundChooserDialogPrivate *priv = chooser->priv;
+  GtkTreePath *start, *end;
+
+  if (priv->shown_source == NULL)
+    return;
+
+  if (!gtk_icon_view_get_visible_range (GTK_ICON_VIEW (priv->icon_view), &start, &end))
+    return;
+
+  bg_source_set_visible_range (priv->shown_source,
+                               gtk_tree_path_get_indices (start)[0],
+                               gtk_tree_path_get_indices (end)[0]);
+
+  gtk_tree_path_free (start);
+  gtk_tree_path_free (end);
+}
+
+static void
+show_source (CcBackgroundChooserDialog *chooser,
+             BgSource                  *source)
+{
+  chooser->priv->shown_source = source;
+  gtk_icon_view_set_model (GTK_ICON_VIEW (chooser->priv->icon_view),
+                           GTK_TREE_MODEL (bg_source_get_liststore (source)));
+  update_visible_range (chooser);
+}
+
 static void
 cc_background_chooser_dialog_realize (GtkWidget *widget)
 {
@@ -97,8 +128,7 @@ cc_background_chooser_dialog_realize (GtkWidget *widget)
       gtk_widget_set_size_request (GTK_WIDGET (chooser), (gint) (0.5 * width), (gint) (0.9 * height));
     }
 
-  gtk_icon_view_set_model (GTK_ICON_VIEW (chooser->priv->icon_view),
-                           GTK_TREE_MODEL (bg_source_get_liststore (BG_SOURCE (chooser->priv->wallpapers_source))));
+  show_source (chooser, BG_SOURCE (chooser->priv->wallpapers_source));
 
   GTK_WIDGET_CLASS (cc_background_chooser_dialog_parent_class)->realize (widget);
 }
@@ -117,6 +147,7 @@ cc_background_chooser_dialog_dispose (GObject *object)
       g_clear_object (&priv->copy_cancellable);
     }
 
+  priv->shown_source = NULL;
   g_clear_object (&priv->pictures_source);
   g_clear_object (&priv->colors_source);
   g_clear_object (&priv->wallpapers_source);
@@ -142,9 +173,7 @@ on_view_toggled (GtkToggleButton           *button,
     return;
 
   source = g_object_get_data (G_OBJECT (button), "source");
-  gtk_icon_view_set_model (GTK_ICON_VIEW (chooser->priv->icon_view),
-                           GTK_TREE_MODEL (bg_source_get_liststore (source)));
-
+  show_source (chooser, source);
 }
 
 static void
@@ -181,6 +210,7 @@ cc_background_chooser_dialog_init (CcBackgroundChooserDialog *chooser)
   GtkWidget *hbox;
   GtkWidget *grid;
   GtkStyleContext *context;
+  GtkAdjustment *adjustment;
 
   chooser->priv = CC_CHOOSER_DIALOG_GET_PRIVATE (chooser);
   priv = chooser->priv;
@@ -267,6 +297,11 @@ cc_background_chooser_dialog_init (CcBackgroundChooserDialog *chooser)
   g_signal_connect (priv->icon_view, "selection-changed", G_CALLBACK (on_selection_changed), chooser);
   g_signal_connect (priv->icon_view, "item-activated", G_CALLBACK (on_item_activated), chooser);
 
+  /* Thumbnails of the rows scrolled to are made first */
+  adjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (priv->icon_view));
+  g_signal_connect_swapped (adjustment, "value-changed", G_CALLBACK (update_visible_range), chooser);
+  g_signal_connect_swapped (adjustment, "changed", G_CALLBACK (update_visible_range), chooser);
+
   renderer = gtk_cell_renderer_pixbuf_new ();
   /* set stock size to 32px so that emblems render at 16px. see:
    * https://bugzilla.gnome.org/show_bug.cgi?id=682123#c4
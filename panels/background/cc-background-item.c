@@ -82,6 +82,11 @@ static void     cc_background_item_finalize       (GObject               *object
 
 G_DEFINE_TYPE (CcBackgroundItem, cc_background_item, G_TYPE_OBJECT)
 
+/* gnome-bg keeps a cache of the files it loaded which is shared by all the
+ * GnomeBG objects and is not thread safe, so it is only ever used with
+ * this lock held, allowing items to be rendered from other threads */
+static GRecMutex bg_lock;
+
 static GEmblem *
 get_slideshow_icon (void)
 {
@@ -132,7 +137,9 @@ cc_background_item_changes_with_time (CcBackgroundItem *item)
 
         changes = FALSE;
         if (item->priv->bg != NULL) {
+                g_rec_mutex_lock (&bg_lock);
                 changes = gnome_bg_changes_with_time (item->priv->bg);
+                g_rec_mutex_unlock (&bg_lock);
         }
         return changes;
 }
@@ -185,6 +192,8 @@ cc_background_item_get_frame_thumbnail (CcBackgroundItem             *item,
 	g_return_val_if_fail (CC_IS_BACKGROUND_ITEM (item), NULL);
 	g_return_val_if_fail (width > 0 && height > 0, NULL);
 
+        g_rec_mutex_lock (&bg_lock);
+
         set_bg_properties (item);
 
         if (force_size) {
@@ -235,6 +244,8 @@ cc_background_item_get_frame_thumbnail (CcBackgroundItem             *item,
 
         update_size (item);
 
+        g_rec_mutex_unlock (&bg_lock);
+
         return icon;
 }
 
@@ -309,7 +320,9 @@ cc_background_item_load (CcBackgroundItem *item,
         if (item->priv->mime_type != NULL
             && (g_str_has_prefix (item->priv->mime_type, "image/")
                 || strcmp (item->priv->mime_type, "application/xml") == 0)) {
+                g_rec_mutex_lock (&bg_lock);
                 set_bg_properties (item);
+                g_rec_mutex_unlock (&bg_lock);
         } else {
 		return FALSE;
         }
@@ -324,7 +337,9 @@ cc_background_item_load (CcBackgroundItem *item,
 					  &item->priv->width,
 					  &item->priv->height);
 		g_free (filename);
+		g_rec_mutex_lock (&bg_lock);
 		update_size (item);
+		g_rec_mutex_unlock (&bg_lock);
 	}
 
         return TRUE;
@@ -799,8 +814,11 @@ cc_background_item_finalize (GObject *object)
         g_free (item->priv->mime_type);
         g_free (item->priv->size);
 
-        if (item->priv->bg != NULL)
+        if (item->priv->bg != NULL) {
+                g_rec_mutex_lock (&bg_lock);
                 g_object_unref (item->priv->bg);
+                g_rec_mutex_unlock (&bg_lock);
+        }
 
         G_OBJECT_CLASS (cc_background_item_parent_class)->finalize (object);
 }
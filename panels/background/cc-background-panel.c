@@ -33,6 +33,7 @@
 #include "cc-background-chooser-dialog.h"
 #include "cc-background-item.h"
 #include "cc-background-resources.h"
+#include "cc-background-screenshot.h"
 #include "cc-background-xml.h"
 
 #include "bg-pictures-source.h"
@@ -44,6 +45,9 @@
 #define WP_PCOLOR_KEY "primary-color"
 #define WP_SCOLOR_KEY "secondary-color"
 
+#define PREVIEW_WIDTH 416
+#define PREVIEW_HEIGHT 248
+
 CC_PANEL_REGISTER (CcBackgroundPanel, cc_background_panel)
 
 #define BACKGROUND_PANEL_PRIVATE(o) \
@@ -65,8 +69,22 @@ struct _CcBackgroundPanelPrivate
 
   GtkWidget *spinner;
 
-  GdkPixbuf *display_screenshot;
-  char *screenshot_path;
+  /* The capture of the top of the screen, or of the whole screen with
+   * the workarea cleared, and where it is on the monitor */
+  cairo_surface_t *display_screenshot;
+  GdkRectangle screenshot_rect;
+  GdkRectangle monitor_rect;
+  gboolean capturing;
+  gboolean capture_failed;
+  /* Bumped whenever the screenshot changes */
+  guint screenshot_serial;
+
+  /* The composed preview, and what it was rendered for */
+  cairo_surface_t *preview_surface;
+  char *preview_key;
+  /* The preview being rendered, if any */
+  char *rendering_key;
+  GCancellable *preview_cancellable;
 };
 
 #define WID(y) (GtkWidget *) gtk_builder_get_object (priv->builder, y)
@@ -107,11 +125,20 @@ cc_background_panel_dispose (GObject *object)
       priv->capture_cancellable = NULL;
     }
 
-  g_clear_object (&priv->thumb_factory);
-  g_clear_object (&priv->display_screenshot);
+  if (priv->preview_cancellable)
+    {
+      /* the render itself can't be interrupted, but its result
+       * won't be used */
+      g_cancellable_cancel (priv->preview_cancellable);
+      g_clear_object (&priv->preview_cancellable);
+    }
+
+  g_clear_pointer (&priv->preview_surface, cairo_surface_destroy);
+  g_clear_pointer (&priv->preview_key, g_free);
+  g_clear_pointer (&priv->rendering_key, g_free);
 
-  g_free (priv->screenshot_path);
-  priv->screenshot_path = NULL;
+  g_clear_object (&priv->thumb_factory);
+  g_clear_pointer (&priv->display_screenshot, cairo_surface_destroy);
 
   g_clear_object (&priv->connection);
 
@@ -178,56 +205,183 @@ get_save_path (void)
                            NULL);
 }
 
-static void
-update_display_preview (CcBackgroundPanel *panel)
+/* Everything the composed preview depends on */
+static char *
+get_preview_key (CcBackgroundPanel *panel)
 {
   CcBackgroundPanelPrivate *priv = panel->priv;
-  GtkWidget *widget;
-  GtkAllocation allocation;
-  const gint preview_width = 416;
-  const gint preview_height = 248;
-  GdkPixbuf *pixbuf;
+  CcBackgroundItem *item = priv->current_background;
+
+  return g_strdup_printf ("%s|%d|%d|%s|%s|%dx%d|%u",
+                          cc_background_item_get_uri (item),
+                          cc_background_item_get_placement (item),
+                          cc_background_item_get_shading (item),
+                          cc_background_item_get_pcolor (item),
+                          cc_background_item_get_scolor (item),
+                          PREVIEW_WIDTH, PREVIEW_HEIGHT,
+                          priv->screenshot_serial);
+}
+
+typedef struct {
+  CcBackgroundItem *item;
+  GnomeDesktopThumbnailFactory *thumb_factory;
+  cairo_surface_t *screenshot;
+  GdkRectangle screenshot_rect;
+  GdkRectangle monitor_rect;
+  char *key;
+  cairo_surface_t *surface;
+} PreviewData;
+
+static void
+preview_data_free (PreviewData *data)
+{
+  g_object_unref (data->item);
+  g_object_unref (data->thumb_factory);
+  if (data->screenshot)
+    cairo_surface_destroy (data->screenshot);
+  g_free (data->key);
+  if (data->surface)
+    cairo_surface_destroy (data->surface);
+  g_free (data);
+}
+
+static void
+render_preview_thread (GSimpleAsyncResult *res,
+                       GObject            *object,
+                       GCancellable       *cancellable)
+{
+  PreviewData *data = g_simple_async_result_get_op_res_gpointer (res);
   GIcon *icon;
   cairo_t *cr;
 
-  widget = WID ("background-desktop-drawingarea");
-  gtk_widget_get_allocation (widget, &allocation);
-
-  if (!priv->current_background)
+  if (g_cancellable_is_cancelled (cancellable))
     return;
 
-  icon = cc_background_item_get_frame_thumbnail (priv->current_background,
-                                                 priv->thumb_factory,
-                                                 preview_width,
-                                                 preview_height,
+  data->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                              PREVIEW_WIDTH, PREVIEW_HEIGHT);
+  cr = cairo_create (data->surface);
+
+  icon = cc_background_item_get_frame_thumbnail (data->item,
+                                                 data->thumb_factory,
+                                                 PREVIEW_WIDTH,
+                                                 PREVIEW_HEIGHT,
                                                  -2, TRUE);
-  pixbuf = GDK_PIXBUF (icon);
-
-  cr = gdk_cairo_create (gtk_widget_get_window (widget));
-  gdk_cairo_set_source_pixbuf (cr,
-                               pixbuf,
-                               0, 0);
-  cairo_paint (cr);
-  g_object_unref (pixbuf);
-
-  pixbuf = NULL;
-  if (panel->priv->display_screenshot != NULL)
-    pixbuf = gdk_pixbuf_scale_simple (panel->priv->display_screenshot,
-                                      preview_width,
-                                      preview_height,
-                                      GDK_INTERP_BILINEAR);
-
-  if (pixbuf)
+  if (icon != NULL)
+    {
+      gdk_cairo_set_source_pixbuf (cr, GDK_PIXBUF (icon), 0, 0);
+      cairo_paint (cr);
+      g_object_unref (icon);
+    }
+
+  if (data->screenshot != NULL)
     {
-      gdk_cairo_set_source_pixbuf (cr,
-                                   pixbuf,
-                                   0, 0);
+      cairo_save (cr);
+      cairo_scale (cr,
+                   (double) PREVIEW_WIDTH / data->monitor_rect.width,
+                   (double) PREVIEW_HEIGHT / data->monitor_rect.height);
+      cairo_set_source_surface (cr, data->screenshot,
+                                data->screenshot_rect.x - data->monitor_rect.x,
+                                data->screenshot_rect.y - data->monitor_rect.y);
+      cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
       cairo_paint (cr);
+      cairo_restore (cr);
     }
 
   cairo_destroy (cr);
 }
 
+static void
+on_preview_rendered (GObject      *source,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+  CcBackgroundPanel *panel = CC_BACKGROUND_PANEL (source);
+  CcBackgroundPanelPrivate *priv = panel->priv;
+  PreviewData *data;
+
+  data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (res));
+
+  /* the panel was disposed in the meantime */
+  if (priv->builder == NULL || data->surface == NULL)
+    return;
+
+  g_clear_pointer (&priv->rendering_key, g_free);
+
+  g_clear_pointer (&priv->preview_surface, cairo_surface_destroy);
+  g_free (priv->preview_key);
+  priv->preview_surface = data->surface;
+  priv->preview_key = data->key;
+  data->surface = NULL;
+  data->key = NULL;
+
+  /* draws the new preview, or renders again if it is out of date */
+  gtk_widget_queue_draw (WID ("background-desktop-drawingarea"));
+}
+
+/* Renders the preview in a thread; only one preview is rendered at a
+ * time, the latest one is picked up when it is done */
+static void
+render_preview_async (CcBackgroundPanel *panel,
+                      const char        *key)
+{
+  CcBackgroundPanelPrivate *priv = panel->priv;
+  GSimpleAsyncResult *result;
+  PreviewData *data;
+
+  if (priv->rendering_key != NULL)
+    return;
+
+  data = g_new0 (PreviewData, 1);
+  /* the render changes the item, so it works on a copy */
+  data->item = cc_background_item_copy (priv->current_background);
+  data->thumb_factory = g_object_ref (priv->thumb_factory);
+  if (priv->display_screenshot != NULL)
+    {
+      data->screenshot = cairo_surface_reference (priv->display_screenshot);
+      data->screenshot_rect = priv->screenshot_rect;
+      data->monitor_rect = priv->monitor_rect;
+    }
+  data->key = g_strdup (key);
+
+  priv->rendering_key = g_strdup (key);
+
+  result = g_simple_async_result_new (G_OBJECT (panel), on_preview_rendered,
+                                      NULL, render_preview_async);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+                                             (GDestroyNotify) preview_data_free);
+  g_simple_async_result_run_in_thread (result, render_preview_thread,
+                                       G_PRIORITY_DEFAULT,
+                                       priv->preview_cancellable);
+  g_object_unref (result);
+}
+
+static void
+update_display_preview (CcBackgroundPanel *panel,
+                        cairo_t           *cr)
+{
+  CcBackgroundPanelPrivate *priv = panel->priv;
+  char *key;
+
+  if (!priv->current_background)
+    return;
+
+  /* the preview is rendered once the screenshot is there */
+  if (!priv->capturing)
+    {
+      key = get_preview_key (panel);
+      if (g_strcmp0 (key, priv->preview_key) != 0)
+        render_preview_async (panel, key);
+      g_free (key);
+    }
+
+  /* until the new one is ready, the previous one is shown */
+  if (priv->preview_surface != NULL)
+    {
+      cairo_set_source_surface (cr, priv->preview_surface, 0, 0);
+      cairo_paint (cr);
+    }
+}
+
 typedef struct {
   CcBackgroundPanel *panel;
   GdkRectangle capture_rect;
@@ -245,81 +399,51 @@ on_screenshot_finished (GObject *source,
   CcBackgroundPanel *panel = data->panel;
   CcBackgroundPanelPrivate *priv;
   GError *error;
-  GdkPixbuf *pixbuf;
   cairo_surface_t *surface;
   cairo_t *cr;
-  GVariant *result;
-  int width;
-  int height;
 
   error = NULL;
-  result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source),
-                                          res,
-                                          &error);
+  surface = cc_background_screenshot_capture_finish (res, &error);
 
-  if (result == NULL) {
-    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
-      g_error_free (error);
-      return;
-    }
-    g_debug ("Unable to get screenshot: %s",
-             error->message);
+  if (surface == NULL &&
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
     g_error_free (error);
-    /* fallback? */
-    goto out;
+    g_free (data);
+    return;
   }
-  g_variant_unref (result);
 
   priv = panel->priv;
 
-  pixbuf = gdk_pixbuf_new_from_file (panel->priv->screenshot_path, &error);
-  if (pixbuf == NULL)
-    {
-      g_debug ("Unable to use GNOME Shell's builtin screenshot interface: %s",
-               error->message);
-      g_error_free (error);
-      goto out;
-    }
-
-  width = gdk_pixbuf_get_width (pixbuf);
-  height = gdk_pixbuf_get_height (pixbuf);
-  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                        width, height);
-  cr = cairo_create (surface);
-  gdk_cairo_set_source_pixbuf (cr, pixbuf, data->capture_rect.x, data->capture_rect.y);
-  cairo_paint (cr);
-  g_object_unref (pixbuf);
+  if (surface == NULL) {
+    g_debug ("Unable to get screenshot: %s",
+             error->message);
+    g_error_free (error);
+    priv->capture_failed = TRUE;
+    goto out;
+  }
 
   if (data->whole_monitor) {
     /* clear the workarea */
-    cairo_save (cr);
+    cr = cairo_create (surface);
     cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
     cairo_rectangle (cr, data->workarea_rect.x - data->monitor_rect.x,
                      data->workarea_rect.y - data->monitor_rect.y,
                      data->workarea_rect.width,
                      data->workarea_rect.height);
     cairo_fill (cr);
-    cairo_restore (cr);
+    cairo_destroy (cr);
   }
 
-  g_clear_object (&panel->priv->display_screenshot);
-  panel->priv->display_screenshot = gdk_pixbuf_get_from_surface (surface,
-                                                                 0, 0,
-                                                                 data->monitor_rect.width,
-                                                                 data->monitor_rect.height);
-
-  g_free (data);
-
-  /* remove the temporary file created by the shell */
-  g_unlink (panel->priv->screenshot_path);
-  g_free (priv->screenshot_path);
-  priv->screenshot_path = NULL;
-
-  cairo_destroy (cr);
-  cairo_surface_destroy (surface);
+  g_clear_pointer (&priv->display_screenshot, cairo_surface_destroy);
+  priv->display_screenshot = surface;
+  priv->screenshot_rect = data->capture_rect;
+  priv->monitor_rect = data->monitor_rect;
+  priv->screenshot_serial++;
 
  out:
-  update_display_preview (panel);
+  g_free (data);
+  priv->capturing = FALSE;
+  gtk_widget_queue_draw (WID ("background-desktop-drawingarea"));
 }
 
 static gboolean
@@ -344,15 +468,13 @@ static void
 get_screenshot_async (CcBackgroundPanel *panel)
 {
   CcBackgroundPanelPrivate *priv = panel->priv;
-  gchar *path, *tmpname;
-  const gchar *method_name;
-  GVariant *method_params;
   GtkWidget *widget;
   ScreenshotData *data;
   int primary;
 
   data = g_new0 (ScreenshotData, 1);
   data->panel = panel;
+  priv->capturing = TRUE;
 
   widget = WID ("background-desktop-drawingarea");
   primary = gdk_screen_get_primary_monitor (gtk_widget_get_screen (widget));
@@ -369,34 +491,11 @@ get_screenshot_async (CcBackgroundPanel *panel)
   g_debug ("Trying to capture rectangle %dx%d (at %d,%d)",
            data->capture_rect.width, data->capture_rect.height, data->capture_rect.x, data->capture_rect.y);
 
-  path = g_build_filename (g_get_user_cache_dir (), "gnome-control-center", NULL);
-  g_mkdir_with_parents (path, 0700);
-
-  tmpname = g_strdup_printf ("scr-%d.png", g_random_int ());
-  g_free (panel->priv->screenshot_path);
-  panel->priv->screenshot_path = g_build_filename (path, tmpname, NULL);
-  g_free (path);
-  g_free (tmpname);
-
-  method_name = "ScreenshotArea";
-  method_params = g_variant_new ("(iiiibs)",
-                                 data->capture_rect.x, data->capture_rect.y,
-                                 data->capture_rect.width, data->capture_rect.height,
-                                 FALSE, /* flash */
-                                 panel->priv->screenshot_path);
-
-  g_dbus_connection_call (panel->priv->connection,
-                          "org.gnome.Shell.Screenshot",
-                          "/org/gnome/Shell/Screenshot",
-                          "org.gnome.Shell.Screenshot",
-                          method_name,
-                          method_params,
-                          NULL,
-                          G_DBUS_CALL_FLAGS_NONE,
-                          -1,
-                          priv->capture_cancellable,
-                          on_screenshot_finished,
-                          data);
+  cc_background_screenshot_capture_async (priv->connection,
+                                          &data->capture_rect,
+                                          priv->capture_cancellable,
+                                          on_screenshot_finished,
+                                          data);
 }
 
 static gboolean
@@ -406,12 +505,13 @@ on_preview_draw (GtkWidget         *widget,
 {
   /* we have another shot in flight or an existing cache */
   if (panel->priv->display_screenshot == NULL
-      && panel->priv->screenshot_path == NULL)
+      && !panel->priv->capturing
+      && !panel->priv->capture_failed)
     {
       get_screenshot_async (panel);
     }
-  else
-    update_display_preview (panel);
+
+  update_display_preview (panel, cr);
 
   return TRUE;
 }
@@ -768,6 +868,7 @@ cc_background_panel_init (CcBackgroundPanel *self)
 
   priv->copy_cancellable = g_cancellable_new ();
   priv->capture_cancellable = g_cancellable_new ();
+  priv->preview_cancellable = g_cancellable_new ();
 
   priv->thumb_factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
 
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <config.h>
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "cc-background-screenshot.h"
+
+/* Set once the shell refused to write to a memory file, so that the
+ * following captures go straight to a temporary file */
+static gboolean memfd_unsupported = FALSE;
+
+typedef struct {
+  GDBusConnection *connection;
+  cairo_rectangle_int_t area;
+  GCancellable *cancellable;
+
+  /* the memory file, and its name for the shell */
+  int fd;
+  char *fd_path;
+  /* the file the shell wrote to, when it isn't the memory file */
+  char *path;
+
+  cairo_surface_t *surface;
+} CaptureData;
+
+typedef struct {
+  const guchar *data;
+  gsize length;
+  gsize offset;
+} PngReader;
+
+static void
+capture_data_free (CaptureData *data)
+{
+  g_object_unref (data->connection);
+  g_clear_object (&data->cancellable);
+  if (data->fd >= 0)
+    close (data->fd);
+  g_free (data->fd_path);
+  g_free (data->path);
+  if (data->surface)
+    cairo_surface_destroy (data->surface);
+  g_slice_free (CaptureData, data);
+}
+
+static int
+create_memfd (void)
+{
+#ifdef HAVE_MEMFD_CREATE
+  if (!memfd_unsupported)
+    return memfd_create ("cc-background-screenshot", MFD_CLOEXEC);
+#endif
+  return -1;
+}
+
+static char *
+create_temporary_path (void)
+{
+  char *dir, *name, *path;
+
+  dir = g_build_filename (g_get_user_cache_dir (), "gnome-control-center", NULL);
+  g_mkdir_with_parents (dir, 0700);
+
+  name = g_strdup_printf ("scr-%d.png", g_random_int ());
+  path = g_build_filename (dir, name, NULL);
+  g_free (dir);
+  g_free (name);
+
+  return path;
+}
+
+static cairo_status_t
+read_png (void          *closure,
+          unsigned char *buffer,
+          unsigned int   length)
+{
+  PngReader *reader = closure;
+
+  if (reader->length - reader->offset < length)
+    return CAIRO_STATUS_READ_ERROR;
+
+  memcpy (buffer, reader->data + reader->offset, length);
+  reader->offset += length;
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+decode_memfd (int      fd,
+              GError **error)
+{
+  cairo_surface_t *surface;
+  PngReader reader;
+  struct stat buf;
+  void *map;
+
+  if (fstat (fd, &buf) != 0)
+    {
+      int errsv = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Unable to stat the screenshot: %s", g_strerror (errsv));
+      return NULL;
+    }
+
+  if (buf.st_size == 0)
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "The screenshot is empty");
+      return NULL;
+    }
+
+  map = mmap (NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    {
+      int errsv = errno;
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Unable to map the screenshot: %s", g_strerror (errsv));
+      return NULL;
+    }
+
+  reader.data = map;
+  reader.length = buf.st_size;
+  reader.offset = 0;
+  surface = cairo_image_surface_create_from_png_stream (read_png, &reader);
+
+  munmap (map, buf.st_size);
+
+  return surface;
+}
+
+static void
+decode_thread (GSimpleAsyncResult *result,
+               GObject            *object,
+               GCancellable       *cancellable)
+{
+  CaptureData *data = g_simple_async_result_get_op_res_gpointer (result);
+  GError *error = NULL;
+
+  if (data->path == NULL)
+    {
+      data->surface = decode_memfd (data->fd, &error);
+    }
+  else
+    {
+      data->surface = cairo_image_surface_create_from_png (data->path);
+      /* remove the temporary file created by the shell */
+      g_unlink (data->path);
+    }
+
+  if (data->surface == NULL)
+    {
+      g_simple_async_result_take_error (result, error);
+      return;
+    }
+
+  if (cairo_surface_status (data->surface) != CAIRO_STATUS_SUCCESS)
+    {
+      g_simple_async_result_set_error (result, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                                       "Unable to read the screenshot: %s",
+                                       cairo_status_to_string (cairo_surface_status (data->surface)));
+      g_clear_pointer (&data->surface, cairo_surface_destroy);
+      return;
+    }
+
+  /* should the shell have captured more than asked for, crop it */
+  if (cairo_image_surface_get_width (data->surface) > data->area.width ||
+      cairo_image_surface_get_height (data->surface) > data->area.height)
+    {
+      cairo_surface_t *cropped;
+      cairo_t *cr;
+
+      cropped = cairo_image_surface_create (cairo_image_surface_get_format (data->surface),
+                                            data->area.width, data->area.height);
+      cr = cairo_create (cropped);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_surface (cr, data->surface, 0, 0);
+      cairo_paint (cr);
+      cairo_destroy (cr);
+
+      cairo_surface_destroy (data->surface);
+      data->surface = cropped;
+    }
+}
+
+static void capture (GSimpleAsyncResult *result);
+
+static void
+on_capture_finished (GObject      *source,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+  GSimpleAsyncResult *result = user_data;
+  CaptureData *data = g_simple_async_result_get_op_res_gpointer (result);
+  GError *error = NULL;
+  GVariant *ret;
+  const char *filename_used;
+  gboolean success;
+
+  ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+  if (ret == NULL)
+    {
+      g_simple_async_result_take_error (result, error);
+      g_simple_async_result_complete (result);
+      g_object_unref (result);
+      return;
+    }
+
+  g_variant_get (ret, "(b&s)", &success, &filename_used);
+
+  if (!success && data->path == NULL)
+    {
+      g_debug ("The shell can't write the screenshot to %s, using a temporary file",
+               data->fd_path);
+      memfd_unsupported = TRUE;
+      g_variant_unref (ret);
+
+      close (data->fd);
+      data->fd = -1;
+      capture (result);
+      return;
+    }
+
+  if (!success)
+    {
+      g_simple_async_result_set_error (result, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                       "The shell failed to capture the screen");
+      g_simple_async_result_complete (result);
+      g_variant_unref (ret);
+      g_object_unref (result);
+      return;
+    }
+
+  /* the shell may have picked another name than the one it was given */
+  if (g_strcmp0 (filename_used, data->path != NULL ? data->path : data->fd_path) != 0)
+    {
+      g_free (data->path);
+      data->path = g_strdup (filename_used);
+    }
+  g_variant_unref (ret);
+
+  g_simple_async_result_run_in_thread (result, decode_thread,
+                                       G_PRIORITY_DEFAULT,
+                                       data->cancellable);
+  g_object_unref (result);
+}
+
+static void
+capture (GSimpleAsyncResult *result)
+{
+  CaptureData *data = g_simple_async_result_get_op_res_gpointer (result);
+  const char *path;
+
+  if (data->fd < 0)
+    data->fd = create_memfd ();
+
+  if (data->fd >= 0)
+    {
+      g_free (data->fd_path);
+      data->fd_path = g_strdup_printf ("/proc/%d/fd/%d", (int) getpid (), data->fd);
+      path = data->fd_path;
+    }
+  else
+    {
+      g_free (data->path);
+      data->path = create_temporary_path ();
+      path = data->path;
+    }
+
+  g_debug ("Capturing %dx%d (at %d,%d) to %s",
+           data->area.width, data->area.height, data->area.x, data->area.y, path);
+
+  g_dbus_connection_call (data->connection,
+                          "org.gnome.Shell.Screenshot",
+                          "/org/gnome/Shell/Screenshot",
+                          "org.gnome.Shell.Screenshot",
+                          "ScreenshotArea",
+                          g_variant_new ("(iiiibs)",
+                                         data->area.x, data->area.y,
+                                         data->area.width, data->area.height,
+                                         FALSE, /* flash */
+                                         path),
+                          G_VARIANT_TYPE ("(bs)"),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          data->cancellable,
+                          on_capture_finished,
+                          result);
+}
+
+/**
+ * cc_background_screenshot_capture_async:
+ * @connection: the session bus
+ * @area: the area of the screen to capture
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called on the thread default main context of the caller
+ * @user_data: data for @callback
+ */
+void
+cc_background_screenshot_capture_async (GDBusConnection             *connection,
+                                        const cairo_rectangle_int_t *area,
+                                        GCancellable                *cancellable,
+                                        GAsyncReadyCallback          callback,
+                                        gpointer                     user_data)
+{
+  GSimpleAsyncResult *result;
+  CaptureData *data;
+
+  g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+  g_return_if_fail (area != NULL && area->width > 0 && area->height > 0);
+
+  data = g_slice_new0 (CaptureData);
+  data->connection = g_object_ref (connection);
+  data->area = *area;
+  if (cancellable != NULL)
+    data->cancellable = g_object_ref (cancellable);
+  data->fd = -1;
+
+  result = g_simple_async_result_new (NULL, callback, user_data,
+                                      cc_background_screenshot_capture_async);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+                                             (GDestroyNotify) capture_data_free);
+  g_simple_async_result_set_check_cancellable (result, cancellable);
+
+  capture (result);
+}
+
+/**
+ * cc_background_screenshot_capture_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full): an image surface of the size of the captured
+ * area, or %NULL
+ */
+cairo_surface_t *
+cc_background_screenshot_capture_finish (GAsyncResult  *result,
+                                         GError       **error)
+{
+  CaptureData *data;
+
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+                                                        cc_background_screenshot_capture_async),
+                        NULL);
+
+  if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result), error))
+    return NULL;
+
+  data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+
+  return cairo_surface_reference (data->surface);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _CC_BACKGROUND_SCREENSHOT_H
+#define _CC_BACKGROUND_SCREENSHOT_H
+
+#include <gio/gio.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+/* Captures an area of the screen through GNOME Shell's screenshot
+ * interface, straight into a cairo image surface.
+ *
+ * The shell only takes a file name to write the capture to, so it is
+ * pointed at an anonymous memory file of ours, through /proc, and the
+ * PNG is decoded from the memory mapping of that file. When the memory
+ * file can't be created, or the shell refuses to write to it, a temporary
+ * file in the user cache directory is used instead, and removed once
+ * read. */
+
+void             cc_background_screenshot_capture_async  (GDBusConnection             *connection,
+                                                          const cairo_rectangle_int_t *area,
+                                                          GCancellable                *cancellable,
+                                                          GAsyncReadyCallback          callback,
+                                                          gpointer                     user_data);
+cairo_surface_t *cc_background_screenshot_capture_finish (GAsyncResult                *result,
+                                                          GError                     **error);
+
+G_END_DECLS
+
+#endif /* _CC_BACKGROUND_SCREENSHOT_H */
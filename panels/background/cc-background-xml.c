@@ -21,8 +21,11 @@
  */
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 #include <libgnome-desktop/gnome-bg.h>
 #include <gdesktop-enums.h>
 
@@ -30,17 +33,40 @@
 #include "cc-background-item.h"
 #include "cc-background-xml.h"
 
-/* The number of items we signal as "added" before
- * returning to the main loop */
-#define NUM_ITEMS_PER_BATCH 1
+/* The most threads parsing the catalogs at once */
+#define MAX_PARSE_THREADS 4
+
+/* Bump when the cache format changes */
+#define CATALOG_CACHE_VERSION 1
+#define CATALOG_CACHE_TYPE "(uxxsa(bbmsmsmsmsmsmsmsms))"
 
 struct CcBackgroundXmlPrivate
 {
+  /* Only used from the main thread */
   GHashTable  *wp_hash;
-  GAsyncQueue *item_added_queue;
-  guint        item_added_id;
 };
 
+/* A wallpaper as read from a catalog, before it gets checked and turned
+ * into a CcBackgroundItem on the main thread */
+typedef struct {
+  gboolean  deleted;
+  gboolean  has_uri;
+  char     *uri;
+  char     *name;
+  char     *cname; /* the untranslated name */
+  char     *options;
+  char     *shade_type;
+  char     *pcolor;
+  char     *scolor;
+  char     *source_url;
+} CatalogEntry;
+
+typedef struct {
+  CcBackgroundXml *xml;
+  char            *filename;
+  GPtrArray       *entries;
+} CatalogResult;
+
 #define CC_BACKGROUND_XML_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), CC_TYPE_BACKGROUND_XML, CcBackgroundXmlPrivate))
 
 enum {
@@ -57,26 +83,12 @@ static void     cc_background_xml_finalize       (GObject              *object);
 G_DEFINE_TYPE (CcBackgroundXml, cc_background_xml, G_TYPE_OBJECT)
 
 static gboolean
-cc_background_xml_get_bool (const xmlNode *parent,
-			    const gchar   *prop_name)
+parse_bool (const xmlChar *value)
 {
-  xmlChar * prop;
-  gboolean ret_val = FALSE;
-
-  g_return_val_if_fail (parent != NULL, FALSE);
-  g_return_val_if_fail (prop_name != NULL, FALSE);
-
-  prop = xmlGetProp ((xmlNode *) parent, (xmlChar*)prop_name);
-  if (prop != NULL) {
-    if (!g_ascii_strcasecmp ((gchar *)prop, "true") || !g_ascii_strcasecmp ((gchar *)prop, "1")) {
-      ret_val = TRUE;
-    } else {
-      ret_val = FALSE;
-    }
-    g_free (prop);
-  }
+  if (value == NULL)
+    return FALSE;
 
-  return ret_val;
+  return !g_ascii_strcasecmp ((gchar *) value, "true") || !g_ascii_strcasecmp ((gchar *) value, "1");
 }
 
 static struct {
@@ -112,216 +124,480 @@ enum_string_to_value (GType type,
 	return value->value;
 }
 
-static gboolean
-idle_emit (CcBackgroundXml *xml)
+static void
+catalog_entry_free (CatalogEntry *entry)
 {
-	GObject *item;
-	guint i = NUM_ITEMS_PER_BATCH;
+  g_free (entry->uri);
+  g_free (entry->name);
+  g_free (entry->cname);
+  g_free (entry->options);
+  g_free (entry->shade_type);
+  g_free (entry->pcolor);
+  g_free (entry->scolor);
+  g_free (entry->source_url);
+  g_slice_free (CatalogEntry, entry);
+}
 
-	g_async_queue_lock (xml->priv->item_added_queue);
+#define NONE "(none)"
 
-	while (i > 0 && (item = g_async_queue_try_pop_unlocked (xml->priv->item_added_queue)) != NULL) {
-		g_signal_emit (G_OBJECT (xml), signals[ADDED], 0, item);
-		g_object_unref (item);
-		i--;
-	}
+static char *
+read_content (xmlTextReaderPtr reader)
+{
+  xmlChar *content;
+  char *ret;
 
-	g_async_queue_unlock (xml->priv->item_added_queue);
+  content = xmlTextReaderReadString (reader);
+  if (content == NULL)
+    return NULL;
 
-        if (g_async_queue_length (xml->priv->item_added_queue) > 0) {
-                return TRUE;
-        } else {
-                xml->priv->item_added_id = 0;
-                return FALSE;
-        }
-}
+  ret = g_strdup (g_strstrip ((gchar *) content));
+  xmlFree (content);
 
-static void
-emit_added_in_idle (CcBackgroundXml *xml,
-		    GObject         *object)
-{
-	g_async_queue_lock (xml->priv->item_added_queue);
-	g_async_queue_push_unlocked (xml->priv->item_added_queue, object);
-	if (xml->priv->item_added_id == 0)
-		xml->priv->item_added_id = g_idle_add ((GSourceFunc) idle_emit, xml);
-	g_async_queue_unlock (xml->priv->item_added_queue);
+  return ret;
 }
 
-#define NONE "(none)"
-#define UNSET_FLAG(flag) G_STMT_START{ (flags&=~(flag)); }G_STMT_END
-#define SET_FLAG(flag) G_STMT_START{ (flags|=flag); }G_STMT_END
-
+/* Reads the child element the reader is on into @entry. Returns FALSE
+ * if the rest of the wallpaper should be ignored, as the tree parser
+ * used to do for empty names and filenames. */
 static gboolean
-cc_background_xml_load_xml_internal (CcBackgroundXml *xml,
-				     const gchar     *filename,
-				     gboolean         in_thread)
+read_wallpaper_child (xmlTextReaderPtr    reader,
+                      CatalogEntry       *entry,
+                      const gchar * const *syslangs)
 {
-  xmlDoc * wplist;
-  xmlNode * root, * list, * wpa;
-  xmlChar * nodelang;
-  const gchar * const * syslangs;
+  const char *element;
+  char *content;
   gint i;
-  gboolean retval;
 
-  wplist = xmlParseFile (filename);
-  retval = FALSE;
+  element = (const char *) xmlTextReaderConstLocalName (reader);
+  content = read_content (reader);
+
+  if (!strcmp (element, "filename")) {
+    if (content == NULL)
+      return FALSE;
+
+    /* FIXME same rubbish as in other parts of the code */
+    g_free (entry->uri);
+    if (strcmp (content, NONE) == 0) {
+      entry->uri = NULL;
+    } else {
+      GFile *file;
+      file = g_file_new_for_commandline_arg (content);
+      entry->uri = g_file_get_uri (file);
+      g_object_unref (file);
+    }
+    entry->has_uri = TRUE;
+  } else if (!strcmp (element, "name")) {
+    const char *nodelang;
+
+    if (content == NULL)
+      return FALSE;
+
+    nodelang = (const char *) xmlTextReaderConstXmlLang (reader);
+
+    if (entry->name == NULL && nodelang == NULL) {
+      entry->cname = g_strdup (content);
+      entry->name = g_strdup (content);
+    } else if (nodelang != NULL) {
+      for (i = 0; syslangs[i] != NULL; i++) {
+        if (!strcmp (syslangs[i], nodelang)) {
+          g_free (entry->name);
+          entry->name = g_strdup (content);
+          break;
+        }
+      }
+    }
+  } else if (!strcmp (element, "options")) {
+    g_free (entry->options);
+    entry->options = g_strdup (content);
+  } else if (!strcmp (element, "shade_type")) {
+    g_free (entry->shade_type);
+    entry->shade_type = g_strdup (content);
+  } else if (!strcmp (element, "pcolor")) {
+    g_free (entry->pcolor);
+    entry->pcolor = g_strdup (content);
+  } else if (!strcmp (element, "scolor")) {
+    g_free (entry->scolor);
+    entry->scolor = g_strdup (content);
+  } else if (!strcmp (element, "source_url")) {
+    g_free (entry->source_url);
+    entry->source_url = g_strdup (content);
+  } else {
+    g_warning ("Unknown Tag: %s", element);
+  }
 
-  if (!wplist)
-    return retval;
+  g_free (content);
+
+  return TRUE;
+}
+
+/* Reads the wallpapers of a catalog with a streaming parser, as only a
+ * few elements of each wallpaper are needed */
+static GPtrArray *
+parse_catalog (const gchar *filename)
+{
+  xmlTextReaderPtr reader;
+  const gchar * const *syslangs;
+  GPtrArray *entries;
+  CatalogEntry *entry = NULL;
+  gboolean skip = FALSE;
+  int ret;
+
+  reader = xmlReaderForFile (filename, NULL, XML_PARSE_NONET | XML_PARSE_NOWARNING | XML_PARSE_NOERROR);
+  if (reader == NULL)
+    return NULL;
 
   syslangs = g_get_language_names ();
+  entries = g_ptr_array_new_with_free_func ((GDestroyNotify) catalog_entry_free);
+
+  while ((ret = xmlTextReaderRead (reader)) == 1) {
+    int type = xmlTextReaderNodeType (reader);
+    int depth = xmlTextReaderDepth (reader);
+
+    if (depth == 1 && type == XML_READER_TYPE_ELEMENT &&
+        !strcmp ((const char *) xmlTextReaderConstLocalName (reader), "wallpaper")) {
+      xmlChar *deleted;
+
+      entry = g_slice_new0 (CatalogEntry);
+      deleted = xmlTextReaderGetAttribute (reader, (const xmlChar *) "deleted");
+      entry->deleted = parse_bool (deleted);
+      xmlFree (deleted);
+      g_ptr_array_add (entries, entry);
+      skip = FALSE;
+
+      if (xmlTextReaderIsEmptyElement (reader))
+        entry = NULL;
+    } else if (depth == 1 && type == XML_READER_TYPE_END_ELEMENT) {
+      entry = NULL;
+    } else if (depth == 2 && type == XML_READER_TYPE_ELEMENT && entry != NULL && !skip) {
+      skip = !read_wallpaper_child (reader, entry, syslangs);
+    }
+  }
 
-  root = xmlDocGetRootElement (wplist);
+  xmlFreeTextReader (reader);
 
-  for (list = root->children; list != NULL; list = list->next) {
-    if (!strcmp ((gchar *)list->name, "wallpaper")) {
-      CcBackgroundItem * item;
-      CcBackgroundItemFlags flags;
-      char *uri, *cname, *id;
+  /* Not well-formed */
+  if (ret != 0) {
+    g_ptr_array_unref (entries);
+    return NULL;
+  }
 
-      flags = 0;
-      cname = NULL;
-      item = cc_background_item_new (NULL);
+  return entries;
+}
 
-      g_object_set (G_OBJECT (item),
-		    "is-deleted", cc_background_xml_get_bool (list, "deleted"),
-		    "source-xml", filename,
-		    NULL);
+static char *
+get_language_key (void)
+{
+  return g_strjoinv (":", (gchar **) g_get_language_names ());
+}
 
-      for (wpa = list->children; wpa != NULL; wpa = wpa->next) {
-	if (wpa->type == XML_COMMENT_NODE) {
-	  continue;
-	} else if (!strcmp ((gchar *)wpa->name, "filename")) {
-	  if (wpa->last != NULL && wpa->last->content != NULL) {
-	    gchar *content = g_strstrip ((gchar *)wpa->last->content);
-	    char *bg_uri;
-
-	    /* FIXME same rubbish as in other parts of the code */
-	    if (strcmp (content, NONE) == 0) {
-	      bg_uri = NULL;
-	    } else {
-	      GFile *file;
-	      file = g_file_new_for_commandline_arg (content);
-	      bg_uri = g_file_get_uri (file);
-	      g_object_unref (file);
-	    }
-	    SET_FLAG(CC_BACKGROUND_ITEM_HAS_URI);
-	    g_object_set (G_OBJECT (item), "uri", bg_uri, NULL);
-	    g_free (bg_uri);
-	  } else {
-	    break;
-	  }
-	} else if (!strcmp ((gchar *)wpa->name, "name")) {
-	  if (wpa->last != NULL && wpa->last->content != NULL) {
-	    char *name;
-	    nodelang = xmlNodeGetLang (wpa->last);
-
-	    g_object_get (G_OBJECT (item), "name", &name, NULL);
-
-	    if (name == NULL && nodelang == NULL) {
-	       g_free (cname);
-	       cname = g_strdup (g_strstrip ((gchar *)wpa->last->content));
-	       g_object_set (G_OBJECT (item), "name", cname, NULL);
-            } else {
-	       for (i = 0; syslangs[i] != NULL; i++) {
-	         if (!strcmp (syslangs[i], (gchar *)nodelang)) {
-		   g_object_set (G_OBJECT (item), "name",
-				 g_strstrip ((gchar *)wpa->last->content), NULL);
-	           break;
-	         }
-	       }
-	    }
-
-	    g_free (name);
-	    xmlFree (nodelang);
-	  } else {
-	    break;
-	  }
-	} else if (!strcmp ((gchar *)wpa->name, "options")) {
-	  if (wpa->last != NULL) {
-	    g_object_set (G_OBJECT (item), "placement",
-			  enum_string_to_value (G_DESKTOP_TYPE_DESKTOP_BACKGROUND_STYLE,
-						g_strstrip ((gchar *)wpa->last->content)), NULL);
-	    SET_FLAG(CC_BACKGROUND_ITEM_HAS_PLACEMENT);
-	  }
-	} else if (!strcmp ((gchar *)wpa->name, "shade_type")) {
-	  if (wpa->last != NULL) {
-	    g_object_set (G_OBJECT (item), "shading",
-			  enum_string_to_value (G_DESKTOP_TYPE_DESKTOP_BACKGROUND_SHADING,
-						g_strstrip ((gchar *)wpa->last->content)), NULL);
-	    SET_FLAG(CC_BACKGROUND_ITEM_HAS_SHADING);
-	  }
-	} else if (!strcmp ((gchar *)wpa->name, "pcolor")) {
-	  if (wpa->last != NULL) {
-	    g_object_set (G_OBJECT (item), "primary-color",
-			  g_strstrip ((gchar *)wpa->last->content), NULL);
-	    SET_FLAG(CC_BACKGROUND_ITEM_HAS_PCOLOR);
-	  }
-	} else if (!strcmp ((gchar *)wpa->name, "scolor")) {
-	  if (wpa->last != NULL) {
-	    g_object_set (G_OBJECT (item), "secondary-color",
-			  g_strstrip ((gchar *)wpa->last->content), NULL);
-	    SET_FLAG(CC_BACKGROUND_ITEM_HAS_SCOLOR);
-	  }
-	} else if (!strcmp ((gchar *)wpa->name, "source_url")) {
-	   if (wpa->last != NULL) {
-             g_object_set (G_OBJECT (item),
-			   "source-url", g_strstrip ((gchar *)wpa->last->content),
-			   "needs-download", FALSE,
-			   NULL);
-	   }
-	} else if (!strcmp ((gchar *)wpa->name, "text")) {
-	  /* Do nothing here, libxml2 is being weird */
-	} else {
-	  g_warning ("Unknown Tag: %s", wpa->name);
-	}
-      }
+static char *
+get_catalog_cache_path (const gchar *filename)
+{
+  char *checksum, *path;
 
-      /* Check whether the target file exists */
-      {
-        GFile *file;
-        const char *uri;
-
-	uri = cc_background_item_get_uri (item);
-	if (uri != NULL)
-	  {
-            file = g_file_new_for_uri (uri);
-	    if (g_file_query_exists (file, NULL) == FALSE)
-	      {
-	        g_object_unref (item);
-	        continue;
-	      }
-	  }
-      }
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, filename, -1);
+  path = g_build_filename (g_get_user_cache_dir (),
+                           "gnome-control-center",
+                           "background-catalogs",
+                           checksum,
+                           NULL);
+  g_free (checksum);
+
+  return path;
+}
+
+/* The cache of a catalog is only valid for the modification time and
+ * size it was written for, and for the same languages */
+static GPtrArray *
+load_catalog_cache (const gchar    *filename,
+                    const GStatBuf *buf)
+{
+  GVariant *variant, *items;
+  GVariantIter iter;
+  GPtrArray *entries;
+  CatalogEntry *entry;
+  char *path, *contents, *key;
+  const char *cached_key;
+  gsize length;
+  guint32 version;
+  gint64 mtime, size;
+
+  path = get_catalog_cache_path (filename);
+  if (!g_file_get_contents (path, &contents, &length, NULL)) {
+    g_free (path);
+    return NULL;
+  }
+  g_free (path);
+
+  variant = g_variant_new_from_data (G_VARIANT_TYPE (CATALOG_CACHE_TYPE),
+                                     contents, length, FALSE,
+                                     g_free, contents);
+  g_variant_ref_sink (variant);
+
+  g_variant_get (variant, "(uxx&s@a(bbmsmsmsmsmsmsmsms))",
+                 &version, &mtime, &size, &cached_key, &items);
+  key = get_language_key ();
+
+  if (version != CATALOG_CACHE_VERSION ||
+      mtime != buf->st_mtime ||
+      size != buf->st_size ||
+      strcmp (key, cached_key) != 0) {
+    g_free (key);
+    g_variant_unref (items);
+    g_variant_unref (variant);
+    return NULL;
+  }
+  g_free (key);
+
+  entries = g_ptr_array_new_with_free_func ((GDestroyNotify) catalog_entry_free);
+
+  g_variant_iter_init (&iter, items);
+  entry = g_slice_new0 (CatalogEntry);
+  while (g_variant_iter_next (&iter, "(bbmsmsmsmsmsmsmsms)",
+                              &entry->deleted, &entry->has_uri,
+                              &entry->uri, &entry->name, &entry->cname,
+                              &entry->options, &entry->shade_type,
+                              &entry->pcolor, &entry->scolor,
+                              &entry->source_url)) {
+    g_ptr_array_add (entries, entry);
+    entry = g_slice_new0 (CatalogEntry);
+  }
+  g_slice_free (CatalogEntry, entry);
+
+  g_variant_unref (items);
+  g_variant_unref (variant);
+
+  return entries;
+}
+
+static void
+save_catalog_cache (const gchar    *filename,
+                    const GStatBuf *buf,
+                    GPtrArray      *entries)
+{
+  GVariantBuilder builder;
+  GVariant *variant;
+  GError *error = NULL;
+  char *path, *dir, *key;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(bbmsmsmsmsmsmsmsms)"));
+  for (i = 0; i < entries->len; i++) {
+    CatalogEntry *entry = g_ptr_array_index (entries, i);
+
+    g_variant_builder_add (&builder, "(bbmsmsmsmsmsmsmsms)",
+                           entry->deleted, entry->has_uri,
+                           entry->uri, entry->name, entry->cname,
+                           entry->options, entry->shade_type,
+                           entry->pcolor, entry->scolor,
+                           entry->source_url);
+  }
+
+  key = get_language_key ();
+  variant = g_variant_new ("(uxxsa(bbmsmsmsmsmsmsmsms))",
+                           CATALOG_CACHE_VERSION,
+                           (gint64) buf->st_mtime,
+                           (gint64) buf->st_size,
+                           key,
+                           &builder);
+  g_variant_ref_sink (variant);
+  g_free (key);
+
+  path = get_catalog_cache_path (filename);
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  if (!g_file_set_contents (path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error)) {
+    g_debug ("Could not cache '%s': %s", filename, error->message);
+    g_error_free (error);
+  }
+
+  g_free (path);
+  g_variant_unref (variant);
+}
+
+/* Returns the wallpapers of a catalog which exist, from the cache if
+ * the catalog did not change. Does blocking I/O, and is safe to call
+ * from any thread. */
+static GPtrArray *
+read_catalog (const gchar *filename)
+{
+  GStatBuf buf;
+  GPtrArray *entries;
+  guint i;
+
+  if (g_stat (filename, &buf) != 0)
+    return NULL;
+
+  entries = load_catalog_cache (filename, &buf);
+  if (entries == NULL) {
+    entries = parse_catalog (filename);
+    if (entries == NULL)
+      return NULL;
+    save_catalog_cache (filename, &buf, entries);
+  }
+
+  /* Check whether the target files exist; that is not cached as they
+   * can go away without the catalog changing */
+  i = 0;
+  while (i < entries->len) {
+    CatalogEntry *entry = g_ptr_array_index (entries, i);
+
+    if (entry->uri != NULL) {
+      GFile *file;
+      gboolean exists;
 
-      /* FIXME, this is a broken way of doing,
-       * need to use proper code here */
-      uri = g_filename_to_uri (filename, NULL, NULL);
-      id = g_strdup_printf ("%s#%s", uri, cname);
-      g_free (uri);
-
-      /* Make sure we don't already have this one and that filename exists */
-      if (g_hash_table_lookup (xml->priv->wp_hash, id) != NULL) {
-	g_object_unref (item);
-	g_free (id);
-	continue;
+      file = g_file_new_for_uri (entry->uri);
+      exists = g_file_query_exists (file, NULL);
+      g_object_unref (file);
+
+      if (!exists) {
+        g_ptr_array_remove_index (entries, i);
+        continue;
       }
+    }
+    i++;
+  }
 
-      g_object_set (G_OBJECT (item), "flags", flags, NULL);
-      g_hash_table_insert (xml->priv->wp_hash, id, item);
-      /* Don't free ID, we added it to the hash table */
-      if (in_thread)
-        emit_added_in_idle (xml, g_object_ref (item));
-      else
-        g_signal_emit (G_OBJECT (xml), signals[ADDED], 0, item);
-      retval = TRUE;
+  return entries;
+}
+
+#define SET_FLAG(flag) G_STMT_START{ (flags|=flag); }G_STMT_END
+
+/* Turns the wallpapers of a catalog into items, and signals the new
+ * ones. Must be called from the main thread. */
+static gboolean
+add_catalog_entries (CcBackgroundXml *xml,
+                     const gchar     *filename,
+                     GPtrArray       *entries)
+{
+  gboolean retval = FALSE;
+  char *file_uri;
+  guint i;
+
+  file_uri = g_filename_to_uri (filename, NULL, NULL);
+
+  for (i = 0; i < entries->len; i++) {
+    CatalogEntry *entry = g_ptr_array_index (entries, i);
+    CcBackgroundItem *item;
+    CcBackgroundItemFlags flags;
+    char *id;
+
+    /* FIXME, this is a broken way of doing,
+     * need to use proper code here */
+    id = g_strdup_printf ("%s#%s", file_uri, entry->cname);
+
+    /* Make sure we don't already have this one */
+    if (g_hash_table_lookup (xml->priv->wp_hash, id) != NULL) {
+      g_free (id);
+      continue;
+    }
+
+    flags = 0;
+    item = cc_background_item_new (NULL);
+
+    g_object_set (G_OBJECT (item),
+		  "is-deleted", entry->deleted,
+		  "source-xml", filename,
+		  NULL);
+
+    if (entry->has_uri) {
+      g_object_set (G_OBJECT (item), "uri", entry->uri, NULL);
+      SET_FLAG(CC_BACKGROUND_ITEM_HAS_URI);
+    }
+    if (entry->name != NULL)
+      g_object_set (G_OBJECT (item), "name", entry->name, NULL);
+    if (entry->options != NULL) {
+      g_object_set (G_OBJECT (item), "placement",
+		    enum_string_to_value (G_DESKTOP_TYPE_DESKTOP_BACKGROUND_STYLE,
+					  entry->options), NULL);
+      SET_FLAG(CC_BACKGROUND_ITEM_HAS_PLACEMENT);
+    }
+    if (entry->shade_type != NULL) {
+      g_object_set (G_OBJECT (item), "shading",
+		    enum_string_to_value (G_DESKTOP_TYPE_DESKTOP_BACKGROUND_SHADING,
+					  entry->shade_type), NULL);
+      SET_FLAG(CC_BACKGROUND_ITEM_HAS_SHADING);
     }
+    if (entry->pcolor != NULL) {
+      g_object_set (G_OBJECT (item), "primary-color", entry->pcolor, NULL);
+      SET_FLAG(CC_BACKGROUND_ITEM_HAS_PCOLOR);
+    }
+    if (entry->scolor != NULL) {
+      g_object_set (G_OBJECT (item), "secondary-color", entry->scolor, NULL);
+      SET_FLAG(CC_BACKGROUND_ITEM_HAS_SCOLOR);
+    }
+    if (entry->source_url != NULL) {
+      g_object_set (G_OBJECT (item),
+		    "source-url", entry->source_url,
+		    "needs-download", FALSE,
+		    NULL);
+    }
+
+    g_object_set (G_OBJECT (item), "flags", flags, NULL);
+    g_hash_table_insert (xml->priv->wp_hash, id, item);
+    /* Don't free ID, we added it to the hash table */
+    g_signal_emit (G_OBJECT (xml), signals[ADDED], 0, item);
+    retval = TRUE;
   }
-  xmlFreeDoc (wplist);
+
+  g_free (file_uri);
+
+  return retval;
+}
+
+static gboolean
+cc_background_xml_load_xml_internal (CcBackgroundXml *xml,
+				     const gchar     *filename)
+{
+  GPtrArray *entries;
+  gboolean retval;
+
+  entries = read_catalog (filename);
+  if (entries == NULL)
+    return FALSE;
+
+  retval = add_catalog_entries (xml, filename, entries);
+  g_ptr_array_unref (entries);
 
   return retval;
 }
 
+static gboolean
+emit_catalog_in_idle (CatalogResult *result)
+{
+  if (result->entries != NULL) {
+    add_catalog_entries (result->xml, result->filename, result->entries);
+    g_ptr_array_unref (result->entries);
+  }
+
+  g_object_unref (result->xml);
+  g_free (result->filename);
+  g_slice_free (CatalogResult, result);
+
+  return FALSE;
+}
+
+/* Runs in the parsing threads; the items of each catalog are signalled
+ * together, from a single idle */
+static void
+read_catalog_thread (gchar           *filename,
+                     CcBackgroundXml *xml)
+{
+  CatalogResult *result;
+
+  result = g_slice_new (CatalogResult);
+  result->xml = g_object_ref (xml);
+  result->filename = filename;
+  result->entries = read_catalog (filename);
+
+  g_idle_add ((GSourceFunc) emit_catalog_in_idle, result);
+}
+
 static void
 gnome_wp_file_changed (GFileMonitor *monitor,
 		       GFile *file,
@@ -335,7 +611,7 @@ gnome_wp_file_changed (GFileMonitor *monitor,
   case G_FILE_MONITOR_EVENT_CHANGED:
   case G_FILE_MONITOR_EVENT_CREATED:
     filename = g_file_get_path (file);
-    cc_background_xml_load_xml_internal (data, filename, FALSE);
+    cc_background_xml_load_xml_internal (data, filename);
     g_free (filename);
     break;
   default:
@@ -373,7 +649,7 @@ cc_background_xml_add_monitor (GFile      *directory,
 static void
 cc_background_xml_load_from_dir (const gchar      *path,
 				 CcBackgroundXml  *data,
-				 gboolean          in_thread)
+				 GThreadPool      *parsers)
 {
   GFile *directory;
   GFileEnumerator *enumerator;
@@ -405,8 +681,7 @@ cc_background_xml_load_from_dir (const gchar      *path,
     fullpath = g_build_filename (path, filename, NULL);
     g_object_unref (info);
 
-    cc_background_xml_load_xml_internal (data, fullpath, in_thread);
-    g_free (fullpath);
+    g_thread_pool_push (parsers, fullpath, NULL);
   }
   g_file_enumerator_close (enumerator, NULL, NULL);
 
@@ -417,17 +692,23 @@ cc_background_xml_load_from_dir (const gchar      *path,
 }
 
 static void
-cc_background_xml_load_list (CcBackgroundXml *data,
-			     gboolean         in_thread)
+cc_background_xml_load_list (CcBackgroundXml *data)
 {
   const char * const *system_data_dirs;
+  GThreadPool *parsers;
   gchar * datadir;
+  long n_threads;
   gint i;
 
+  n_threads = sysconf (_SC_NPROCESSORS_ONLN);
+  parsers = g_thread_pool_new ((GFunc) read_catalog_thread, data,
+                               CLAMP (n_threads, 1, MAX_PARSE_THREADS),
+                               FALSE, NULL);
+
   datadir = g_build_filename (g_get_user_data_dir (),
                               "gnome-background-properties",
                               NULL);
-  cc_background_xml_load_from_dir (datadir, data, in_thread);
+  cc_background_xml_load_from_dir (datadir, data, parsers);
   g_free (datadir);
 
   system_data_dirs = g_get_system_data_dirs ();
@@ -435,9 +716,12 @@ cc_background_xml_load_list (CcBackgroundXml *data,
     datadir = g_build_filename (system_data_dirs[i],
                                 "gnome-background-properties",
 				NULL);
-    cc_background_xml_load_from_dir (datadir, data, in_thread);
+    cc_background_xml_load_from_dir (datadir, data, parsers);
     g_free (datadir);
   }
+
+  /* Wait for all the catalogs to be read */
+  g_thread_pool_free (parsers, FALSE, TRUE);
 }
 
 const GHashTable *
@@ -461,7 +745,7 @@ load_list_thread (GSimpleAsyncResult *res,
 	CcBackgroundXml *data;
 
 	data = g_simple_async_result_get_op_res_gpointer (res);
-	cc_background_xml_load_list (data, TRUE);
+	cc_background_xml_load_list (data);
 }
 
 void cc_background_xml_load_list_async (CcBackgroundXml *xml,
@@ -488,7 +772,7 @@ cc_background_xml_load_xml (CcBackgroundXml *xml,
 	if (g_file_test (filename, G_FILE_TEST_IS_REGULAR) == FALSE)
 		return FALSE;
 
-	return cc_background_xml_load_xml_internal (xml, filename, FALSE);
+	return cc_background_xml_load_xml_internal (xml, filename);
 }
 
 static void
@@ -627,14 +911,8 @@ cc_background_xml_finalize (GObject *object)
 		g_hash_table_destroy (xml->priv->wp_hash);
 		xml->priv->wp_hash = NULL;
 	}
-	if (xml->priv->item_added_id != 0) {
-		g_source_remove (xml->priv->item_added_id);
-		xml->priv->item_added_id = 0;
-	}
-	if (xml->priv->item_added_queue) {
-		g_async_queue_unref (xml->priv->item_added_queue);
-		xml->priv->item_added_queue = NULL;
-	}
+
+        G_OBJECT_CLASS (cc_background_xml_parent_class)->finalize (object);
 }
 
 static void
@@ -663,7 +941,6 @@ cc_background_xml_init (CcBackgroundXml *xml)
 						    g_str_equal,
 						    (GDestroyNotify) g_free,
 						    (GDestroyNotify) g_object_unref);
-	xml->priv->item_added_queue = g_async_queue_new_full ((GDestroyNotify) g_object_unref);
 }
 
 CcBackgroundXml *
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/* Captures through a mock of GNOME Shell's screenshot interface, on a
+ * private session bus */
+
+#include <config.h>
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "cc-background-screenshot.h"
+
+typedef enum {
+  MOCK_WRITE,         /* writes the capture where asked */
+  MOCK_WRITE_LARGER,  /* same, but captures more than asked for */
+  MOCK_WRITE_ELSEWHERE,
+  MOCK_REFUSE_PROC    /* fails for paths in /proc, like shells which
+                         create the file exclusively */
+} MockMode;
+
+static const char introspection_xml[] =
+  "<node>"
+  "  <interface name='org.gnome.Shell.Screenshot'>"
+  "    <method name='ScreenshotArea'>"
+  "      <arg type='i' direction='in' name='x'/>"
+  "      <arg type='i' direction='in' name='y'/>"
+  "      <arg type='i' direction='in' name='width'/>"
+  "      <arg type='i' direction='in' name='height'/>"
+  "      <arg type='b' direction='in' name='flash'/>"
+  "      <arg type='s' direction='in' name='filename'/>"
+  "      <arg type='b' direction='out' name='success'/>"
+  "      <arg type='s' direction='out' name='filename_used'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+static GDBusConnection *connection;
+static char *cache_dir;
+static MockMode mock_mode;
+static char *last_requested_path;
+
+/* Red, so that it can be told apart from a cleared surface */
+#define MOCK_COLOR 0xff0000
+
+static void
+handle_method_call (GDBusConnection       *conn,
+                    const gchar           *sender,
+                    const gchar           *object_path,
+                    const gchar           *interface_name,
+                    const gchar           *method_name,
+                    GVariant              *parameters,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  const char *filename;
+  char *used;
+  gint x, y, width, height;
+  gboolean flash;
+
+  g_variant_get (parameters, "(iiiib&s)", &x, &y, &width, &height, &flash, &filename);
+
+  g_free (last_requested_path);
+  last_requested_path = g_strdup (filename);
+
+  if (mock_mode == MOCK_REFUSE_PROC && g_str_has_prefix (filename, "/proc/"))
+    {
+      g_dbus_method_invocation_return_value (invocation,
+                                             g_variant_new ("(bs)", FALSE, filename));
+      return;
+    }
+
+  if (mock_mode == MOCK_WRITE_LARGER)
+    {
+      width *= 2;
+      height *= 2;
+    }
+
+  if (mock_mode == MOCK_WRITE_ELSEWHERE)
+    used = g_build_filename (cache_dir, "elsewhere.png", NULL);
+  else
+    used = g_strdup (filename);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+  cr = cairo_create (surface);
+  cairo_set_source_rgb (cr, 1.0, 0.0, 0.0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  g_assert_cmpint (cairo_surface_write_to_png (surface, used), ==, CAIRO_STATUS_SUCCESS);
+  cairo_surface_destroy (surface);
+
+  g_dbus_method_invocation_return_value (invocation,
+                                         g_variant_new ("(bs)", TRUE, used));
+  g_free (used);
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+  handle_method_call,
+  NULL,
+  NULL
+};
+
+static void
+on_name_acquired (GDBusConnection *conn,
+                  const gchar     *name,
+                  gpointer         user_data)
+{
+  g_main_loop_quit (user_data);
+}
+
+static void
+start_mock_shell (void)
+{
+  GDBusNodeInfo *info;
+  GMainLoop *loop;
+  guint id;
+
+  info = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  g_assert (info != NULL);
+
+  id = g_dbus_connection_register_object (connection,
+                                          "/org/gnome/Shell/Screenshot",
+                                          info->interfaces[0],
+                                          &interface_vtable,
+                                          NULL, NULL, NULL);
+  g_assert_cmpuint (id, >, 0);
+  g_dbus_node_info_unref (info);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_bus_own_name_on_connection (connection,
+                                "org.gnome.Shell.Screenshot",
+                                G_BUS_NAME_OWNER_FLAGS_NONE,
+                                on_name_acquired,
+                                NULL,
+                                loop, NULL);
+  g_main_loop_run (loop);
+  g_main_loop_unref (loop);
+}
+
+static void
+on_captured (GObject      *source,
+             GAsyncResult *res,
+             gpointer      user_data)
+{
+  GAsyncResult **result = user_data;
+
+  *result = g_object_ref (res);
+}
+
+static cairo_surface_t *
+capture (int       width,
+         int       height,
+         GError  **error)
+{
+  cairo_rectangle_int_t area = { 10, 20, 0, 0 };
+  cairo_surface_t *surface;
+  GAsyncResult *result = NULL;
+
+  area.width = width;
+  area.height = height;
+
+  cc_background_screenshot_capture_async (connection, &area, NULL, on_captured, &result);
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  surface = cc_background_screenshot_capture_finish (result, error);
+  g_object_unref (result);
+
+  return surface;
+}
+
+static void
+assert_capture (cairo_surface_t *surface,
+                int              width,
+                int              height)
+{
+  guint32 pixel;
+
+  g_assert (surface != NULL);
+  g_assert_cmpint (cairo_surface_status (surface), ==, CAIRO_STATUS_SUCCESS);
+  g_assert_cmpint (cairo_image_surface_get_width (surface), ==, width);
+  g_assert_cmpint (cairo_image_surface_get_height (surface), ==, height);
+
+  cairo_surface_flush (surface);
+  memcpy (&pixel, cairo_image_surface_get_data (surface), sizeof (pixel));
+  g_assert_cmphex (pixel & 0xffffff, ==, MOCK_COLOR);
+}
+
+static void
+assert_no_temporary_files (void)
+{
+  char *path;
+  GDir *dir;
+
+  path = g_build_filename (cache_dir, "gnome-control-center", NULL);
+  dir = g_dir_open (path, 0, NULL);
+  if (dir != NULL)
+    {
+      g_assert_cmpstr (g_dir_read_name (dir), ==, NULL);
+      g_dir_close (dir);
+    }
+  g_free (path);
+
+  path = g_build_filename (cache_dir, "elsewhere.png", NULL);
+  g_assert (!g_file_test (path, G_FILE_TEST_EXISTS));
+  g_free (path);
+}
+
+static void
+test_memfd (void)
+{
+  cairo_surface_t *surface;
+  GError *error = NULL;
+
+  mock_mode = MOCK_WRITE;
+  surface = capture (64, 32, &error);
+  g_assert_no_error (error);
+  assert_capture (surface, 64, 32);
+  cairo_surface_destroy (surface);
+
+#ifdef HAVE_MEMFD_CREATE
+  g_assert (g_str_has_prefix (last_requested_path, "/proc/"));
+#endif
+  assert_no_temporary_files ();
+}
+
+static void
+test_crop (void)
+{
+  cairo_surface_t *surface;
+  GError *error = NULL;
+
+  mock_mode = MOCK_WRITE_LARGER;
+  surface = capture (40, 30, &error);
+  g_assert_no_error (error);
+  assert_capture (surface, 40, 30);
+  cairo_surface_destroy (surface);
+}
+
+static void
+test_elsewhere (void)
+{
+  cairo_surface_t *surface;
+  GError *error = NULL;
+
+  mock_mode = MOCK_WRITE_ELSEWHERE;
+  surface = capture (16, 16, &error);
+  g_assert_no_error (error);
+  assert_capture (surface, 16, 16);
+  cairo_surface_destroy (surface);
+
+  assert_no_temporary_files ();
+}
+
+/* Must run last, as the memory file isn't tried again afterwards */
+static void
+test_fallback (void)
+{
+  cairo_surface_t *surface;
+  GError *error = NULL;
+
+  mock_mode = MOCK_REFUSE_PROC;
+  surface = capture (64, 32, &error);
+  g_assert_no_error (error);
+  assert_capture (surface, 64, 32);
+  cairo_surface_destroy (surface);
+
+  g_assert (!g_str_has_prefix (last_requested_path, "/proc/"));
+  assert_no_temporary_files ();
+
+  /* and straight to the file the next time */
+  g_clear_pointer (&last_requested_path, g_free);
+  surface = capture (8, 8, &error);
+  g_assert_no_error (error);
+  assert_capture (surface, 8, 8);
+  cairo_surface_destroy (surface);
+
+  g_assert (!g_str_has_prefix (last_requested_path, "/proc/"));
+}
+
+int
+main (int argc, char **argv)
+{
+  GTestDBus *bus;
+  char *path;
+  int ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  cache_dir = g_dir_make_tmp ("test-screenshot-XXXXXX", NULL);
+  g_assert (cache_dir != NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_dir, TRUE);
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+  g_assert (connection != NULL);
+  start_mock_shell ();
+
+  g_test_add_func ("/background/screenshot/memfd", test_memfd);
+  g_test_add_func ("/background/screenshot/crop", test_crop);
+  g_test_add_func ("/background/screenshot/elsewhere", test_elsewhere);
+  g_test_add_func ("/background/screenshot/fallback", test_fallback);
+
+  ret = g_test_run ();
+
+  g_object_unref (connection);
+  g_test_dbus_down (bus);
+  g_object_unref (bus);
+
+  path = g_build_filename (cache_dir, "gnome-control-center", NULL);
+  g_rmdir (path);
+  g_free (path);
+  g_rmdir (cache_dir);
+  g_free (cache_dir);
+  g_free (last_requested_path);
+
+  return ret;
+}
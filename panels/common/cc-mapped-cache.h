@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CC_MAPPED_CACHE_H
+#define _CC_MAPPED_CACHE_H
+
+#include <string.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Helpers for the files which are written once and then mapped as is:
+ * the panel cache, the settings index, the compiled timezone database
+ * and the PPD catalog. They are laid out as
+ *
+ *   header, starting with an 8 bytes magic
+ *   arrays of records
+ *   string pool, starting with an empty string
+ *
+ * with the strings referenced by their offset in the pool. Every offset
+ * and count read from a file must be checked before it is used, as the
+ * file may be truncated or from another version.
+ *
+ * These are inline so that the build time generators can use them
+ * without linking to the panels. */
+
+typedef struct {
+  GString    *strings;
+  GHashTable *offsets;
+} CcStringPool;
+
+static inline void
+cc_string_pool_init (CcStringPool *pool)
+{
+  pool->strings = g_string_new (NULL);
+  pool->offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /* Offset 0 is the empty string */
+  g_string_append_c (pool->strings, '\0');
+}
+
+static inline void
+cc_string_pool_clear (CcStringPool *pool)
+{
+  g_string_free (pool->strings, TRUE);
+  g_hash_table_destroy (pool->offsets);
+}
+
+/* Each string is only stored once, NULL is stored as the empty string */
+static inline guint32
+cc_string_pool_add (CcStringPool *pool,
+                    const char   *str)
+{
+  gpointer offset;
+
+  if (str == NULL || *str == '\0')
+    return 0;
+
+  if (g_hash_table_lookup_extended (pool->offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  offset = GUINT_TO_POINTER (pool->strings->len);
+  g_string_append_len (pool->strings, str, strlen (str) + 1);
+  g_hash_table_insert (pool->offsets, g_strdup (str), offset);
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static inline gboolean
+cc_mapped_cache_check_magic (const char *contents,
+                             gsize       length,
+                             gsize       header_size,
+                             const char *magic)
+{
+  return length >= header_size && memcmp (contents, magic, 8) == 0;
+}
+
+/* The array is aligned for its items, and within the file */
+static inline gboolean
+cc_mapped_cache_check_array (gsize   length,
+                             guint32 offset,
+                             guint32 n_items,
+                             gsize   item_size,
+                             gsize   alignment)
+{
+  return offset % alignment == 0 &&
+         offset <= length &&
+         n_items <= (length - offset) / item_size;
+}
+
+/* The pool is within the file, and its last string is terminated */
+static inline gboolean
+cc_mapped_cache_check_strings (const char *contents,
+                               gsize       length,
+                               guint32     strings_offset,
+                               guint32     strings_size)
+{
+  return strings_offset <= length &&
+         strings_size > 0 &&
+         strings_size <= length - strings_offset &&
+         contents[strings_offset + strings_size - 1] == '\0';
+}
+
+static inline gboolean
+cc_mapped_cache_check_string (guint32 strings_size,
+                              guint32 offset)
+{
+  return offset < strings_size;
+}
+
+G_END_DECLS
+
+#endif /* _CC_MAPPED_CACHE_H */
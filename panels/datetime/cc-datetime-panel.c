@@ -26,6 +26,7 @@
 #include <langinfo.h>
 #include <sys/time.h>
 #include "cc-timezone-map.h"
+#include "cc-timezone-search.h"
 #include "timedated.h"
 #include "date-endian.h"
 #define GNOME_DESKTOP_USE_UNSTABLE_API
@@ -34,13 +35,13 @@
 #include <string.h>
 #include <stdlib.h>
 #include <libintl.h>
+#include <glib/gi18n.h>
 
 #include <libgnome-desktop/gnome-wall-clock.h>
 #include <polkit/polkit.h>
 
 /* FIXME: This should be "Etc/GMT" instead */
 #define DEFAULT_TZ "Europe/London"
-#define GETTEXT_PACKAGE_TIMEZONES GETTEXT_PACKAGE "-timezones"
 
 CC_PANEL_REGISTER (CcDateTimePanel, cc_date_time_panel)
 
@@ -53,15 +54,26 @@ enum {
   CITY_COL_CITY_TRANSLATED,
   CITY_COL_REGION_TRANSLATED,
   CITY_COL_ZONE,
+  CITY_COL_REGION_ID,
   CITY_NUM_COLS
 };
 
 enum {
   REGION_COL_REGION,
   REGION_COL_REGION_TRANSLATED,
+  REGION_COL_REGION_ID,
   REGION_NUM_COLS
 };
 
+enum {
+  COMPLETION_COL_TEXT,
+  COMPLETION_COL_CITY,
+  COMPLETION_NUM_COLS
+};
+
+/* The number of cities offered while typing */
+#define MAX_COMPLETIONS 12
+
 #define W(x) (GtkWidget*) gtk_builder_get_object (priv->builder, x)
 
 #define CLOCK_SCHEMA "org.gnome.desktop.interface"
@@ -76,6 +88,11 @@ struct _CcDateTimePanelPrivate
 
   GtkTreeModel *locations;
   GtkTreeModelFilter *city_filter;
+  guint active_region_id;
+  gboolean has_active_region;
+
+  CcTimezoneSearch *search;
+  GtkListStore *completion_store;
 
   GDateTime *date;
 
@@ -92,6 +109,9 @@ struct _CcDateTimePanelPrivate
 };
 
 static void update_time (CcDateTimePanel *self);
+static void on_clock_changed (GnomeWallClock  *clock,
+                              GParamSpec      *pspec,
+                              CcDateTimePanel *panel);
 
 static void
 cc_date_time_panel_get_property (GObject    *object,
@@ -167,6 +187,18 @@ cc_date_time_panel_dispose (GObject *object)
       priv->permission = NULL;
     }
 
+  if (priv->completion_store)
+    {
+      g_object_unref (priv->completion_store);
+      priv->completion_store = NULL;
+    }
+
+  if (priv->search)
+    {
+      cc_timezone_search_unref (priv->search);
+      priv->search = NULL;
+    }
+
   G_OBJECT_CLASS (cc_date_time_panel_parent_class)->dispose (object);
 }
 
@@ -184,6 +216,26 @@ cc_date_time_panel_get_help_uri (CcPanel *panel)
   return "help:gnome-help/clock";
 }
 
+static void
+cc_date_time_panel_set_active (CcPanel  *panel,
+                               gboolean  active)
+{
+  CcDateTimePanel *self = CC_DATE_TIME_PANEL (panel);
+  CcDateTimePanelPrivate *priv = self->priv;
+
+  /* Don't wake up every minute for a clock nobody is looking at */
+  if (active)
+    {
+      priv->clock_tracker = g_object_new (GNOME_TYPE_WALL_CLOCK, NULL);
+      g_signal_connect (priv->clock_tracker, "notify::clock", G_CALLBACK (on_clock_changed), self);
+      on_clock_changed (priv->clock_tracker, NULL, self);
+    }
+  else
+    {
+      g_clear_object (&priv->clock_tracker);
+    }
+}
+
 static void
 cc_date_time_panel_class_init (CcDateTimePanelClass *klass)
 {
@@ -198,6 +250,7 @@ cc_date_time_panel_class_init (CcDateTimePanelClass *klass)
 
   panel_class->get_permission = cc_date_time_panel_get_permission;
   panel_class->get_help_uri   = cc_date_time_panel_get_help_uri;
+  panel_class->set_active     = cc_date_time_panel_set_active;
 }
 
 static void clock_settings_changed_cb (GSettings       *settings,
@@ -430,12 +483,29 @@ change_date (CcDateTimePanel *self)
   queue_set_datetime (self);
 }
 
+/* Caches the region the cities are filtered on */
+static void
+update_active_region (CcDateTimePanel *self)
+{
+  CcDateTimePanelPrivate *priv = self->priv;
+  GtkComboBox *combo;
+  GtkTreeIter iter;
+
+  combo = GTK_COMBO_BOX (W ("region_combobox"));
+  priv->has_active_region = gtk_combo_box_get_active_iter (combo, &iter);
+  if (priv->has_active_region)
+    gtk_tree_model_get (gtk_combo_box_get_model (combo), &iter,
+                        REGION_COL_REGION_ID, &priv->active_region_id, -1);
+}
+
 static void
 region_changed_cb (GtkComboBox     *box,
                    CcDateTimePanel *self)
 {
   GtkTreeModelFilter *modelfilter;
 
+  update_active_region (self);
+
   modelfilter = GTK_TREE_MODEL_FILTER (gtk_builder_get_object (self->priv->builder, "city-modelfilter"));
 
   gtk_tree_model_filter_refilter (modelfilter);
@@ -507,6 +577,7 @@ update_timezone (CcDateTimePanel *self)
     }
   while (gtk_tree_model_iter_next (model, &iter));
 
+  update_active_region (self);
 
   /* update city combo */
   widget = (GtkWidget *) gtk_builder_get_object (priv->builder,
@@ -582,126 +653,144 @@ get_initial_timezone (CcDateTimePanel *self)
 }
 
 /* load region and city tree models */
-struct get_region_data
+static gboolean
+city_model_filter_func (GtkTreeModel    *model,
+                        GtkTreeIter     *iter,
+                        CcDateTimePanel *self)
 {
-  GtkListStore *region_store;
-  GtkListStore *city_store;
-  GHashTable *table;
-};
+  guint region_id;
+
+  if (!self->priv->has_active_region)
+    return FALSE;
 
-/* Slash look-alikes that might be used in translations */
-#define TRANSLATION_SPLIT                                                        \
-        "\342\201\204"        /* FRACTION SLASH */                               \
-        "\342\210\225"        /* DIVISION SLASH */                               \
-        "\342\247\270"        /* BIG SOLIDUS */                                  \
-        "\357\274\217"        /* FULLWIDTH SOLIDUS */                            \
-        "/"
+  gtk_tree_model_get (model, iter, CITY_COL_REGION_ID, &region_id, -1);
+
+  return region_id == self->priv->active_region_id;
+}
 
 static void
-get_regions (TzLocation             *loc,
-             struct get_region_data *data)
+load_regions_model (CcTimezoneSearch *search,
+                    GtkListStore     *regions,
+                    GtkListStore     *cities)
 {
-  gchar *zone;
-  gchar **split;
-  gchar **split_translated;
-  gchar *translated_city;
+  guint i, n;
 
-  zone = g_strdup (loc->zone);
-  g_strdelimit (zone, "_", ' ');
-  split = g_strsplit (zone, "/", 2);
-  g_free (zone);
+  n = cc_timezone_search_get_n_regions (search);
+  for (i = 0; i < n; i++)
+    {
+      const CcTimezoneRegion *region = cc_timezone_search_get_region (search, i);
 
-  /* Load the translation for it */
-  zone = g_strdup (dgettext (GETTEXT_PACKAGE_TIMEZONES, loc->zone));
-  g_strdelimit (zone, "_", ' ');
-  split_translated = g_regex_split_simple ("[\\x{2044}\\x{2215}\\x{29f8}\\x{ff0f}/]", zone, 0, 0);
-  g_free (zone);
+      gtk_list_store_insert_with_values (regions, NULL, -1,
+                                         REGION_COL_REGION, region->region,
+                                         REGION_COL_REGION_TRANSLATED, region->region_translated,
+                                         REGION_COL_REGION_ID, i,
+                                         -1);
+    }
 
-  if (!g_hash_table_lookup_extended (data->table, split[0], NULL, NULL))
+  n = cc_timezone_search_get_n_cities (search);
+  for (i = 0; i < n; i++)
     {
-      g_hash_table_insert (data->table, g_strdup (split[0]),
-                           GINT_TO_POINTER (1));
-      gtk_list_store_insert_with_values (data->region_store, NULL, 0,
-                                         REGION_COL_REGION, split[0],
-                                         REGION_COL_REGION_TRANSLATED, split_translated[0], -1);
+      const CcTimezoneCity *city = cc_timezone_search_get_city (search, i);
+
+      gtk_list_store_insert_with_values (cities, NULL, -1,
+                                         CITY_COL_CITY, city->city,
+                                         CITY_COL_CITY_TRANSLATED, city->city_translated,
+                                         CITY_COL_REGION, city->region,
+                                         CITY_COL_REGION_TRANSLATED, city->region_translated,
+                                         CITY_COL_ZONE, city->location->zone,
+                                         CITY_COL_REGION_ID, city->region_id,
+                                         -1);
     }
 
-  /* g_regex_split_simple() splits too much for us, and would break
-   * America/Argentina/Buenos_Aires into 3 strings, so rejoin the city part */
-  translated_city = g_strjoinv ("/", split_translated + 1);
+  /* sort the models */
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (regions),
+                                        REGION_COL_REGION_TRANSLATED,
+                                        GTK_SORT_ASCENDING);
+}
 
-  gtk_list_store_insert_with_values (data->city_store, NULL, 0,
-                                     CITY_COL_CITY, split[1],
-                                     CITY_COL_CITY_TRANSLATED, translated_city,
-                                     CITY_COL_REGION, split[0],
-                                     CITY_COL_REGION_TRANSLATED, split_translated[0],
-                                     CITY_COL_ZONE, loc->zone,
-                                     -1);
+static void
+city_search_changed_cb (GtkEntry        *entry,
+                        CcDateTimePanel *self)
+{
+  CcDateTimePanelPrivate *priv = self->priv;
+  guint matches[MAX_COMPLETIONS];
+  guint i, n_matches;
 
-  g_free (translated_city);
-  g_strfreev (split);
-  g_strfreev (split_translated);
+  n_matches = cc_timezone_search_query (priv->search,
+                                        gtk_entry_get_text (entry),
+                                        matches, G_N_ELEMENTS (matches));
+
+  gtk_list_store_clear (priv->completion_store);
+
+  for (i = 0; i < n_matches; i++)
+    {
+      const CcTimezoneCity *city = cc_timezone_search_get_city (priv->search, matches[i]);
+      gchar *text;
+
+      /* Translators: a city, then the region of the world it is in */
+      text = g_strdup_printf (C_("timezone search", "%s, %s"),
+                              city->city_translated, city->region_translated);
+      gtk_list_store_insert_with_values (priv->completion_store, NULL, -1,
+                                         COMPLETION_COL_TEXT, text,
+                                         COMPLETION_COL_CITY, matches[i],
+                                         -1);
+      g_free (text);
+    }
 }
 
 static gboolean
-city_model_filter_func (GtkTreeModel *model,
-                        GtkTreeIter  *iter,
-                        GtkComboBox  *combo)
+city_search_match_func (GtkEntryCompletion *completion,
+                        const gchar        *key,
+                        GtkTreeIter        *iter,
+                        gpointer            user_data)
 {
-  GtkTreeModel *combo_model;
-  GtkTreeIter combo_iter;
-  gchar *active_region = NULL;
-  gchar *city_region = NULL;
-  gboolean result;
-
-  if (gtk_combo_box_get_active_iter (combo, &combo_iter) == FALSE)
-    return FALSE;
-
-  combo_model = gtk_combo_box_get_model (combo);
-  gtk_tree_model_get (combo_model, &combo_iter,
-                      CITY_COL_CITY, &active_region, -1);
+  /* the model only holds the matches */
+  return TRUE;
+}
 
-  gtk_tree_model_get (model, iter,
-                      CITY_COL_REGION, &city_region, -1);
+static gboolean
+city_search_match_selected_cb (GtkEntryCompletion *completion,
+                               GtkTreeModel       *model,
+                               GtkTreeIter        *iter,
+                               CcDateTimePanel    *self)
+{
+  const CcTimezoneCity *city;
+  guint id;
 
-  if (g_strcmp0 (active_region, city_region) == 0)
-    result = TRUE;
-  else
-    result = FALSE;
+  gtk_tree_model_get (model, iter, COMPLETION_COL_CITY, &id, -1);
+  city = cc_timezone_search_get_city (self->priv->search, id);
 
-  g_free (city_region);
+  cc_timezone_map_set_timezone (CC_TIMEZONE_MAP (self->priv->map),
+                                city->location->zone);
 
-  g_free (active_region);
+  gtk_entry_set_text (GTK_ENTRY (gtk_entry_completion_get_entry (completion)), "");
 
-  return result;
+  return TRUE;
 }
 
-
 static void
-load_regions_model (GtkListStore *regions, GtkListStore *cities)
+setup_city_search (CcDateTimePanel *self)
 {
-  struct get_region_data data;
-  TzDB *db;
-  GHashTable *table;
-
-
-  db = tz_load_db ();
-  table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-
-  data.table = table;
-  data.region_store = regions;
-  data.city_store = cities;
+  CcDateTimePanelPrivate *priv = self->priv;
+  GtkEntryCompletion *completion;
+  GtkWidget *entry;
 
-  g_ptr_array_foreach (db->locations, (GFunc) get_regions, &data);
+  priv->completion_store = gtk_list_store_new (COMPLETION_NUM_COLS,
+                                               G_TYPE_STRING, G_TYPE_UINT);
 
-  g_hash_table_destroy (table);
+  completion = gtk_entry_completion_new ();
+  gtk_entry_completion_set_model (completion, GTK_TREE_MODEL (priv->completion_store));
+  gtk_entry_completion_set_text_column (completion, COMPLETION_COL_TEXT);
+  gtk_entry_completion_set_match_func (completion, city_search_match_func, NULL, NULL);
+  gtk_entry_completion_set_popup_set_width (completion, FALSE);
+  g_signal_connect (completion, "match-selected",
+                    G_CALLBACK (city_search_match_selected_cb), self);
 
-  tz_db_free (db);
+  entry = W ("city_searchentry");
+  gtk_entry_set_completion (GTK_ENTRY (entry), completion);
+  g_object_unref (completion);
 
-  /* sort the models */
-  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (regions),
-                                        REGION_COL_REGION_TRANSLATED,
-                                        GTK_SORT_ASCENDING);
+  g_signal_connect (entry, "changed", G_CALLBACK (city_search_changed_cb), self);
 }
 
 static void
@@ -953,6 +1042,7 @@ cc_date_time_panel_init (CcDateTimePanel *self)
   GError *err = NULL;
   GtkTreeModelFilter *city_modelfilter;
   GtkTreeModelSort *city_modelsort;
+  TzDB *db;
   const char *ampm;
   guint i, num_days;
   int ret;
@@ -1080,7 +1170,12 @@ cc_date_time_panel_init (CcDateTimePanel *self)
   priv->locations = (GtkTreeModel*) gtk_builder_get_object (priv->builder,
                                                             "region-liststore");
 
-  load_regions_model (GTK_LIST_STORE (priv->locations),
+  db = tz_load_db ();
+  priv->search = cc_timezone_search_get (db);
+  tz_db_unref (db);
+
+  load_regions_model (priv->search,
+                      GTK_LIST_STORE (priv->locations),
                       GTK_LIST_STORE (gtk_builder_get_object (priv->builder,
                                                               "city-liststore")));
 
@@ -1094,9 +1189,11 @@ cc_date_time_panel_init (CcDateTimePanel *self)
 
   gtk_tree_model_filter_set_visible_func (city_modelfilter,
                                           (GtkTreeModelFilterVisibleFunc) city_model_filter_func,
-                                          widget,
+                                          self,
                                           NULL);
 
+  setup_city_search (self);
+
   /* After the initial setup, so we can be sure that
    * the model is filled up */
   get_initial_timezone (self);
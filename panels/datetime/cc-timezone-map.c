@@ -22,6 +22,8 @@
  *
  */
 
+#include <config.h>
+
 #include "cc-timezone-map.h"
 #include <math.h>
 #include <string.h>
@@ -37,6 +39,12 @@ G_DEFINE_TYPE (CcTimezoneMap, cc_timezone_map, GTK_TYPE_WIDGET)
 
 #define DATETIME_RESOURCE_PATH "/org/gnome/control-center/datetime"
 
+/* How many scaled hilights are kept around */
+#define MAX_HILIGHTS 4
+
+/* In the offset map, for the pixels which aren't in any timezone */
+#define NO_OFFSET G_MAXUINT8
+
 typedef struct
 {
   gdouble offset;
@@ -46,22 +54,55 @@ typedef struct
   guchar alpha;
 } CcTimezoneMapOffset;
 
+typedef struct
+{
+  gdouble offset;
+  gboolean dim;
+  cairo_surface_t *surface;
+} CcTimezoneMapHilight;
+
+/* A location projected on the map, for the nearest location lookups */
+typedef struct
+{
+  gfloat x;
+  gfloat y;
+  TzLocation *location;
+} CcTimezoneMapPoint;
+
 struct _CcTimezoneMapPrivate
 {
   GdkPixbuf *orig_background;
   GdkPixbuf *orig_background_dim;
-  GdkPixbuf *orig_color_map;
 
-  GdkPixbuf *background;
-  GdkPixbuf *color_map;
+  /* The index in color_codes of the offset of each pixel of the
+   * colour-code map, at its original size, or NO_OFFSET */
+  guint8 *offset_map;
+  gint offset_map_width;
+  gint offset_map_height;
+
+  /* The layers, scaled to layers_width x layers_height when first
+   * painted at that size */
+  gint layers_width;
+  gint layers_height;
+  cairo_surface_t *background;
+  gboolean background_dim;
+  /* of CcTimezoneMapHilight, most recently used first */
+  GQueue hilights;
 
-  guchar *visible_map_pixels;
-  gint visible_map_rowstride;
+  cairo_surface_t *pin;
 
   gdouble selected_offset;
 
   TzDB *tzdb;
   TzLocation *location;
+
+  /* The locations as a k-d tree: the median of each subtree along its
+   * axis, alternately x and y, comes first, with the points before it
+   * and after it in the array forming its subtrees */
+  CcTimezoneMapPoint *points;
+  gint n_points;
+  gint points_width;
+  gint points_height;
 };
 
 enum
@@ -72,6 +113,12 @@ enum
 
 static guint signals[LAST_SIGNAL];
 
+static void clear_layers (CcTimezoneMap *map);
+
+static void update_points (CcTimezoneMap *map,
+                           gint           width,
+                           gint           height);
+
 
 static CcTimezoneMapOffset color_codes[] =
 {
@@ -151,26 +198,8 @@ cc_timezone_map_dispose (GObject *object)
   g_clear_object (&priv->orig_background);
   g_clear_object (&priv->orig_background_dim);
 
-  if (priv->orig_color_map)
-    {
-      g_object_unref (priv->orig_color_map);
-      priv->orig_color_map = NULL;
-    }
-
-  if (priv->background)
-    {
-      g_object_unref (priv->background);
-      priv->background = NULL;
-    }
-
-  if (priv->color_map)
-    {
-      g_object_unref (priv->color_map);
-      priv->color_map = NULL;
-
-      priv->visible_map_pixels = NULL;
-      priv->visible_map_rowstride = 0;
-    }
+  clear_layers (CC_TIMEZONE_MAP (object));
+  g_clear_pointer (&priv->pin, cairo_surface_destroy);
 
   G_OBJECT_CLASS (cc_timezone_map_parent_class)->dispose (object);
 }
@@ -182,10 +211,13 @@ cc_timezone_map_finalize (GObject *object)
 
   if (priv->tzdb)
     {
-      tz_db_free (priv->tzdb);
+      tz_db_unref (priv->tzdb);
       priv->tzdb = NULL;
     }
 
+  g_free (priv->points);
+  g_free (priv->offset_map);
+
 
   G_OBJECT_CLASS (cc_timezone_map_parent_class)->finalize (object);
 }
@@ -228,31 +260,17 @@ cc_timezone_map_size_allocate (GtkWidget     *widget,
                                GtkAllocation *allocation)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  GdkPixbuf *pixbuf;
-
-  if (priv->background)
-    g_object_unref (priv->background);
-
-  if (!gtk_widget_is_sensitive (widget))
-    pixbuf = priv->orig_background_dim;
-  else
-    pixbuf = priv->orig_background;
 
-  priv->background = gdk_pixbuf_scale_simple (pixbuf,
-                                              allocation->width,
-                                              allocation->height,
-                                              GDK_INTERP_BILINEAR);
-
-  if (priv->color_map)
-    g_object_unref (priv->color_map);
-
-  priv->color_map = gdk_pixbuf_scale_simple (priv->orig_color_map,
-                                             allocation->width,
-                                             allocation->height,
-                                             GDK_INTERP_BILINEAR);
+  /* the layers get scaled again when next painted */
+  if (allocation->width != priv->layers_width ||
+      allocation->height != priv->layers_height)
+    {
+      clear_layers (CC_TIMEZONE_MAP (widget));
+      priv->layers_width = allocation->width;
+      priv->layers_height = allocation->height;
+    }
 
-  priv->visible_map_pixels = gdk_pixbuf_get_pixels (priv->color_map);
-  priv->visible_map_rowstride = gdk_pixbuf_get_rowstride (priv->color_map);
+  update_points (CC_TIMEZONE_MAP (widget), allocation->width, allocation->height);
 
   GTK_WIDGET_CLASS (cc_timezone_map_parent_class)->size_allocate (widget,
                                                                   allocation);
@@ -322,68 +340,337 @@ convert_latitude_to_y (gdouble latitude, gdouble map_height)
   return y;
 }
 
+static gfloat
+point_coord (const CcTimezoneMapPoint *point,
+             gint                      axis)
+{
+  return axis == 0 ? point->x : point->y;
+}
 
-static gboolean
-cc_timezone_map_draw (GtkWidget *widget,
-                      cairo_t   *cr)
+/* Moves the k-th smallest point along the axis to k, with the smaller
+ * ones before it and the larger ones after it */
+static void
+select_point (CcTimezoneMapPoint *points,
+              gint                n_points,
+              gint                k,
+              gint                axis)
 {
-  CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  GdkPixbuf *hilight, *orig_hilight, *pin;
-  GtkAllocation alloc;
-  gchar *file;
+  gint left, right;
+
+  left = 0;
+  right = n_points - 1;
+  while (left < right)
+    {
+      CcTimezoneMapPoint tmp;
+      gfloat pivot;
+      gint i, j;
+
+      pivot = point_coord (&points[left + (right - left) / 2], axis);
+      i = left;
+      j = right;
+      while (i <= j)
+        {
+          while (point_coord (&points[i], axis) < pivot)
+            i++;
+          while (point_coord (&points[j], axis) > pivot)
+            j--;
+          if (i <= j)
+            {
+              tmp = points[i];
+              points[i] = points[j];
+              points[j] = tmp;
+              i++;
+              j--;
+            }
+        }
+
+      if (k <= j)
+        right = j;
+      else if (k >= i)
+        left = i;
+      else
+        break;
+    }
+}
+
+static void
+build_tree (CcTimezoneMapPoint *points,
+            gint                n_points,
+            gint                depth)
+{
+  gint median;
+
+  if (n_points <= 1)
+    return;
+
+  median = n_points / 2;
+  select_point (points, n_points, median, depth % 2);
+  build_tree (points, median, depth + 1);
+  build_tree (points + median + 1, n_points - median - 1, depth + 1);
+}
+
+static void
+find_nearest (const CcTimezoneMapPoint  *points,
+              gint                       n_points,
+              gint                       depth,
+              gfloat                     x,
+              gfloat                     y,
+              const CcTimezoneMapPoint **nearest,
+              gfloat                    *nearest_dist)
+{
+  const CcTimezoneMapPoint *median;
+  gfloat dx, dy, dist, diff;
+  gint n_before;
+
+  if (n_points <= 0)
+    return;
+
+  n_before = n_points / 2;
+  median = &points[n_before];
+
+  dx = median->x - x;
+  dy = median->y - y;
+  dist = dx * dx + dy * dy;
+  if (dist < *nearest_dist)
+    {
+      *nearest = median;
+      *nearest_dist = dist;
+    }
+
+  diff = (depth % 2 == 0) ? x - median->x : y - median->y;
+
+  /* the side of the point first, the other one only if it can hold
+   * something nearer */
+  if (diff < 0)
+    {
+      find_nearest (points, n_before, depth + 1, x, y, nearest, nearest_dist);
+      if (diff * diff < *nearest_dist)
+        find_nearest (median + 1, n_points - n_before - 1, depth + 1, x, y, nearest, nearest_dist);
+    }
+  else
+    {
+      find_nearest (median + 1, n_points - n_before - 1, depth + 1, x, y, nearest, nearest_dist);
+      if (diff * diff < *nearest_dist)
+        find_nearest (points, n_before, depth + 1, x, y, nearest, nearest_dist);
+    }
+}
+
+static void
+update_points (CcTimezoneMap *map,
+               gint           width,
+               gint           height)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GPtrArray *locations;
+  gint i;
+
+  if (priv->tzdb == NULL ||
+      (priv->points != NULL &&
+       priv->points_width == width &&
+       priv->points_height == height))
+    return;
+
+  locations = tz_get_locations (priv->tzdb);
+  if (priv->points == NULL)
+    {
+      priv->n_points = locations->len;
+      priv->points = g_new (CcTimezoneMapPoint, priv->n_points);
+    }
+
+  for (i = 0; i < priv->n_points; i++)
+    {
+      TzLocation *loc = locations->pdata[i];
+
+      priv->points[i].x = convert_longtitude_to_x (loc->longitude, width);
+      priv->points[i].y = convert_latitude_to_y (loc->latitude, height);
+      priv->points[i].location = loc;
+    }
+
+  build_tree (priv->points, priv->n_points, 0);
+
+  priv->points_width = width;
+  priv->points_height = height;
+}
+
+static TzLocation *
+get_nearest_location (CcTimezoneMap *map,
+                      gdouble        x,
+                      gdouble        y)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  const CcTimezoneMapPoint *nearest = NULL;
+  gfloat nearest_dist = G_MAXFLOAT;
+
+  find_nearest (priv->points, priv->n_points, 0, x, y, &nearest, &nearest_dist);
+
+  return nearest ? nearest->location : NULL;
+}
+
+
+static void
+hilight_free (CcTimezoneMapHilight *hilight)
+{
+  cairo_surface_destroy (hilight->surface);
+  g_slice_free (CcTimezoneMapHilight, hilight);
+}
+
+static void
+clear_layers (CcTimezoneMap *map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  CcTimezoneMapHilight *hilight;
+
+  g_clear_pointer (&priv->background, cairo_surface_destroy);
+
+  while ((hilight = g_queue_pop_head (&priv->hilights)) != NULL)
+    hilight_free (hilight);
+}
+
+static cairo_surface_t *
+create_scaled_surface (GdkPixbuf *pixbuf,
+                       gint       width,
+                       gint       height)
+{
+  cairo_surface_t *surface;
+  GdkPixbuf *scaled;
+  cairo_t *cr;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+
+  if (gdk_pixbuf_get_width (pixbuf) == width &&
+      gdk_pixbuf_get_height (pixbuf) == height)
+    scaled = g_object_ref (pixbuf);
+  else
+    scaled = gdk_pixbuf_scale_simple (pixbuf, width, height, GDK_INTERP_BILINEAR);
+
+  cr = cairo_create (surface);
+  gdk_cairo_set_source_pixbuf (cr, scaled, 0, 0);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  g_object_unref (scaled);
+
+  return surface;
+}
+
+static cairo_surface_t *
+get_background (CcTimezoneMap *map,
+                gboolean       dim)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  GdkPixbuf *pixbuf;
+
+  if (priv->background != NULL && priv->background_dim == dim)
+    return priv->background;
+
+  g_clear_pointer (&priv->background, cairo_surface_destroy);
+
+  pixbuf = dim ? priv->orig_background_dim : priv->orig_background;
+  if (pixbuf == NULL)
+    return NULL;
+
+  priv->background = create_scaled_surface (pixbuf,
+                                            priv->layers_width,
+                                            priv->layers_height);
+  priv->background_dim = dim;
+
+  return priv->background;
+}
+
+static cairo_surface_t *
+get_hilight (CcTimezoneMap *map,
+             gdouble        offset,
+             gboolean       dim)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  CcTimezoneMapHilight *hilight;
+  GdkPixbuf *pixbuf;
   GError *err = NULL;
-  gdouble pointx, pointy;
+  GList *l;
+  gchar *file;
   char buf[16];
   const char *fmt;
 
-  gtk_widget_get_allocation (widget, &alloc);
+  for (l = priv->hilights.head; l != NULL; l = l->next)
+    {
+      hilight = l->data;
 
-  /* paint background */
-  gdk_cairo_set_source_pixbuf (cr, priv->background, 0, 0);
-  cairo_paint (cr);
+      if (hilight->offset == offset && hilight->dim == dim)
+        {
+          g_queue_unlink (&priv->hilights, l);
+          g_queue_push_head_link (&priv->hilights, l);
+          return hilight->surface;
+        }
+    }
 
-  /* paint hilight */
-  if (gtk_widget_is_sensitive (widget))
+  if (!dim)
     fmt = DATETIME_RESOURCE_PATH "/timezone_%s.png";
   else
     fmt = DATETIME_RESOURCE_PATH "/timezone_%s_dim.png";
 
   file = g_strdup_printf (fmt,
                           g_ascii_formatd (buf, sizeof (buf),
-                                           "%g", priv->selected_offset));
-  orig_hilight = gdk_pixbuf_new_from_resource (file, &err);
+                                           "%g", offset));
+  pixbuf = gdk_pixbuf_new_from_resource (file, &err);
   g_free (file);
-  file = NULL;
 
-  if (!orig_hilight)
+  if (!pixbuf)
     {
       g_warning ("Could not load hilight: %s",
                  (err) ? err->message : "Unknown Error");
-      if (err)
-        g_clear_error (&err);
+      g_clear_error (&err);
+      return NULL;
     }
-  else
-    {
 
-      hilight = gdk_pixbuf_scale_simple (orig_hilight, alloc.width,
-                                         alloc.height, GDK_INTERP_BILINEAR);
-      gdk_cairo_set_source_pixbuf (cr, hilight, 0, 0);
+  hilight = g_slice_new (CcTimezoneMapHilight);
+  hilight->offset = offset;
+  hilight->dim = dim;
+  hilight->surface = create_scaled_surface (pixbuf,
+                                            priv->layers_width,
+                                            priv->layers_height);
+  g_object_unref (pixbuf);
+
+  g_queue_push_head (&priv->hilights, hilight);
+  if (g_queue_get_length (&priv->hilights) > MAX_HILIGHTS)
+    hilight_free (g_queue_pop_tail (&priv->hilights));
+
+  return hilight->surface;
+}
+
+static gboolean
+cc_timezone_map_draw (GtkWidget *widget,
+                      cairo_t   *cr)
+{
+  CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
+  CcTimezoneMap *map = CC_TIMEZONE_MAP (widget);
+  cairo_surface_t *surface;
+  GtkAllocation alloc;
+  gdouble pointx, pointy;
+  gboolean dim;
+
+  if (priv->layers_width <= 0 || priv->layers_height <= 0)
+    return TRUE;
 
+  gtk_widget_get_allocation (widget, &alloc);
+  dim = !gtk_widget_is_sensitive (widget);
+
+  /* paint background */
+  surface = get_background (map, dim);
+  if (surface)
+    {
+      cairo_set_source_surface (cr, surface, 0, 0);
       cairo_paint (cr);
-      g_object_unref (hilight);
-      g_object_unref (orig_hilight);
     }
 
-  /* load pin icon */
-  pin = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/pin.png", &err);
-
-  if (err)
+  /* paint hilight */
+  surface = get_hilight (map, priv->selected_offset, dim);
+  if (surface)
     {
-      g_warning ("Could not load pin icon: %s", err->message);
-      g_clear_error (&err);
+      cairo_set_source_surface (cr, surface, 0, 0);
+      cairo_paint (cr);
     }
 
-  if (priv->location)
+  if (priv->location && priv->pin)
     {
       pointx = convert_longtitude_to_x (priv->location->longitude, alloc.width);
       pointy = convert_latitude_to_y (priv->location->latitude, alloc.height);
@@ -391,16 +678,10 @@ cc_timezone_map_draw (GtkWidget *widget,
       if (pointy > alloc.height)
         pointy = alloc.height;
 
-      if (pin)
-        {
-          gdk_cairo_set_source_pixbuf (cr, pin, pointx - PIN_HOT_POINT_X, pointy - PIN_HOT_POINT_Y);
-          cairo_paint (cr);
-        }
-    }
-
-  if (pin)
-    {
-      g_object_unref (pin);
+      cairo_set_source_surface (cr, priv->pin,
+                                pointx - PIN_HOT_POINT_X,
+                                pointy - PIN_HOT_POINT_Y);
+      cairo_paint (cr);
     }
 
   return TRUE;
@@ -429,6 +710,34 @@ update_cursor (GtkWidget *widget)
     g_object_unref (cursor);
 }
 
+/* Previews the location a click would pick */
+static gboolean
+cc_timezone_map_query_tooltip (GtkWidget  *widget,
+                               gint        x,
+                               gint        y,
+                               gboolean    keyboard_mode,
+                               GtkTooltip *tooltip)
+{
+  TzLocation *location;
+  const char *zone;
+  char *city;
+
+  if (keyboard_mode || !gtk_widget_is_sensitive (widget))
+    return FALSE;
+
+  location = get_nearest_location (CC_TIMEZONE_MAP (widget), x, y);
+  if (location == NULL)
+    return FALSE;
+
+  zone = g_dgettext (GETTEXT_PACKAGE_TIMEZONES, location->zone);
+  city = g_strdup (strrchr (zone, '/') ? strrchr (zone, '/') + 1 : zone);
+  g_strdelimit (city, "_", ' ');
+  gtk_tooltip_set_text (tooltip, city);
+  g_free (city);
+
+  return TRUE;
+}
+
 static void
 cc_timezone_map_state_flags_changed (GtkWidget     *widget,
                                      GtkStateFlags  prev_state)
@@ -459,6 +768,7 @@ cc_timezone_map_class_init (CcTimezoneMapClass *klass)
   widget_class->realize = cc_timezone_map_realize;
   widget_class->draw = cc_timezone_map_draw;
   widget_class->state_flags_changed = cc_timezone_map_state_flags_changed;
+  widget_class->query_tooltip = cc_timezone_map_query_tooltip;
 
   signals[LOCATION_CHANGED] = g_signal_new ("location-changed",
                                             CC_TYPE_TIMEZONE_MAP,
@@ -472,19 +782,6 @@ cc_timezone_map_class_init (CcTimezoneMapClass *klass)
 }
 
 
-static gint
-sort_locations (TzLocation *a,
-                TzLocation *b)
-{
-  if (a->dist > b->dist)
-    return 1;
-
-  if (a->dist < b->dist)
-    return -1;
-
-  return 0;
-}
-
 static void
 set_location (CcTimezoneMap *map,
               TzLocation    *location)
@@ -496,7 +793,7 @@ set_location (CcTimezoneMap *map,
 
   info = tz_info_from_location (priv->location);
 
-  priv->selected_offset = tz_location_get_utc_offset (priv->location)
+  priv->selected_offset = info->utc_offset
     / (60.0*60.0) + ((info->daylight) ? -1.0 : 0.0);
 
   g_signal_emit (map, signals[LOCATION_CHANGED], 0, priv->location);
@@ -509,78 +806,97 @@ button_press_event (GtkWidget      *widget,
                     GdkEventButton *event)
 {
   CcTimezoneMapPrivate *priv = CC_TIMEZONE_MAP (widget)->priv;
-  gint x, y;
-  guchar r, g, b, a;
-  guchar *pixels;
-  gint rowstride;
-  gint i;
-
-  const GPtrArray *array;
-  gint width, height;
-  GList *distances = NULL;
   GtkAllocation alloc;
+  gint x, y, map_x, map_y;
+  guint8 index;
+  TzLocation *location;
 
   x = event->x;
   y = event->y;
 
+  gtk_widget_get_allocation (widget, &alloc);
 
-  rowstride = priv->visible_map_rowstride;
-  pixels = priv->visible_map_pixels;
-
-  r = pixels[(rowstride * y + x * 4)];
-  g = pixels[(rowstride * y + x * 4) + 1];
-  b = pixels[(rowstride * y + x * 4) + 2];
-  a = pixels[(rowstride * y + x * 4) + 3];
-
-
-  for (i = 0; color_codes[i].offset != -100; i++)
+  if (priv->offset_map != NULL)
     {
-       if (color_codes[i].red == r && color_codes[i].green == g
-           && color_codes[i].blue == b && color_codes[i].alpha == a)
-         {
-           priv->selected_offset = color_codes[i].offset;
-         }
+      map_x = CLAMP (x * priv->offset_map_width / alloc.width, 0, priv->offset_map_width - 1);
+      map_y = CLAMP (y * priv->offset_map_height / alloc.height, 0, priv->offset_map_height - 1);
+
+      index = priv->offset_map[map_y * priv->offset_map_width + map_x];
+      if (index != NO_OFFSET)
+        priv->selected_offset = color_codes[index].offset;
     }
 
   gtk_widget_queue_draw (widget);
 
-  /* work out the co-ordinates */
+  location = get_nearest_location (CC_TIMEZONE_MAP (widget), x, y);
+  if (location)
+    set_location (CC_TIMEZONE_MAP (widget), location);
 
-  array = tz_get_locations (priv->tzdb);
+  return TRUE;
+}
 
-  gtk_widget_get_allocation (widget, &alloc);
-  width = alloc.width;
-  height = alloc.height;
+static void
+load_offset_map (CcTimezoneMap *map,
+                 GdkPixbuf     *color_map)
+{
+  CcTimezoneMapPrivate *priv = map->priv;
+  const guchar *pixels, *pixel;
+  guint32 color, last_color;
+  guint8 index;
+  gint rowstride, width, height;
+  gint x, y, i;
 
-  for (i = 0; i < array->len; i++)
+  if (gdk_pixbuf_get_n_channels (color_map) != 4)
     {
-      gdouble pointx, pointy, dx, dy;
-      TzLocation *loc = array->pdata[i];
-
-      pointx = convert_longtitude_to_x (loc->longitude, width);
-      pointy = convert_latitude_to_y (loc->latitude, height);
-
-      dx = pointx - x;
-      dy = pointy - y;
-
-      loc->dist = dx * dx + dy * dy;
-      distances = g_list_prepend (distances, loc);
-
+      g_warning ("The colour-code map has no alpha channel");
+      return;
     }
-  distances = g_list_sort (distances, (GCompareFunc) sort_locations);
 
+  width = gdk_pixbuf_get_width (color_map);
+  height = gdk_pixbuf_get_height (color_map);
+  rowstride = gdk_pixbuf_get_rowstride (color_map);
+  pixels = gdk_pixbuf_get_pixels (color_map);
 
-  set_location (CC_TIMEZONE_MAP (widget), (TzLocation*) distances->data);
+  priv->offset_map = g_new (guint8, width * height);
+  priv->offset_map_width = width;
+  priv->offset_map_height = height;
 
-  g_list_free (distances);
+  /* the map is made of large areas of the same colour */
+  last_color = 0;
+  index = NO_OFFSET;
 
-  return TRUE;
+  for (y = 0; y < height; y++)
+    {
+      for (x = 0; x < width; x++)
+        {
+          pixel = pixels + y * rowstride + x * 4;
+          color = (pixel[0] << 24) | (pixel[1] << 16) | (pixel[2] << 8) | pixel[3];
+
+          if (color != last_color || (x == 0 && y == 0))
+            {
+              index = NO_OFFSET;
+              for (i = 0; color_codes[i].offset != -100; i++)
+                {
+                  if (color_codes[i].red == pixel[0] && color_codes[i].green == pixel[1]
+                      && color_codes[i].blue == pixel[2] && color_codes[i].alpha == pixel[3])
+                    {
+                      index = i;
+                      break;
+                    }
+                }
+              last_color = color;
+            }
+
+          priv->offset_map[y * width + x] = index;
+        }
+    }
 }
 
 static void
 cc_timezone_map_init (CcTimezoneMap *self)
 {
   CcTimezoneMapPrivate *priv;
+  GdkPixbuf *color_map, *pin;
   GError *err = NULL;
 
   priv = self->priv = TIMEZONE_MAP_PRIVATE (self);
@@ -605,17 +921,39 @@ cc_timezone_map_init (CcTimezoneMap *self)
       g_clear_error (&err);
     }
 
-  priv->orig_color_map = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/cc.png",
-                                                       &err);
-  if (!priv->orig_color_map)
+  color_map = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/cc.png",
+                                            &err);
+  if (!color_map)
     {
       g_warning ("Could not load background image: %s",
                  (err) ? err->message : "Unknown error");
       g_clear_error (&err);
     }
+  else
+    {
+      load_offset_map (self, color_map);
+      g_object_unref (color_map);
+    }
+
+  pin = gdk_pixbuf_new_from_resource (DATETIME_RESOURCE_PATH "/pin.png", &err);
+  if (!pin)
+    {
+      g_warning ("Could not load pin icon: %s",
+                 (err) ? err->message : "Unknown error");
+      g_clear_error (&err);
+    }
+  else
+    {
+      priv->pin = create_scaled_surface (pin,
+                                         gdk_pixbuf_get_width (pin),
+                                         gdk_pixbuf_get_height (pin));
+      g_object_unref (pin);
+    }
 
   priv->tzdb = tz_load_db ();
 
+  gtk_widget_set_has_tooltip (GTK_WIDGET (self), TRUE);
+
   g_signal_connect (self, "button-press-event", G_CALLBACK (button_press_event),
                     NULL);
 }
@@ -0,0 +1,563 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <locale.h>
+#include <glib/gi18n-lib.h>
+
+#include "cc-util.h"
+#include "cc-timezone-search.h"
+
+#define NO_NODE G_MAXUINT32
+
+typedef struct {
+  const char *key;
+  guint       city;
+} SearchKey;
+
+/* Covers the keys [start, end), which all share the path from the root
+ * to the node, byte being the last one of that path */
+typedef struct {
+  guint32 first_child;
+  guint32 next_sibling;
+  guint32 start;
+  guint32 end;
+  guchar  byte;
+} TrieNode;
+
+struct _CcTimezoneSearch
+{
+  gint          ref_count;
+  TzDB         *db;
+  char         *locale;
+
+  GStringChunk *strings;
+  GArray       *cities;   /* CcTimezoneCity */
+  GArray       *regions;  /* CcTimezoneRegion */
+  GArray       *keys;     /* SearchKey, sorted */
+  GArray       *nodes;    /* TrieNode, the root first */
+
+  /* The last query, and the node reached by each of its prefixes,
+   * or NO_NODE once nothing matches */
+  GString      *query;
+  GArray       *path;
+};
+
+G_LOCK_DEFINE_STATIC (shared_search);
+static CcTimezoneSearch *shared_search = NULL;
+
+/* Folds the case, accents and separators of names and queries, so that
+ * "São Paulo" is found as "sao paulo" and "Buenos_Aires" as "buenos aires" */
+static char *
+normalize (const char *str)
+{
+  char *normalized, *p, *q;
+  gboolean space = TRUE;
+
+  normalized = cc_util_normalize_casefold_and_unaccent (str);
+
+  for (p = q = normalized; *p != '\0'; p++)
+    {
+      if (*p == ' ' || *p == '_' || *p == '/' || *p == '-')
+        {
+          if (!space)
+            *q++ = ' ';
+          space = TRUE;
+        }
+      else
+        {
+          *q++ = *p;
+          space = FALSE;
+        }
+    }
+  *q = '\0';
+
+  return normalized;
+}
+
+static gboolean
+is_slash (gunichar c)
+{
+  /* Slash look-alikes that might be used in translations */
+  return (c == '/' ||
+          c == 0x2044 ||  /* FRACTION SLASH */
+          c == 0x2215 ||  /* DIVISION SLASH */
+          c == 0x29f8 ||  /* BIG SOLIDUS */
+          c == 0xff0f);   /* FULLWIDTH SOLIDUS */
+}
+
+/* Splits the translation of a zone into its region and its city, the
+ * city keeping its own slashes, as in America/Argentina/Buenos_Aires */
+static void
+split_translated (const char  *zone,
+                  char       **region,
+                  char       **city)
+{
+  GString *part;
+  const char *p;
+
+  part = g_string_new (NULL);
+  *region = NULL;
+
+  for (p = zone; *p != '\0'; p = g_utf8_next_char (p))
+    {
+      gunichar c = g_utf8_get_char (p);
+
+      if (c == '_')
+        c = ' ';
+
+      if (is_slash (c))
+        {
+          if (*region == NULL)
+            {
+              *region = g_strdup (part->str);
+              g_string_truncate (part, 0);
+              continue;
+            }
+          c = '/';
+        }
+
+      g_string_append_unichar (part, c);
+    }
+
+  if (*region == NULL)
+    {
+      *region = g_string_free (part, FALSE);
+      *city = g_strdup ("");
+    }
+  else
+    {
+      *city = g_string_free (part, FALSE);
+    }
+}
+
+static guint
+add_region (CcTimezoneSearch *search,
+            GHashTable       *region_ids,
+            const char       *region,
+            const char       *region_translated)
+{
+  CcTimezoneRegion r;
+  gpointer id;
+
+  if (g_hash_table_lookup_extended (region_ids, region, NULL, &id))
+    return GPOINTER_TO_UINT (id);
+
+  r.region = g_string_chunk_insert_const (search->strings, region);
+  r.region_translated = g_string_chunk_insert_const (search->strings, region_translated);
+  g_array_append_val (search->regions, r);
+
+  g_hash_table_insert (region_ids, (gpointer) r.region,
+                       GUINT_TO_POINTER (search->regions->len - 1));
+
+  return search->regions->len - 1;
+}
+
+/* Adds the name as a key, and the rest of it from each of its words */
+static void
+add_keys (CcTimezoneSearch *search,
+          const char       *name,
+          guint             city)
+{
+  SearchKey key;
+  char *normalized;
+  const char *word;
+
+  normalized = normalize (name);
+
+  word = normalized;
+  while (*word != '\0')
+    {
+      key.key = g_string_chunk_insert_const (search->strings, word);
+      key.city = city;
+      g_array_append_val (search->keys, key);
+
+      word = strchr (word, ' ');
+      if (word == NULL)
+        break;
+      word++;
+    }
+
+  g_free (normalized);
+}
+
+static void
+load_cities (CcTimezoneSearch *search,
+             GHashTable       *city_ids)
+{
+  GHashTable *region_ids;
+  GPtrArray *locations;
+  guint i;
+
+  region_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  locations = tz_get_locations (search->db);
+
+  for (i = 0; i < locations->len; i++)
+    {
+      TzLocation *loc = g_ptr_array_index (locations, i);
+      CcTimezoneCity city;
+      char *zone, *slash;
+      char *region_translated, *city_translated;
+
+      zone = g_strdup (loc->zone);
+      g_strdelimit (zone, "_", ' ');
+      slash = strchr (zone, '/');
+      if (slash != NULL)
+        *slash = '\0';
+
+      split_translated (dgettext (GETTEXT_PACKAGE_TIMEZONES, loc->zone),
+                        &region_translated, &city_translated);
+
+      city.location = loc;
+      city.region_id = add_region (search, region_ids, zone, region_translated);
+      city.region = g_array_index (search->regions, CcTimezoneRegion, city.region_id).region;
+      city.city = g_string_chunk_insert_const (search->strings,
+                                               slash != NULL ? slash + 1 : "");
+      city.region_translated = g_array_index (search->regions, CcTimezoneRegion, city.region_id).region_translated;
+      city.city_translated = g_string_chunk_insert_const (search->strings, city_translated);
+      g_array_append_val (search->cities, city);
+
+      g_hash_table_insert (city_ids, loc->zone, GUINT_TO_POINTER (i));
+
+      add_keys (search, city.city_translated, i);
+      if (strcmp (city.city, city.city_translated) != 0)
+        add_keys (search, city.city, i);
+      add_keys (search, city.region_translated, i);
+      if (strcmp (city.region, city.region_translated) != 0)
+        add_keys (search, city.region, i);
+
+      g_free (region_translated);
+      g_free (city_translated);
+      g_free (zone);
+    }
+
+  g_hash_table_destroy (region_ids);
+}
+
+typedef struct {
+  CcTimezoneSearch *search;
+  GHashTable       *city_ids;
+} AliasData;
+
+static void
+add_alias (const char *alias,
+           const char *zone,
+           gpointer    user_data)
+{
+  AliasData *data = user_data;
+  gpointer city;
+
+  /* only the links to the cities themselves */
+  if (!g_hash_table_lookup_extended (data->city_ids, zone, NULL, &city))
+    return;
+
+  add_keys (data->search, alias, GPOINTER_TO_UINT (city));
+}
+
+static gint
+compare_keys (gconstpointer a,
+              gconstpointer b)
+{
+  const SearchKey *ka = a, *kb = b;
+  int cmp;
+
+  cmp = strcmp (ka->key, kb->key);
+  if (cmp != 0)
+    return cmp;
+
+  return (ka->city > kb->city) - (ka->city < kb->city);
+}
+
+/* Builds the node for the keys [start, end) sharing their first depth
+ * bytes, and below it those for each of the following bytes */
+static guint32
+build_node (CcTimezoneSearch *search,
+            guint             start,
+            guint             end,
+            guint             depth,
+            guchar            byte)
+{
+  TrieNode node;
+  guint32 id, previous = NO_NODE;
+  guint i;
+
+  node.first_child = NO_NODE;
+  node.next_sibling = NO_NODE;
+  node.start = start;
+  node.end = end;
+  node.byte = byte;
+  g_array_append_val (search->nodes, node);
+  id = search->nodes->len - 1;
+
+  /* the keys ending here come first */
+  i = start;
+  while (i < end && g_array_index (search->keys, SearchKey, i).key[depth] == '\0')
+    i++;
+
+  while (i < end)
+    {
+      guchar c = g_array_index (search->keys, SearchKey, i).key[depth];
+      guint32 child;
+      guint j;
+
+      for (j = i + 1; j < end; j++)
+        {
+          if ((guchar) g_array_index (search->keys, SearchKey, j).key[depth] != c)
+            break;
+        }
+
+      child = build_node (search, i, j, depth + 1, c);
+
+      /* the array may have moved, so no pointers to the nodes are kept */
+      if (previous == NO_NODE)
+        g_array_index (search->nodes, TrieNode, id).first_child = child;
+      else
+        g_array_index (search->nodes, TrieNode, previous).next_sibling = child;
+      previous = child;
+
+      i = j;
+    }
+
+  return id;
+}
+
+static CcTimezoneSearch *
+cc_timezone_search_new (TzDB       *db,
+                        const char *locale)
+{
+  CcTimezoneSearch *search;
+  GHashTable *city_ids;
+  AliasData data;
+  guint32 root;
+
+  search = g_slice_new0 (CcTimezoneSearch);
+  search->ref_count = 1;
+  search->db = tz_db_ref (db);
+  search->locale = g_strdup (locale);
+  search->strings = g_string_chunk_new (4096);
+  search->cities = g_array_new (FALSE, FALSE, sizeof (CcTimezoneCity));
+  search->regions = g_array_new (FALSE, FALSE, sizeof (CcTimezoneRegion));
+  search->keys = g_array_new (FALSE, FALSE, sizeof (SearchKey));
+  search->nodes = g_array_new (FALSE, FALSE, sizeof (TrieNode));
+
+  city_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  load_cities (search, city_ids);
+
+  data.search = search;
+  data.city_ids = city_ids;
+  tz_db_foreach_alias (db, add_alias, &data);
+  g_hash_table_destroy (city_ids);
+
+  g_array_sort (search->keys, compare_keys);
+  build_node (search, 0, search->keys->len, 0, '\0');
+
+  search->query = g_string_new (NULL);
+  search->path = g_array_new (FALSE, FALSE, sizeof (guint32));
+  root = 0;
+  g_array_append_val (search->path, root);
+
+  g_debug ("Indexed %u cities under %u keys, in %u nodes",
+           search->cities->len, search->keys->len, search->nodes->len);
+
+  return search;
+}
+
+/**
+ * cc_timezone_search_get:
+ * @db: the timezone database
+ *
+ * Returns: the index of the cities of @db for the current locale, to be
+ * released with cc_timezone_search_unref(). It is shared with the other
+ * callers until the locale changes.
+ */
+CcTimezoneSearch *
+cc_timezone_search_get (TzDB *db)
+{
+  CcTimezoneSearch *search;
+  const char *locale;
+
+  locale = setlocale (LC_MESSAGES, NULL);
+
+  G_LOCK (shared_search);
+
+  if (shared_search != NULL &&
+      (shared_search->db != db || g_strcmp0 (shared_search->locale, locale) != 0))
+    {
+      /* the users of the previous index keep their reference */
+      cc_timezone_search_unref (shared_search);
+      shared_search = NULL;
+    }
+
+  if (shared_search == NULL)
+    shared_search = cc_timezone_search_new (db, locale);
+
+  search = shared_search;
+  g_atomic_int_inc (&search->ref_count);
+
+  G_UNLOCK (shared_search);
+
+  return search;
+}
+
+void
+cc_timezone_search_unref (CcTimezoneSearch *search)
+{
+  if (search == NULL)
+    return;
+
+  if (!g_atomic_int_dec_and_test (&search->ref_count))
+    return;
+
+  g_array_free (search->path, TRUE);
+  g_string_free (search->query, TRUE);
+  g_array_free (search->nodes, TRUE);
+  g_array_free (search->keys, TRUE);
+  g_array_free (search->regions, TRUE);
+  g_array_free (search->cities, TRUE);
+  g_string_chunk_free (search->strings);
+  g_free (search->locale);
+  tz_db_unref (search->db);
+  g_slice_free (CcTimezoneSearch, search);
+}
+
+guint
+cc_timezone_search_get_n_cities (CcTimezoneSearch *search)
+{
+  return search->cities->len;
+}
+
+const CcTimezoneCity *
+cc_timezone_search_get_city (CcTimezoneSearch *search,
+                             guint             city)
+{
+  g_return_val_if_fail (city < search->cities->len, NULL);
+
+  return &g_array_index (search->cities, CcTimezoneCity, city);
+}
+
+guint
+cc_timezone_search_get_n_regions (CcTimezoneSearch *search)
+{
+  return search->regions->len;
+}
+
+const CcTimezoneRegion *
+cc_timezone_search_get_region (CcTimezoneSearch *search,
+                               guint             region)
+{
+  g_return_val_if_fail (region < search->regions->len, NULL);
+
+  return &g_array_index (search->regions, CcTimezoneRegion, region);
+}
+
+static guint32
+find_child (CcTimezoneSearch *search,
+            guint32           node,
+            guchar            byte)
+{
+  guint32 child;
+
+  if (node == NO_NODE)
+    return NO_NODE;
+
+  child = g_array_index (search->nodes, TrieNode, node).first_child;
+  while (child != NO_NODE)
+    {
+      const TrieNode *n = &g_array_index (search->nodes, TrieNode, child);
+
+      if (n->byte == byte)
+        break;
+      child = n->next_sibling;
+    }
+
+  return child;
+}
+
+/**
+ * cc_timezone_search_query:
+ * @search: a #CcTimezoneSearch
+ * @text: what the user typed
+ * @cities: (out caller-allocates): the matching cities
+ * @max_cities: the size of @cities
+ *
+ * Finds the cities which have a word of their names, or their region,
+ * starting with @text. Only the characters added to or removed from the
+ * end of the previous query are looked up in the index.
+ *
+ * The cities are in the order of the matching keys, each appearing once.
+ *
+ * Returns: the number of cities stored in @cities
+ */
+guint
+cc_timezone_search_query (CcTimezoneSearch *search,
+                          const char       *text,
+                          guint            *cities,
+                          guint             max_cities)
+{
+  const TrieNode *node;
+  char *normalized;
+  guint32 id;
+  guint common, n_cities, i, j;
+
+  normalized = normalize (text);
+
+  /* step back to the longest prefix shared with the previous query... */
+  for (common = 0; common < search->query->len; common++)
+    {
+      if (search->query->str[common] != normalized[common])
+        break;
+    }
+  g_string_truncate (search->query, common);
+  g_array_set_size (search->path, common + 1);
+
+  /* ...and down for what's new */
+  for (i = common; normalized[i] != '\0'; i++)
+    {
+      id = find_child (search, g_array_index (search->path, guint32, i),
+                       (guchar) normalized[i]);
+      g_array_append_val (search->path, id);
+      g_string_append_c (search->query, normalized[i]);
+    }
+
+  g_free (normalized);
+
+  id = g_array_index (search->path, guint32, search->query->len);
+  if (id == NO_NODE || search->query->len == 0)
+    return 0;
+
+  node = &g_array_index (search->nodes, TrieNode, id);
+  n_cities = 0;
+
+  for (i = node->start; i < node->end && n_cities < max_cities; i++)
+    {
+      guint city = g_array_index (search->keys, SearchKey, i).city;
+
+      for (j = 0; j < n_cities; j++)
+        {
+          if (cities[j] == city)
+            break;
+        }
+      if (j == n_cities)
+        cities[n_cities++] = city;
+    }
+
+  return n_cities;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _CC_TIMEZONE_SEARCH_H
+#define _CC_TIMEZONE_SEARCH_H
+
+#include <glib.h>
+#include "tz.h"
+
+G_BEGIN_DECLS
+
+/* The cities of the timezone database, with their names split into
+ * region and city and translated once for the current locale, and an
+ * index to find them as the user types.
+ *
+ * The index holds the beginning of every word of the names of the
+ * cities, translated or not, of their regions and of their former names
+ * from the backward file, casefolded and without accents. It is a trie
+ * over those keys, sorted, where each node covers the range of keys it
+ * is a prefix of. Queries are remembered, so that typing or erasing a
+ * character costs a single step in the trie.
+ *
+ * The index is shared while in use, and built again when the locale
+ * changes. It is only to be queried from the main thread. */
+
+typedef struct _CcTimezoneSearch CcTimezoneSearch;
+
+typedef struct {
+  TzLocation *location;
+  const char *region;             /* with spaces instead of underscores */
+  const char *city;
+  const char *region_translated;
+  const char *city_translated;
+  guint       region_id;          /* index of the region */
+} CcTimezoneCity;
+
+typedef struct {
+  const char *region;
+  const char *region_translated;
+} CcTimezoneRegion;
+
+CcTimezoneSearch       *cc_timezone_search_get           (TzDB             *db);
+void                    cc_timezone_search_unref         (CcTimezoneSearch *search);
+
+guint                   cc_timezone_search_get_n_cities  (CcTimezoneSearch *search);
+const CcTimezoneCity   *cc_timezone_search_get_city      (CcTimezoneSearch *search,
+                                                          guint             city);
+guint                   cc_timezone_search_get_n_regions (CcTimezoneSearch *search);
+const CcTimezoneRegion *cc_timezone_search_get_region    (CcTimezoneSearch *search,
+                                                          guint             region);
+
+guint                   cc_timezone_search_query         (CcTimezoneSearch *search,
+                                                          const char       *text,
+                                                          guint            *cities,
+                                                          guint             max_cities);
+
+G_END_DECLS
+
+#endif /* _CC_TIMEZONE_SEARCH_H */
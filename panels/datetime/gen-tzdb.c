@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Compiles zone.tab and the backward file into the timezone database
+ * mapped by tz_load_db(), see tz.c.
+ *
+ * Usage: gen-tzdb OUTPUT BACKWARD [ZONE_TAB]
+ *
+ * ZONE_TAB defaults to the system one, which the database is checked
+ * against at runtime.
+ */
+
+#include <config.h>
+
+#include "tz.h"
+
+int main (int argc, char **argv)
+{
+	const char *zone_tab;
+	GError *error = NULL;
+	TzDB *db;
+
+	if (argc != 3 && argc != 4) {
+		g_printerr ("Usage: %s OUTPUT BACKWARD [ZONE_TAB]\n", argv[0]);
+		return 1;
+	}
+
+	zone_tab = argc == 4 ? argv[3] : TZ_DATA_FILE;
+
+	db = tz_db_load_text (zone_tab, argv[2], &error);
+	if (db == NULL) {
+		g_printerr ("%s\n", error->message);
+		return 1;
+	}
+
+	if (!tz_db_write (db, zone_tab, argv[1], &error)) {
+		g_printerr ("%s\n", error->message);
+		tz_db_unref (db);
+		return 1;
+	}
+
+	tz_db_unref (db);
+
+	return 0;
+}
@@ -32,7 +32,7 @@ int main (int argc, char **argv)
                 char buf[16];
 
 		info = tz_info_from_location (loc);
-		selected_offset = tz_location_get_utc_offset (loc)
+		selected_offset = info->utc_offset
 			/ (60.0*60.0) + ((info->daylight) ? -1.0 : 0.0);
 
 		filename = g_strdup_printf ("timezone_%s.png",
@@ -47,8 +47,9 @@ int main (int argc, char **argv)
 
 		g_free (filename);
 		g_free (path);
+		tz_info_free (info);
 	}
-	tz_db_free (db);
+	tz_db_unref (db);
 	g_free (pixmap_dir);
 
 	return retval;
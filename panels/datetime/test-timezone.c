@@ -94,7 +94,7 @@ int main (int argc, char **argv)
 		g_free (clean_tz);
 	}
 	g_list_free (tzs);
-	tz_db_free (tz_db);
+	tz_db_unref (tz_db);
 	g_hash_table_destroy (ht);
 
 	return ret;
@@ -0,0 +1,216 @@
+#include <config.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "tz.h"
+#include "cc-timezone-search.h"
+
+/* Checks that the compiled timezone database matches the text one, the
+ * UTC offsets of the locations, and the search of the cities */
+
+static const char *aliases[] = {
+	"US/Eastern",
+	"Asia/Calcutta",
+	"Europe/Kiev",
+	"posix/Etc/UTC",
+	"No/Such_Zone",
+};
+
+/* 2013-01-15 and 2013-07-15, 12:00 UTC */
+#define WINTER 1358251200
+#define SUMMER 1373889600
+
+static void
+check_info (TzLocation *loc,
+	    gint64      time,
+	    glong       utc_offset,
+	    const char *abbreviation,
+	    gboolean    daylight)
+{
+	TzInfo *info;
+
+	info = tz_info_from_location_at (loc, time);
+	g_assert_cmpint (info->utc_offset, ==, utc_offset);
+	g_assert_cmpstr (info->tzname_normal, ==, abbreviation);
+	g_assert_cmpint (info->daylight, ==, daylight);
+	tz_info_free (info);
+}
+
+/* The offsets don't depend on the TZ environment variable any more, so
+ * they can be looked up from several threads at once */
+static gpointer
+get_offsets (gpointer data)
+{
+	GPtrArray *locs = data;
+	guint i, j;
+
+	for (j = 0; j < 10; j++) {
+		for (i = 0; i < locs->len; i++) {
+			TzInfo *info;
+
+			info = tz_info_from_location_at (locs->pdata[i], WINTER + j * 86400);
+			g_assert (info->tzname_normal != NULL);
+			tz_info_free (info);
+		}
+	}
+
+	return NULL;
+}
+
+static void
+check_offsets (GPtrArray *locs)
+{
+	TzLocation paris = { (gchar *) "FR", 48.86, 2.33, (gchar *) "Europe/Paris", NULL };
+	TzLocation phoenix = { (gchar *) "US", 33.45, -112.07, (gchar *) "America/Phoenix", NULL };
+	GThread *threads[4];
+	guint i;
+
+	check_info (&paris, WINTER, 3600, "CET", FALSE);
+	check_info (&paris, SUMMER, 7200, "CEST", TRUE);
+	check_info (&phoenix, WINTER, -7 * 3600, "MST", FALSE);
+	check_info (&phoenix, SUMMER, -7 * 3600, "MST", FALSE);
+
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("offsets", get_offsets, locs);
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		g_thread_join (threads[i]);
+}
+
+static gboolean
+search_finds (CcTimezoneSearch *search,
+	      const char       *text,
+	      const char       *zone)
+{
+	guint cities[64];
+	guint i, n;
+
+	n = cc_timezone_search_query (search, text, cities, G_N_ELEMENTS (cities));
+	for (i = 0; i < n; i++) {
+		if (strcmp (cc_timezone_search_get_city (search, cities[i])->location->zone, zone) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+check_search (TzDB *db)
+{
+	CcTimezoneSearch *search;
+	guint first[64], again[64];
+	guint n_first, n_again;
+
+	search = cc_timezone_search_get (db);
+
+	g_assert (search_finds (search, "Buenos_Aires", "America/Argentina/Buenos_Aires"));
+	g_assert (search_finds (search, "aires", "America/Argentina/Buenos_Aires"));
+	g_assert (search_finds (search, "S\303\243o Paulo", "America/Sao_Paulo"));
+	g_assert (search_finds (search, "calcutta", "Asia/Kolkata"));
+	g_assert (search_finds (search, "US/Eastern", "America/New_York"));
+	g_assert (!search_finds (search, "", "Europe/Paris"));
+	g_assert (!search_finds (search, "parisx", "Europe/Paris"));
+
+	/* typing, erasing and typing something else */
+	n_first = cc_timezone_search_query (search, "par", first, G_N_ELEMENTS (first));
+	g_assert (search_finds (search, "pari", "Europe/Paris"));
+	g_assert (search_finds (search, "paris", "Europe/Paris"));
+	g_assert (!search_finds (search, "parix", "Europe/Paris"));
+	g_assert (search_finds (search, "eur", "Europe/Paris"));
+	n_again = cc_timezone_search_query (search, "par", again, G_N_ELEMENTS (again));
+	g_assert_cmpuint (n_first, ==, n_again);
+	g_assert (memcmp (first, again, n_first * sizeof (guint)) == 0);
+
+	cc_timezone_search_unref (search);
+}
+
+int main (int argc, char **argv)
+{
+	TzDB *text_db, *compiled_db;
+	GPtrArray *text_locs, *compiled_locs;
+	GError *error = NULL;
+	char *dir, *path, *path_missing, *zone_tab;
+	guint i;
+
+	if (argc != 2) {
+		g_message ("Usage: %s BACKWARD", argv[0]);
+		return 1;
+	}
+
+	dir = g_dir_make_tmp ("test-tzdb-XXXXXX", &error);
+	g_assert_no_error (error);
+	path = g_build_filename (dir, "tzdb", NULL);
+	path_missing = g_build_filename (dir, "backward", NULL);
+
+	text_db = tz_db_load_text (TZ_DATA_FILE, argv[1], &error);
+	g_assert_no_error (error);
+	tz_db_write (text_db, TZ_DATA_FILE, path, &error);
+	g_assert_no_error (error);
+
+	compiled_db = tz_db_load_compiled (path, TZ_DATA_FILE, &error);
+	g_assert_no_error (error);
+
+	text_locs = tz_get_locations (text_db);
+	compiled_locs = tz_get_locations (compiled_db);
+	g_assert_cmpuint (text_locs->len, ==, compiled_locs->len);
+
+	for (i = 0; i < text_locs->len; i++) {
+		TzLocation *a = text_locs->pdata[i];
+		TzLocation *b = compiled_locs->pdata[i];
+		char *clean_a, *clean_b;
+
+		g_assert_cmpstr (a->zone, ==, b->zone);
+		g_assert_cmpstr (a->country, ==, b->country);
+		g_assert_cmpstr (a->comment, ==, b->comment);
+		g_assert_cmpfloat (a->latitude, ==, b->latitude);
+		g_assert_cmpfloat (a->longitude, ==, b->longitude);
+
+		clean_a = tz_info_get_clean_name (text_db, a->zone);
+		clean_b = tz_info_get_clean_name (compiled_db, b->zone);
+		g_assert_cmpstr (clean_a, ==, clean_b);
+		g_free (clean_a);
+		g_free (clean_b);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (aliases); i++) {
+		char *clean_a, *clean_b;
+
+		clean_a = tz_info_get_clean_name (text_db, aliases[i]);
+		clean_b = tz_info_get_clean_name (compiled_db, aliases[i]);
+		g_assert_cmpstr (clean_a, ==, clean_b);
+		g_free (clean_a);
+		g_free (clean_b);
+	}
+
+	check_offsets (compiled_locs);
+	check_search (compiled_db);
+
+	tz_db_unref (compiled_db);
+
+	/* A database compiled from another zone.tab isn't used */
+	zone_tab = g_build_filename (dir, "zone.tab", NULL);
+	g_file_set_contents (zone_tab, "# empty\n", -1, &error);
+	g_assert_no_error (error);
+	compiled_db = tz_db_load_compiled (path, zone_tab, &error);
+	g_assert (compiled_db == NULL);
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+	g_clear_error (&error);
+
+	/* Without the backward file, only the links are missing */
+	compiled_db = tz_db_load_text (TZ_DATA_FILE, path_missing, &error);
+	g_assert_no_error (error);
+	g_assert (compiled_db != NULL);
+	g_assert_cmpuint (tz_get_locations (compiled_db)->len, ==, text_locs->len);
+	tz_db_unref (compiled_db);
+
+	tz_db_unref (text_db);
+
+	g_unlink (zone_tab);
+	g_unlink (path);
+	g_rmdir (dir);
+	g_free (zone_tab);
+	g_free (path);
+	g_free (path_missing);
+	g_free (dir);
+
+	return 0;
+}
@@ -24,6 +24,7 @@
 
 
 #include <glib.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -31,6 +32,7 @@
 #include <math.h>
 #include <string.h>
 #include "tz.h"
+#include "cc-mapped-cache.h"
 
 
 /* Forward declarations for private functions */
@@ -38,34 +40,169 @@
 static float convert_pos (gchar *pos, int digits);
 static int compare_country_names (const void *a, const void *b);
 static void sort_locations_by_country (GPtrArray *locations);
-static gchar * tz_data_file_get (void);
-static void load_backward_tz (TzDB *tz_db);
+static void load_backward_tz (TzDB *tz_db, const char *backward);
+static void tz_location_free (TzLocation *loc);
+
+/* The compiled database is generated at build time by gen-tzdb from
+ * zone.tab and the backward file, and mapped as is at runtime:
+ *
+ *   TzDBHeader
+ *   TzDBRecord[n_records], sorted by zone
+ *   TzDBAlias[n_aliases], sorted by alias
+ *   string pool, starting with an empty string
+ *
+ * It is only used as long as the SHA-1 of zone.tab is the one it was
+ * compiled from. All offsets are in bytes, strings are referenced by
+ * their offset in the pool, and the file uses the byte order of the
+ * machine it was built on. */
+
+#define TZ_DB_MAGIC "CCTZDB01"
+
+typedef struct {
+	gchar   magic[8];
+	guint32 checksum;	/* of zone.tab */
+	guint32 n_records;
+	guint32 records_offset;
+	guint32 n_aliases;
+	guint32 aliases_offset;
+	guint32 strings_offset;
+	guint32 strings_size;
+} TzDBHeader;
+
+typedef struct {
+	guint32 country;
+	guint32 zone;
+	guint32 comment;	/* 0 if there is none */
+	guint32 padding;
+	gdouble latitude;
+	gdouble longitude;
+} TzDBRecord;
+
+typedef struct {
+	guint32 alias;
+	guint32 real;
+} TzDBAlias;
+
+struct _TzDB
+{
+	gint        ref_count;
+	GPtrArray  *locations;
+
+	/* Text database */
+	GHashTable *backward;
+
+	/* Compiled database, the locations point to its strings */
+	GMappedFile     *file;
+	TzLocation      *records;
+	const TzDBAlias *aliases;
+	guint            n_aliases;
+	const char      *strings;
+};
+
+/* The database shared by the map and the panel, while it is in use */
+static TzDB *shared_db = NULL;
 
 /* ---------------- *
  * Public interface *
  * ---------------- */
+
+/**
+ * tz_load_db:
+ *
+ * Returns: a reference to the shared database, from the compiled
+ * database if it is up to date, or else from zone.tab
+ */
 TzDB *
 tz_load_db (void)
 {
-	gchar *tz_data_file;
+	GError *error = NULL;
+	TzDB *tz_db;
+
+	if (shared_db != NULL)
+		return tz_db_ref (shared_db);
+
+	tz_db = tz_db_load_compiled (GNOMECC_DATA_DIR "/datetime/tzdb",
+				     TZ_DATA_FILE, &error);
+	if (tz_db == NULL) {
+		g_debug ("Not using the compiled timezone database: %s", error->message);
+		g_clear_error (&error);
+
+		tz_db = tz_db_load_text (TZ_DATA_FILE,
+					 GNOMECC_DATA_DIR "/datetime/backward",
+					 &error);
+		if (tz_db == NULL) {
+			g_warning ("%s", error->message);
+			g_error_free (error);
+			return NULL;
+		}
+	}
+
+	shared_db = tz_db;
+
+	return tz_db;
+}
+
+TzDB *
+tz_db_ref (TzDB *db)
+{
+	g_return_val_if_fail (db != NULL, NULL);
+
+	db->ref_count++;
+
+	return db;
+}
+
+void
+tz_db_unref (TzDB *db)
+{
+	g_return_if_fail (db != NULL);
+
+	if (--db->ref_count > 0)
+		return;
+
+	if (db == shared_db)
+		shared_db = NULL;
+
+	g_ptr_array_free (db->locations, TRUE);
+	if (db->backward)
+		g_hash_table_destroy (db->backward);
+	g_free (db->records);
+	if (db->file)
+		g_mapped_file_unref (db->file);
+	g_free (db);
+}
+
+/**
+ * tz_db_load_text:
+ * @zone_tab: the zone.tab file
+ * @backward: the backward file, listing the links between zones
+ * @error: return location for a #GError
+ *
+ * A missing or unreadable @backward file only leaves the database
+ * without links.
+ *
+ * Returns: a new database, parsed from the text files
+ */
+TzDB *
+tz_db_load_text (const char  *zone_tab,
+		 const char  *backward,
+		 GError     **error)
+{
 	TzDB *tz_db;
 	FILE *tzfile;
 	char buf[4096];
 
-	tz_data_file = tz_data_file_get ();
-	if (!tz_data_file) {
-		g_warning ("Could not get the TimeZone data file name");
-		return NULL;
-	}
-	tzfile = fopen (tz_data_file, "r");
+	tzfile = fopen (zone_tab, "r");
 	if (!tzfile) {
-		g_warning ("Could not open *%s*\n", tz_data_file);
-		g_free (tz_data_file);
+		int errsv = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+			     "Could not open *%s*: %s", zone_tab, g_strerror (errsv));
 		return NULL;
 	}
 
 	tz_db = g_new0 (TzDB, 1);
-	tz_db->locations = g_ptr_array_new ();
+	tz_db->ref_count = 1;
+	tz_db->locations = g_ptr_array_new_with_free_func ((GDestroyNotify) tz_location_free);
 
 	while (fgets (buf, sizeof(buf), tzfile))
 	{
@@ -123,12 +260,220 @@ tz_load_db (void)
 	/* now sort by country */
 	sort_locations_by_country (tz_db->locations);
 	
-	g_free (tz_data_file);
-
 	/* Load up the hashtable of backward links */
-	load_backward_tz (tz_db);
+	load_backward_tz (tz_db, backward);
+
+	return tz_db;
+}
+
+static char *
+get_zone_tab_checksum (const char  *zone_tab,
+		       GError     **error)
+{
+	GMappedFile *file;
+	char *checksum;
+
+	file = g_mapped_file_new (zone_tab, FALSE, error);
+	if (file == NULL)
+		return NULL;
+
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+						(const guchar *) g_mapped_file_get_contents (file),
+						g_mapped_file_get_length (file));
+	g_mapped_file_unref (file);
+
+	return checksum;
+}
+
+static gboolean
+check_string (const TzDBHeader *header,
+	      guint32           offset)
+{
+	return cc_mapped_cache_check_string (header->strings_size, offset);
+}
+
+/**
+ * tz_db_load_compiled:
+ * @path: the compiled database
+ * @zone_tab: the zone.tab file it must have been compiled from
+ * @error: return location for a #GError
+ *
+ * Returns: a new database, or %NULL if it is missing, invalid or out of
+ * date
+ */
+TzDB *
+tz_db_load_compiled (const char  *path,
+		     const char  *zone_tab,
+		     GError     **error)
+{
+	const TzDBHeader *header;
+	const TzDBRecord *records;
+	const TzDBAlias *aliases;
+	GMappedFile *file;
+	const char *contents;
+	char *checksum;
+	gsize length;
+	TzDB *tz_db;
+	guint i;
+
+	file = g_mapped_file_new (path, FALSE, error);
+	if (file == NULL)
+		return NULL;
+
+	contents = g_mapped_file_get_contents (file);
+	length = g_mapped_file_get_length (file);
+	header = (const TzDBHeader *) contents;
+
+	if (!cc_mapped_cache_check_magic (contents, length, sizeof (TzDBHeader), TZ_DB_MAGIC) ||
+	    !cc_mapped_cache_check_array (length, header->records_offset, header->n_records,
+					  sizeof (TzDBRecord), sizeof (gdouble)) ||
+	    !cc_mapped_cache_check_array (length, header->aliases_offset, header->n_aliases,
+					  sizeof (TzDBAlias), sizeof (guint32)) ||
+	    !cc_mapped_cache_check_strings (contents, length,
+					    header->strings_offset, header->strings_size) ||
+	    !check_string (header, header->checksum))
+		goto invalid;
+
+	records = (const TzDBRecord *) (contents + header->records_offset);
+	for (i = 0; i < header->n_records; i++) {
+		if (!check_string (header, records[i].country) ||
+		    !check_string (header, records[i].zone) ||
+		    !check_string (header, records[i].comment))
+			goto invalid;
+	}
+
+	aliases = (const TzDBAlias *) (contents + header->aliases_offset);
+	for (i = 0; i < header->n_aliases; i++) {
+		if (!check_string (header, aliases[i].alias) ||
+		    !check_string (header, aliases[i].real))
+			goto invalid;
+	}
+
+	checksum = get_zone_tab_checksum (zone_tab, error);
+	if (checksum == NULL) {
+		g_mapped_file_unref (file);
+		return NULL;
+	}
+	if (strcmp (checksum, contents + header->strings_offset + header->checksum) != 0) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+			     "'%s' was not compiled from the current '%s'", path, zone_tab);
+		g_free (checksum);
+		g_mapped_file_unref (file);
+		return NULL;
+	}
+	g_free (checksum);
+
+	tz_db = g_new0 (TzDB, 1);
+	tz_db->ref_count = 1;
+	tz_db->file = file;
+	tz_db->strings = contents + header->strings_offset;
+	tz_db->aliases = aliases;
+	tz_db->n_aliases = header->n_aliases;
+
+	/* The locations are built on top of the strings of the file */
+	tz_db->records = g_new0 (TzLocation, header->n_records);
+	tz_db->locations = g_ptr_array_sized_new (header->n_records);
+	for (i = 0; i < header->n_records; i++) {
+		TzLocation *loc = &tz_db->records[i];
+
+		loc->country = (gchar *) tz_db->strings + records[i].country;
+		loc->zone = (gchar *) tz_db->strings + records[i].zone;
+		loc->comment = records[i].comment ? (gchar *) tz_db->strings + records[i].comment : NULL;
+		loc->latitude = records[i].latitude;
+		loc->longitude = records[i].longitude;
+		g_ptr_array_add (tz_db->locations, loc);
+	}
 
 	return tz_db;
+
+invalid:
+	g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		     "Invalid timezone database '%s'", path);
+	g_mapped_file_unref (file);
+	return NULL;
+}
+
+/**
+ * tz_db_write:
+ * @db: a database loaded with tz_db_load_text()
+ * @zone_tab: the zone.tab file @db was loaded from
+ * @path: the compiled database to write
+ * @error: return location for a #GError
+ */
+gboolean
+tz_db_write (TzDB        *db,
+	     const char  *zone_tab,
+	     const char  *path,
+	     GError     **error)
+{
+	TzDBHeader header;
+	GArray *records, *aliases;
+	CcStringPool pool;
+	GString *output;
+	GList *keys, *l;
+	char *checksum;
+	gboolean ret;
+	guint i;
+
+	g_return_val_if_fail (db->backward != NULL, FALSE);
+
+	checksum = get_zone_tab_checksum (zone_tab, error);
+	if (checksum == NULL)
+		return FALSE;
+
+	records = g_array_sized_new (FALSE, TRUE, sizeof (TzDBRecord), db->locations->len);
+	aliases = g_array_new (FALSE, TRUE, sizeof (TzDBAlias));
+	cc_string_pool_init (&pool);
+
+	for (i = 0; i < db->locations->len; i++) {
+		TzLocation *loc = db->locations->pdata[i];
+		TzDBRecord record;
+
+		memset (&record, 0, sizeof (record));
+		record.country = cc_string_pool_add (&pool, loc->country);
+		record.zone = cc_string_pool_add (&pool, loc->zone);
+		record.comment = cc_string_pool_add (&pool, loc->comment);
+		record.latitude = loc->latitude;
+		record.longitude = loc->longitude;
+		g_array_append_val (records, record);
+	}
+
+	keys = g_hash_table_get_keys (db->backward);
+	keys = g_list_sort (keys, (GCompareFunc) strcmp);
+	for (l = keys; l != NULL; l = l->next) {
+		TzDBAlias alias;
+
+		alias.alias = cc_string_pool_add (&pool, l->data);
+		alias.real = cc_string_pool_add (&pool,
+						 g_hash_table_lookup (db->backward, l->data));
+		g_array_append_val (aliases, alias);
+	}
+	g_list_free (keys);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, TZ_DB_MAGIC, sizeof (header.magic));
+	header.checksum = cc_string_pool_add (&pool, checksum);
+	header.n_records = records->len;
+	header.records_offset = sizeof (header);
+	header.n_aliases = aliases->len;
+	header.aliases_offset = header.records_offset + records->len * sizeof (TzDBRecord);
+	header.strings_offset = header.aliases_offset + aliases->len * sizeof (TzDBAlias);
+	header.strings_size = pool.strings->len;
+
+	output = g_string_new_len ((const char *) &header, sizeof (header));
+	g_string_append_len (output, records->data, records->len * sizeof (TzDBRecord));
+	g_string_append_len (output, aliases->data, aliases->len * sizeof (TzDBAlias));
+	g_string_append_len (output, pool.strings->str, pool.strings->len);
+
+	ret = g_file_set_contents (path, output->str, output->len, error);
+
+	g_string_free (output, TRUE);
+	cc_string_pool_clear (&pool);
+	g_array_free (aliases, TRUE);
+	g_array_free (records, TRUE);
+	g_free (checksum);
+
+	return ret;
 }
 
 static void
@@ -141,15 +486,6 @@ tz_location_free (TzLocation *loc)
 	g_free (loc);
 }
 
-void
-tz_db_free (TzDB *db)
-{
-	g_ptr_array_foreach (db->locations, (GFunc) tz_location_free, NULL);
-	g_ptr_array_free (db->locations, TRUE);
-	g_hash_table_destroy (db->backward);
-	g_free (db);
-}
-
 GPtrArray *
 tz_get_locations (TzDB *db)
 {
@@ -197,57 +533,76 @@ tz_location_get_utc_offset (TzLocation *loc)
 	return offset;
 }
 
+/* The zones already loaded, as GTimeZone only reads its file once */
+static GHashTable *time_zones = NULL;
+G_LOCK_DEFINE_STATIC (time_zones);
+
+static GTimeZone *
+get_time_zone (const char *zone)
+{
+	GTimeZone *tz;
+
+	G_LOCK (time_zones);
+
+	if (time_zones == NULL)
+		time_zones = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, (GDestroyNotify) g_time_zone_unref);
+
+	tz = g_hash_table_lookup (time_zones, zone);
+	if (tz == NULL) {
+		tz = g_time_zone_new (zone);
+		g_hash_table_insert (time_zones, g_strdup (zone), tz);
+	}
+	g_time_zone_ref (tz);
+
+	G_UNLOCK (time_zones);
+
+	return tz;
+}
+
+/**
+ * tz_info_from_location_at:
+ * @loc: a location
+ * @time: the time, in seconds since the epoch
+ *
+ * Unlike localtime() and the TZ environment variable, this is safe to
+ * call from any thread.
+ *
+ * Returns: the offset, abbreviation and daylight saving time of @loc
+ * at @time
+ */
 TzInfo *
-tz_info_from_location (TzLocation *loc)
+tz_info_from_location_at (TzLocation *loc,
+			  gint64      time)
 {
 	TzInfo *tzinfo;
-	time_t curtime;
-	struct tm *curzone;
-	gchar *tz_env_value;
-	
+	GTimeZone *tz;
+	gint interval;
+
 	g_return_val_if_fail (loc != NULL, NULL);
 	g_return_val_if_fail (loc->zone != NULL, NULL);
-	
-	tz_env_value = g_strdup (getenv ("TZ"));
-	setenv ("TZ", loc->zone, 1);
-	
-#if 0
-	tzset ();
-#endif
-	tzinfo = g_new0 (TzInfo, 1);
-
-	curtime = time (NULL);
-	curzone = localtime (&curtime);
-
-#ifndef __sun
-	/* Currently this solution doesnt seem to work - I get that */
-	/* America/Phoenix uses daylight savings, which is wrong    */
-	tzinfo->tzname_normal = g_strdup (curzone->tm_zone);
-	if (curzone->tm_isdst) 
-		tzinfo->tzname_daylight =
-			g_strdup (&curzone->tm_zone[curzone->tm_isdst]);
-	else
-		tzinfo->tzname_daylight = NULL;
 
-	tzinfo->utc_offset = curzone->tm_gmtoff;
-#else
-	tzinfo->tzname_normal = NULL;
-	tzinfo->tzname_daylight = NULL;
-	tzinfo->utc_offset = 0;
-#endif
+	tz = get_time_zone (loc->zone);
+	interval = g_time_zone_find_interval (tz, G_TIME_TYPE_UNIVERSAL, time);
 
-	tzinfo->daylight = curzone->tm_isdst;
+	tzinfo = g_new0 (TzInfo, 1);
+	tzinfo->tzname_normal = g_strdup (g_time_zone_get_abbreviation (tz, interval));
+	tzinfo->daylight = g_time_zone_is_dst (tz, interval);
+	if (tzinfo->daylight)
+		tzinfo->tzname_daylight = g_strdup (tzinfo->tzname_normal);
+	tzinfo->utc_offset = g_time_zone_get_offset (tz, interval);
 
-	if (tz_env_value)
-		setenv ("TZ", tz_env_value, 1);
-	else
-		unsetenv ("TZ");
+	g_time_zone_unref (tz);
 
-	g_free (tz_env_value);
-	
 	return tzinfo;
 }
 
+TzInfo *
+tz_info_from_location (TzLocation *loc)
+{
+	return tz_info_from_location_at (loc, g_get_real_time () / G_USEC_PER_SEC);
+}
+
 
 void
 tz_info_free (TzInfo *tzinfo)
@@ -307,11 +662,66 @@ compare_timezones (const char *a,
 	return FALSE;
 }
 
+static const char *
+lookup_backward (TzDB       *tz_db,
+		 const char *tz)
+{
+	guint lower, upper;
+
+	if (tz_db->backward != NULL)
+		return g_hash_table_lookup (tz_db->backward, tz);
+
+	lower = 0;
+	upper = tz_db->n_aliases;
+	while (lower < upper) {
+		guint middle = lower + (upper - lower) / 2;
+		const TzDBAlias *alias = &tz_db->aliases[middle];
+		int cmp;
+
+		cmp = strcmp (tz, tz_db->strings + alias->alias);
+		if (cmp == 0)
+			return tz_db->strings + alias->real;
+		if (cmp < 0)
+			upper = middle;
+		else
+			lower = middle + 1;
+	}
+
+	return NULL;
+}
+
+/**
+ * tz_db_foreach_alias:
+ * @tz_db: a #TzDB
+ * @func: called with each former name of a zone, and the zone
+ * @user_data: data for @func
+ *
+ * Lists the links of the backward file. The zones they point to are not
+ * necessarily ones of the locations.
+ */
+void
+tz_db_foreach_alias (TzDB        *tz_db,
+		     TzAliasFunc  func,
+		     gpointer     user_data)
+{
+	guint i;
+
+	if (tz_db->backward != NULL) {
+		g_hash_table_foreach (tz_db->backward, (GHFunc) func, user_data);
+		return;
+	}
+
+	for (i = 0; i < tz_db->n_aliases; i++)
+		func (tz_db->strings + tz_db->aliases[i].alias,
+		      tz_db->strings + tz_db->aliases[i].real,
+		      user_data);
+}
+
 char *
 tz_info_get_clean_name (TzDB *tz_db,
 			const char *tz)
 {
-	char *ret;
+	const char *ret;
 	const char *timezone;
 	guint i;
 	gboolean replaced;
@@ -346,7 +756,7 @@ tz_info_get_clean_name (TzDB *tz_db,
 	if (!replaced)
 		timezone = tz;
 
-	ret = g_hash_table_lookup (tz_db->backward, timezone);
+	ret = lookup_backward (tz_db, timezone);
 	if (ret == NULL)
 		return g_strdup (timezone);
 	return g_strdup (ret);
@@ -356,16 +766,6 @@ tz_info_get_clean_name (TzDB *tz_db,
  * Private functions *
  * ----------------- */
 
-static gchar *
-tz_data_file_get (void)
-{
-	gchar *file;
-
-	file = g_strdup (TZ_DATA_FILE);
-
-	return file;
-}
-
 static float
 convert_pos (gchar *pos, int digits)
 {
@@ -425,7 +825,8 @@ sort_locations_by_country (GPtrArray *locations)
 }
 
 static void
-load_backward_tz (TzDB *tz_db)
+load_backward_tz (TzDB       *tz_db,
+                  const char *backward)
 {
   GError *error = NULL;
   char **lines, *contents;
@@ -433,11 +834,14 @@ load_backward_tz (TzDB *tz_db)
 
   tz_db->backward = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
-  if (g_file_get_contents (GNOMECC_DATA_DIR "/datetime/backward", &contents, NULL, &error) == FALSE)
+  /* the zones are still usable without their old names */
+  if (g_file_get_contents (backward, &contents, NULL, &error) == FALSE)
     {
-      g_warning ("Failed to load 'backward' file: %s", error->message);
+      g_warning ("Failed to load the timezone links: %s", error->message);
+      g_error_free (error);
       return;
     }
+
   lines = g_strsplit (contents, "\n", -1);
   g_free (contents);
   for (i = 0; lines[i] != NULL; i++)
@@ -467,7 +871,11 @@ load_backward_tz (TzDB *tz_db)
         }
 
       if (real == NULL || alias == NULL)
-        g_warning ("Could not parse line: %s", lines[i]);
+        {
+          g_warning ("Could not parse line: %s", lines[i]);
+          g_strfreev (items);
+          continue;
+        }
 
       /* We don't need more than one name for it */
       if (g_str_equal (real, "Etc/UTC") ||
@@ -479,4 +887,3 @@ load_backward_tz (TzDB *tz_db)
     }
   g_strfreev (lines);
 }
-
@@ -28,6 +28,9 @@
 
 #include <glib.h>
 
+/* The translations of the zone names */
+#define GETTEXT_PACKAGE_TIMEZONES GETTEXT_PACKAGE "-timezones"
+
 #ifndef __sun
 #  define TZ_DATA_FILE "/usr/share/zoneinfo/zone.tab"
 #else
@@ -38,12 +41,10 @@ typedef struct _TzDB TzDB;
 typedef struct _TzLocation TzLocation;
 typedef struct _TzInfo TzInfo;
 
+typedef void (*TzAliasFunc) (const char *alias,
+			     const char *zone,
+			     gpointer    user_data);
 
-struct _TzDB
-{
-	GPtrArray  *locations;
-	GHashTable *backward;
-};
 
 struct _TzLocation
 {
@@ -52,8 +53,6 @@ struct _TzLocation
 	gdouble longitude;
 	gchar *zone;
 	gchar *comment;
-
-	gdouble dist; /* distance to clicked point for comparison */
 };
 
 /* see the glibc info page information on time zone information */
@@ -72,7 +71,21 @@ struct _TzInfo
 
 
 TzDB      *tz_load_db                 (void);
-void       tz_db_free                 (TzDB *db);
+TzDB      *tz_db_ref                  (TzDB *db);
+void       tz_db_unref                (TzDB *db);
+TzDB      *tz_db_load_text            (const char *zone_tab,
+				       const char *backward,
+				       GError    **error);
+TzDB      *tz_db_load_compiled        (const char *path,
+				       const char *zone_tab,
+				       GError    **error);
+gboolean   tz_db_write                (TzDB *db,
+				       const char *zone_tab,
+				       const char *path,
+				       GError    **error);
+void       tz_db_foreach_alias        (TzDB *tz_db,
+				       TzAliasFunc func,
+				       gpointer    user_data);
 char *     tz_info_get_clean_name     (TzDB *tz_db,
 				       const char *tz);
 GPtrArray *tz_get_locations           (TzDB *db);
@@ -84,6 +97,8 @@ gchar     *tz_location_get_comment    (TzLocation *loc);
 glong      tz_location_get_utc_offset (TzLocation *loc);
 gint       tz_location_set_locally    (TzLocation *loc);
 TzInfo    *tz_info_from_location      (TzLocation *loc);
+TzInfo    *tz_info_from_location_at   (TzLocation *loc,
+				       gint64      time);
 void       tz_info_free               (TzInfo *tz_info);
 
 #endif
@@ -0,0 +1,427 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include <locale.h>
+#include <sys/utsname.h>
+
+#include <glib/gstdio.h>
+
+#include "cc-info-facts.h"
+
+typedef enum {
+  SOURCE_CPUINFO    = 1 << 0,
+  SOURCE_KERNEL     = 1 << 1,
+  SOURCE_DRM        = 1 << 2,
+  SOURCE_OS_RELEASE = 1 << 3,
+  SOURCE_GL         = 1 << 4
+} FactSources;
+
+#define N_SOURCES 5
+
+static const struct {
+  const char  *name;
+  FactSources  sources;
+} fact_sources[] = {
+  { CC_INFO_FACT_PROCESSOR, SOURCE_CPUINFO },
+  { CC_INFO_FACT_GRAPHICS,  SOURCE_KERNEL | SOURCE_DRM | SOURCE_GL },
+  { CC_INFO_FACT_OS_TYPE,   SOURCE_OS_RELEASE },
+};
+
+typedef struct {
+  char *value;
+  char *stored_fingerprint;
+  char *fingerprint;
+} Fact;
+
+struct _CcInfoFacts
+{
+  char     *path;
+  Fact      facts[G_N_ELEMENTS (fact_sources)];
+  gboolean  dirty;
+};
+
+/* The lines of the CPU models, the ones get_cpu_info() counts */
+static void
+add_cpuinfo (GString *s)
+{
+  char *contents;
+  char **lines;
+  guint i;
+
+  if (!g_file_get_contents ("/proc/cpuinfo", &contents, NULL, NULL))
+    return;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      if (g_str_has_prefix (lines[i], "model name") ||
+          g_str_has_prefix (lines[i], "cpu\t") ||
+          g_str_has_prefix (lines[i], "cpu ") ||
+          g_str_has_prefix (lines[i], "Processor"))
+        {
+          g_string_append (s, lines[i]);
+          g_string_append_c (s, '\n');
+        }
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+}
+
+static void
+add_kernel (GString *s)
+{
+  struct utsname buf;
+
+  if (uname (&buf) == 0)
+    g_string_append_printf (s, "%s %s\n", buf.release, buf.version);
+}
+
+static void
+add_file (GString    *s,
+          const char *path)
+{
+  char *contents;
+
+  if (g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_string_append (s, contents);
+      g_free (contents);
+    }
+}
+
+/* The graphics cards, but not their outputs, which come and go with the
+ * monitors */
+static void
+add_drm (GString *s)
+{
+  GDir *dir;
+  GPtrArray *cards;
+  const char *name;
+  char *target;
+  guint i;
+
+  dir = g_dir_open ("/sys/class/drm", 0, NULL);
+  if (dir == NULL)
+    return;
+
+  cards = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      if (g_str_has_prefix (name, "card") && strchr (name, '-') == NULL)
+        g_ptr_array_add (cards, g_strdup (name));
+    }
+  g_dir_close (dir);
+
+  g_ptr_array_sort (cards, (GCompareFunc) g_strcmp0);
+  for (i = 0; i < cards->len; i++)
+    {
+      char *path;
+
+      name = g_ptr_array_index (cards, i);
+      g_string_append_printf (s, "%s\n", name);
+
+      path = g_build_filename ("/sys/class/drm", name, "device", "vendor", NULL);
+      add_file (s, path);
+      g_free (path);
+      path = g_build_filename ("/sys/class/drm", name, "device", "device", NULL);
+      add_file (s, path);
+      g_free (path);
+
+      /* the kernel driver of the card, which can be switched */
+      path = g_build_filename ("/sys/class/drm", name, "device", "driver", NULL);
+      target = g_file_read_link (path, NULL);
+      if (target != NULL)
+        g_string_append_printf (s, "%s\n", target);
+      g_free (target);
+      g_free (path);
+    }
+
+  g_ptr_array_free (cards, TRUE);
+}
+
+/* The OpenGL stack, which gives the renderer string: ldconfig runs
+ * whenever a libGL is installed or replaced, and Mesa drivers may also
+ * live in a dri directory of their own */
+static void
+add_gl (GString *s)
+{
+  const char *paths[] = {
+    "/etc/ld.so.cache",
+    "/usr/lib/dri",
+    "/usr/lib64/dri",
+  };
+  GStatBuf buf;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (paths); i++)
+    {
+      if (g_stat (paths[i], &buf) == 0)
+        g_string_append_printf (s, "%s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n",
+                                paths[i], (gint64) buf.st_mtime, (gint64) buf.st_size);
+    }
+}
+
+static void
+add_os_release (GString *s)
+{
+  GStatBuf buf;
+
+  if (g_stat ("/etc/os-release", &buf) == 0)
+    g_string_append_printf (s, "%" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n",
+                            (gint64) buf.st_mtime, (gint64) buf.st_size);
+}
+
+static char *
+compute_fingerprint (FactSources  sources,
+                     GString    **source_strings)
+{
+  GChecksum *checksum;
+  char *fingerprint;
+  guint i;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+  /* the facts are translated */
+  g_checksum_update (checksum, (const guchar *) setlocale (LC_MESSAGES, NULL), -1);
+
+  for (i = 0; i < N_SOURCES; i++)
+    {
+      FactSources source = 1 << i;
+
+      if (!(sources & source))
+        continue;
+
+      /* each source is only read once for all the facts */
+      if (source_strings[i] == NULL)
+        {
+          source_strings[i] = g_string_new (NULL);
+          switch (source)
+            {
+            case SOURCE_CPUINFO:
+              add_cpuinfo (source_strings[i]);
+              break;
+            case SOURCE_KERNEL:
+              add_kernel (source_strings[i]);
+              break;
+            case SOURCE_DRM:
+              add_drm (source_strings[i]);
+              break;
+            case SOURCE_OS_RELEASE:
+              add_os_release (source_strings[i]);
+              break;
+            case SOURCE_GL:
+              add_gl (source_strings[i]);
+              break;
+            default:
+              g_assert_not_reached ();
+            }
+        }
+
+      g_checksum_update (checksum, (const guchar *) source_strings[i]->str,
+                         source_strings[i]->len);
+    }
+
+  fingerprint = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return fingerprint;
+}
+
+static gint
+find_fact (const char *name)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (fact_sources); i++)
+    {
+      if (strcmp (fact_sources[i].name, name) == 0)
+        return i;
+    }
+
+  return -1;
+}
+
+/**
+ * cc_info_facts_load:
+ *
+ * Returns: the cached facts, possibly none
+ */
+CcInfoFacts *
+cc_info_facts_load (void)
+{
+  GString *source_strings[N_SOURCES] = { NULL, };
+  CcInfoFacts *facts;
+  GKeyFile *keyfile;
+  guint i;
+
+  facts = g_slice_new0 (CcInfoFacts);
+  facts->path = g_build_filename (g_get_user_cache_dir (),
+                                  "gnome-control-center", "info-facts", NULL);
+
+  keyfile = g_key_file_new ();
+  if (!g_key_file_load_from_file (keyfile, facts->path, G_KEY_FILE_NONE, NULL))
+    g_debug ("No cached facts in %s", facts->path);
+
+  for (i = 0; i < G_N_ELEMENTS (fact_sources); i++)
+    {
+      Fact *fact = &facts->facts[i];
+
+      fact->value = g_key_file_get_string (keyfile, fact_sources[i].name, "value", NULL);
+      fact->stored_fingerprint = g_key_file_get_string (keyfile, fact_sources[i].name,
+                                                        "fingerprint", NULL);
+      fact->fingerprint = compute_fingerprint (fact_sources[i].sources, source_strings);
+    }
+
+  for (i = 0; i < N_SOURCES; i++)
+    {
+      if (source_strings[i] != NULL)
+        g_string_free (source_strings[i], TRUE);
+    }
+  g_key_file_free (keyfile);
+
+  return facts;
+}
+
+void
+cc_info_facts_free (CcInfoFacts *facts)
+{
+  guint i;
+
+  if (facts == NULL)
+    return;
+
+  for (i = 0; i < G_N_ELEMENTS (fact_sources); i++)
+    {
+      g_free (facts->facts[i].value);
+      g_free (facts->facts[i].stored_fingerprint);
+      g_free (facts->facts[i].fingerprint);
+    }
+  g_free (facts->path);
+  g_slice_free (CcInfoFacts, facts);
+}
+
+/**
+ * cc_info_facts_get:
+ * @facts: a #CcInfoFacts
+ * @fact: one of the CC_INFO_FACT_ names
+ * @up_to_date: (out): whether the fact was stored for the system as it
+ *   is now, and doesn't need probing
+ *
+ * Returns: the cached value of @fact, or %NULL
+ */
+const char *
+cc_info_facts_get (CcInfoFacts *facts,
+                   const char  *fact,
+                   gboolean    *up_to_date)
+{
+  gint i;
+
+  i = find_fact (fact);
+  g_return_val_if_fail (i >= 0, NULL);
+
+  *up_to_date = (facts->facts[i].value != NULL &&
+                 g_strcmp0 (facts->facts[i].stored_fingerprint,
+                            facts->facts[i].fingerprint) == 0);
+
+  return facts->facts[i].value;
+}
+
+/**
+ * cc_info_facts_set:
+ * @facts: a #CcInfoFacts
+ * @fact: one of the CC_INFO_FACT_ names
+ * @value: the probed value, with the system as it is now
+ */
+void
+cc_info_facts_set (CcInfoFacts *facts,
+                   const char  *fact,
+                   const char  *value)
+{
+  Fact *f;
+  gint i;
+
+  i = find_fact (fact);
+  g_return_if_fail (i >= 0);
+  g_return_if_fail (value != NULL);
+
+  f = &facts->facts[i];
+  if (g_strcmp0 (f->value, value) == 0 &&
+      g_strcmp0 (f->stored_fingerprint, f->fingerprint) == 0)
+    return;
+
+  g_free (f->value);
+  f->value = g_strdup (value);
+  g_free (f->stored_fingerprint);
+  f->stored_fingerprint = g_strdup (f->fingerprint);
+  facts->dirty = TRUE;
+}
+
+/**
+ * cc_info_facts_save:
+ * @facts: a #CcInfoFacts
+ * @error: return location for a #GError
+ *
+ * Writes the facts back to the cache, if any changed.
+ */
+gboolean
+cc_info_facts_save (CcInfoFacts  *facts,
+                    GError      **error)
+{
+  GKeyFile *keyfile;
+  char *data, *dir;
+  gsize length;
+  gboolean ret;
+  guint i;
+
+  if (!facts->dirty)
+    return TRUE;
+
+  keyfile = g_key_file_new ();
+  for (i = 0; i < G_N_ELEMENTS (fact_sources); i++)
+    {
+      Fact *fact = &facts->facts[i];
+
+      if (fact->value == NULL)
+        continue;
+
+      g_key_file_set_string (keyfile, fact_sources[i].name, "value", fact->value);
+      g_key_file_set_string (keyfile, fact_sources[i].name, "fingerprint",
+                             fact->stored_fingerprint);
+    }
+
+  data = g_key_file_to_data (keyfile, &length, NULL);
+  g_key_file_free (keyfile);
+
+  dir = g_path_get_dirname (facts->path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  ret = g_file_set_contents (facts->path, data, length, error);
+  g_free (data);
+
+  if (ret)
+    facts->dirty = FALSE;
+
+  return ret;
+}
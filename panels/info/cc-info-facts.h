@@ -0,0 +1,59 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _CC_INFO_FACTS_H
+#define _CC_INFO_FACTS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The facts about the system which rarely change and are slow to probe,
+ * kept in the user cache directory from one opening of the panel to the
+ * next.
+ *
+ * Each fact is stored with a fingerprint of what it depends on, cheap
+ * to compute: the CPU models of /proc/cpuinfo for the processor, the
+ * kernel release, the DRM devices and their drivers and the OpenGL
+ * libraries for the graphics, the modification time of os-release for
+ * the OS type, and the locale for them all. A cached fact is shown right
+ * away, and replaced if probing again finds a different value. */
+
+#define CC_INFO_FACT_PROCESSOR "processor"
+#define CC_INFO_FACT_GRAPHICS  "graphics"
+#define CC_INFO_FACT_OS_TYPE   "os-type"
+
+typedef struct _CcInfoFacts CcInfoFacts;
+
+CcInfoFacts *cc_info_facts_load (void);
+void         cc_info_facts_free (CcInfoFacts *facts);
+
+const char  *cc_info_facts_get  (CcInfoFacts *facts,
+                                 const char  *fact,
+                                 gboolean    *up_to_date);
+void         cc_info_facts_set  (CcInfoFacts *facts,
+                                 const char  *fact,
+                                 const char  *value);
+gboolean     cc_info_facts_save (CcInfoFacts *facts,
+                                 GError     **error);
+
+G_END_DECLS
+
+#endif /* _CC_INFO_FACTS_H */
@@ -24,10 +24,16 @@
 #include "cc-info-panel.h"
 #include "cc-info-resources.h"
 
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <gio/gio.h>
 #include <gio/gunixmounts.h>
+#include <gio/gunixinputstream.h>
 #include <gio/gdesktopappinfo.h>
 
 #include <glibtop/fsusage.h>
@@ -35,10 +41,8 @@
 #include <glibtop/mem.h>
 #include <glibtop/sysinfo.h>
 
-#include <gdk/gdkx.h>
-#include <GL/gl.h>
-#include <GL/glx.h>
-
+#include "cc-info-facts.h"
+#include "cc-info-prober.h"
 #include "gsd-disk-space-helper.h"
 
 /* Autorun options */
@@ -57,6 +61,10 @@
 #define GNOME_SESSION_MANAGER_SCHEMA        "org.gnome.desktop.session"
 #define KEY_SESSION_NAME          "session-name"
 
+/* How long to wait for each fact, such as the size of a network
+ * filesystem, or the name of the OpenGL renderer */
+#define PROBE_TIMEOUT_MS 5000
+
 #define WID(w) (GtkWidget *) gtk_builder_get_object (self->priv->builder, w)
 
 CC_PANEL_REGISTER (CcInfoPanel, cc_info_panel)
@@ -64,14 +72,6 @@ CC_PANEL_REGISTER (CcInfoPanel, cc_info_panel)
 #define INFO_PANEL_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), CC_TYPE_INFO_PANEL, CcInfoPanelPrivate))
 
-typedef struct {
-  /* Will be one of the other two below, or "Unknown" */ 
-  const char *hardware_string;
-
-  char *xorg_vesa_hardware;
-  char *glx_renderer;
-} GraphicsData;
-
 typedef enum {
 	PK_NOT_AVAILABLE,
 	UPDATES_AVAILABLE,
@@ -92,15 +92,14 @@ typedef struct
 struct _CcInfoPanelPrivate
 {
   GtkBuilder    *builder;
-  char          *gnome_version;
-  char          *gnome_distributor;
-  char          *gnome_date;
   UpdatesState   updates_state;
 
+  CcInfoProber  *prober;
+  CcInfoFacts   *facts;
+
   /* Free space */
-  GList         *primary_mounts;
+  guint          pending_mounts;
   guint64        total_bytes;
-  GCancellable  *cancellable;
 
   /* Media */
   GSettings     *media_settings;
@@ -109,11 +108,8 @@ struct _CcInfoPanelPrivate
   GDBusConnection     *session_bus;
   GDBusProxy          *pk_proxy;
   GDBusProxy          *pk_transaction_proxy;
-
-  GraphicsData  *graphics_data;
 };
 
-static void get_primary_disc_info_start (CcInfoPanel *self);
 static void refresh_update_button (CcInfoPanel *self);
 
 typedef struct
@@ -291,66 +287,49 @@ prettify_info (const char *info)
   return pretty;
 }
 
-static void
-graphics_data_free (GraphicsData *gdata)
-{
-  g_free (gdata->xorg_vesa_hardware);
-  g_free (gdata->glx_renderer);
-  g_slice_free (GraphicsData, gdata);
-}
-
 static char *
-get_graphics_data_glx_renderer ()
-{
-  Display *display;
-  int attributes[] = {
-    GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
-    GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
-    GLX_RENDER_TYPE, GLX_RGBA_BIT,
-    None
-  };
-  int nconfigs;
-  Window window;
-  GLXFBConfig *config;
-  GLXWindow glxwin;
-  GLXContext context;
+get_graphics_data_glx_renderer (GCancellable *cancellable)
+{
+  char *argv[] = { LIBEXECDIR "/cc-info-renderer-helper", NULL };
+  GInputStream *stream;
+  GError *error = NULL;
+  char buffer[256];
+  gsize len;
+  GPid pid;
+  int out_fd;
   char *renderer;
 
-  gdk_error_trap_push ();
+  if (!g_spawn_async_with_pipes (NULL, argv, NULL,
+                                 G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL,
+                                 NULL, NULL, &pid,
+                                 NULL, &out_fd, NULL, &error))
+    {
+      g_warning ("Failed to get OpenGL driver info: %s", error->message);
+      g_error_free (error);
+      return NULL;
+    }
 
-  display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default ());
+  stream = g_unix_input_stream_new (out_fd, TRUE);
+  g_input_stream_read_all (stream, buffer, sizeof (buffer) - 1, &len,
+                           cancellable, &error);
+  g_object_unref (stream);
 
-  config = glXChooseFBConfig (display, DefaultScreen (display),
-                              attributes, &nconfigs);
-  if (config == NULL) {
-    g_warning ("Failed to get OpenGL configuration");
+  /* the helper is stuck in the driver, or has said all it had to */
+  if (error != NULL)
+    {
+      kill (pid, SIGKILL);
+      g_error_free (error);
+      len = 0;
+    }
+  waitpid (pid, NULL, 0);
+  g_spawn_close_pid (pid);
 
-    gdk_error_trap_pop_ignored ();
+  buffer[len] = '\0';
+  g_strchomp (buffer);
+  if (buffer[0] == '\0')
     return NULL;
-  }
-
-  window = XCreateSimpleWindow (display, DefaultRootWindow (display),
-                                0, 0, /* x, y */
-                                1, 1, /* width, height */
-                                0, 0, 0  /* border_width, border, background */);
-  glxwin = glXCreateWindow (display, *config, window, NULL);
 
-  context = glXCreateNewContext (display, *config, GLX_RGBA_TYPE,
-                                 NULL, TRUE);
-
-  glXMakeContextCurrent (display, glxwin, glxwin, context);
-  renderer = (char *) glGetString (GL_RENDERER);
-  renderer = renderer ? prettify_info (renderer) : NULL;
-
-  glXMakeContextCurrent (display, None, None, NULL);
-  glXDestroyContext (display, context);
-  glXDestroyWindow (display, glxwin);
-  XDestroyWindow (display, window);
-
-  if (gdk_error_trap_pop () != Success) {
-    g_warning ("Failed to get OpenGL driver info");
-    return NULL;
-  }
+  renderer = prettify_info (buffer);
 
   return renderer;
 }
@@ -358,88 +337,63 @@ get_graphics_data_glx_renderer ()
 static char *
 get_graphics_data_xorg_vesa_hardware (void)
 {
-  char *display_num;
+  static const char marker[] = "VESA VBE OEM Product: ";
+  const char *display;
+  const char *contents, *start, *end;
+  GMappedFile *file;
   char *log_path;
-  char *log_contents;
-  gsize log_len;
-  GError *error = NULL;
-  GRegex *re;
-  GMatchInfo *match;
   char *result = NULL;
+  gsize len;
 
-  {
-    const char *display;
-
-    display = g_getenv ("DISPLAY");
-    if (!display)
-      return NULL;
-
-    re = g_regex_new ("^:([0-9]+)", 0, 0, NULL);
-    g_assert (re != NULL);
-
-    g_regex_match (re, display, 0, &match);
-
-    if (!g_match_info_matches (match))
-      {
-        g_regex_unref (re);
-        g_match_info_free (match);
-        return NULL;
-      }
-
-    display_num = g_match_info_fetch (match, 1);
-
-    g_regex_unref (re);
-    re = NULL;
-    g_match_info_free (match);
-    match = NULL;
-  }
+  /* only for local displays, as in ":0" or ":0.0" */
+  display = g_getenv ("DISPLAY");
+  if (display == NULL || display[0] != ':' || !g_ascii_isdigit (display[1]))
+    return NULL;
 
-  log_path = g_strdup_printf ("/var/log/Xorg.%s.log", display_num);
-  g_free (display_num);
-  log_contents = NULL;
-  g_file_get_contents (log_path, &log_contents, &log_len, &error);
+  len = strspn (display + 1, "0123456789");
+  log_path = g_strdup_printf ("/var/log/Xorg.%.*s.log", (int) len, display + 1);
+  file = g_mapped_file_new (log_path, FALSE, NULL);
   g_free (log_path);
-  if (!log_contents)
+  if (file == NULL)
     return NULL;
 
-  re = g_regex_new ("VESA VBE OEM Product: (.*)$", G_REGEX_MULTILINE, 0, NULL);
-  g_assert (re != NULL);
+  contents = g_mapped_file_get_contents (file);
+  len = g_mapped_file_get_length (file);
 
-  g_regex_match (re, log_contents, 0, &match);
-  if (g_match_info_matches (match))
+  start = contents != NULL ? g_strstr_len (contents, len, marker) : NULL;
+  if (start != NULL)
     {
       char *tmp;
       char *pretty_tmp;
-      tmp = g_match_info_fetch (match, 1);
+
+      start += strlen (marker);
+      end = memchr (start, '\n', contents + len - start);
+      if (end == NULL)
+        end = contents + len;
+
+      tmp = g_strndup (start, end - start);
       pretty_tmp = prettify_info (tmp);
       g_free (tmp);
       result = g_strdup_printf ("VESA: %s", pretty_tmp);
       g_free (pretty_tmp);
     }
-  g_match_info_free (match);
-  g_regex_unref (re);
+
+  g_mapped_file_unref (file);
 
   return result;
 }
 
-static GraphicsData *
-get_graphics_data (void)
+static gpointer
+probe_graphics (gpointer      data,
+                GCancellable *cancellable)
 {
-  GraphicsData *result;
-
-  result = g_slice_new0 (GraphicsData);
+  char *hardware;
 
-  result->glx_renderer = get_graphics_data_glx_renderer ();
-  result->xorg_vesa_hardware = get_graphics_data_xorg_vesa_hardware ();
+  hardware = get_graphics_data_xorg_vesa_hardware ();
+  if (hardware == NULL)
+    hardware = get_graphics_data_glx_renderer (cancellable);
 
-  if (result->xorg_vesa_hardware != NULL)
-    result->hardware_string = result->xorg_vesa_hardware;
-  else if (result->glx_renderer != NULL)
-    result->hardware_string = result->glx_renderer;
-  else
-    result->hardware_string = _("Unknown");
-
-  return result;
+  return hardware;
 }
 
 static void
@@ -465,11 +419,8 @@ cc_info_panel_dispose (GObject *object)
       priv->pk_transaction_proxy = NULL;
     }
 
-  if (priv->graphics_data != NULL)
-    {
-      graphics_data_free (priv->graphics_data);
-      priv->graphics_data = NULL;
-    }
+  g_clear_pointer (&priv->prober, cc_info_prober_free);
+  g_clear_pointer (&priv->facts, cc_info_facts_free);
 
   G_OBJECT_CLASS (cc_info_panel_parent_class)->dispose (object);
 }
@@ -479,11 +430,6 @@ cc_info_panel_finalize (GObject *object)
 {
   CcInfoPanelPrivate *priv = CC_INFO_PANEL (object)->priv;
 
-  g_clear_pointer (&priv->cancellable, g_cancellable_cancel);
-  g_free (priv->gnome_version);
-  g_free (priv->gnome_date);
-  g_free (priv->gnome_distributor);
-
   g_clear_object (&priv->media_settings);
 
   G_OBJECT_CLASS (cc_info_panel_parent_class)->finalize (object);
@@ -548,66 +494,59 @@ get_os_type (void)
 }
 
 static void
-query_done (GFile        *file,
-            GAsyncResult *res,
-            CcInfoPanel  *self)
+update_disk_label (CcInfoPanel *self)
 {
+  char *size;
+
+  size = g_format_size (self->priv->total_bytes);
+  gtk_label_set_text (GTK_LABEL (WID ("disk_label")), size);
+  g_free (size);
+}
+
+static gpointer
+probe_filesystem_size (gpointer      data,
+                       GCancellable *cancellable)
+{
+  const char *path = data;
+  GFile *file;
   GFileInfo *info;
   GError *error = NULL;
+  guint64 *size = NULL;
 
-  self->priv->cancellable = NULL;
-  info = g_file_query_filesystem_info_finish (file, res, &error);
+  file = g_file_new_for_path (path);
+  info = g_file_query_filesystem_info (file,
+                                       G_FILE_ATTRIBUTE_FILESYSTEM_SIZE,
+                                       cancellable,
+                                       &error);
   if (info != NULL)
     {
-      self->priv->total_bytes += g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_FILESYSTEM_SIZE);
+      size = g_new (guint64, 1);
+      *size = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_FILESYSTEM_SIZE);
       g_object_unref (info);
     }
   else
     {
-      char *path;
-      path = g_file_get_path (file);
       g_warning ("Failed to get filesystem free space for '%s': %s", path, error->message);
-      g_free (path);
       g_error_free (error);
     }
+  g_object_unref (file);
 
-  /* And onto the next element */
-  get_primary_disc_info_start (self);
+  return size;
 }
 
 static void
-get_primary_disc_info_start (CcInfoPanel *self)
+on_filesystem_size (gpointer result,
+                    gpointer user_data)
 {
-  GUnixMountEntry *mount;
-  GFile *file;
-
-  if (self->priv->primary_mounts == NULL)
-    {
-      char *size;
-      GtkWidget *widget;
-
-      size = g_format_size (self->priv->total_bytes);
-      widget = WID ("disk_label");
-      gtk_label_set_text (GTK_LABEL (widget), size);
-      g_free (size);
-
-      return;
-    }
-
-  mount = self->priv->primary_mounts->data;
-  self->priv->primary_mounts = g_list_remove (self->priv->primary_mounts, mount);
-  file = g_file_new_for_path (g_unix_mount_get_mount_path (mount));
-  g_unix_mount_free (mount);
+  CcInfoPanel *self = user_data;
+  guint64 *size = result;
 
-  self->priv->cancellable = g_cancellable_new ();
+  if (size != NULL)
+    self->priv->total_bytes += *size;
 
-  g_file_query_filesystem_info_async (file,
-                                      G_FILE_ATTRIBUTE_FILESYSTEM_SIZE,
-                                      0,
-                                      self->priv->cancellable,
-                                      (GAsyncReadyCallback) query_done,
-                                      self);
-  g_object_unref (file);
+  /* the total once all the filesystems answered, or timed out */
+  if (--self->priv->pending_mounts == 0)
+    update_disk_label (self);
 }
 
 static void
@@ -624,20 +563,24 @@ get_primary_disc_info (CcInfoPanel *self)
 
       mount_path = g_unix_mount_get_mount_path (mount);
 
-      if (gsd_should_ignore_unix_mount (mount) ||
-          gsd_is_removable_mount (mount) ||
-          g_str_has_prefix (mount_path, "/media/") ||
-          g_str_has_prefix (mount_path, g_get_home_dir ()))
+      if (!gsd_should_ignore_unix_mount (mount) &&
+          !gsd_is_removable_mount (mount) &&
+          !g_str_has_prefix (mount_path, "/media/") &&
+          !g_str_has_prefix (mount_path, g_get_home_dir ()))
         {
-          g_unix_mount_free (mount);
-          continue;
+          /* all at once, so that a slow one doesn't delay the others */
+          self->priv->pending_mounts++;
+          cc_info_prober_add (self->priv->prober, mount_path, PROBE_TIMEOUT_MS,
+                              probe_filesystem_size, g_strdup (mount_path), g_free,
+                              g_free, on_filesystem_size, self);
         }
 
-      self->priv->primary_mounts = g_list_prepend (self->priv->primary_mounts, mount);
+      g_unix_mount_free (mount);
     }
   g_list_free (points);
 
-  get_primary_disc_info_start (self);
+  if (self->priv->pending_mounts == 0)
+    update_disk_label (self);
 }
 
 static char *
@@ -1526,48 +1469,199 @@ info_panel_setup_selector (CcInfoPanel  *self)
   gtk_widget_show_all (GTK_WIDGET (view));
 }
 
-static void
-info_panel_setup_overview (CcInfoPanel  *self)
+/* libgtop keeps global state, so its calls are serialized */
+G_LOCK_DEFINE_STATIC (glibtop);
+
+static gpointer
+probe_gnome_version (gpointer      data,
+                     GCancellable *cancellable)
+{
+  char *version = NULL;
+
+  load_gnome_version (&version, NULL, NULL);
+
+  return version;
+}
+
+static gpointer
+probe_memory (gpointer      data,
+              GCancellable *cancellable)
 {
-  GtkWidget  *widget;
-  gboolean    res;
   glibtop_mem mem;
-  const glibtop_sysinfo *info;
-  char       *text;
 
-  res = load_gnome_version (&self->priv->gnome_version,
-                            &self->priv->gnome_distributor,
-                            &self->priv->gnome_date);
-  if (res)
+  G_LOCK (glibtop);
+  glibtop_get_mem (&mem);
+  G_UNLOCK (glibtop);
+
+  return g_format_size_full (mem.total, G_FORMAT_SIZE_IEC_UNITS);
+}
+
+static gpointer
+probe_processor (gpointer      data,
+                 GCancellable *cancellable)
+{
+  char *text;
+
+  G_LOCK (glibtop);
+  text = get_cpu_info (glibtop_get_sysinfo ());
+  G_UNLOCK (glibtop);
+
+  return text;
+}
+
+static gpointer
+probe_os_type (gpointer      data,
+               GCancellable *cancellable)
+{
+  return get_os_type ();
+}
+
+static void
+set_probed_label (CcInfoPanel *self,
+                  const char  *id,
+                  const char  *text,
+                  gboolean     markup)
+{
+  GtkLabel *label = GTK_LABEL (WID (id));
+
+  if (text == NULL)
+    gtk_label_set_text (label, _("Unknown"));
+  else if (markup)
+    gtk_label_set_markup (label, text);
+  else
+    gtk_label_set_text (label, text);
+}
+
+static void
+on_gnome_version (gpointer result,
+                  gpointer user_data)
+{
+  CcInfoPanel *self = user_data;
+  char *text;
+
+  if (result == NULL)
+    return;
+
+  text = g_strdup_printf (_("Version %s"), (char *) result);
+  gtk_label_set_text (GTK_LABEL (WID ("version_label")), text);
+  g_free (text);
+}
+
+static void
+on_memory (gpointer result,
+           gpointer user_data)
+{
+  set_probed_label (user_data, "memory_label", result, FALSE);
+}
+
+/* Shows the cached value of the fact, until it is probed again. A value
+ * cached for a system which changed since is not shown, the label keeps
+ * its "Calculating…" placeholder. */
+static void
+show_cached_fact (CcInfoPanel *self,
+                  const char  *fact,
+                  const char  *id,
+                  gboolean     markup)
+{
+  const char *value;
+  gboolean up_to_date;
+
+  value = cc_info_facts_get (self->priv->facts, fact, &up_to_date);
+  if (up_to_date)
+    set_probed_label (self, id, value, markup);
+}
+
+static void
+on_fact_probed (CcInfoPanel *self,
+                const char  *fact,
+                const char  *id,
+                const char  *result,
+                gboolean     markup)
+{
+  GError *error = NULL;
+  const char *cached;
+  gboolean up_to_date;
+
+  cached = cc_info_facts_get (self->priv->facts, fact, &up_to_date);
+
+  if (result == NULL)
     {
-      widget = WID ("version_label");
-      text = g_strdup_printf (_("Version %s"), self->priv->gnome_version);
-      gtk_label_set_text (GTK_LABEL (widget), text);
-      g_free (text);
+      /* better the previous value than none, as long as it was cached
+       * for the system as it is now */
+      if (!up_to_date)
+        set_probed_label (self, id, NULL, markup);
+      return;
     }
 
-  glibtop_get_mem (&mem);
-  text = g_format_size_full (mem.total, G_FORMAT_SIZE_IEC_UNITS);
-  widget = WID ("memory_label");
-  gtk_label_set_text (GTK_LABEL (widget), text ? text : "");
-  g_free (text);
+  if (!up_to_date || g_strcmp0 (cached, result) != 0)
+    set_probed_label (self, id, result, markup);
 
-  info = glibtop_get_sysinfo ();
+  /* only written out if the value or the fingerprint changed */
+  cc_info_facts_set (self->priv->facts, fact, result);
+  if (!cc_info_facts_save (self->priv->facts, &error))
+    {
+      g_warning ("Failed to cache the system facts: %s", error->message);
+      g_error_free (error);
+    }
+}
 
-  widget = WID ("processor_label");
-  text = get_cpu_info (info);
-  gtk_label_set_markup (GTK_LABEL (widget), text ? text : "");
-  g_free (text);
+static void
+on_processor (gpointer result,
+              gpointer user_data)
+{
+  on_fact_probed (user_data, CC_INFO_FACT_PROCESSOR, "processor_label", result, TRUE);
+}
 
-  widget = WID ("os_type_label");
-  text = get_os_type ();
-  gtk_label_set_text (GTK_LABEL (widget), text ? text : "");
-  g_free (text);
+static void
+on_os_type (gpointer result,
+            gpointer user_data)
+{
+  on_fact_probed (user_data, CC_INFO_FACT_OS_TYPE, "os_type_label", result, FALSE);
+}
 
-  get_primary_disc_info (self);
+static void
+on_graphics (gpointer result,
+             gpointer user_data)
+{
+  on_fact_probed (user_data, CC_INFO_FACT_GRAPHICS, "graphics_label", result, TRUE);
+}
 
-  widget = WID ("graphics_label");
-  gtk_label_set_markup (GTK_LABEL (widget), self->priv->graphics_data->hardware_string);
+static void
+info_panel_setup_overview (CcInfoPanel  *self)
+{
+  GtkWidget  *widget;
+
+  /* filled in as the probes answer */
+  gtk_label_set_text (GTK_LABEL (WID ("version_label")), "");
+
+  self->priv->prober = cc_info_prober_new ();
+
+  cc_info_prober_add (self->priv->prober, "version", PROBE_TIMEOUT_MS,
+                      probe_gnome_version, NULL, NULL,
+                      g_free, on_gnome_version, self);
+  cc_info_prober_add (self->priv->prober, "memory", PROBE_TIMEOUT_MS,
+                      probe_memory, NULL, NULL,
+                      g_free, on_memory, self);
+
+  /* the slow facts which rarely change are shown from the cache right
+   * away when their fingerprints still match, and still probed in case
+   * the system changed in a way the fingerprints don't catch */
+  self->priv->facts = cc_info_facts_load ();
+
+  show_cached_fact (self, CC_INFO_FACT_PROCESSOR, "processor_label", TRUE);
+  cc_info_prober_add (self->priv->prober, "processor", PROBE_TIMEOUT_MS,
+                      probe_processor, NULL, NULL,
+                      g_free, on_processor, self);
+  show_cached_fact (self, CC_INFO_FACT_OS_TYPE, "os_type_label", FALSE);
+  cc_info_prober_add (self->priv->prober, "os-type", PROBE_TIMEOUT_MS,
+                      probe_os_type, NULL, NULL,
+                      g_free, on_os_type, self);
+  show_cached_fact (self, CC_INFO_FACT_GRAPHICS, "graphics_label", TRUE);
+  cc_info_prober_add (self->priv->prober, "graphics", PROBE_TIMEOUT_MS,
+                      probe_graphics, NULL, NULL,
+                      g_free, on_graphics, self);
+
+  get_primary_disc_info (self);
 
   widget = WID ("info_vbox");
   gtk_widget_reparent (widget, (GtkWidget *) self);
@@ -1838,8 +1932,6 @@ cc_info_panel_init (CcInfoPanel *self)
       return;
     }
 
-  self->priv->graphics_data = get_graphics_data ();
-
   widget = WID ("updates_button");
   g_signal_connect (widget, "clicked", G_CALLBACK (on_updates_button_clicked), self);
 
@@ -0,0 +1,253 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include "cc-info-prober.h"
+
+struct _CcInfoProber
+{
+  GMainContext *context;
+  /* the probes which haven't been reported yet */
+  GList        *probes;
+};
+
+typedef struct
+{
+  volatile gint        ref_count;
+
+  char                *name;
+  CcInfoProbeFunc      func;
+  gpointer             probe_data;
+  GDestroyNotify       probe_data_free;
+  GDestroyNotify       result_free;
+  CcInfoProbeCallback  callback;
+  gpointer             user_data;
+
+  /* NULL once reported, or once the prober is gone */
+  CcInfoProber        *prober;
+  GMainContext        *context;
+  GCancellable        *cancellable;
+  GSource             *timeout;
+  gint64               start_time;
+
+  gpointer             result;
+} Probe;
+
+static Probe *
+probe_ref (Probe *probe)
+{
+  g_atomic_int_inc (&probe->ref_count);
+  return probe;
+}
+
+static void
+probe_unref (Probe *probe)
+{
+  if (!g_atomic_int_dec_and_test (&probe->ref_count))
+    return;
+
+  if (probe->result != NULL && probe->result_free != NULL)
+    probe->result_free (probe->result);
+  if (probe->probe_data_free != NULL)
+    probe->probe_data_free (probe->probe_data);
+  g_object_unref (probe->cancellable);
+  g_main_context_unref (probe->context);
+  g_free (probe->name);
+  g_slice_free (Probe, probe);
+}
+
+/* Takes the probe out of the prober, so that it is reported only once.
+ * The caller then drops the prober's reference */
+static gboolean
+probe_detach (Probe *probe)
+{
+  if (probe->prober == NULL)
+    return FALSE;
+
+  probe->prober->probes = g_list_remove (probe->prober->probes, probe);
+  probe->prober = NULL;
+
+  if (probe->timeout != NULL)
+    {
+      g_source_destroy (probe->timeout);
+      g_source_unref (probe->timeout);
+      probe->timeout = NULL;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+on_probe_done (gpointer user_data)
+{
+  Probe *probe = user_data;
+
+  if (probe_detach (probe))
+    {
+      g_debug ("Probe '%s' took %" G_GINT64_FORMAT " ms", probe->name,
+               (g_get_monotonic_time () - probe->start_time) / 1000);
+      probe->callback (probe->result, probe->user_data);
+      probe_unref (probe);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+on_probe_timeout (gpointer user_data)
+{
+  Probe *probe = user_data;
+
+  if (probe_detach (probe))
+    {
+      g_warning ("Probe '%s' timed out", probe->name);
+      g_cancellable_cancel (probe->cancellable);
+      probe->callback (NULL, probe->user_data);
+      probe_unref (probe);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+run_probe (gpointer data,
+           gpointer user_data)
+{
+  Probe *probe = data;
+  GSource *source;
+
+  if (!g_cancellable_is_cancelled (probe->cancellable))
+    probe->result = probe->func (probe->probe_data, probe->cancellable);
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, on_probe_done, probe, (GDestroyNotify) probe_unref);
+  g_source_attach (source, probe->context);
+  g_source_unref (source);
+}
+
+static GThreadPool *
+get_pool (void)
+{
+  static gsize pool = 0;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *p;
+
+      /* as many threads as probes, so that a stuck probe doesn't hold up
+       * the others */
+      p = g_thread_pool_new (run_probe, NULL, -1, FALSE, NULL);
+      g_once_init_leave (&pool, (gsize) p);
+    }
+
+  return (GThreadPool *) pool;
+}
+
+/**
+ * cc_info_prober_new:
+ *
+ * Returns: a prober reporting to the thread default main context
+ */
+CcInfoProber *
+cc_info_prober_new (void)
+{
+  CcInfoProber *prober;
+
+  prober = g_slice_new0 (CcInfoProber);
+  prober->context = g_main_context_ref_thread_default ();
+
+  return prober;
+}
+
+/**
+ * cc_info_prober_free:
+ * @prober: a #CcInfoProber
+ *
+ * Cancels the pending probes, whose callbacks won't be called.
+ */
+void
+cc_info_prober_free (CcInfoProber *prober)
+{
+  if (prober == NULL)
+    return;
+
+  while (prober->probes != NULL)
+    {
+      Probe *probe = prober->probes->data;
+
+      probe_detach (probe);
+      g_cancellable_cancel (probe->cancellable);
+      probe_unref (probe);
+    }
+
+  g_main_context_unref (prober->context);
+  g_slice_free (CcInfoProber, prober);
+}
+
+/**
+ * cc_info_prober_add:
+ * @prober: a #CcInfoProber
+ * @name: the name of the probe, for debugging
+ * @timeout_ms: how long to wait for the result
+ * @func: the probe, run on a worker thread
+ * @probe_data: data for @func
+ * @probe_data_free: (allow-none): frees @probe_data
+ * @result_free: (allow-none): frees the result of @func
+ * @callback: called on the main context with the result
+ * @user_data: data for @callback
+ */
+void
+cc_info_prober_add (CcInfoProber        *prober,
+                    const char          *name,
+                    guint                timeout_ms,
+                    CcInfoProbeFunc      func,
+                    gpointer             probe_data,
+                    GDestroyNotify       probe_data_free,
+                    GDestroyNotify       result_free,
+                    CcInfoProbeCallback  callback,
+                    gpointer             user_data)
+{
+  Probe *probe;
+
+  probe = g_slice_new0 (Probe);
+  probe->ref_count = 1;
+  probe->name = g_strdup (name);
+  probe->func = func;
+  probe->probe_data = probe_data;
+  probe->probe_data_free = probe_data_free;
+  probe->result_free = result_free;
+  probe->callback = callback;
+  probe->user_data = user_data;
+  probe->prober = prober;
+  probe->context = g_main_context_ref (prober->context);
+  probe->cancellable = g_cancellable_new ();
+  probe->start_time = g_get_monotonic_time ();
+
+  /* the prober's reference */
+  prober->probes = g_list_prepend (prober->probes, probe);
+
+  probe->timeout = g_timeout_source_new (timeout_ms);
+  g_source_set_callback (probe->timeout, on_probe_timeout, probe, NULL);
+  g_source_attach (probe->timeout, prober->context);
+
+  /* the worker's reference, handed over to the idle source */
+  g_thread_pool_push (get_pool (), probe_ref (probe), NULL);
+}
@@ -0,0 +1,63 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+#ifndef _CC_INFO_PROBER_H
+#define _CC_INFO_PROBER_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Runs the probes of the system facts shown by the panel, each on its
+ * own worker thread, and hands their results back to the main context
+ * as they come.
+ *
+ * A probe which takes longer than its timeout is reported as failed,
+ * and its cancellable is cancelled; whatever it returns afterwards is
+ * dropped. Since a probe may be stuck in a system call, such as on an
+ * unresponsive network mount, it only ever holds up its own thread. */
+
+typedef struct _CcInfoProber CcInfoProber;
+
+/* Called on a worker thread, returns the result or %NULL */
+typedef gpointer (*CcInfoProbeFunc)     (gpointer      probe_data,
+                                         GCancellable *cancellable);
+
+/* Called on the main context, with %NULL if the probe failed or timed
+ * out. The result belongs to the prober */
+typedef void     (*CcInfoProbeCallback) (gpointer      result,
+                                         gpointer      user_data);
+
+CcInfoProber *cc_info_prober_new  (void);
+void          cc_info_prober_free (CcInfoProber        *prober);
+
+void          cc_info_prober_add  (CcInfoProber        *prober,
+                                   const char          *name,
+                                   guint                timeout_ms,
+                                   CcInfoProbeFunc      func,
+                                   gpointer             probe_data,
+                                   GDestroyNotify       probe_data_free,
+                                   GDestroyNotify       result_free,
+                                   CcInfoProbeCallback  callback,
+                                   gpointer             user_data);
+
+G_END_DECLS
+
+#endif /* _CC_INFO_PROBER_H */
@@ -0,0 +1,101 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ *
+ * Copyright (C) 2013 Red Hat, Inc
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ */
+
+/* Prints the name of the OpenGL renderer of the display.
+ *
+ * This runs out of the panel's process, so that the panel can give up
+ * on a driver which takes too long to load, and isn't taken down by one
+ * which crashes or raises X errors. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <X11/Xlib.h>
+#include <GL/gl.h>
+#include <GL/glx.h>
+
+static int
+on_x_error (Display     *display,
+            XErrorEvent *event)
+{
+  fprintf (stderr, "Failed to get OpenGL driver info\n");
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  Display *display;
+  int attributes[] = {
+    GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT,
+    GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+    GLX_RENDER_TYPE, GLX_RGBA_BIT,
+    None
+  };
+  int nconfigs;
+  Window window;
+  GLXFBConfig *config;
+  GLXWindow glxwin;
+  GLXContext context;
+  const char *renderer;
+
+  display = XOpenDisplay (NULL);
+  if (display == NULL)
+    {
+      fprintf (stderr, "Failed to open the display\n");
+      return 1;
+    }
+
+  XSetErrorHandler (on_x_error);
+
+  config = glXChooseFBConfig (display, DefaultScreen (display),
+                              attributes, &nconfigs);
+  if (config == NULL)
+    {
+      fprintf (stderr, "Failed to get OpenGL configuration\n");
+      return 1;
+    }
+
+  window = XCreateSimpleWindow (display, DefaultRootWindow (display),
+                                0, 0, /* x, y */
+                                1, 1, /* width, height */
+                                0, 0, 0  /* border_width, border, background */);
+  glxwin = glXCreateWindow (display, *config, window, NULL);
+
+  context = glXCreateNewContext (display, *config, GLX_RGBA_TYPE,
+                                 NULL, TRUE);
+
+  glXMakeContextCurrent (display, glxwin, glxwin, context);
+  renderer = (const char *) glGetString (GL_RENDERER);
+  if (renderer != NULL)
+    printf ("%s\n", renderer);
+
+  glXMakeContextCurrent (display, None, None, NULL);
+  glXDestroyContext (display, context);
+  glXDestroyWindow (display, glxwin);
+  XDestroyWindow (display, window);
+  XFree (config);
+  XSync (display, False);
+  XCloseDisplay (display);
+
+  return renderer != NULL ? 0 : 1;
+}
@@ -37,8 +37,12 @@
 #include "pp-ppd-selection-dialog.h"
 #include "pp-options-dialog.h"
 #include "pp-jobs-dialog.h"
+#include "pp-jobs-counter.h"
 #include "pp-utils.h"
 #include "pp-maintenance-command.h"
+#include "pp-cups.h"
+#include "pp-cups-pool.h"
+#include "pp-ppd-catalog.h"
 
 CC_PANEL_REGISTER (CcPrintersPanel, cc_printers_panel)
 
@@ -73,12 +77,14 @@ struct _CcPrintersPanelPrivate
   GtkBuilder *builder;
 
   cups_dest_t *dests;
+  GHashTable *dest_indices;
   gchar **dest_model_names;
   gchar **ppd_file_names;
   int num_dests;
   int current_dest;
 
   int num_jobs;
+  PpJobsCounter *jobs_counter;
 
   GdkRGBA background_color;
 
@@ -98,11 +104,15 @@ struct _CcPrintersPanelPrivate
   guint            cups_status_check_id;
   guint            dbus_subscription_id;
 
+  GCancellable    *get_dests_cancellable;
+  gboolean         refresh_dests_again;
+
   GtkWidget    *popup_menu;
   GList        *driver_change_list;
   GCancellable *get_ppd_name_cancellable;
   gboolean      getting_ppd_names;
   PPDList      *all_ppds_list;
+  PpPPDCatalog *ppd_catalog;
   GHashTable   *preferred_drivers;
   GCancellable *get_all_ppds_cancellable;
 
@@ -122,12 +132,20 @@ typedef struct
 } SetPPDItem;
 
 static void update_jobs_count (CcPrintersPanel *self);
+static void jobs_counted_cb (const gchar *printer_name, gint num_jobs, gpointer user_data);
 static void actualize_printers_list (CcPrintersPanel *self);
+static void refresh_printers_list (CcPrintersPanel *self);
+static gboolean update_printer_state (CcPrintersPanel *self,
+                                      const gchar     *printer_name,
+                                      gint             printer_state,
+                                      const gchar     *printer_state_reasons,
+                                      gboolean         printer_is_accepting_jobs);
 static void update_sensitivity (gpointer user_data);
 static void printer_disable_cb (GObject *gobject, GParamSpec *pspec, gpointer user_data);
 static void printer_set_default_cb (GtkToggleButton *button, gpointer user_data);
 static void detach_from_cups_notifier (gpointer data);
 static void free_dests (CcPrintersPanel *self);
+static gboolean cups_status_check (gpointer user_data);
 
 static void
 cc_printers_panel_get_property (GObject    *object,
@@ -163,7 +181,14 @@ cc_printers_panel_dispose (GObject *object)
   if (priv->pp_new_printer_dialog)
     g_clear_object (&priv->pp_new_printer_dialog);
 
+  if (priv->get_dests_cancellable)
+    {
+      g_cancellable_cancel (priv->get_dests_cancellable);
+      g_clear_object (&priv->get_dests_cancellable);
+    }
+
   free_dests (CC_PRINTERS_PANEL (object));
+  g_clear_pointer (&priv->dest_indices, g_hash_table_unref);
 
   g_clear_pointer (&priv->new_printer_name, g_free);
   g_clear_pointer (&priv->new_printer_location, g_free);
@@ -189,6 +214,8 @@ cc_printers_panel_dispose (GObject *object)
 
   detach_from_cups_notifier (CC_PRINTERS_PANEL (object));
 
+  g_clear_pointer (&priv->jobs_counter, pp_jobs_counter_free);
+
   if (priv->cups_status_check_id > 0)
     {
       g_source_remove (priv->cups_status_check_id);
@@ -201,6 +228,8 @@ cc_printers_panel_dispose (GObject *object)
       priv->all_ppds_list = NULL;
     }
 
+  g_clear_pointer (&priv->ppd_catalog, pp_ppd_catalog_free);
+
   if (priv->preferred_drivers)
     {
       g_hash_table_unref (priv->preferred_drivers);
@@ -255,6 +284,32 @@ cc_printers_panel_get_help_uri (CcPanel *panel)
   return "help:gnome-help/printing";
 }
 
+static void
+cc_printers_panel_set_active (CcPanel  *panel,
+                              gboolean  active)
+{
+  CcPrintersPanel        *self = CC_PRINTERS_PANEL (panel);
+  CcPrintersPanelPrivate *priv = self->priv;
+
+  if (active)
+    {
+      /* Catch up with what happened while hidden */
+      if (cups_status_check (self))
+        priv->cups_status_check_id =
+          g_timeout_add_seconds (CUPS_STATUS_CHECK_INTERVAL, cups_status_check, self);
+    }
+  else
+    {
+      detach_from_cups_notifier (self);
+
+      if (priv->cups_status_check_id > 0)
+        {
+          g_source_remove (priv->cups_status_check_id);
+          priv->cups_status_check_id = 0;
+        }
+    }
+}
+
 static void
 cc_printers_panel_class_init (CcPrintersPanelClass *klass)
 {
@@ -270,6 +325,7 @@ cc_printers_panel_class_init (CcPrintersPanelClass *klass)
 
   panel_class->get_permission = cc_printers_panel_get_permission;
   panel_class->get_help_uri = cc_printers_panel_get_help_uri;
+  panel_class->set_active = cc_printers_panel_set_active;
 }
 
 static void
@@ -294,9 +350,6 @@ on_cups_notification (GDBusConnection *connection,
   gint                    printer_state;
   gint                    job_state;
   gint                    job_impressions_completed;
-  static const char * const requested_attrs[] = {
-    "job-printer-uri",
-    "job-originating-user-name"};
 
   priv = PRINTERS_PANEL_PRIVATE (self);
 
@@ -336,56 +389,33 @@ on_cups_notification (GDBusConnection *connection,
                      &job_impressions_completed);
     }
 
-  if (g_strcmp0 (signal_name, "PrinterAdded") == 0 ||
-      g_strcmp0 (signal_name, "PrinterDeleted") == 0 ||
-      g_strcmp0 (signal_name, "PrinterStateChanged") == 0 ||
+  if (g_strcmp0 (signal_name, "JobCreated") != 0 &&
+      g_strcmp0 (signal_name, "JobCompleted") != 0)
+    pp_cups_pool_dests_changed ();
+
+  if (g_strcmp0 (signal_name, "PrinterStateChanged") == 0 ||
       g_strcmp0 (signal_name, "PrinterStopped") == 0)
-    actualize_printers_list (self);
-  else if (g_strcmp0 (signal_name, "JobCreated") == 0 ||
-           g_strcmp0 (signal_name, "JobCompleted") == 0)
     {
-      http_t *http;
-      gchar  *job_uri;
-      ipp_t  *request, *response;
-
-      job_uri = g_strdup_printf ("ipp://localhost/jobs/%d", job_id);
-      if ((http = httpConnectEncrypt (cupsServer (), ippPort (),
-                                     cupsEncryption ())) != NULL)
-        {
-          request = ippNewRequest (IPP_GET_JOB_ATTRIBUTES);
-          ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
-                       "job-uri", NULL, job_uri);
-          ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-                        "requesting-user-name", NULL, cupsUser ());
-          ippAddStrings (request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                         "requested-attributes", G_N_ELEMENTS (requested_attrs), NULL, requested_attrs);
-          response = cupsDoRequest (http, request, "/");
-
-          if (response)
-            {
-              if (ippGetStatusCode (response) <= IPP_OK_CONFLICT)
-                {
-                  ipp_attribute_t *attr_username = NULL;
-                  ipp_attribute_t *attr_printer_uri = NULL;
-
-                  attr_username = ippFindAttribute(response, "job-originating-user-name", IPP_TAG_NAME);
-                  attr_printer_uri = ippFindAttribute(response, "job-printer-uri", IPP_TAG_URI);
-                  if (attr_username && attr_printer_uri &&
-                      g_strcmp0 (ippGetString (attr_username, 0, NULL), cupsUser ()) == 0 &&
-                      g_strrstr (ippGetString (attr_printer_uri, 0, NULL), "/") != 0 &&
-                      priv->current_dest >= 0 &&
-                      priv->current_dest < priv->num_dests &&
-                      priv->dests != NULL &&
-                      g_strcmp0 (g_strrstr (ippGetString (attr_printer_uri, 0, NULL), "/") + 1,
-                                 priv->dests[priv->current_dest].name) == 0)
-                    update_jobs_count (self);
-                }
-              ippDelete(response);
-            }
-          httpClose (http);
-        }
-      g_free (job_uri);
+      /* The state comes with the notification, only a printer which
+       * isn't known yet needs the whole list */
+      if (printer_name == NULL ||
+          !update_printer_state (self,
+                                 printer_name,
+                                 printer_state,
+                                 printer_state_reasons,
+                                 printer_is_accepting_jobs))
+        refresh_printers_list (self);
     }
+  else if (g_strcmp0 (signal_name, "PrinterAdded") == 0 ||
+           g_strcmp0 (signal_name, "PrinterDeleted") == 0)
+    refresh_printers_list (self);
+  else if ((g_strcmp0 (signal_name, "JobCreated") == 0 ||
+            g_strcmp0 (signal_name, "JobCompleted") == 0) &&
+           priv->current_dest >= 0 &&
+           priv->current_dest < priv->num_dests &&
+           priv->dests != NULL &&
+           g_strcmp0 (printer_name, priv->dests[priv->current_dest].name) == 0)
+    pp_jobs_counter_job_changed (priv->jobs_counter, printer_name);
 }
 
 static gboolean
@@ -510,6 +540,8 @@ free_dests (CcPrintersPanel *self)
       g_free (priv->ppd_file_names);
       cupsFreeDests (priv->num_dests, priv->dests);
     }
+  if (priv->dest_indices)
+    g_hash_table_remove_all (priv->dest_indices);
   priv->dests = NULL;
   priv->num_dests = 0;
   priv->current_dest = -1;
@@ -1045,7 +1077,9 @@ printer_selection_changed_cb (GtkTreeSelection *selection,
 }
 
 static void
-actualize_printers_list (CcPrintersPanel *self)
+set_printers_list (CcPrintersPanel *self,
+                   cups_dest_t     *dests,
+                   int              num_dests)
 {
   CcPrintersPanelPrivate *priv;
   GtkTreeSelection       *selection;
@@ -1092,10 +1126,17 @@ actualize_printers_list (CcPrintersPanel *self)
     }
 
   free_dests (self);
-  priv->num_dests = cupsGetDests (&priv->dests);
+  priv->dests = dests;
+  priv->num_dests = num_dests;
   priv->dest_model_names = g_new0 (gchar *, priv->num_dests);
   priv->ppd_file_names = g_new0 (gchar *, priv->num_dests);
 
+  /* The instances of a printer follow each other, the index is the
+   * one of the first */
+  for (i = 0; i < priv->num_dests; i++)
+    if (!g_hash_table_contains (priv->dest_indices, priv->dests[i].name))
+      g_hash_table_insert (priv->dest_indices, priv->dests[i].name, GINT_TO_POINTER (i));
+
   store = gtk_list_store_new (PRINTER_N_COLUMNS,
                               G_TYPE_INT,
                               G_TYPE_STRING,
@@ -1108,10 +1149,10 @@ actualize_printers_list (CcPrintersPanel *self)
       widget = (GtkWidget*)
         gtk_builder_get_object (priv->builder, "notebook");
 
-      http = httpConnectEncrypt (cupsServer (), ippPort (), cupsEncryption ());
+      http = pp_cups_pool_acquire ();
       if (http)
         {
-          httpClose (http);
+          pp_cups_pool_release (http, TRUE);
           gtk_notebook_set_current_page (GTK_NOTEBOOK (widget), NOTEBOOK_NO_PRINTERS_PAGE);
         }
       else
@@ -1301,6 +1342,174 @@ actualize_printers_list (CcPrintersPanel *self)
   update_sensitivity (self);
 }
 
+static void
+actualize_printers_list (CcPrintersPanel *self)
+{
+  CcPrintersPanelPrivate *priv;
+  cups_dest_t            *dests = NULL;
+  int                     num_dests;
+
+  priv = PRINTERS_PANEL_PRIVATE (self);
+
+  /* Whatever is being fetched is older than this */
+  if (priv->get_dests_cancellable)
+    {
+      g_cancellable_cancel (priv->get_dests_cancellable);
+      g_clear_object (&priv->get_dests_cancellable);
+      priv->refresh_dests_again = FALSE;
+    }
+
+  /* The printers are reloaded after changing them */
+  pp_cups_pool_dests_changed ();
+
+  num_dests = pp_cups_pool_get_dests (&dests);
+  set_printers_list (self, dests, num_dests);
+}
+
+static void
+refresh_printers_list_cb (GObject      *source_object,
+                          GAsyncResult *res,
+                          gpointer      user_data)
+{
+  CcPrintersPanelPrivate *priv;
+  CcPrintersPanel        *self;
+  PpCupsDests            *dests;
+  GError                 *error = NULL;
+
+  dests = pp_cups_get_dests_finish (PP_CUPS (source_object), res, &error);
+  g_object_unref (source_object);
+
+  if (dests == NULL)
+    {
+      if (error->domain != G_IO_ERROR ||
+          error->code != G_IO_ERROR_CANCELLED)
+        {
+          self = (CcPrintersPanel*) user_data;
+          priv = PRINTERS_PANEL_PRIVATE (self);
+
+          g_warning ("%s", error->message);
+          g_clear_object (&priv->get_dests_cancellable);
+        }
+
+      g_error_free (error);
+      return;
+    }
+
+  self = (CcPrintersPanel*) user_data;
+  priv = PRINTERS_PANEL_PRIVATE (self);
+
+  g_clear_object (&priv->get_dests_cancellable);
+
+  set_printers_list (self, dests->dests, dests->num_of_dests);
+  g_free (dests);
+
+  if (priv->refresh_dests_again)
+    {
+      priv->refresh_dests_again = FALSE;
+      refresh_printers_list (self);
+    }
+}
+
+/* Fetches the printers away from the main thread, then rebuilds the
+ * list. The notifications which come meanwhile are answered by a
+ * single fetch once this one is done. */
+static void
+refresh_printers_list (CcPrintersPanel *self)
+{
+  CcPrintersPanelPrivate *priv;
+
+  priv = PRINTERS_PANEL_PRIVATE (self);
+
+  if (priv->get_dests_cancellable)
+    {
+      priv->refresh_dests_again = TRUE;
+      return;
+    }
+
+  priv->get_dests_cancellable = g_cancellable_new ();
+  pp_cups_get_dests_async (pp_cups_new (),
+                           priv->get_dests_cancellable,
+                           refresh_printers_list_cb,
+                           self);
+}
+
+/* Changes the printer with the state it was notified with, and only its
+ * rows. Returns FALSE if the printer isn't known. */
+static gboolean
+update_printer_state (CcPrintersPanel *self,
+                      const gchar     *printer_name,
+                      gint             printer_state,
+                      const gchar     *printer_state_reasons,
+                      gboolean         printer_is_accepting_jobs)
+{
+  CcPrintersPanelPrivate *priv;
+  GtkTreeModel           *model;
+  GtkTreeView            *treeview;
+  GtkTreeIter             iter;
+  cups_dest_t            *dest;
+  gboolean                valid;
+  gpointer                index;
+  gchar                  *state;
+  gint                    first, last;
+  gint                    id;
+
+  priv = PRINTERS_PANEL_PRIVATE (self);
+
+  if (!g_hash_table_lookup_extended (priv->dest_indices, printer_name, NULL, &index))
+    return FALSE;
+
+  /* A list being fetched may be older than the notification */
+  if (priv->get_dests_cancellable)
+    priv->refresh_dests_again = TRUE;
+
+  state = g_strdup_printf ("%d", printer_state);
+
+  first = GPOINTER_TO_INT (index);
+  for (last = first;
+       last < priv->num_dests && g_strcmp0 (priv->dests[last].name, printer_name) == 0;
+       last++)
+    {
+      dest = &priv->dests[last];
+
+      dest->num_options = cupsAddOption ("printer-state", state,
+                                         dest->num_options, &dest->options);
+      dest->num_options = cupsAddOption ("printer-state-reasons",
+                                         printer_state_reasons ? printer_state_reasons : "",
+                                         dest->num_options, &dest->options);
+      dest->num_options = cupsAddOption ("printer-is-accepting-jobs",
+                                         printer_is_accepting_jobs ? "true" : "false",
+                                         dest->num_options, &dest->options);
+    }
+
+  g_free (state);
+
+  treeview = (GtkTreeView*)
+    gtk_builder_get_object (priv->builder, "printers-treeview");
+  model = gtk_tree_view_get_model (treeview);
+
+  valid = model != NULL && gtk_tree_model_get_iter_first (model, &iter);
+  while (valid)
+    {
+      gtk_tree_model_get (model, &iter,
+                          PRINTER_ID_COLUMN, &id,
+                          -1);
+
+      if (id >= first && id < last)
+        gtk_list_store_set (GTK_LIST_STORE (model), &iter,
+                            PRINTER_PAUSED_COLUMN, printer_state == IPP_PRINTER_STOPPED,
+                            -1);
+
+      valid = gtk_tree_model_iter_next (model, &iter);
+    }
+
+  if (priv->current_dest >= first && priv->current_dest < last)
+    printer_selection_changed_cb (gtk_tree_view_get_selection (treeview), self);
+
+  update_sensitivity (self);
+
+  return TRUE;
+}
+
 static void
 set_cell_sensitivity_func (GtkTreeViewColumn *tree_column,
                            GtkCellRenderer   *cell,
@@ -1404,29 +1613,22 @@ enum
 };
 
 static void
-update_jobs_count (CcPrintersPanel *self)
+show_jobs_count (CcPrintersPanel *self)
 {
   CcPrintersPanelPrivate *priv;
-  cups_job_t             *jobs;
   GtkWidget              *widget;
   gchar                  *active_jobs = NULL;
-  gint                    num_jobs;
 
   priv = PRINTERS_PANEL_PRIVATE (self);
 
-  priv->num_jobs = -1;
-
-  if (priv->current_dest >= 0 &&
+  /* Still being counted when negative */
+  if (priv->num_jobs >= 0 &&
+      priv->current_dest >= 0 &&
       priv->current_dest < priv->num_dests &&
       priv->dests != NULL)
     {
-      priv->num_jobs = cupsGetJobs (&jobs, priv->dests[priv->current_dest].name, 1, CUPS_WHICHJOBS_ACTIVE);
-      if (priv->num_jobs > 0)
-        cupsFreeJobs (priv->num_jobs, jobs);
-
-      num_jobs = priv->num_jobs < 0 ? 0 : (guint) priv->num_jobs;
       /* Translators: there is n active print jobs on this printer */
-      active_jobs = g_strdup_printf (ngettext ("%u active", "%u active", num_jobs), num_jobs);
+      active_jobs = g_strdup_printf (ngettext ("%u active", "%u active", (guint) priv->num_jobs), (guint) priv->num_jobs);
     }
 
   widget = (GtkWidget*)
@@ -1439,6 +1641,26 @@ update_jobs_count (CcPrintersPanel *self)
     }
   else
     cc_editable_entry_set_text (CC_EDITABLE_ENTRY (widget), EMPTY_TEXT);
+}
+
+static void
+jobs_counted_cb (const gchar *printer_name,
+                 gint         num_jobs,
+                 gpointer     user_data)
+{
+  CcPrintersPanelPrivate *priv;
+  CcPrintersPanel        *self = (CcPrintersPanel*) user_data;
+
+  priv = PRINTERS_PANEL_PRIVATE (self);
+
+  if (priv->current_dest < 0 ||
+      priv->current_dest >= priv->num_dests ||
+      priv->dests == NULL ||
+      g_strcmp0 (printer_name, priv->dests[priv->current_dest].name) != 0)
+    return;
+
+  priv->num_jobs = num_jobs < 0 ? 0 : num_jobs;
+  show_jobs_count (self);
 
   if (priv->pp_jobs_dialog)
     {
@@ -1446,6 +1668,23 @@ update_jobs_count (CcPrintersPanel *self)
     }
 }
 
+static void
+update_jobs_count (CcPrintersPanel *self)
+{
+  CcPrintersPanelPrivate *priv;
+
+  priv = PRINTERS_PANEL_PRIVATE (self);
+
+  priv->num_jobs = -1;
+
+  if (priv->current_dest >= 0 &&
+      priv->current_dest < priv->num_dests &&
+      priv->dests != NULL)
+    pp_jobs_counter_update (priv->jobs_counter, priv->dests[priv->current_dest].name);
+
+  show_jobs_count (self);
+}
+
 static void
 printer_disable_cb (GObject    *gobject,
                     GParamSpec *pspec,
@@ -1848,7 +2087,7 @@ printer_name_edit_cb (GtkWidget *entry,
   if (printer_rename (old_name, new_name))
     {
       free_dests (self);
-      priv->num_dests = cupsGetDests (&priv->dests);
+      priv->num_dests = pp_cups_pool_get_dests (&priv->dests);
       priv->dest_model_names = g_new0 (gchar *, priv->num_dests);
       priv->ppd_file_names = g_new0 (gchar *, priv->num_dests);
 
@@ -2045,7 +2284,9 @@ select_ppd_in_dialog (GtkMenuItem *menuitem,
   CcPrintersPanel        *self = (CcPrintersPanel*) user_data;
   GtkWidget              *widget;
   gchar                  *device_id = NULL;
+  gchar                  *model_name = NULL;
   gchar                  *manufacturer = NULL;
+  gchar                  *ppd_name = NULL;
 
   priv = PRINTERS_PANEL_PRIVATE (self);
 
@@ -2061,7 +2302,20 @@ select_ppd_in_dialog (GtkMenuItem *menuitem,
             get_ppd_attribute (priv->ppd_file_names[priv->current_dest],
                                "1284DeviceID");
 
-          if (device_id)
+          /* Preselect the driver the catalog has for the printer */
+          if (priv->ppd_catalog)
+            {
+              model_name =
+                get_ppd_attribute (priv->ppd_file_names[priv->current_dest],
+                                   "ModelName");
+
+              ppd_name = get_ppd_name_for_device (priv->ppd_catalog,
+                                                  device_id,
+                                                  model_name,
+                                                  &manufacturer);
+            }
+
+          if (!manufacturer && device_id)
             {
               manufacturer = get_tag_value (device_id, "mfg");
               if (!manufacturer)
@@ -2085,10 +2339,13 @@ select_ppd_in_dialog (GtkMenuItem *menuitem,
         GTK_WINDOW (gtk_widget_get_toplevel (widget)),
         priv->all_ppds_list,
         manufacturer,
+        ppd_name,
         ppd_selection_dialog_response_cb,
         self);
 
       g_free (manufacturer);
+      g_free (ppd_name);
+      g_free (model_name);
       g_free (device_id);
     }
 }
@@ -2433,7 +2690,6 @@ test_page_cb (GtkButton *button,
                                     NULL };
       const gchar **pattern;
       const gchar  *datadir = NULL;
-      http_t       *http = NULL;
       gchar        *printer_uri = NULL;
       gchar        *filename = NULL;
       gchar        *resource = NULL;
@@ -2485,20 +2741,15 @@ test_page_cb (GtkButton *button,
               resource = g_strdup_printf ("/printers/%s", printer_name);
             }
 
-          http = httpConnectEncrypt (cupsServer (), ippPort (), cupsEncryption ());
-          if (http)
-            {
-              request = ippNewRequest (IPP_PRINT_JOB);
-              ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
-                            "printer-uri", NULL, printer_uri);
-              ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-                            "requesting-user-name", NULL, cupsUser ());
-              ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-              /* Translators: Name of job which makes printer to print test page */
-                            "job-name", NULL, _("Test page"));
-              response = cupsDoFileRequest (http, request, resource, filename);
-              httpClose (http);
-            }
+          request = ippNewRequest (IPP_PRINT_JOB);
+          ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
+                        "printer-uri", NULL, printer_uri);
+          ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                        "requesting-user-name", NULL, cupsUser ());
+          ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+          /* Translators: Name of job which makes printer to print test page */
+                        "job-name", NULL, _("Test page"));
+          response = pp_cups_pool_do_file_request (request, resource, filename);
 
           if (response)
             {
@@ -2763,10 +3014,10 @@ cups_status_check (gpointer user_data)
 
   priv = self->priv = PRINTERS_PANEL_PRIVATE (self);
 
-  http = httpConnectEncrypt (cupsServer (), ippPort (), cupsEncryption ());
+  http = pp_cups_pool_acquire ();
   if (http)
     {
-      httpClose (http);
+      pp_cups_pool_release (http, TRUE);
       actualize_printers_list (self);
       attach_to_cups_notifier (self);
       priv->cups_status_check_id = 0;
@@ -2777,8 +3028,9 @@ cups_status_check (gpointer user_data)
 }
 
 static void
-get_all_ppds_async_cb (PPDList  *ppds,
-                       gpointer  user_data)
+get_all_ppds_async_cb (PPDList      *ppds,
+                       PpPPDCatalog *catalog,
+                       gpointer      user_data)
 {
   CcPrintersPanelPrivate *priv;
   CcPrintersPanel        *self = (CcPrintersPanel*) user_data;
@@ -2786,6 +3038,7 @@ get_all_ppds_async_cb (PPDList  *ppds,
   priv = self->priv = PRINTERS_PANEL_PRIVATE (self);
 
   priv->all_ppds_list = ppds;
+  priv->ppd_catalog = catalog;
 
   if (priv->pp_ppd_selection_dialog)
     pp_ppd_selection_dialog_set_ppd_list (priv->pp_ppd_selection_dialog,
@@ -2886,12 +3139,14 @@ cc_printers_panel_init (CcPrintersPanel *self)
   /* initialize main data structure */
   priv->builder = gtk_builder_new ();
   priv->dests = NULL;
+  priv->dest_indices = g_hash_table_new (g_str_hash, g_str_equal);
   priv->dest_model_names = NULL;
   priv->ppd_file_names = NULL;
   priv->num_dests = 0;
   priv->current_dest = -1;
 
-  priv->num_jobs = 0;
+  priv->num_jobs = -1;
+  priv->jobs_counter = pp_jobs_counter_new (jobs_counted_cb, self);
 
   priv->pp_new_printer_dialog = NULL;
   priv->pp_options_dialog = NULL;
@@ -2915,6 +3170,7 @@ cc_printers_panel_init (CcPrintersPanel *self)
   priv->getting_ppd_names = FALSE;
 
   priv->all_ppds_list = NULL;
+  priv->ppd_catalog = NULL;
   priv->get_all_ppds_cancellable = NULL;
 
   priv->preferred_drivers = NULL;
@@ -3037,14 +3293,14 @@ Please check your installation");
                       get_all_ppds_async_cb,
                       self);
 
-  http = httpConnectEncrypt (cupsServer (), ippPort (), cupsEncryption ());
+  http = pp_cups_pool_acquire ();
   if (!http)
     {
       priv->cups_status_check_id =
         g_timeout_add_seconds (CUPS_STATUS_CHECK_INTERVAL, cups_status_check, self);
     }
   else
-    httpClose (http);
+    pp_cups_pool_release (http, TRUE);
 
   gtk_container_add (GTK_CONTAINER (self), top_widget);
   gtk_widget_show_all (GTK_WIDGET (self));
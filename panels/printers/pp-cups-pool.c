@@ -0,0 +1,382 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <cups/cups.h>
+
+#include "pp-cups-pool.h"
+
+#if (CUPS_VERSION_MAJOR > 1) || (CUPS_VERSION_MINOR > 5)
+#define HAVE_CUPS_1_6 1
+#endif
+
+#ifndef HAVE_CUPS_1_6
+#define ippGetOperation(ipp) ipp->request.op.operation_id
+#endif
+
+/* How many idle connections are kept open */
+#define MAX_IDLE_CONNECTIONS 4
+
+/* How long a connection may stay idle, in seconds; cupsd closes the
+ * connections idle for 30 seconds by default */
+#define IDLE_TIMEOUT 20
+
+typedef struct
+{
+  http_t *http;
+  gint64  last_used;
+} Connection;
+
+typedef struct
+{
+  guint  n_requests;
+  gint64 total_time;
+  gint64 max_time;
+} OperationStats;
+
+typedef struct
+{
+  GThreadFunc func;
+  gpointer    data;
+} Job;
+
+G_LOCK_DEFINE_STATIC (pool);
+
+/* Protected by the pool lock, the connections used last come first */
+static GQueue       idle_connections = G_QUEUE_INIT;
+static GHashTable  *operation_stats = NULL;
+static cups_dest_t *cached_dests = NULL;
+static gint         num_cached_dests = 0;
+static gboolean     dests_cached = FALSE;
+static guint        dests_generation = 0;
+
+/**
+ * pp_cups_pool_acquire:
+ *
+ * Returns: a connection to the CUPS server for the caller alone, to be
+ *   handed back with pp_cups_pool_release(), or %NULL
+ */
+http_t *
+pp_cups_pool_acquire (void)
+{
+  Connection *connection;
+  http_t     *http = NULL;
+  gint64      now;
+
+  now = g_get_monotonic_time ();
+
+  G_LOCK (pool);
+  while (http == NULL &&
+         (connection = g_queue_pop_head (&idle_connections)) != NULL)
+    {
+      if (now - connection->last_used < IDLE_TIMEOUT * G_USEC_PER_SEC)
+        http = connection->http;
+      else
+        httpClose (connection->http);
+
+      g_slice_free (Connection, connection);
+    }
+  G_UNLOCK (pool);
+
+  if (http == NULL)
+    {
+      http = httpConnectEncrypt (cupsServer (), ippPort (), cupsEncryption ());
+      if (http == NULL)
+        g_debug ("Connection to CUPS server \'%s\' failed.", cupsServer ());
+    }
+
+  return http;
+}
+
+/**
+ * pp_cups_pool_release:
+ * @http: (allow-none): a connection from pp_cups_pool_acquire()
+ * @reuse: %FALSE if the connection failed and is to be closed
+ */
+void
+pp_cups_pool_release (http_t   *http,
+                      gboolean  reuse)
+{
+  Connection *connection;
+
+  if (http == NULL)
+    return;
+
+  if (!reuse)
+    {
+      httpClose (http);
+      return;
+    }
+
+  connection = g_slice_new (Connection);
+  connection->http = http;
+  connection->last_used = g_get_monotonic_time ();
+
+  G_LOCK (pool);
+  g_queue_push_head (&idle_connections, connection);
+  while (g_queue_get_length (&idle_connections) > MAX_IDLE_CONNECTIONS)
+    {
+      connection = g_queue_pop_tail (&idle_connections);
+      httpClose (connection->http);
+      g_slice_free (Connection, connection);
+    }
+  G_UNLOCK (pool);
+}
+
+static void
+record_request (ipp_op_t operation,
+                gint64   time)
+{
+  OperationStats *stats;
+
+  G_LOCK (pool);
+  if (operation_stats == NULL)
+    operation_stats = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  stats = g_hash_table_lookup (operation_stats, GINT_TO_POINTER (operation));
+  if (stats == NULL)
+    {
+      stats = g_new0 (OperationStats, 1);
+      g_hash_table_insert (operation_stats, GINT_TO_POINTER (operation), stats);
+    }
+
+  stats->n_requests++;
+  stats->total_time += time;
+  stats->max_time = MAX (stats->max_time, time);
+
+  g_debug ("%s took %.1f ms (%u requests, %.1f ms on average, %.1f ms at most)",
+           ippOpString (operation),
+           time / 1000.0,
+           stats->n_requests,
+           stats->total_time / 1000.0 / stats->n_requests,
+           stats->max_time / 1000.0);
+  G_UNLOCK (pool);
+}
+
+/**
+ * pp_cups_pool_do_file_request:
+ * @request: the request, freed by the call
+ * @resource: the resource to send @request to
+ * @filename: (allow-none): a file to send with @request
+ *
+ * Sends @request on one of the connections of the pool, like
+ * cupsDoFileRequest().
+ *
+ * Returns: the response, or %NULL
+ */
+ipp_t *
+pp_cups_pool_do_file_request (ipp_t       *request,
+                              const gchar *resource,
+                              const gchar *filename)
+{
+  ipp_op_t  operation;
+  http_t   *http;
+  ipp_t    *response;
+  gint64    start;
+
+  operation = ippGetOperation (request);
+  start = g_get_monotonic_time ();
+
+  http = pp_cups_pool_acquire ();
+  if (http == NULL)
+    {
+      ippDelete (request);
+      return NULL;
+    }
+
+  response = cupsDoFileRequest (http, request, resource, filename);
+
+  record_request (operation, g_get_monotonic_time () - start);
+
+  pp_cups_pool_release (http,
+                        response != NULL &&
+                        cupsLastError () != IPP_SERVICE_UNAVAILABLE);
+
+  return response;
+}
+
+/**
+ * pp_cups_pool_do_request:
+ * @request: the request, freed by the call
+ * @resource: the resource to send @request to
+ *
+ * Returns: the response, or %NULL
+ */
+ipp_t *
+pp_cups_pool_do_request (ipp_t       *request,
+                         const gchar *resource)
+{
+  return pp_cups_pool_do_file_request (request, resource, NULL);
+}
+
+/* Allocated the way CUPS allocates them, for cupsFreeDests() */
+static gint
+copy_dests (cups_dest_t  *dests,
+            gint          num_dests,
+            cups_dest_t **copy)
+{
+  cups_dest_t *dest;
+  gint         i, j;
+
+  *copy = NULL;
+  if (num_dests == 0)
+    return 0;
+
+  *copy = calloc (num_dests, sizeof (cups_dest_t));
+  for (i = 0; i < num_dests; i++)
+    {
+      dest = &(*copy)[i];
+
+      dest->name = strdup (dests[i].name);
+      if (dests[i].instance != NULL)
+        dest->instance = strdup (dests[i].instance);
+      dest->is_default = dests[i].is_default;
+
+      for (j = 0; j < dests[i].num_options; j++)
+        dest->num_options = cupsAddOption (dests[i].options[j].name,
+                                           dests[i].options[j].value,
+                                           dest->num_options,
+                                           &dest->options);
+    }
+
+  return num_dests;
+}
+
+/**
+ * pp_cups_pool_get_dests:
+ * @dests: (out): return location for the destinations
+ *
+ * Gets the destinations like cupsGetDests(), from the server only if
+ * they changed since they were last got.
+ *
+ * Returns: the number of destinations
+ */
+gint
+pp_cups_pool_get_dests (cups_dest_t **dests)
+{
+  ipp_status_t  status;
+  http_t       *http;
+  guint         generation;
+  gint          num_dests;
+  gint64        start;
+
+  G_LOCK (pool);
+  if (dests_cached)
+    {
+      num_dests = copy_dests (cached_dests, num_cached_dests, dests);
+      G_UNLOCK (pool);
+
+      return num_dests;
+    }
+  generation = dests_generation;
+  G_UNLOCK (pool);
+
+  start = g_get_monotonic_time ();
+
+  http = pp_cups_pool_acquire ();
+  num_dests = cupsGetDests2 (http, dests);
+  status = cupsLastError ();
+
+  record_request (CUPS_GET_PRINTERS, g_get_monotonic_time () - start);
+
+  pp_cups_pool_release (http, status != IPP_SERVICE_UNAVAILABLE);
+
+  /* Not if the destinations changed while they were being got, the
+   * list may not have the change */
+  G_LOCK (pool);
+  if (generation == dests_generation && status <= IPP_OK_CONFLICT)
+    {
+      cupsFreeDests (num_cached_dests, cached_dests);
+      num_cached_dests = copy_dests (*dests, num_dests, &cached_dests);
+      dests_cached = TRUE;
+    }
+  G_UNLOCK (pool);
+
+  return num_dests;
+}
+
+/**
+ * pp_cups_pool_dests_changed:
+ *
+ * Tells the pool that the cached destinations are out of date, because
+ * they were changed or the server notified of a change.
+ */
+void
+pp_cups_pool_dests_changed (void)
+{
+  G_LOCK (pool);
+  dests_generation++;
+  cupsFreeDests (num_cached_dests, cached_dests);
+  cached_dests = NULL;
+  num_cached_dests = 0;
+  dests_cached = FALSE;
+  G_UNLOCK (pool);
+}
+
+static void
+run_job (gpointer data,
+         gpointer user_data)
+{
+  Job *job = (Job *) data;
+
+  job->func (job->data);
+  g_slice_free (Job, job);
+}
+
+static GThreadPool *
+get_worker (void)
+{
+  static gsize worker = 0;
+
+  if (g_once_init_enter (&worker))
+    {
+      GThreadPool *w;
+
+      /* a single thread, the requests are sent one after another */
+      w = g_thread_pool_new (run_job, NULL, 1, FALSE, NULL);
+      g_once_init_leave (&worker, (gsize) w);
+    }
+
+  return (GThreadPool *) worker;
+}
+
+/**
+ * pp_cups_pool_queue:
+ * @func: a function sending requests through the pool
+ * @data: data for @func
+ *
+ * Runs @func on the worker thread, after the functions queued before.
+ */
+void
+pp_cups_pool_queue (GThreadFunc func,
+                    gpointer    data)
+{
+  Job *job;
+
+  job = g_slice_new (Job);
+  job->func = func;
+  job->data = data;
+
+  g_thread_pool_push (get_worker (), job, NULL);
+}
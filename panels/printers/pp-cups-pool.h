@@ -0,0 +1,65 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __PP_CUPS_POOL_H__
+#define __PP_CUPS_POOL_H__
+
+#include <glib.h>
+#include <cups/cups.h>
+
+G_BEGIN_DECLS
+
+/* Connections to the CUPS server shared by the whole panel.
+ *
+ * The connections are kept open between requests, so that the requests
+ * of one user action don't each connect to the server again, and are
+ * dropped once they have been idle long enough for the server to have
+ * closed them. The time every request takes is logged, along with the
+ * average of its operation.
+ *
+ * The destinations are cached as well, until something tells the pool
+ * that they changed; each change makes a new generation of them, and a
+ * list fetched during a change isn't kept.
+ *
+ * The requests which don't need an answer right away can be queued on
+ * a worker thread, which runs them one after another. */
+
+/* Connections */
+http_t *pp_cups_pool_acquire          (void);
+void    pp_cups_pool_release          (http_t       *http,
+                                       gboolean      reuse);
+
+/* Requests, they take @request like cupsDoRequest() does */
+ipp_t  *pp_cups_pool_do_request       (ipp_t        *request,
+                                       const gchar  *resource);
+ipp_t  *pp_cups_pool_do_file_request  (ipp_t        *request,
+                                       const gchar  *resource,
+                                       const gchar  *filename);
+
+/* Destinations, to be freed with cupsFreeDests() */
+gint    pp_cups_pool_get_dests        (cups_dest_t **dests);
+void    pp_cups_pool_dests_changed    (void);
+
+/* Worker */
+void    pp_cups_pool_queue            (GThreadFunc   func,
+                                       gpointer      data);
+
+G_END_DECLS
+
+#endif
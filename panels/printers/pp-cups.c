@@ -20,6 +20,7 @@
  */
 
 #include "pp-cups.h"
+#include "pp-cups-pool.h"
 
 G_DEFINE_TYPE (PpCups, pp_cups, G_TYPE_OBJECT);
 
@@ -63,7 +64,7 @@ _pp_cups_get_dests_thread (GSimpleAsyncResult *res,
   data = g_simple_async_result_get_op_res_gpointer (res);
 
   data->dests = g_new0 (PpCupsDests, 1);
-  data->dests->num_of_dests = cupsGetDests (&data->dests->dests);
+  data->dests->num_of_dests = pp_cups_pool_get_dests (&data->dests->dests);
 }
 
 static void
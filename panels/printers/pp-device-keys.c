@@ -0,0 +1,216 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "pp-device-keys.h"
+#include "pp-utils.h"
+
+/* Ports which the backends may or may not write in the URI */
+static const struct
+{
+  const gchar *scheme;
+  const gchar *port;
+} default_ports[] =
+{
+  { "ipp://",    "631" },
+  { "ipps://",   "631" },
+  { "socket://", "9100" },
+  { "lpd://",    "515" }
+};
+
+static gboolean
+is_default_port (const gchar *scheme,
+                 gsize        scheme_length,
+                 const gchar *port,
+                 gsize        port_length)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (default_ports); i++)
+    if (strlen (default_ports[i].scheme) == scheme_length &&
+        g_ascii_strncasecmp (default_ports[i].scheme, scheme, scheme_length) == 0 &&
+        strlen (default_ports[i].port) == port_length &&
+        strncmp (default_ports[i].port, port, port_length) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+/*
+ * Normalize given device URI so that the URIs of a device
+ * found by different backends are equal: lowercase scheme
+ * and host, no user info, no default port and no trailing
+ * slash.  Queues on other ports of the same host are told
+ * apart unless with_port is FALSE, as for the URIs returned
+ * by GroupPhysicalDevices which have no port numbers.
+ */
+gchar *
+pp_device_uri_key (const gchar *device_uri,
+                   gboolean     with_port)
+{
+  const gchar *separator;
+  const gchar *host;
+  const gchar *host_end;
+  const gchar *path;
+  const gchar *c;
+  GString     *key;
+  gchar       *tmp;
+
+  if (!device_uri)
+    return NULL;
+
+  key = g_string_new ("uri:");
+
+  separator = strstr (device_uri, "://");
+  if (separator)
+    {
+      host = separator + 3;
+      path = host + strcspn (host, "/?#");
+
+      tmp = g_ascii_strdown (device_uri, host - device_uri);
+      g_string_append (key, tmp);
+      g_free (tmp);
+
+      for (c = host; c < path; c++)
+        if (*c == '@')
+          host = c + 1;
+
+      /* The colons of an IPv6 address are not a port */
+      if (*host == '[')
+        {
+          c = memchr (host, ']', path - host);
+          host_end = c ? c + 1 : path;
+        }
+      else
+        {
+          c = memchr (host, ':', path - host);
+          host_end = c ? c : path;
+        }
+
+      tmp = g_ascii_strdown (host, host_end - host);
+      g_string_append (key, tmp);
+      g_free (tmp);
+
+      if (with_port &&
+          *host_end == ':' &&
+          host_end + 1 < path &&
+          !is_default_port (device_uri, separator + 3 - device_uri,
+                            host_end + 1, path - host_end - 1))
+        g_string_append_len (key, host_end, path - host_end);
+
+      g_string_append (key, path);
+    }
+  else
+    {
+      g_string_append (key, device_uri);
+    }
+
+  if (key->str[key->len - 1] == '/')
+    g_string_truncate (key, key->len - 1);
+
+  return g_string_free (key, FALSE);
+}
+
+/*
+ * Only a device ID with a serial number tells
+ * a device apart from the others of its model.
+ */
+gchar *
+pp_device_id_key (const gchar *device_id)
+{
+  gchar *manufacturer;
+  gchar *model;
+  gchar *serial;
+  gchar *tmp;
+  gchar *key = NULL;
+
+  if (!device_id)
+    return NULL;
+
+  serial = get_tag_value (device_id, "sern");
+  if (!serial)
+    serial = get_tag_value (device_id, "serialnumber");
+  if (!serial)
+    serial = get_tag_value (device_id, "sn");
+
+  if (serial)
+    {
+      manufacturer = get_tag_value (device_id, "mfg");
+      if (!manufacturer)
+        manufacturer = get_tag_value (device_id, "manufacturer");
+
+      model = get_tag_value (device_id, "mdl");
+      if (!model)
+        model = get_tag_value (device_id, "model");
+
+      tmp = g_strdup_printf ("id:%s;%s;%s",
+                             manufacturer ? manufacturer : "",
+                             model ? model : "",
+                             serial);
+      key = g_ascii_strdown (tmp, -1);
+
+      g_free (tmp);
+      g_free (manufacturer);
+      g_free (model);
+      g_free (serial);
+    }
+
+  return key;
+}
+
+/*
+ * Devices with a device ID can get their driver found,
+ * direct connections are more reliable than network ones
+ * and the local CUPS server tells the most about devices.
+ */
+gint
+pp_device_rank (gboolean has_device_id,
+                gboolean network_device,
+                gint     acquisition_method)
+{
+  gint rank = 0;
+
+  if (has_device_id)
+    rank += 8;
+
+  if (!network_device)
+    rank += 4;
+
+  switch (acquisition_method)
+    {
+      case ACQUISITION_METHOD_DEFAULT_CUPS_SERVER:
+        rank += 3;
+        break;
+      case ACQUISITION_METHOD_SNMP:
+        rank += 2;
+        break;
+      case ACQUISITION_METHOD_REMOTE_CUPS_SERVER:
+        rank += 1;
+        break;
+      default:
+        break;
+    }
+
+  return rank;
+}
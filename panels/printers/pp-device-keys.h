@@ -0,0 +1,41 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __PP_DEVICE_KEYS_H__
+#define __PP_DEVICE_KEYS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Keys under which the new printer dialog recognizes a device found
+ * by several backends, and the rank deciding which of them is kept. */
+
+gchar *pp_device_uri_key (const gchar *device_uri,
+                          gboolean     with_port);
+
+gchar *pp_device_id_key  (const gchar *device_id);
+
+gint   pp_device_rank    (gboolean     has_device_id,
+                          gboolean     network_device,
+                          gint         acquisition_method);
+
+G_END_DECLS
+
+#endif /* __PP_DEVICE_KEYS_H__ */
@@ -21,6 +21,10 @@
 
 #include "pp-host.h"
 
+#include <signal.h>
+#include <sys/wait.h>
+#include <gio/gunixinputstream.h>
+
 struct _PpHostPrivate
 {
   gchar *hostname;
@@ -240,31 +244,67 @@ _pp_host_get_snmp_devices_thread (GSimpleAsyncResult *res,
   PpHostPrivate  *priv = host->priv;
   PpPrintDevice  *device;
   GSDData        *data;
-  GError         *error;
+  GInputStream   *stream;
+  const gchar    *serverbin;
+  GString        *output;
+  GError         *error = NULL;
   gchar         **argv;
   gchar          *stdout_string = NULL;
-  gchar          *stderr_string = NULL;
-  gint            exit_status;
+  gchar           buffer[1024];
+  gssize          n_read;
+  GPid            pid;
+  gint            exit_status = -1;
+  gint            out_fd;
 
   data = g_simple_async_result_get_op_res_gpointer (res);
   data->devices = g_new0 (PpDevicesList, 1);
   data->devices->devices = NULL;
 
+  /* CUPS_SERVERBIN lets a stub backend be used instead */
+  serverbin = g_getenv ("CUPS_SERVERBIN");
+
   argv = g_new0 (gchar *, 3);
-  argv[0] = g_strdup ("/usr/lib/cups/backend/snmp");
+  argv[0] = g_build_filename (serverbin ? serverbin : "/usr/lib/cups",
+                              "backend", "snmp", NULL);
   argv[1] = g_strdup (priv->hostname);
 
   /* Use SNMP to get printer's informations */
-  g_spawn_sync (NULL,
-                argv,
-                NULL,
-                0,
-                NULL,
-                NULL,
-                &stdout_string,
-                &stderr_string,
-                &exit_status,
-                &error);
+  if (g_spawn_async_with_pipes (NULL,
+                                argv,
+                                NULL,
+                                G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL,
+                                NULL,
+                                NULL,
+                                &pid,
+                                NULL,
+                                &out_fd,
+                                NULL,
+                                &error))
+    {
+      output = g_string_new (NULL);
+      stream = g_unix_input_stream_new (out_fd, TRUE);
+      while ((n_read = g_input_stream_read (stream, buffer, sizeof (buffer),
+                                            cancellable, &error)) > 0)
+        g_string_append_len (output, buffer, n_read);
+      g_object_unref (stream);
+
+      /* The search was given up on, don't wait for an unresponsive host */
+      if (error)
+        {
+          kill (pid, SIGKILL);
+          g_error_free (error);
+        }
+
+      waitpid (pid, &exit_status, 0);
+      g_spawn_close_pid (pid);
+
+      stdout_string = g_string_free (output, FALSE);
+    }
+  else
+    {
+      g_warning ("%s", error->message);
+      g_error_free (error);
+    }
 
   g_free (argv[1]);
   g_free (argv[0]);
@@ -301,8 +341,9 @@ _pp_host_get_snmp_devices_thread (GSimpleAsyncResult *res,
         }
 
       g_strfreev (printer_informations);
-      g_free (stdout_string);
     }
+
+  g_free (stdout_string);
 }
 
 static void
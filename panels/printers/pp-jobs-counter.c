@@ -0,0 +1,315 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <cups/cups.h>
+
+#include "pp-jobs-counter.h"
+
+/* How long to wait for more job notifications of a printer, in ms */
+#define COALESCE_INTERVAL 250
+
+/* Shared by the counter and the worker thread, and kept alive by the
+ * counts on their way to the main context */
+typedef struct
+{
+  volatile gint  ref_count;
+  GAsyncQueue   *queue;
+  GMainContext  *context;
+
+  /* Only touched on the main context, NULL once the counter is freed */
+  PpJobsCounter *counter;
+} Worker;
+
+struct _PpJobsCounter
+{
+  Worker                *worker;
+
+  /* Printers whose jobs changed during the current interval */
+  GHashTable            *pending;
+  guint                  pending_id;
+
+  PpJobsCounterCallback  callback;
+  gpointer               user_data;
+};
+
+typedef struct
+{
+  Worker *worker;
+  gchar  *printer_name;
+  gint    num_jobs;
+} Count;
+
+/* Queued after the last printer name, to stop the worker */
+static gchar worker_stop[] = "";
+
+static Worker *
+worker_ref (Worker *worker)
+{
+  g_atomic_int_inc (&worker->ref_count);
+  return worker;
+}
+
+static void
+worker_unref (Worker *worker)
+{
+  if (!g_atomic_int_dec_and_test (&worker->ref_count))
+    return;
+
+  g_async_queue_unref (worker->queue);
+  g_main_context_unref (worker->context);
+  g_free (worker);
+}
+
+static gboolean
+count_idle_cb (gpointer user_data)
+{
+  Count         *count = (Count *) user_data;
+  PpJobsCounter *counter = count->worker->counter;
+
+  if (counter != NULL)
+    counter->callback (count->printer_name, count->num_jobs, counter->user_data);
+
+  return FALSE;
+}
+
+static void
+count_free (gpointer user_data)
+{
+  Count *count = (Count *) user_data;
+
+  worker_unref (count->worker);
+  g_free (count->printer_name);
+  g_free (count);
+}
+
+static gint
+count_jobs (http_t      **http,
+            const gchar  *printer_name)
+{
+  cups_job_t *jobs;
+  gint        num_jobs = -1;
+  gint        attempt;
+
+  /* The server may have closed the connection since the last count,
+   * in which case it is opened again once */
+  for (attempt = 0; attempt < 2; attempt++)
+    {
+      if (*http == NULL)
+        *http = httpConnectEncrypt (cupsServer (), ippPort (), cupsEncryption ());
+
+      if (*http == NULL)
+        break;
+
+      num_jobs = cupsGetJobs2 (*http, &jobs, printer_name, 1, CUPS_WHICHJOBS_ACTIVE);
+      if (num_jobs > 0)
+        cupsFreeJobs (num_jobs, jobs);
+
+      if (num_jobs >= 0 || cupsLastError () != IPP_SERVICE_UNAVAILABLE)
+        break;
+
+      httpClose (*http);
+      *http = NULL;
+    }
+
+  return num_jobs;
+}
+
+static gboolean
+has_printer (GPtrArray   *printers,
+             const gchar *printer_name)
+{
+  guint i;
+
+  for (i = 0; i < printers->len; i++)
+    if (g_strcmp0 (g_ptr_array_index (printers, i), printer_name) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+static gpointer
+worker_func (gpointer user_data)
+{
+  Worker    *worker = (Worker *) user_data;
+  GPtrArray *printers;
+  GSource   *idle_source;
+  gboolean   stop = FALSE;
+  http_t    *http = NULL;
+  gchar     *printer_name;
+  guint      i;
+
+  printers = g_ptr_array_new_with_free_func (g_free);
+
+  while (!stop)
+    {
+      /* Wait for a printer, then take the ones queued meanwhile too, so
+       * that each of them is counted only once */
+      printer_name = g_async_queue_pop (worker->queue);
+      do
+        {
+          if (printer_name == worker_stop)
+            stop = TRUE;
+          else if (has_printer (printers, printer_name))
+            g_free (printer_name);
+          else
+            g_ptr_array_add (printers, printer_name);
+        }
+      while ((printer_name = g_async_queue_try_pop (worker->queue)) != NULL);
+
+      for (i = 0; i < printers->len && !stop; i++)
+        {
+          Count *count;
+
+          count = g_new0 (Count, 1);
+          count->printer_name = g_strdup (g_ptr_array_index (printers, i));
+          count->num_jobs = count_jobs (&http, count->printer_name);
+          count->worker = worker_ref (worker);
+
+          idle_source = g_idle_source_new ();
+          g_source_set_callback (idle_source, count_idle_cb, count, count_free);
+          g_source_attach (idle_source, worker->context);
+          g_source_unref (idle_source);
+        }
+
+      g_ptr_array_set_size (printers, 0);
+    }
+
+  if (http != NULL)
+    httpClose (http);
+
+  g_ptr_array_free (printers, TRUE);
+  worker_unref (worker);
+
+  return NULL;
+}
+
+static gboolean
+pending_timeout_cb (gpointer user_data)
+{
+  PpJobsCounter  *counter = (PpJobsCounter *) user_data;
+  GHashTableIter  iter;
+  gpointer        printer_name;
+
+  g_hash_table_iter_init (&iter, counter->pending);
+  while (g_hash_table_iter_next (&iter, &printer_name, NULL))
+    {
+      g_hash_table_iter_steal (&iter);
+      g_async_queue_push (counter->worker->queue, printer_name);
+    }
+
+  counter->pending_id = 0;
+
+  return FALSE;
+}
+
+/**
+ * pp_jobs_counter_new:
+ * @callback: called on the thread default main context with each count
+ * @user_data: data for @callback
+ */
+PpJobsCounter *
+pp_jobs_counter_new (PpJobsCounterCallback callback,
+                     gpointer              user_data)
+{
+  PpJobsCounter *counter;
+  GThread       *thread;
+  Worker        *worker;
+
+  worker = g_new0 (Worker, 1);
+  worker->ref_count = 1;
+  worker->queue = g_async_queue_new ();
+  worker->context = g_main_context_ref_thread_default ();
+
+  counter = g_new0 (PpJobsCounter, 1);
+  counter->worker = worker;
+  counter->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  counter->callback = callback;
+  counter->user_data = user_data;
+
+  worker->counter = counter;
+
+  thread = g_thread_new ("jobs-counter", worker_func, worker_ref (worker));
+  g_thread_unref (thread);
+
+  return counter;
+}
+
+/**
+ * pp_jobs_counter_free:
+ * @counter: a #PpJobsCounter
+ *
+ * Stops the worker once it's done with its current count; the counts
+ * which weren't handed back yet are dropped.
+ */
+void
+pp_jobs_counter_free (PpJobsCounter *counter)
+{
+  if (counter == NULL)
+    return;
+
+  if (counter->pending_id != 0)
+    g_source_remove (counter->pending_id);
+  g_hash_table_unref (counter->pending);
+
+  counter->worker->counter = NULL;
+  g_async_queue_push (counter->worker->queue, worker_stop);
+  worker_unref (counter->worker);
+
+  g_free (counter);
+}
+
+/**
+ * pp_jobs_counter_job_changed:
+ * @counter: a #PpJobsCounter
+ * @printer_name: the printer of a job which was created or completed
+ *
+ * Counts the jobs of @printer_name again, after waiting a little for
+ * the printer's other jobs to change too.
+ */
+void
+pp_jobs_counter_job_changed (PpJobsCounter *counter,
+                             const gchar   *printer_name)
+{
+  g_return_if_fail (printer_name != NULL);
+
+  g_hash_table_replace (counter->pending, g_strdup (printer_name), NULL);
+
+  if (counter->pending_id == 0)
+    counter->pending_id = g_timeout_add (COALESCE_INTERVAL, pending_timeout_cb, counter);
+}
+
+/**
+ * pp_jobs_counter_update:
+ * @counter: a #PpJobsCounter
+ * @printer_name: a printer
+ *
+ * Counts the jobs of @printer_name right away.
+ */
+void
+pp_jobs_counter_update (PpJobsCounter *counter,
+                        const gchar   *printer_name)
+{
+  g_return_if_fail (printer_name != NULL);
+
+  g_hash_table_remove (counter->pending, printer_name);
+  g_async_queue_push (counter->worker->queue, g_strdup (printer_name));
+}
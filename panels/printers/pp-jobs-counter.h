@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __PP_JOBS_COUNTER_H__
+#define __PP_JOBS_COUNTER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Counts the active jobs of the user on printers, away from the main
+ * thread.
+ *
+ * The counting is done by a worker thread holding one connection to
+ * the CUPS server for its whole life. The job notifications of a
+ * printer which come within a short interval are merged into a single
+ * count, and only the last count of a printer is handed back to the
+ * main context. */
+
+typedef struct _PpJobsCounter PpJobsCounter;
+
+/* Called on the main context, with -1 as @num_jobs if counting failed */
+typedef void (*PpJobsCounterCallback) (const gchar *printer_name,
+                                       gint         num_jobs,
+                                       gpointer     user_data);
+
+PpJobsCounter *pp_jobs_counter_new         (PpJobsCounterCallback  callback,
+                                            gpointer               user_data);
+void           pp_jobs_counter_free        (PpJobsCounter         *counter);
+
+void           pp_jobs_counter_job_changed (PpJobsCounter         *counter,
+                                            const gchar           *printer_name);
+void           pp_jobs_counter_update      (PpJobsCounter         *counter,
+                                            const gchar           *printer_name);
+
+G_END_DECLS
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <glib.h>
 #include <glib/gi18n.h>
@@ -33,6 +34,7 @@
 #include "pp-new-printer-dialog.h"
 #include "pp-ppd-selection-dialog.h"
 #include "pp-utils.h"
+#include "pp-device-keys.h"
 #include "pp-host.h"
 #include "pp-cups.h"
 #include "pp-samba.h"
@@ -84,10 +86,48 @@ typedef struct
   gboolean  network_device;
   gint      acquisition_method;
   gboolean  show;
+  /* Keys of the device in device_keys */
+  gchar    *uri_key;
+  gchar    *id_key;
+  /* Key in device_hosts, the URI key without the port as
+   * GroupPhysicalDevices returns them */
+  gchar    *host_key;
+  /* Whether the device is in new_devices, waiting to be grouped */
+  gboolean  pending;
 } TDevice;
 
+enum
+{
+  BACKEND_CUPS = 0,
+  BACKEND_REMOTE_CUPS,
+  BACKEND_SNMP,
+  BACKEND_SAMBA_HOST,
+  BACKEND_SAMBA,
+  N_BACKENDS
+};
+
+/* How long the backends may search before their results are given up
+ * on, in seconds */
+static const guint backend_timeouts[N_BACKENDS] =
+{
+  60, /* the CUPS backends are asked one after another */
+  10,
+  10,
+  0,  /* Samba may be waiting for the user to authenticate */
+  0
+};
+
+typedef struct
+{
+  PpNewPrinterDialog *dialog;
+  GCancellable       *cancellable;
+  gboolean            searching;
+  guint               timeout_id;
+} Backend;
+
 static void     t_device_free (gpointer data);
 static TDevice *t_device_copy (TDevice *device);
+static void     backend_stop (Backend *backend);
 
 struct _PpNewPrinterDialogPrivate
 {
@@ -101,11 +141,15 @@ struct _PpNewPrinterDialogPrivate
 
   GCancellable *cancellable;
 
-  gboolean  cups_searching;
-  gboolean  remote_cups_searching;
-  gboolean  snmp_searching;
-  gboolean  samba_host_searching;
-  gboolean  samba_searching;
+  /* The backends search at the same time, each with its own timeout */
+  Backend backends[N_BACKENDS];
+
+  /* Devices of devices and new_devices by their normalized URI and by
+   * their device ID, the lists of them by their URI without port, and
+   * the names taken by them */
+  GHashTable *device_keys;
+  GHashTable *device_hosts;
+  GHashTable *device_names;
 
   GtkCellRenderer *text_renderer;
   GtkCellRenderer *icon_renderer;
@@ -288,6 +332,7 @@ pp_new_printer_dialog_init (PpNewPrinterDialog *dialog)
   GError                    *error = NULL;
   gchar                     *objects[] = { "dialog", NULL };
   guint                      builder_result;
+  gint                       i;
 
   priv = PP_NEW_PRINTER_DIALOG_GET_PRIVATE (dialog);
   dialog->priv = priv;
@@ -307,6 +352,14 @@ pp_new_printer_dialog_init (PpNewPrinterDialog *dialog)
   /* GCancellable for cancelling of async operations */
   priv->cancellable = g_cancellable_new ();
 
+  for (i = 0; i < N_BACKENDS; i++)
+    priv->backends[i].dialog = dialog;
+
+  priv->device_keys = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->device_hosts = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, (GDestroyNotify) g_list_free);
+  priv->device_names = g_hash_table_new (g_str_hash, g_str_equal);
+
   /* Construct dialog */
   priv->dialog = (GtkWidget*) gtk_builder_get_object (priv->builder, "dialog");
 
@@ -341,6 +394,7 @@ pp_new_printer_dialog_finalize (GObject *object)
 {
   PpNewPrinterDialog *dialog = PP_NEW_PRINTER_DIALOG (object);
   PpNewPrinterDialogPrivate *priv = dialog->priv;
+  gint                       i;
 
   priv->text_renderer = NULL;
   priv->icon_renderer = NULL;
@@ -351,6 +405,13 @@ pp_new_printer_dialog_finalize (GObject *object)
       g_clear_object (&priv->cancellable);
     }
 
+  for (i = 0; i < N_BACKENDS; i++)
+    backend_stop (&priv->backends[i]);
+
+  g_clear_pointer (&priv->device_keys, g_hash_table_unref);
+  g_clear_pointer (&priv->device_hosts, g_hash_table_unref);
+  g_clear_pointer (&priv->device_names, g_hash_table_unref);
+
   if (priv->builder)
     g_clear_object (&priv->builder);
 
@@ -395,6 +456,136 @@ device_selection_changed_cb (GtkTreeSelection *selection,
         &iter));
 }
 
+static gint
+get_device_rank (TDevice *device)
+{
+  return pp_device_rank (device->device_id != NULL,
+                         device->network_device,
+                         device->acquisition_method);
+}
+
+static gint
+compare_devices (gconstpointer a,
+                 gconstpointer b)
+{
+  TDevice *device_a = (TDevice *) a;
+  TDevice *device_b = (TDevice *) b;
+  gint     result;
+
+  result = get_device_rank (device_b) - get_device_rank (device_a);
+  if (result == 0)
+    result = g_strcmp0 (device_a->display_name, device_b->display_name);
+
+  return result;
+}
+
+/*
+ * The listed devices which have the URI or the device ID of given
+ * device, there are two when it has the URI of one and the device ID
+ * of another.
+ */
+static gint
+find_duplicates (PpNewPrinterDialog *dialog,
+                 TDevice            *device,
+                 TDevice           **duplicates)
+{
+  PpNewPrinterDialogPrivate *priv = dialog->priv;
+  TDevice                   *duplicate;
+  gint                       n = 0;
+
+  if (device->uri_key &&
+      (duplicate = g_hash_table_lookup (priv->device_keys, device->uri_key)) != NULL)
+    duplicates[n++] = duplicate;
+
+  if (device->id_key &&
+      (duplicate = g_hash_table_lookup (priv->device_keys, device->id_key)) != NULL &&
+      (n == 0 || duplicates[0] != duplicate))
+    duplicates[n++] = duplicate;
+
+  return n;
+}
+
+static void
+register_device (PpNewPrinterDialog *dialog,
+                 TDevice            *device)
+{
+  PpNewPrinterDialogPrivate *priv = dialog->priv;
+  GList                     *list;
+
+  if (device->uri_key)
+    g_hash_table_replace (priv->device_keys, device->uri_key, device);
+
+  if (device->id_key)
+    g_hash_table_replace (priv->device_keys, device->id_key, device);
+
+  if (device->host_key)
+    {
+      list = g_hash_table_lookup (priv->device_hosts, device->host_key);
+      if (list)
+        list = g_list_append (list, device);
+      else
+        g_hash_table_insert (priv->device_hosts,
+                             g_strdup (device->host_key),
+                             g_list_append (NULL, device));
+    }
+
+  if (device->device_name)
+    g_hash_table_add (priv->device_names, device->device_name);
+}
+
+static void
+unregister_device (PpNewPrinterDialog *dialog,
+                   TDevice            *device)
+{
+  PpNewPrinterDialogPrivate *priv = dialog->priv;
+  gpointer                   host_key;
+  gpointer                   list;
+
+  if (device->uri_key &&
+      g_hash_table_lookup (priv->device_keys, device->uri_key) == device)
+    g_hash_table_remove (priv->device_keys, device->uri_key);
+
+  if (device->id_key &&
+      g_hash_table_lookup (priv->device_keys, device->id_key) == device)
+    g_hash_table_remove (priv->device_keys, device->id_key);
+
+  /* The list may start with the device, take it out of the table to
+   * change it */
+  if (device->host_key &&
+      g_hash_table_lookup_extended (priv->device_hosts, device->host_key,
+                                    &host_key, &list))
+    {
+      g_hash_table_steal (priv->device_hosts, host_key);
+      list = g_list_remove (list, device);
+      if (list)
+        g_hash_table_insert (priv->device_hosts, host_key, list);
+      else
+        g_free (host_key);
+    }
+
+  if (device->device_name)
+    g_hash_table_remove (priv->device_names, device->device_name);
+}
+
+/*
+ * Remove given device from devices or new_devices and free it.
+ */
+static void
+remove_device (PpNewPrinterDialog *dialog,
+               TDevice            *device)
+{
+  PpNewPrinterDialogPrivate *priv = dialog->priv;
+
+  unregister_device (dialog, device);
+
+  if (device->pending)
+    priv->new_devices = g_list_remove (priv->new_devices, device);
+  else
+    priv->devices = g_list_remove (priv->devices, device);
+
+  t_device_free (device);
+}
+
 static void
 add_device_to_list (PpNewPrinterDialog *dialog,
                     PpPrintDevice      *device,
@@ -404,13 +595,13 @@ add_device_to_list (PpNewPrinterDialog *dialog,
   gboolean  network_device;
   gboolean  already_present;
   TDevice  *store_device;
-  TDevice  *item;
-  GList    *iter;
+  TDevice  *duplicates[2];
+  TDevice  *best;
   gchar    *name = NULL;
   gchar    *canonized_name = NULL;
   gchar    *new_name;
   gchar    *new_canonized_name = NULL;
-  gint      name_index, j;
+  gint      name_index, n_duplicates, i, j;
 
   if (device)
     {
@@ -440,6 +631,10 @@ add_device_to_list (PpNewPrinterDialog *dialog,
           store_device->network_device = network_device;
           store_device->acquisition_method = device->acquisition_method;
           store_device->show = TRUE;
+          store_device->uri_key = pp_device_uri_key (device->device_uri, TRUE);
+          store_device->id_key = pp_device_id_key (device->device_id);
+          store_device->host_key = pp_device_uri_key (device->device_uri, FALSE);
+          store_device->pending = new_device;
 
           if (device->device_id)
             {
@@ -469,6 +664,39 @@ add_device_to_list (PpNewPrinterDialog *dialog,
               name = g_strdup (device->device_info);
             }
 
+          if (!name &&
+              device->device_uri &&
+              device->device_uri[0] != '\0')
+            {
+              name = g_strdup (device->device_uri);
+            }
+
+          /* Nothing to show the device by */
+          if (!name)
+            {
+              t_device_free (store_device);
+              return;
+            }
+
+          /* Other backends may have found the device already, keep the
+           * one which tells the most about it and remove the others */
+          best = store_device;
+          n_duplicates = find_duplicates (dialog, store_device, duplicates);
+          for (i = 0; i < n_duplicates; i++)
+            if (get_device_rank (duplicates[i]) >= get_device_rank (best))
+              best = duplicates[i];
+
+          for (i = 0; i < n_duplicates; i++)
+            if (duplicates[i] != best)
+              remove_device (dialog, duplicates[i]);
+
+          if (best != store_device)
+            {
+              t_device_free (store_device);
+              g_free (name);
+              return;
+            }
+
           g_strstrip (name);
 
           name_index = 2;
@@ -490,25 +718,11 @@ add_device_to_list (PpNewPrinterDialog *dialog,
                   new_canonized_name = g_strcanon (g_strdup (new_name), ALLOWED_CHARACTERS, '-');
                 }
 
-              already_present = FALSE;
-              for (j = 0; j < priv->num_of_dests; j++)
+              already_present = g_hash_table_contains (priv->device_names, new_canonized_name);
+              for (j = 0; j < priv->num_of_dests && !already_present; j++)
                 if (g_strcmp0 (priv->dests[j].name, new_canonized_name) == 0)
                   already_present = TRUE;
 
-              for (iter = priv->devices; iter; iter = iter->next)
-                {
-                  item = (TDevice *) iter->data;
-                  if (g_strcmp0 (item->device_name, new_canonized_name) == 0)
-                    already_present = TRUE;
-                }
-
-              for (iter = priv->new_devices; iter; iter = iter->next)
-                {
-                  item = (TDevice *) iter->data;
-                  if (g_strcmp0 (item->device_name, new_canonized_name) == 0)
-                    already_present = TRUE;
-                }
-
               if (already_present)
                 {
                   g_free (new_name);
@@ -531,6 +745,8 @@ add_device_to_list (PpNewPrinterDialog *dialog,
             priv->new_devices = g_list_append (priv->new_devices, store_device);
           else
             priv->devices = g_list_append (priv->devices, store_device);
+
+          register_device (dialog, store_device);
         }
     }
 }
@@ -549,21 +765,29 @@ add_devices_to_list (PpNewPrinterDialog  *dialog,
 }
 
 static TDevice *
-device_in_list (gchar *device_uri,
-                GList *device_list)
+device_in_list (PpNewPrinterDialog *dialog,
+                const gchar        *device_uri,
+                gboolean            pending)
 {
-  GList   *iter;
-  TDevice *device;
+  PpNewPrinterDialogPrivate *priv = dialog->priv;
+  TDevice                   *device = NULL;
+  GList                     *iter;
+  gchar                     *key;
 
-  for (iter = device_list; iter; iter = iter->next)
-    {
-      device = (TDevice *) iter->data;
-      /* GroupPhysicalDevices returns uris without port numbers */
-      if (g_str_has_prefix (device->device_uri, device_uri))
-        return device;
-    }
+  /* The URIs from GroupPhysicalDevices have no port, so the queues
+   * on several ports of a host are all looked up by its first one */
+  key = pp_device_uri_key (device_uri, FALSE);
+
+  for (iter = g_hash_table_lookup (priv->device_hosts, key); iter; iter = iter->next)
+    if (((TDevice *) iter->data)->pending == pending)
+      {
+        device = (TDevice *) iter->data;
+        break;
+      }
+
+  g_free (key);
 
-  return NULL;
+  return device;
 }
 
 static void
@@ -582,6 +806,10 @@ t_device_free (gpointer data)
       g_free (device->device_uri);
       g_free (device->device_id);
       g_free (device->device_ppd);
+      g_free (device->host_name);
+      g_free (device->uri_key);
+      g_free (device->id_key);
+      g_free (device->host_key);
       g_free (device);
     }
 }
@@ -609,22 +837,35 @@ t_device_copy (TDevice *device)
       result->network_device = device->network_device;
       result->acquisition_method = device->acquisition_method;
       result->show = device->show;
+      result->uri_key = g_strdup (device->uri_key);
+      result->id_key = g_strdup (device->id_key);
+      result->host_key = g_strdup (device->host_key);
+      result->pending = device->pending;
     }
 
   return result;
 }
 
+static gboolean
+is_searching (PpNewPrinterDialog *dialog)
+{
+  PpNewPrinterDialogPrivate *priv = dialog->priv;
+  gint                       i;
+
+  for (i = 0; i < N_BACKENDS; i++)
+    if (priv->backends[i].searching)
+      return TRUE;
+
+  return FALSE;
+}
+
 static void
 update_spinner_state (PpNewPrinterDialog *dialog)
 {
   PpNewPrinterDialogPrivate *priv = dialog->priv;
   GtkWidget *spinner;
 
-  if (priv->cups_searching ||
-      priv->remote_cups_searching ||
-      priv->snmp_searching ||
-      priv->samba_host_searching ||
-      priv->samba_searching)
+  if (is_searching (dialog))
     {
       spinner = (GtkWidget*)
         gtk_builder_get_object (priv->builder, "spinner");
@@ -640,6 +881,81 @@ update_spinner_state (PpNewPrinterDialog *dialog)
     }
 }
 
+static void
+backend_stop (Backend *backend)
+{
+  if (backend->timeout_id != 0)
+    {
+      g_source_remove (backend->timeout_id);
+      backend->timeout_id = 0;
+    }
+
+  if (backend->cancellable)
+    {
+      g_cancellable_cancel (backend->cancellable);
+      g_clear_object (&backend->cancellable);
+    }
+
+  backend->searching = FALSE;
+}
+
+static void
+backend_finished (PpNewPrinterDialog *dialog,
+                  gint                id)
+{
+  Backend *backend = &dialog->priv->backends[id];
+
+  if (backend->timeout_id != 0)
+    {
+      g_source_remove (backend->timeout_id);
+      backend->timeout_id = 0;
+    }
+
+  g_clear_object (&backend->cancellable);
+  backend->searching = FALSE;
+
+  update_spinner_state (dialog);
+}
+
+static gboolean
+backend_timeout_cb (gpointer user_data)
+{
+  Backend *backend = (Backend *) user_data;
+
+  backend->timeout_id = 0;
+  backend_stop (backend);
+
+  /* Show what the other backends found without waiting for this one */
+  actualize_devices_list (backend->dialog);
+
+  return FALSE;
+}
+
+/*
+ * Start a search of given backend, cancelling
+ * the one it may be doing already.
+ */
+static GCancellable *
+backend_start (PpNewPrinterDialog *dialog,
+               gint                id)
+{
+  Backend *backend = &dialog->priv->backends[id];
+
+  backend_stop (backend);
+
+  backend->cancellable = g_cancellable_new ();
+  backend->searching = TRUE;
+
+  if (backend_timeouts[id] > 0)
+    backend->timeout_id = g_timeout_add_seconds (backend_timeouts[id],
+                                                  backend_timeout_cb,
+                                                  backend);
+
+  update_spinner_state (dialog);
+
+  return backend->cancellable;
+}
+
 static void
 group_physical_devices_cb (gchar    ***device_uris,
                            gpointer    user_data)
@@ -647,6 +963,7 @@ group_physical_devices_cb (gchar    ***device_uris,
   PpNewPrinterDialog        *dialog = (PpNewPrinterDialog *) user_data;
   PpNewPrinterDialogPrivate *priv = dialog->priv;
   TDevice                   *device, *tmp;
+  GList                     *iter;
   gint                       i, j;
 
   if (device_uris)
@@ -657,7 +974,7 @@ group_physical_devices_cb (gchar    ***device_uris,
             {
               for (j = 0; device_uris[i][j]; j++)
                 {
-                  device = device_in_list (device_uris[i][j], priv->devices);
+                  device = device_in_list (dialog, device_uris[i][j], FALSE);
                   if (device)
                     break;
                 }
@@ -666,29 +983,27 @@ group_physical_devices_cb (gchar    ***device_uris,
                 {
                   for (j = 0; device_uris[i][j]; j++)
                     {
-                      tmp = device_in_list (device_uris[i][j], priv->new_devices);
+                      tmp = device_in_list (dialog, device_uris[i][j], TRUE);
                       if (tmp)
-                        {
-                          priv->new_devices = g_list_remove (priv->new_devices, tmp);
-                          t_device_free (tmp);
-                        }
+                        remove_device (dialog, tmp);
                     }
                 }
               else
                 {
                   for (j = 0; device_uris[i][j]; j++)
                     {
-                      tmp = device_in_list (device_uris[i][j], priv->new_devices);
+                      tmp = device_in_list (dialog, device_uris[i][j], TRUE);
                       if (tmp)
                         {
-                          priv->new_devices = g_list_remove (priv->new_devices, tmp);
                           if (j == 0)
                             {
+                              priv->new_devices = g_list_remove (priv->new_devices, tmp);
                               priv->devices = g_list_append (priv->devices, tmp);
+                              tmp->pending = FALSE;
                             }
                           else
                             {
-                              t_device_free (tmp);
+                              remove_device (dialog, tmp);
                             }
                         }
                     }
@@ -710,6 +1025,9 @@ group_physical_devices_cb (gchar    ***device_uris,
     }
   else
     {
+      for (iter = priv->new_devices; iter; iter = iter->next)
+        ((TDevice *) iter->data)->pending = FALSE;
+
       priv->devices = g_list_concat (priv->devices, priv->new_devices);
       priv->new_devices = NULL;
     }
@@ -822,9 +1140,7 @@ get_cups_devices_cb (GList    *devices,
       priv = dialog->priv;
 
       if (finished)
-        {
-          priv->cups_searching = FALSE;
-        }
+        backend_finished (dialog, BACKEND_CUPS);
 
       if (devices)
         {
@@ -972,8 +1288,7 @@ get_snmp_devices_cb (GObject      *source_object,
       dialog = PP_NEW_PRINTER_DIALOG (user_data);
       priv = dialog->priv;
 
-      priv->snmp_searching = FALSE;
-      update_spinner_state (dialog);
+      backend_finished (dialog, BACKEND_SNMP);
 
       if (result->devices)
         {
@@ -999,8 +1314,7 @@ get_snmp_devices_cb (GObject      *source_object,
 
           g_warning ("%s", error->message);
 
-          priv->snmp_searching = FALSE;
-          update_spinner_state (dialog);
+          backend_finished (dialog, BACKEND_SNMP);
         }
 
       g_error_free (error);
@@ -1027,8 +1341,7 @@ get_remote_cups_devices_cb (GObject      *source_object,
       dialog = PP_NEW_PRINTER_DIALOG (user_data);
       priv = dialog->priv;
 
-      priv->remote_cups_searching = FALSE;
-      update_spinner_state (dialog);
+      backend_finished (dialog, BACKEND_REMOTE_CUPS);
 
       if (result->devices)
         {
@@ -1054,8 +1367,7 @@ get_remote_cups_devices_cb (GObject      *source_object,
 
           g_warning ("%s", error->message);
 
-          priv->remote_cups_searching = FALSE;
-          update_spinner_state (dialog);
+          backend_finished (dialog, BACKEND_REMOTE_CUPS);
         }
 
       g_error_free (error);
@@ -1082,8 +1394,7 @@ get_samba_host_devices_cb (GObject      *source_object,
       dialog = PP_NEW_PRINTER_DIALOG (user_data);
       priv = dialog->priv;
 
-      priv->samba_host_searching = FALSE;
-      update_spinner_state (dialog);
+      backend_finished (dialog, BACKEND_SAMBA_HOST);
 
       if (result->devices)
         {
@@ -1109,8 +1420,7 @@ get_samba_host_devices_cb (GObject      *source_object,
 
           g_warning ("%s", error->message);
 
-          priv->samba_host_searching = FALSE;
-          update_spinner_state (dialog);
+          backend_finished (dialog, BACKEND_SAMBA_HOST);
         }
 
       g_error_free (error);
@@ -1137,8 +1447,7 @@ get_samba_devices_cb (GObject      *source_object,
       dialog = PP_NEW_PRINTER_DIALOG (user_data);
       priv = dialog->priv;
 
-      priv->samba_searching = FALSE;
-      update_spinner_state (dialog);
+      backend_finished (dialog, BACKEND_SAMBA);
 
       if (result->devices)
         {
@@ -1164,8 +1473,7 @@ get_samba_devices_cb (GObject      *source_object,
 
           g_warning ("%s", error->message);
 
-          priv->samba_searching = FALSE;
-          update_spinner_state (dialog);
+          backend_finished (dialog, BACKEND_SAMBA);
         }
 
       g_error_free (error);
@@ -1175,12 +1483,7 @@ get_samba_devices_cb (GObject      *source_object,
 static void
 get_cups_devices (PpNewPrinterDialog *dialog)
 {
-  PpNewPrinterDialogPrivate *priv = dialog->priv;
-
-  priv->cups_searching = TRUE;
-  update_spinner_state (dialog);
-
-  get_cups_devices_async (priv->cancellable,
+  get_cups_devices_async (backend_start (dialog, BACKEND_CUPS),
                           get_cups_devices_cb,
                           dialog);
 }
@@ -1238,7 +1541,7 @@ search_address_cb (GtkEntry *entry,
   gboolean             found = FALSE;
   gboolean             subfound;
   TDevice             *device;
-  GList               *iter, *tmp;
+  GList               *iter;
   gchar               *text;
   gchar               *lowercase_name;
   gchar               *lowercase_location;
@@ -1299,36 +1602,24 @@ search_address_cb (GtkEntry *entry,
         {
           device = iter->data;
           device->show = TRUE;
+          iter = iter->next;
 
           if (device->acquisition_method == ACQUISITION_METHOD_REMOTE_CUPS_SERVER ||
               device->acquisition_method == ACQUISITION_METHOD_SNMP ||
               device->acquisition_method == ACQUISITION_METHOD_SAMBA_HOST)
-            {
-              tmp = iter;
-              iter = iter->next;
-              priv->devices = g_list_remove_link (priv->devices, tmp);
-              g_list_free_full (tmp, t_device_free);
-            }
-          else
-            iter = iter->next;
+            remove_device (dialog, device);
         }
 
       iter = priv->new_devices;
       while (iter)
         {
           device = iter->data;
+          iter = iter->next;
 
           if (device->acquisition_method == ACQUISITION_METHOD_REMOTE_CUPS_SERVER ||
               device->acquisition_method == ACQUISITION_METHOD_SNMP ||
               device->acquisition_method == ACQUISITION_METHOD_SAMBA_HOST)
-            {
-              tmp = iter;
-              iter = iter->next;
-              priv->new_devices = g_list_remove_link (priv->new_devices, tmp);
-              g_list_free_full (tmp, t_device_free);
-            }
-          else
-            iter = iter->next;
+            remove_device (dialog, device);
         }
 
       if (text && text[0] != '\0')
@@ -1349,23 +1640,20 @@ search_address_cb (GtkEntry *entry,
               samba_host = pp_samba_new (GTK_WINDOW (priv->dialog),
                                          host);
 
-              priv->remote_cups_searching = TRUE;
-              priv->snmp_searching = TRUE;
-              priv->samba_host_searching = TRUE;
-              update_spinner_state (dialog);
-
+              /* The backends search the host at the same time and
+               * a search of another host replaces this one */
               pp_host_get_remote_cups_devices_async (snmp_host,
-                                                     priv->cancellable,
+                                                     backend_start (dialog, BACKEND_REMOTE_CUPS),
                                                      get_remote_cups_devices_cb,
                                                      dialog);
 
               pp_host_get_snmp_devices_async (remote_cups_host,
-                                              priv->cancellable,
+                                              backend_start (dialog, BACKEND_SNMP),
                                               get_snmp_devices_cb,
                                               dialog);
 
               pp_samba_get_devices_async (samba_host,
-                                          priv->cancellable,
+                                          backend_start (dialog, BACKEND_SAMBA_HOST),
                                           get_samba_host_devices_cb,
                                           dialog);
 
@@ -1400,6 +1688,7 @@ actualize_devices_list (PpNewPrinterDialog *dialog)
   gboolean           no_device = TRUE;
   TDevice           *device;
   gfloat             yalign;
+  GList             *devices;
   GList             *item;
   gchar             *display_string;
 
@@ -1408,7 +1697,10 @@ actualize_devices_list (PpNewPrinterDialog *dialog)
 
   store = gtk_list_store_new (3, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
 
-  for (item = priv->devices; item; item = item->next)
+  /* Best devices first */
+  devices = g_list_sort (g_list_copy (priv->devices), compare_devices);
+
+  for (item = devices; item; item = item->next)
     {
       device = (TDevice *) item->data;
 
@@ -1441,16 +1733,13 @@ actualize_devices_list (PpNewPrinterDialog *dialog)
         }
     }
 
+  g_list_free (devices);
+
   column = gtk_tree_view_get_column (treeview, 0);
   if (priv->text_renderer)
     gtk_cell_renderer_get_alignment (priv->text_renderer, NULL, &yalign);
 
-  if (no_device &&
-      !priv->cups_searching &&
-      !priv->remote_cups_searching &&
-      !priv->snmp_searching &&
-      !priv->samba_host_searching &&
-      !priv->samba_searching)
+  if (no_device && !is_searching (dialog))
     {
       if (priv->text_renderer)
         gtk_cell_renderer_set_alignment (priv->text_renderer, 0.5, yalign);
@@ -1567,11 +1856,11 @@ populate_devices_list (PpNewPrinterDialog *dialog)
   cups = pp_cups_new ();
   pp_cups_get_dests_async (cups, priv->cancellable, cups_get_dests_cb, dialog);
 
-  priv->samba_searching = TRUE;
-  update_spinner_state (dialog);
-
   samba = pp_samba_new (GTK_WINDOW (priv->dialog), NULL);
-  pp_samba_get_devices_async (samba, priv->cancellable, get_samba_devices_cb, dialog);
+  pp_samba_get_devices_async (samba,
+                              backend_start (dialog, BACKEND_SAMBA),
+                              get_samba_devices_cb,
+                              dialog);
 }
 
 static void
@@ -1681,6 +1970,7 @@ new_printer_dialog_response_cb (GtkDialog *_dialog,
   TDevice                   *tmp;
   GList                     *list_iter;
   gchar                     *device_name = NULL;
+  gint                       i;
 
   gtk_widget_hide (GTK_WIDGET (_dialog));
 
@@ -1689,6 +1979,9 @@ new_printer_dialog_response_cb (GtkDialog *_dialog,
       g_cancellable_cancel (priv->cancellable);
       g_clear_object (&priv->cancellable);
 
+      for (i = 0; i < N_BACKENDS; i++)
+        backend_stop (&priv->backends[i]);
+
       treeview = (GtkWidget*)
         gtk_builder_get_object (priv->builder, "devices-treeview");
 
@@ -1724,6 +2017,7 @@ new_printer_dialog_response_cb (GtkDialog *_dialog,
                 pp_ppd_selection_dialog_new (priv->parent,
                                              priv->list,
                                              NULL,
+                                             NULL,
                                              ppd_selection_cb,
                                              dialog);
             }
@@ -0,0 +1,878 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <cups/cups.h>
+
+#include "pp-ppd-catalog.h"
+#include "cc-mapped-cache.h"
+
+#define PPD_CATALOG_MAGIC "PPDCAT03"
+
+/* Driver data can change in ways the modification times of the
+ * directories don't show, such as a file edited in place, so the
+ * catalog is fetched again once a day anyway */
+#define PPD_CATALOG_MAX_AGE (24 * 60 * 60)
+
+/* How deep the directories are looked into for sources */
+#define MAX_SOURCE_DEPTH 3
+
+typedef struct
+{
+  gchar   magic[8];
+  gint64  created;
+  guint32 key;
+  guint32 n_sources;
+  guint32 sources_offset;
+  guint32 n_manufacturers;
+  guint32 manufacturers_offset;
+  guint32 n_ppds;
+  guint32 ppds_offset;
+  guint32 n_device_ids;
+  guint32 device_ids_offset;
+  guint32 strings_offset;
+  guint32 strings_size;
+  guint32 padding;
+} CatalogHeader;
+
+typedef struct
+{
+  gint64  mtime;
+  guint32 path;
+  guint32 padding;
+} CatalogSource;
+
+/* The PPDs of a manufacturer follow each other */
+typedef struct
+{
+  guint32 name;
+  guint32 display_name;
+  guint32 first_ppd;
+  guint32 n_ppds;
+} CatalogManufacturer;
+
+typedef struct
+{
+  guint32 name;
+  guint32 display_name;
+  guint32 manufacturer;
+  guint32 model_key;
+  guint32 device_id;
+  guint32 device_key;
+} CatalogPPD;
+
+struct _PpPPDCatalog
+{
+  GBytes                    *bytes;
+  const CatalogHeader       *header;
+  const CatalogSource       *sources;
+  const CatalogManufacturer *manufacturers;
+  const CatalogPPD          *ppds;
+  /* The PPDs which have a device ID, sorted by its key */
+  const guint32             *device_ids;
+  const gchar               *strings;
+};
+
+struct _PpPPDCatalogSources
+{
+  GPtrArray *paths;
+  GArray    *mtimes;
+  gint64     time;
+};
+
+/* Where cups-driverd looks for PPDs and driver programs, and the
+ * database foomatic builds its PPDs from */
+static const gchar * const ppd_directories[] = {
+  "/usr/share/cups/model",
+  "/usr/share/cups/drv",
+  "/usr/share/ppd",
+  "/usr/share/model",
+  "/usr/local/share/ppd",
+  "/opt/share/ppd",
+  "/usr/lib/cups/driver",
+  "/usr/share/foomatic",
+};
+
+static gint64
+get_mtime (const gchar *path)
+{
+  GStatBuf buf;
+
+  if (g_stat (path, &buf) != 0)
+    return 0;
+
+  return buf.st_mtime;
+}
+
+/*
+ * The directory and its subdirectories, which is where the packages
+ * of drivers put their files. Replacing or removing a file changes the
+ * modification time of its directory.
+ */
+static void
+add_sources (GPtrArray   *sources,
+             const gchar *path,
+             gint         depth)
+{
+  const gchar *name;
+  gchar       *child;
+  GDir        *dir;
+
+  g_ptr_array_add (sources, g_strdup (path));
+
+  if (depth >= MAX_SOURCE_DEPTH)
+    return;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      child = g_build_filename (path, name, NULL);
+      if (g_file_test (child, G_FILE_TEST_IS_DIR) &&
+          !g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+        add_sources (sources, child, depth + 1);
+      g_free (child);
+    }
+
+  g_dir_close (dir);
+}
+
+/**
+ * pp_ppd_catalog_sources_new:
+ *
+ * Takes the modification times of the directories the PPDs come from.
+ * This must be done before asking the server for its PPDs, so that a
+ * driver installed meanwhile invalidates the catalog.
+ *
+ * Returns: the sources, to be passed to pp_ppd_catalog_new()
+ */
+PpPPDCatalogSources *
+pp_ppd_catalog_sources_new (void)
+{
+  PpPPDCatalogSources *sources;
+  gint64               mtime;
+  gint                 i;
+
+  sources = g_new0 (PpPPDCatalogSources, 1);
+  sources->paths = g_ptr_array_new_with_free_func (g_free);
+  sources->time = g_get_real_time () / G_USEC_PER_SEC;
+
+  for (i = 0; i < G_N_ELEMENTS (ppd_directories); i++)
+    add_sources (sources->paths, ppd_directories[i], 0);
+
+  sources->mtimes = g_array_sized_new (FALSE, FALSE, sizeof (gint64), sources->paths->len);
+  for (i = 0; i < sources->paths->len; i++)
+    {
+      mtime = get_mtime (g_ptr_array_index (sources->paths, i));
+      g_array_append_val (sources->mtimes, mtime);
+    }
+
+  return sources;
+}
+
+void
+pp_ppd_catalog_sources_free (PpPPDCatalogSources *sources)
+{
+  if (sources == NULL)
+    return;
+
+  g_ptr_array_free (sources->paths, TRUE);
+  g_array_free (sources->mtimes, TRUE);
+  g_free (sources);
+}
+
+/*
+ * The catalog of a remote server can't be told out of date.
+ */
+static gboolean
+is_local_server (const gchar *server)
+{
+  return server[0] == '/' ||
+         g_ascii_strcasecmp (server, "localhost") == 0 ||
+         g_ascii_strncasecmp (server, "localhost:", strlen ("localhost:")) == 0;
+}
+
+static gchar *
+get_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "gnome-control-center", "ppd-catalog", NULL);
+}
+
+/*
+ * Keeps only the letters and digits, lowercased, so that
+ * "LaserJet 4050" is found by "laserjet 40".
+ */
+static gchar *
+make_key (const gchar *str)
+{
+  GString *key;
+  gint     i;
+
+  if (str == NULL)
+    return NULL;
+
+  key = g_string_sized_new (strlen (str));
+  for (i = 0; str[i] != '\0'; i++)
+    {
+      if (g_ascii_isalnum (str[i]))
+        g_string_append_c (key, g_ascii_tolower (str[i]));
+      else if ((guchar) str[i] >= 0x80)
+        g_string_append_c (key, str[i]);
+    }
+
+  return g_string_free (key, FALSE);
+}
+
+static gchar *
+make_device_key (const gchar *device_id)
+{
+  gchar *mfg;
+  gchar *mdl;
+  gchar *mfg_key;
+  gchar *mdl_key;
+  gchar *result = NULL;
+
+  if (device_id == NULL || device_id[0] == '\0')
+    return NULL;
+
+  mfg = get_tag_value (device_id, "mfg");
+  if (!mfg)
+    mfg = get_tag_value (device_id, "manufacturer");
+
+  mdl = get_tag_value (device_id, "mdl");
+  if (!mdl)
+    mdl = get_tag_value (device_id, "model");
+
+  if (mfg && mdl)
+    {
+      mfg_key = make_key (mfg);
+      mdl_key = make_key (mdl);
+      result = g_strdup_printf ("%s;%s", mfg_key, mdl_key);
+      g_free (mfg_key);
+      g_free (mdl_key);
+    }
+
+  g_free (mfg);
+  g_free (mdl);
+
+  return result;
+}
+
+static gboolean
+check_string (PpPPDCatalog *catalog,
+              guint32       offset)
+{
+  return cc_mapped_cache_check_string (catalog->header->strings_size, offset);
+}
+
+static gboolean
+check_records (PpPPDCatalog *catalog)
+{
+  const CatalogHeader *header = catalog->header;
+  gint                 i;
+
+  if (!check_string (catalog, header->key))
+    return FALSE;
+
+  for (i = 0; i < header->n_sources; i++)
+    {
+      if (!check_string (catalog, catalog->sources[i].path))
+        return FALSE;
+    }
+
+  for (i = 0; i < header->n_manufacturers; i++)
+    {
+      const CatalogManufacturer *manufacturer = &catalog->manufacturers[i];
+
+      if (!check_string (catalog, manufacturer->name) ||
+          !check_string (catalog, manufacturer->display_name) ||
+          manufacturer->first_ppd > header->n_ppds ||
+          manufacturer->n_ppds > header->n_ppds - manufacturer->first_ppd)
+        return FALSE;
+    }
+
+  for (i = 0; i < header->n_ppds; i++)
+    {
+      const CatalogPPD *ppd = &catalog->ppds[i];
+
+      if (!check_string (catalog, ppd->name) ||
+          !check_string (catalog, ppd->display_name) ||
+          ppd->manufacturer >= header->n_manufacturers ||
+          !check_string (catalog, ppd->model_key) ||
+          !check_string (catalog, ppd->device_id) ||
+          !check_string (catalog, ppd->device_key))
+        return FALSE;
+    }
+
+  for (i = 0; i < header->n_device_ids; i++)
+    {
+      if (catalog->device_ids[i] >= header->n_ppds)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Takes @bytes.
+ */
+static PpPPDCatalog *
+catalog_open (GBytes  *bytes,
+              GError **error)
+{
+  const CatalogHeader *header;
+  PpPPDCatalog        *catalog;
+  const gchar         *contents;
+  gsize                length;
+
+  contents = g_bytes_get_data (bytes, &length);
+  header = (const CatalogHeader *) contents;
+
+  if (!cc_mapped_cache_check_magic (contents, length, sizeof (CatalogHeader),
+                                    PPD_CATALOG_MAGIC) ||
+      !cc_mapped_cache_check_array (length, header->sources_offset, header->n_sources,
+                                    sizeof (CatalogSource), sizeof (gint64)) ||
+      !cc_mapped_cache_check_array (length, header->manufacturers_offset, header->n_manufacturers,
+                                    sizeof (CatalogManufacturer), sizeof (guint32)) ||
+      !cc_mapped_cache_check_array (length, header->ppds_offset, header->n_ppds,
+                                    sizeof (CatalogPPD), sizeof (guint32)) ||
+      !cc_mapped_cache_check_array (length, header->device_ids_offset, header->n_device_ids,
+                                    sizeof (guint32), sizeof (guint32)) ||
+      !cc_mapped_cache_check_strings (contents, length,
+                                      header->strings_offset, header->strings_size))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Invalid PPD catalog");
+      g_bytes_unref (bytes);
+      return NULL;
+    }
+
+  catalog = g_new0 (PpPPDCatalog, 1);
+  catalog->bytes = bytes;
+  catalog->header = header;
+  catalog->sources = (const CatalogSource *) (contents + header->sources_offset);
+  catalog->manufacturers = (const CatalogManufacturer *) (contents + header->manufacturers_offset);
+  catalog->ppds = (const CatalogPPD *) (contents + header->ppds_offset);
+  catalog->device_ids = (const guint32 *) (contents + header->device_ids_offset);
+  catalog->strings = contents + header->strings_offset;
+
+  if (!check_records (catalog))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Invalid PPD catalog");
+      pp_ppd_catalog_free (catalog);
+      return NULL;
+    }
+
+  return catalog;
+}
+
+static gint
+compare_entries (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  const PpPPDCatalogEntry *entries = user_data;
+  guint                    index_a = *(const guint *) a;
+  guint                    index_b = *(const guint *) b;
+  gint                     result;
+
+  result = strcmp (entries[index_a].manufacturer_name,
+                   entries[index_b].manufacturer_name);
+  if (result != 0)
+    return result;
+
+  /* Keep the order of the server within a manufacturer */
+  return index_a < index_b ? -1 : index_a > index_b;
+}
+
+static gint
+compare_device_ids (gconstpointer a,
+                    gconstpointer b,
+                    gpointer      user_data)
+{
+  gpointer   *sort_data = user_data;
+  CatalogPPD *ppds = sort_data[0];
+  GString    *strings = sort_data[1];
+  guint32     index_a = *(const guint32 *) a;
+  guint32     index_b = *(const guint32 *) b;
+  gint        result;
+
+  result = strcmp (strings->str + ppds[index_a].device_key,
+                   strings->str + ppds[index_b].device_key);
+  if (result != 0)
+    return result;
+
+  return index_a < index_b ? -1 : index_a > index_b;
+}
+
+/**
+ * pp_ppd_catalog_new:
+ * @sources: the sources, as they were before the PPDs were asked for
+ * @entries: the PPDs, in the order of the server
+ * @n_entries: the number of PPDs
+ *
+ * Returns: a catalog of the PPDs, which can be saved as the one of the
+ * current CUPS server
+ */
+PpPPDCatalog *
+pp_ppd_catalog_new (const PpPPDCatalogSources *sources,
+                    const PpPPDCatalogEntry   *entries,
+                    guint                      n_entries)
+{
+  CatalogManufacturer  manufacturer;
+  CatalogHeader        header;
+  CatalogSource        source;
+  CatalogPPD           ppd;
+  CcStringPool         pool;
+  PpPPDCatalog        *catalog;
+  GString             *output;
+  GArray              *source_array;
+  GArray              *manufacturers;
+  GArray              *ppds;
+  GArray              *device_ids;
+  gpointer             sort_data[2];
+  guint               *order;
+  gchar               *key;
+  guint32              index;
+  gint                 i;
+
+  source_array = g_array_new (FALSE, TRUE, sizeof (CatalogSource));
+  manufacturers = g_array_new (FALSE, TRUE, sizeof (CatalogManufacturer));
+  ppds = g_array_sized_new (FALSE, TRUE, sizeof (CatalogPPD), n_entries);
+  device_ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+  cc_string_pool_init (&pool);
+
+  for (i = 0; i < sources->paths->len; i++)
+    {
+      memset (&source, 0, sizeof (source));
+      source.path = cc_string_pool_add (&pool, g_ptr_array_index (sources->paths, i));
+      source.mtime = g_array_index (sources->mtimes, gint64, i);
+      g_array_append_val (source_array, source);
+    }
+
+  order = g_new (guint, n_entries);
+  for (i = 0; i < n_entries; i++)
+    order[i] = i;
+  g_qsort_with_data (order, n_entries, sizeof (guint), compare_entries, (gpointer) entries);
+
+  for (i = 0; i < n_entries; i++)
+    {
+      const PpPPDCatalogEntry *entry = &entries[order[i]];
+
+      if (manufacturers->len == 0 ||
+          strcmp (pool.strings->str + g_array_index (manufacturers, CatalogManufacturer,
+                                                     manufacturers->len - 1).name,
+                  entry->manufacturer_name) != 0)
+        {
+          manufacturer.name = cc_string_pool_add (&pool, entry->manufacturer_name);
+          manufacturer.display_name = cc_string_pool_add (&pool, entry->manufacturer_display_name);
+          manufacturer.first_ppd = i;
+          manufacturer.n_ppds = 0;
+          g_array_append_val (manufacturers, manufacturer);
+        }
+
+      g_array_index (manufacturers, CatalogManufacturer, manufacturers->len - 1).n_ppds++;
+
+      ppd.name = cc_string_pool_add (&pool, entry->ppd_name);
+      ppd.display_name = cc_string_pool_add (&pool, entry->ppd_display_name);
+      ppd.manufacturer = manufacturers->len - 1;
+
+      key = make_key (entry->ppd_display_name);
+      ppd.model_key = cc_string_pool_add (&pool, key);
+      g_free (key);
+
+      ppd.device_id = cc_string_pool_add (&pool, entry->device_id);
+      key = make_device_key (entry->device_id);
+      ppd.device_key = cc_string_pool_add (&pool, key);
+      g_free (key);
+
+      g_array_append_val (ppds, ppd);
+
+      if (ppd.device_key != 0)
+        {
+          index = i;
+          g_array_append_val (device_ids, index);
+        }
+    }
+
+  sort_data[0] = ppds->data;
+  sort_data[1] = pool.strings;
+  g_qsort_with_data (device_ids->data, device_ids->len, sizeof (guint32),
+                     compare_device_ids, sort_data);
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, PPD_CATALOG_MAGIC, sizeof (header.magic));
+  header.created = sources->time;
+  header.key = cc_string_pool_add (&pool, cupsServer ());
+  header.n_sources = source_array->len;
+  header.sources_offset = sizeof (header);
+  header.n_manufacturers = manufacturers->len;
+  header.manufacturers_offset = header.sources_offset + source_array->len * sizeof (CatalogSource);
+  header.n_ppds = ppds->len;
+  header.ppds_offset = header.manufacturers_offset + manufacturers->len * sizeof (CatalogManufacturer);
+  header.n_device_ids = device_ids->len;
+  header.device_ids_offset = header.ppds_offset + ppds->len * sizeof (CatalogPPD);
+  header.strings_offset = header.device_ids_offset + device_ids->len * sizeof (guint32);
+  header.strings_size = pool.strings->len;
+
+  output = g_string_new_len ((const gchar *) &header, sizeof (header));
+  g_string_append_len (output, source_array->data, source_array->len * sizeof (CatalogSource));
+  g_string_append_len (output, manufacturers->data, manufacturers->len * sizeof (CatalogManufacturer));
+  g_string_append_len (output, ppds->data, ppds->len * sizeof (CatalogPPD));
+  g_string_append_len (output, device_ids->data, device_ids->len * sizeof (guint32));
+  g_string_append_len (output, pool.strings->str, pool.strings->len);
+
+  catalog = catalog_open (g_bytes_new_take (output->str, output->len), NULL);
+  g_string_free (output, FALSE);
+
+  g_free (order);
+  cc_string_pool_clear (&pool);
+  g_array_free (device_ids, TRUE);
+  g_array_free (ppds, TRUE);
+  g_array_free (manufacturers, TRUE);
+  g_array_free (source_array, TRUE);
+
+  return catalog;
+}
+
+/**
+ * pp_ppd_catalog_load:
+ * @error: return location for a #GError
+ *
+ * Returns: the cached catalog of the current CUPS server, or %NULL if
+ * there is none or it is out of date
+ */
+PpPPDCatalog *
+pp_ppd_catalog_load (GError **error)
+{
+  PpPPDCatalog *catalog;
+  GMappedFile  *file;
+  const gchar  *server;
+  gchar        *path;
+  gint64        now;
+  gint          i;
+
+  server = cupsServer ();
+  if (!is_local_server (server))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                   "No PPD catalog is kept for %s", server);
+      return NULL;
+    }
+
+  path = get_cache_path ();
+  file = g_mapped_file_new (path, FALSE, error);
+  g_free (path);
+
+  if (file == NULL)
+    return NULL;
+
+  catalog = catalog_open (g_mapped_file_get_bytes (file), error);
+  g_mapped_file_unref (file);
+
+  if (catalog == NULL)
+    return NULL;
+
+  if (strcmp (catalog->strings + catalog->header->key, server) != 0)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "The PPD catalog is the one of another server");
+      pp_ppd_catalog_free (catalog);
+      return NULL;
+    }
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  if (catalog->header->created > now ||
+      now - catalog->header->created > PPD_CATALOG_MAX_AGE)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "The PPD catalog is too old");
+      pp_ppd_catalog_free (catalog);
+      return NULL;
+    }
+
+  for (i = 0; i < catalog->header->n_sources; i++)
+    {
+      const CatalogSource *source = &catalog->sources[i];
+
+      if (get_mtime (catalog->strings + source->path) != source->mtime)
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                       "The PPD catalog is out of date");
+          pp_ppd_catalog_free (catalog);
+          return NULL;
+        }
+    }
+
+  return catalog;
+}
+
+/**
+ * pp_ppd_catalog_save:
+ * @catalog: a #PpPPDCatalog
+ * @error: return location for a #GError
+ *
+ * Atomically replaces the cached catalog. The catalog of a remote
+ * server is not saved.
+ */
+gboolean
+pp_ppd_catalog_save (PpPPDCatalog  *catalog,
+                     GError       **error)
+{
+  gconstpointer  data;
+  gboolean       result;
+  gchar         *path;
+  gchar         *dir;
+  gsize          length;
+
+  if (!is_local_server (catalog->strings + catalog->header->key))
+    return TRUE;
+
+  path = get_cache_path ();
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  data = g_bytes_get_data (catalog->bytes, &length);
+  result = g_file_set_contents (path, data, length, error);
+  g_free (path);
+
+  return result;
+}
+
+void
+pp_ppd_catalog_free (PpPPDCatalog *catalog)
+{
+  if (catalog == NULL)
+    return;
+
+  g_bytes_unref (catalog->bytes);
+  g_free (catalog);
+}
+
+guint
+pp_ppd_catalog_get_n_ppds (PpPPDCatalog *catalog)
+{
+  return catalog->header->n_ppds;
+}
+
+/**
+ * pp_ppd_catalog_get_ppd:
+ * @catalog: a #PpPPDCatalog
+ * @index: the index of the PPD
+ * @out: (out caller-allocates): the PPD, with strings owned by @catalog
+ */
+void
+pp_ppd_catalog_get_ppd (PpPPDCatalog      *catalog,
+                        guint              index,
+                        PpPPDCatalogEntry *out)
+{
+  const CatalogManufacturer *manufacturer;
+  const CatalogPPD          *ppd;
+
+  g_return_if_fail (index < catalog->header->n_ppds);
+
+  ppd = &catalog->ppds[index];
+  manufacturer = &catalog->manufacturers[ppd->manufacturer];
+
+  out->ppd_name = catalog->strings + ppd->name;
+  out->ppd_display_name = catalog->strings + ppd->display_name;
+  out->manufacturer_name = catalog->strings + manufacturer->name;
+  out->manufacturer_display_name = catalog->strings + manufacturer->display_name;
+  out->device_id = ppd->device_id != 0 ? catalog->strings + ppd->device_id : NULL;
+}
+
+static const CatalogManufacturer *
+find_manufacturer (PpPPDCatalog *catalog,
+                   const gchar  *manufacturer_name)
+{
+  guint32 low = 0;
+  guint32 high = catalog->header->n_manufacturers;
+  guint32 middle;
+  gint    result;
+
+  while (low < high)
+    {
+      middle = low + (high - low) / 2;
+      result = strcmp (catalog->strings + catalog->manufacturers[middle].name,
+                       manufacturer_name);
+
+      if (result == 0)
+        return &catalog->manufacturers[middle];
+      else if (result < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return NULL;
+}
+
+/**
+ * pp_ppd_catalog_search:
+ * @catalog: a #PpPPDCatalog
+ * @manufacturer_name: (allow-none): the normalized name of a manufacturer
+ * @model: (allow-none): a part of the name of the model
+ *
+ * Returns: the indices of the PPDs of @manufacturer_name whose name
+ * contains @model, ignoring case, spaces and punctuation
+ */
+GArray *
+pp_ppd_catalog_search (PpPPDCatalog *catalog,
+                       const gchar  *manufacturer_name,
+                       const gchar  *model)
+{
+  const CatalogManufacturer *manufacturer;
+  GArray                    *result;
+  guint32                    first = 0;
+  guint32                    last = catalog->header->n_ppds;
+  guint32                    i;
+  gchar                     *key;
+
+  result = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  if (manufacturer_name)
+    {
+      manufacturer = find_manufacturer (catalog, manufacturer_name);
+      if (manufacturer == NULL)
+        return result;
+
+      first = manufacturer->first_ppd;
+      last = first + manufacturer->n_ppds;
+    }
+
+  key = make_key (model);
+  for (i = first; i < last; i++)
+    {
+      if (key == NULL ||
+          strstr (catalog->strings + catalog->ppds[i].model_key, key) != NULL)
+        {
+          guint index = i;
+
+          g_array_append_val (result, index);
+        }
+    }
+
+  g_free (key);
+
+  return result;
+}
+
+/**
+ * pp_ppd_catalog_find_by_device_id:
+ * @catalog: a #PpPPDCatalog
+ * @device_id: the IEEE 1284 device ID of a printer
+ *
+ * Returns: the indices of the PPDs for the manufacturer and the model
+ * given by @device_id
+ */
+GArray *
+pp_ppd_catalog_find_by_device_id (PpPPDCatalog *catalog,
+                                  const gchar  *device_id)
+{
+  GArray  *result;
+  guint32  low = 0;
+  guint32  high = catalog->header->n_device_ids;
+  guint32  middle;
+  guint    index;
+  gchar   *key;
+
+  result = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  key = make_device_key (device_id);
+  if (key == NULL)
+    return result;
+
+  /* The first PPD whose key isn't below the one looked for */
+  while (low < high)
+    {
+      middle = low + (high - low) / 2;
+      if (strcmp (catalog->strings + catalog->ppds[catalog->device_ids[middle]].device_key, key) < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  for (; low < catalog->header->n_device_ids; low++)
+    {
+      index = catalog->device_ids[low];
+      if (strcmp (catalog->strings + catalog->ppds[index].device_key, key) != 0)
+        break;
+
+      g_array_append_val (result, index);
+    }
+
+  g_free (key);
+
+  return result;
+}
+
+/**
+ * pp_ppd_catalog_get_ppd_list:
+ * @catalog: a #PpPPDCatalog
+ *
+ * Returns: the PPDs sorted by manufacturer, to be freed with
+ * ppd_list_free()
+ */
+PPDList *
+pp_ppd_catalog_get_ppd_list (PpPPDCatalog *catalog)
+{
+  const CatalogManufacturer *manufacturer;
+  const CatalogPPD          *ppd;
+  PPDManufacturerItem       *item;
+  PPDList                   *list;
+  gint                       i, j;
+
+  list = g_new0 (PPDList, 1);
+  list->num_of_manufacturers = catalog->header->n_manufacturers;
+  list->manufacturers = g_new0 (PPDManufacturerItem *, list->num_of_manufacturers);
+
+  for (i = 0; i < list->num_of_manufacturers; i++)
+    {
+      manufacturer = &catalog->manufacturers[i];
+
+      item = g_new0 (PPDManufacturerItem, 1);
+      item->manufacturer_name = g_strdup (catalog->strings + manufacturer->name);
+      item->manufacturer_display_name = g_strdup (catalog->strings + manufacturer->display_name);
+      item->num_of_ppds = manufacturer->n_ppds;
+      item->ppds = g_new0 (PPDName *, item->num_of_ppds);
+
+      for (j = 0; j < item->num_of_ppds; j++)
+        {
+          ppd = &catalog->ppds[manufacturer->first_ppd + j];
+
+          item->ppds[j] = g_new0 (PPDName, 1);
+          item->ppds[j]->ppd_name = g_strdup (catalog->strings + ppd->name);
+          item->ppds[j]->ppd_display_name = g_strdup (catalog->strings + ppd->display_name);
+          item->ppds[j]->ppd_match_level = -1;
+        }
+
+      list->manufacturers[i] = item;
+    }
+
+  return list;
+}
@@ -0,0 +1,83 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __PP_PPD_CATALOG_H__
+#define __PP_PPD_CATALOG_H__
+
+#include <glib.h>
+#include "pp-utils.h"
+
+G_BEGIN_DECLS
+
+/* The PPDs the CUPS server knows of, grouped by manufacturer.
+ *
+ * The catalog is kept as flat arrays of records pointing into a pool of
+ * strings, the same way in memory and in its cache file in the user
+ * cache directory, which is mapped as is. CUPS has no generation number
+ * for its PPD database, so the cache is only used with a local server,
+ * and holds the modification times of the directories the PPDs, the
+ * driver programs and the foomatic database are installed in, as they
+ * were before the server was asked for its PPDs; installing or removing
+ * a driver changes one of them and invalidates the cache. It is also
+ * dropped after a day, for the changes this misses.
+ *
+ * The PPDs can be searched by manufacturer and part of the model name,
+ * and looked up by the IEEE 1284 device ID of a printer through a
+ * sorted index. */
+
+typedef struct _PpPPDCatalogSources PpPPDCatalogSources;
+
+typedef struct
+{
+  const gchar *ppd_name;
+  const gchar *ppd_display_name;
+  /* Normalized, the PPDs are grouped by it */
+  const gchar *manufacturer_name;
+  const gchar *manufacturer_display_name;
+  /* The IEEE 1284 device ID of the PPD, may be NULL */
+  const gchar *device_id;
+} PpPPDCatalogEntry;
+
+PpPPDCatalogSources *pp_ppd_catalog_sources_new  (void);
+void                 pp_ppd_catalog_sources_free (PpPPDCatalogSources *sources);
+
+PpPPDCatalog *pp_ppd_catalog_new                (const PpPPDCatalogSources *sources,
+                                                 const PpPPDCatalogEntry   *entries,
+                                                 guint                      n_entries);
+PpPPDCatalog *pp_ppd_catalog_load               (GError                 **error);
+gboolean      pp_ppd_catalog_save               (PpPPDCatalog            *catalog,
+                                                 GError                 **error);
+void          pp_ppd_catalog_free               (PpPPDCatalog            *catalog);
+
+guint         pp_ppd_catalog_get_n_ppds         (PpPPDCatalog            *catalog);
+void          pp_ppd_catalog_get_ppd            (PpPPDCatalog            *catalog,
+                                                 guint                    index,
+                                                 PpPPDCatalogEntry       *out);
+
+GArray       *pp_ppd_catalog_search             (PpPPDCatalog            *catalog,
+                                                 const gchar             *manufacturer_name,
+                                                 const gchar             *model);
+GArray       *pp_ppd_catalog_find_by_device_id  (PpPPDCatalog            *catalog,
+                                                 const gchar             *device_id);
+
+PPDList      *pp_ppd_catalog_get_ppd_list       (PpPPDCatalog            *catalog);
+
+G_END_DECLS
+
+#endif
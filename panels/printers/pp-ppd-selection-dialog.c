@@ -62,6 +62,8 @@ struct _PpPPDSelectionDialog {
   gchar           *ppd_name;
   GtkResponseType  response;
   gchar           *manufacturer;
+  /* The driver found for the printer, selected in the list */
+  gchar           *preselected_ppd_name;
 
   PPDList *list;
 };
@@ -75,6 +77,8 @@ manufacturer_selection_changed_cb (GtkTreeSelection *selection,
   GtkTreeModel         *model;
   GtkTreeIter           iter;
   GtkTreeView          *models_treeview;
+  GtkTreeIter          *preselect_iter = NULL;
+  GtkTreePath          *path;
   gchar                *manufacturer_name = NULL;
   gint                  i, index;
 
@@ -112,9 +116,27 @@ manufacturer_selection_changed_cb (GtkTreeSelection *selection,
                                   PPD_NAMES_COLUMN, dialog->list->manufacturers[index]->ppds[i]->ppd_name,
                                   PPD_DISPLAY_NAMES_COLUMN, dialog->list->manufacturers[index]->ppds[i]->ppd_display_name,
                                   -1);
+
+              if (!preselect_iter &&
+                  g_strcmp0 (dialog->preselected_ppd_name,
+                             dialog->list->manufacturers[index]->ppds[i]->ppd_name) == 0)
+                {
+                  preselect_iter = gtk_tree_iter_copy (&iter);
+                }
             }
 
           gtk_tree_view_set_model (models_treeview, GTK_TREE_MODEL (store));
+
+          if (preselect_iter)
+            {
+              gtk_tree_selection_select_iter (gtk_tree_view_get_selection (models_treeview),
+                                              preselect_iter);
+              path = gtk_tree_model_get_path (GTK_TREE_MODEL (store), preselect_iter);
+              gtk_tree_view_scroll_to_cell (models_treeview, path, NULL, TRUE, 0.5, 0.0);
+              gtk_tree_path_free (path);
+              gtk_tree_iter_free (preselect_iter);
+            }
+
           g_object_unref (store);
           gtk_tree_view_columns_autosize (models_treeview);
         }
@@ -367,6 +389,7 @@ PpPPDSelectionDialog *
 pp_ppd_selection_dialog_new (GtkWindow            *parent,
                              PPDList              *ppd_list,
                              gchar                *manufacturer,
+                             const gchar          *ppd_name,
                              UserResponseCallback  user_callback,
                              gpointer              user_data)
 {
@@ -400,6 +423,9 @@ pp_ppd_selection_dialog_new (GtkWindow            *parent,
   dialog->list = ppd_list_copy (ppd_list);
 
   dialog->manufacturer = get_standard_manufacturers_name (manufacturer);
+  if (!dialog->manufacturer)
+    dialog->manufacturer = g_strdup (manufacturer);
+  dialog->preselected_ppd_name = g_strdup (ppd_name);
 
   /* connect signals */
   g_signal_connect (dialog->dialog, "delete-event", G_CALLBACK (gtk_widget_hide_on_delete), NULL);
@@ -433,6 +459,8 @@ pp_ppd_selection_dialog_free (PpPPDSelectionDialog *dialog)
 
   g_free (dialog->manufacturer);
 
+  g_free (dialog->preselected_ppd_name);
+
   g_free (dialog);
 }
 
@@ -32,6 +32,7 @@ typedef struct _PpPPDSelectionDialog PpPPDSelectionDialog;
 PpPPDSelectionDialog *pp_ppd_selection_dialog_new          (GtkWindow                 *parent,
                                                             PPDList                   *ppd_list,
                                                             gchar                     *manufacturer,
+                                                            const gchar               *ppd_name,
                                                             UserResponseCallback       user_callback,
                                                             gpointer                   user_data);
 gchar                *pp_ppd_selection_dialog_get_ppd_name (PpPPDSelectionDialog      *dialog);
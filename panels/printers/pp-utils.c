@@ -28,6 +28,8 @@
 #include <cups/ppd.h>
 
 #include "pp-utils.h"
+#include "pp-cups-pool.h"
+#include "pp-ppd-catalog.h"
 
 #define DBUS_TIMEOUT      120000
 #define DBUS_TIMEOUT_LONG 600000
@@ -176,7 +178,7 @@ get_dest_attr (const char *dest_name,
 
   ret = NULL;
 
-  num_dests = cupsGetDests (&dests);
+  num_dests = pp_cups_pool_get_dests (&dests);
   if (num_dests < 1) {
           g_debug ("Unable to get printer destinations");
           return NULL;
@@ -228,12 +230,9 @@ get_ppd_attribute (const gchar *ppd_file_name,
 void
 cancel_cups_subscription (gint id)
 {
-  http_t *http;
   ipp_t  *request;
 
-  if (id >= 0 &&
-      ((http = httpConnectEncrypt (cupsServer (), ippPort (),
-                                  cupsEncryption ())) != NULL)) {
+  if (id >= 0) {
     request = ippNewRequest (IPP_CANCEL_SUBSCRIPTION);
     ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
                  "printer-uri", NULL, "/");
@@ -241,8 +240,7 @@ cancel_cups_subscription (gint id)
                  "requesting-user-name", NULL, cupsUser ());
     ippAddInteger (request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
                   "notify-subscription-id", id);
-    ippDelete (cupsDoRequest (http, request, "/"));
-    httpClose (http);
+    ippDelete (pp_cups_pool_do_request (request, "/"));
   }
 }
 
@@ -254,70 +252,65 @@ renew_cups_subscription (gint id,
                          gint lease_duration)
 {
   ipp_attribute_t              *attr = NULL;
-  http_t                       *http;
   ipp_t                        *request;
   ipp_t                        *response = NULL;
   gint                          result = -1;
 
-  if ((http = httpConnectEncrypt (cupsServer (), ippPort (),
-                                  cupsEncryption ())) == NULL) {
-    g_debug ("Connection to CUPS server \'%s\' failed.", cupsServer ());
-  }
-  else {
-    if (id >= 0) {
-      request = ippNewRequest (IPP_RENEW_SUBSCRIPTION);
-      ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
-                   "printer-uri", NULL, "/");
-      ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-                   "requesting-user-name", NULL, cupsUser ());
-      ippAddInteger (request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
-                    "notify-subscription-id", id);
-      ippAddInteger (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
-                    "notify-lease-duration", lease_duration);
-      response = cupsDoRequest (http, request, "/");
-      if (response != NULL &&
-          ippGetStatusCode (response) <= IPP_OK_CONFLICT) {
-        if ((attr = ippFindAttribute (response, "notify-lease-duration",
-                                      IPP_TAG_INTEGER)) == NULL)
-          g_debug ("No notify-lease-duration in response!\n");
-        else
-          if (ippGetInteger (attr, 0) == lease_duration)
-            result = id;
-      }
-    }
-
-    if (result < 0) {
-      request = ippNewRequest (IPP_CREATE_PRINTER_SUBSCRIPTION);
-      ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
-                    "printer-uri", NULL, "/");
-      ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
-                    "requesting-user-name", NULL, cupsUser ());
-      ippAddStrings (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
-                     "notify-events", num_events, NULL, events);
-      ippAddString (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
-                    "notify-pull-method", NULL, "ippget");
-      ippAddString (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_URI,
-                    "notify-recipient-uri", NULL, "dbus://");
-      ippAddInteger (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
-                     "notify-lease-duration", lease_duration);
-      response = cupsDoRequest (http, request, "/");
-
-      if (response != NULL &&
-          ippGetStatusCode (response) <= IPP_OK_CONFLICT) {
-        if ((attr = ippFindAttribute (response, "notify-subscription-id",
-                                      IPP_TAG_INTEGER)) == NULL)
-          g_debug ("No notify-subscription-id in response!\n");
-        else
-          result = ippGetInteger (attr, 0);
-      }
+  if (id >= 0) {
+    request = ippNewRequest (IPP_RENEW_SUBSCRIPTION);
+    ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
+                 "printer-uri", NULL, "/");
+    ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                 "requesting-user-name", NULL, cupsUser ());
+    ippAddInteger (request, IPP_TAG_OPERATION, IPP_TAG_INTEGER,
+                  "notify-subscription-id", id);
+    ippAddInteger (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
+                  "notify-lease-duration", lease_duration);
+    response = pp_cups_pool_do_request (request, "/");
+    if (response != NULL &&
+        ippGetStatusCode (response) <= IPP_OK_CONFLICT) {
+      if ((attr = ippFindAttribute (response, "notify-lease-duration",
+                                    IPP_TAG_INTEGER)) == NULL)
+        g_debug ("No notify-lease-duration in response!\n");
+      else
+        if (ippGetInteger (attr, 0) == lease_duration)
+          result = id;
     }
 
     if (response)
       ippDelete (response);
+    response = NULL;
+  }
 
-    httpClose (http);
+  if (result < 0) {
+    request = ippNewRequest (IPP_CREATE_PRINTER_SUBSCRIPTION);
+    ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
+                  "printer-uri", NULL, "/");
+    ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_NAME,
+                  "requesting-user-name", NULL, cupsUser ());
+    ippAddStrings (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
+                   "notify-events", num_events, NULL, events);
+    ippAddString (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD,
+                  "notify-pull-method", NULL, "ippget");
+    ippAddString (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_URI,
+                  "notify-recipient-uri", NULL, "dbus://");
+    ippAddInteger (request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER,
+                   "notify-lease-duration", lease_duration);
+    response = pp_cups_pool_do_request (request, "/");
+
+    if (response != NULL &&
+        ippGetStatusCode (response) <= IPP_OK_CONFLICT) {
+      if ((attr = ippFindAttribute (response, "notify-subscription-id",
+                                    IPP_TAG_INTEGER)) == NULL)
+        g_debug ("No notify-subscription-id in response!\n");
+      else
+        result = ippGetInteger (attr, 0);
+    }
   }
 
+  if (response)
+    ippDelete (response);
+
   return result;
 }
 
@@ -331,7 +324,7 @@ set_local_default_printer (const gchar *printer_name)
   int          num_dests = 0;
   int          i;
 
-  num_dests = cupsGetDests (&dests);
+  num_dests = pp_cups_pool_get_dests (&dests);
 
   for (i = 0; i < num_dests; i ++)
     {
@@ -342,6 +335,9 @@ set_local_default_printer (const gchar *printer_name)
     }
 
   cupsSetDests (num_dests, dests);
+  cupsFreeDests (num_dests, dests);
+
+  pp_cups_pool_dests_changed ();
 }
 
 /*
@@ -369,7 +365,6 @@ printer_rename (const gchar *old_name,
   gboolean          default_printer = FALSE;
   gboolean          printer_shared = FALSE;
   GError           *error = NULL;
-  http_t           *http;
   gchar            *ppd_link;
   gchar            *ppd_filename = NULL;
   gchar           **sheets = NULL;
@@ -399,7 +394,7 @@ printer_rename (const gchar *old_name,
       g_strcmp0 (old_name, new_name) == 0)
     return FALSE;
 
-  num_dests = cupsGetDests (&dests);
+  num_dests = pp_cups_pool_get_dests (&dests);
 
   dest = cupsGetDest (new_name, NULL, num_dests, dests);
   if (dest)
@@ -466,55 +461,50 @@ printer_rename (const gchar *old_name,
   /*
    * Gather additional informations about the original printer
    */
-  if ((http = httpConnectEncrypt (cupsServer (), ippPort (),
-                                  cupsEncryption ())) != NULL)
-    {
-      request = ippNewRequest (IPP_GET_PRINTER_ATTRIBUTES);
-      ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
-                    "printer-uri", NULL, printer_uri);
-      ippAddStrings (request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
-                     "requested-attributes", G_N_ELEMENTS (requested_attrs), NULL, requested_attrs);
-      response = cupsDoRequest (http, request, "/");
+  request = ippNewRequest (IPP_GET_PRINTER_ATTRIBUTES);
+  ippAddString (request, IPP_TAG_OPERATION, IPP_TAG_URI,
+                "printer-uri", NULL, printer_uri);
+  ippAddStrings (request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+                 "requested-attributes", G_N_ELEMENTS (requested_attrs), NULL, requested_attrs);
+  response = pp_cups_pool_do_request (request, "/");
 
-      if (response)
+  if (response)
+    {
+      if (ippGetStatusCode (response) <= IPP_OK_CONFLICT)
         {
-          if (ippGetStatusCode (response) <= IPP_OK_CONFLICT)
-            {
-              attr = ippFindAttribute (response, "printer-error-policy", IPP_TAG_NAME);
-              if (attr)
-                error_policy = g_strdup (ippGetString (attr, 0, NULL));
+          attr = ippFindAttribute (response, "printer-error-policy", IPP_TAG_NAME);
+          if (attr)
+            error_policy = g_strdup (ippGetString (attr, 0, NULL));
 
-              attr = ippFindAttribute (response, "printer-op-policy", IPP_TAG_NAME);
-              if (attr)
-                op_policy = g_strdup (ippGetString (attr, 0, NULL));
+          attr = ippFindAttribute (response, "printer-op-policy", IPP_TAG_NAME);
+          if (attr)
+            op_policy = g_strdup (ippGetString (attr, 0, NULL));
 
-              attr = ippFindAttribute (response, "requesting-user-name-allowed", IPP_TAG_NAME);
-              if (attr && ippGetCount (attr) > 0)
-                {
-                  users_allowed = g_new0 (gchar *, ippGetCount (attr) + 1);
-                  for (i = 0; i < ippGetCount (attr); i++)
-                    users_allowed[i] = g_strdup (ippGetString (attr, i, NULL));
-                }
+          attr = ippFindAttribute (response, "requesting-user-name-allowed", IPP_TAG_NAME);
+          if (attr && ippGetCount (attr) > 0)
+            {
+              users_allowed = g_new0 (gchar *, ippGetCount (attr) + 1);
+              for (i = 0; i < ippGetCount (attr); i++)
+                users_allowed[i] = g_strdup (ippGetString (attr, i, NULL));
+            }
 
-              attr = ippFindAttribute (response, "requesting-user-name-denied", IPP_TAG_NAME);
-              if (attr && ippGetCount (attr) > 0)
-                {
-                  users_denied = g_new0 (gchar *, ippGetCount (attr) + 1);
-                  for (i = 0; i < ippGetCount (attr); i++)
-                    users_denied[i] = g_strdup (ippGetString (attr, i, NULL));
-                }
+          attr = ippFindAttribute (response, "requesting-user-name-denied", IPP_TAG_NAME);
+          if (attr && ippGetCount (attr) > 0)
+            {
+              users_denied = g_new0 (gchar *, ippGetCount (attr) + 1);
+              for (i = 0; i < ippGetCount (attr); i++)
+                users_denied[i] = g_strdup (ippGetString (attr, i, NULL));
+            }
 
-              attr = ippFindAttribute (response, "member-names", IPP_TAG_NAME);
-              if (attr && ippGetCount (attr) > 0)
-                {
-                  member_names = g_new0 (gchar *, ippGetCount (attr) + 1);
-                  for (i = 0; i < ippGetCount (attr); i++)
-                    member_names[i] = g_strdup (ippGetString (attr, i, NULL));
-                }
+          attr = ippFindAttribute (response, "member-names", IPP_TAG_NAME);
+          if (attr && ippGetCount (attr) > 0)
+            {
+              member_names = g_new0 (gchar *, ippGetCount (attr) + 1);
+              for (i = 0; i < ippGetCount (attr); i++)
+                member_names[i] = g_strdup (ippGetString (attr, i, NULL));
             }
-          ippDelete (response);
         }
-      httpClose (http);
+      ippDelete (response);
     }
 
   if (job_sheets)
@@ -598,7 +588,10 @@ printer_rename (const gchar *old_name,
       g_free (ppd_filename);
     }
 
-  num_dests = cupsGetDests (&dests);
+  /* The new printer was added meanwhile */
+  pp_cups_pool_dests_changed ();
+
+  num_dests = pp_cups_pool_get_dests (&dests);
   dest = cupsGetDest (new_name, NULL, num_dests, dests);
   if (dest)
     {
@@ -620,6 +613,8 @@ printer_rename (const gchar *old_name,
   else
     printer_set_accepting_jobs (old_name, accepting, NULL);
 
+  pp_cups_pool_dests_changed ();
+
   cupsFreeDests (num_dests, dests);
   g_free (op_policy);
   g_free (error_policy);
@@ -1478,7 +1473,7 @@ get_ipp_attributes_func (gpointer user_data)
                     "printer-uri", NULL, printer_uri);
       ippAddStrings (request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
                      "requested-attributes", length, NULL, (const char **) requested_attrs);
-      response = cupsDoRequest (CUPS_HTTP_DEFAULT, request, "/");
+      response = pp_cups_pool_do_request (request, "/");
     }
 
   if (response)
@@ -1565,8 +1560,6 @@ get_ipp_attributes_async (const gchar  *printer_name,
                           gpointer      user_data)
 {
   GIAData *data;
-  GThread *thread;
-  GError  *error = NULL;
 
   data = g_new0 (GIAData, 1);
   data->printer_name = g_strdup (printer_name);
@@ -1575,23 +1568,7 @@ get_ipp_attributes_async (const gchar  *printer_name,
   data->user_data = user_data;
   data->context = g_main_context_ref_thread_default ();
 
-  thread = g_thread_try_new ("get-ipp-attributes",
-                             get_ipp_attributes_func,
-                             data,
-                             &error);
-
-  if (!thread)
-    {
-      g_warning ("%s", error->message);
-      callback (NULL, user_data);
-
-      g_error_free (error);
-      get_ipp_attributes_data_free (data);
-    }
-  else
-    {
-      g_thread_unref (thread);
-    }
+  pp_cups_pool_queue (get_ipp_attributes_func, data);
 }
 
 IPPAttribute *
@@ -1987,7 +1964,7 @@ get_ppds_attribute_async (gchar       **ppds_names,
 
   if (!ppds_names || !attribute_name)
     {
-      callback (NULL, user_data);
+      callback (NULL, NULL, user_data);
       return;
     }
 
@@ -2675,6 +2652,7 @@ get_ppd_names_async (gchar        *printer_name,
 typedef struct
 {
   PPDList      *result;
+  PpPPDCatalog *catalog;
   GCancellable *cancellable;
   GAPCallback   callback;
   gpointer      user_data;
@@ -2692,10 +2670,12 @@ get_all_ppds_idle_cb (gpointer user_data)
     {
       ppd_list_free (data->result);
       data->result = NULL;
+      pp_ppd_catalog_free (data->catalog);
+      data->catalog = NULL;
     }
   else
     {
-      data->callback (data->result, data->user_data);
+      data->callback (data->result, data->catalog, data->user_data);
     }
 
   return FALSE;
@@ -2804,39 +2784,53 @@ static const struct {
   { "zebra", "Zebra" },
 };
 
-static gpointer
-get_all_ppds_func (gpointer user_data)
+/*
+ * Asks the server for all its PPDs, which takes long with large
+ * driver collections installed.
+ */
+static PpPPDCatalog *
+fetch_ppd_catalog (void)
 {
-  ipp_attribute_t *attr;
-  GHashTable      *ppds_hash = NULL;
-  GHashTable      *manufacturers_hash = NULL;
-  GAPData         *data = (GAPData *) user_data;
-  PPDName         *item;
-  ipp_t           *request;
-  ipp_t           *response;
-  GList           *list;
-  const gchar     *ppd_make_and_model;
-  const gchar     *ppd_device_id;
-  const gchar     *ppd_name;
-  const gchar     *ppd_product;
-  const gchar     *ppd_make;
-  gchar           *mfg;
-  gchar           *mfg_normalized;
-  gchar           *mdl;
-  gchar           *manufacturer_display_name;
-  gint             i, j;
+  PpPPDCatalogSources *sources;
+  PpPPDCatalogEntry  entry;
+  ipp_attribute_t   *attr;
+  PpPPDCatalog      *catalog = NULL;
+  GHashTable        *manufacturers_hash;
+  GPtrArray         *strings;
+  GArray            *entries;
+  ipp_t             *request;
+  ipp_t             *response;
+  const gchar       *attr_name;
+  const gchar       *ppd_make_and_model;
+  const gchar       *ppd_device_id;
+  const gchar       *ppd_name;
+  const gchar       *ppd_product;
+  const gchar       *ppd_make;
+  gchar             *mfg;
+  gchar             *mfg_normalized;
+  gchar             *mdl;
+  gchar             *manufacturer_display_name;
+  gint               i;
+  static const char * const requested_attrs[] = {
+    "ppd-device-id",
+    "ppd-make",
+    "ppd-make-and-model",
+    "ppd-name",
+    "ppd-product"};
+
+  /* A driver installed while the server answers invalidates the catalog */
+  sources = pp_ppd_catalog_sources_new ();
 
   request = ippNewRequest (CUPS_GET_PPDS);
+  ippAddStrings (request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD,
+                 "requested-attributes", G_N_ELEMENTS (requested_attrs), NULL, requested_attrs);
   response = cupsDoRequest (CUPS_HTTP_DEFAULT, request, "/");
 
   if (response &&
       ippGetStatusCode (response) <= IPP_OK_CONFLICT)
     {
-      /*
-       * This hash contains names of manufacturers as keys and
-       * values are GLists of PPD names.
-       */
-      ppds_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      entries = g_array_new (FALSE, FALSE, sizeof (PpPPDCatalogEntry));
+      strings = g_ptr_array_new_with_free_func (g_free);
 
       /*
        * This hash contains all possible names of manufacturers as keys
@@ -2872,21 +2866,30 @@ get_all_ppds_func (gpointer user_data)
 
           while (attr != NULL && ippGetGroupTag (attr) == IPP_TAG_PRINTER)
             {
-              if (g_strcmp0 (ippGetName (attr), "ppd-device-id") == 0 &&
-                  ippGetValueTag (attr) == IPP_TAG_TEXT)
-                ppd_device_id = ippGetString (attr, 0, NULL);
-              else if (g_strcmp0 (ippGetName (attr), "ppd-make-and-model") == 0 &&
-                       ippGetValueTag (attr) == IPP_TAG_TEXT)
-                ppd_make_and_model = ippGetString (attr, 0, NULL);
-              else if (g_strcmp0 (ippGetName (attr), "ppd-name") == 0 &&
-                       ippGetValueTag (attr) == IPP_TAG_NAME)
-                ppd_name = ippGetString (attr, 0, NULL);
-              else if (g_strcmp0 (ippGetName (attr), "ppd-product") == 0 &&
-                       ippGetValueTag (attr) == IPP_TAG_TEXT)
-                ppd_product = ippGetString (attr, 0, NULL);
-              else if (g_strcmp0 (ippGetName (attr), "ppd-make") == 0 &&
-                       ippGetValueTag (attr) == IPP_TAG_TEXT)
-                ppd_make = ippGetString (attr, 0, NULL);
+              attr_name = ippGetName (attr);
+
+              /* All the attributes asked for start with "ppd-" */
+              if (attr_name != NULL && g_str_has_prefix (attr_name, "ppd-"))
+                {
+                  attr_name += strlen ("ppd-");
+
+                  if (ippGetValueTag (attr) == IPP_TAG_NAME)
+                    {
+                      if (strcmp (attr_name, "name") == 0)
+                        ppd_name = ippGetString (attr, 0, NULL);
+                    }
+                  else if (ippGetValueTag (attr) == IPP_TAG_TEXT)
+                    {
+                      if (strcmp (attr_name, "device-id") == 0)
+                        ppd_device_id = ippGetString (attr, 0, NULL);
+                      else if (strcmp (attr_name, "make-and-model") == 0)
+                        ppd_make_and_model = ippGetString (attr, 0, NULL);
+                      else if (strcmp (attr_name, "product") == 0)
+                        ppd_product = ippGetString (attr, 0, NULL);
+                      else if (strcmp (attr_name, "make") == 0)
+                        ppd_make = ippGetString (attr, 0, NULL);
+                    }
+                }
 
               attr = ippNextAttribute (response);
             }
@@ -2938,7 +2941,8 @@ get_all_ppds_func (gpointer user_data)
               manufacturer_display_name = g_hash_table_lookup (manufacturers_hash, mfg_normalized);
               if (!manufacturer_display_name)
                 {
-                  g_hash_table_insert (manufacturers_hash, g_strdup (mfg_normalized), g_strdup (mfg));
+                  manufacturer_display_name = g_strdup (mfg);
+                  g_hash_table_insert (manufacturers_hash, g_strdup (mfg_normalized), manufacturer_display_name);
                 }
               else
                 {
@@ -2946,88 +2950,69 @@ get_all_ppds_func (gpointer user_data)
                   mfg_normalized = normalize (manufacturer_display_name);
                 }
 
-              item = g_new0 (PPDName, 1);
-              item->ppd_name = g_strdup (ppd_name);
-              item->ppd_display_name = g_strdup (mdl);
-              item->ppd_match_level = -1;
+              entry.ppd_name = ppd_name;
+              entry.ppd_display_name = mdl;
+              entry.manufacturer_name = mfg_normalized;
+              entry.manufacturer_display_name = manufacturer_display_name;
+              entry.device_id = ppd_device_id;
+              g_array_append_val (entries, entry);
 
-              list = g_hash_table_lookup (ppds_hash, mfg_normalized);
-              if (list)
-                {
-                  list = g_list_append (list, item);
-                }
-              else
-                {
-                  list = g_list_append (list, item);
-                  g_hash_table_insert (ppds_hash, g_strdup (mfg_normalized), list);
-                }
+              /* The entries point to them until the catalog is made */
+              g_ptr_array_add (strings, mdl);
+              g_ptr_array_add (strings, mfg_normalized);
+            }
+          else
+            {
+              g_free (mdl);
+              g_free (mfg_normalized);
             }
 
-          g_free (mdl);
           g_free (mfg);
-          g_free (mfg_normalized);
 
           if (attr == NULL)
             break;
         }
+
+      catalog = pp_ppd_catalog_new (sources, (PpPPDCatalogEntry *) entries->data, entries->len);
+
+      g_hash_table_destroy (manufacturers_hash);
+      g_ptr_array_free (strings, TRUE);
+      g_array_free (entries, TRUE);
     }
 
   if (response)
     ippDelete(response);
 
-  if (ppds_hash &&
-      manufacturers_hash)
-    {
-      GHashTableIter  iter;
-      gpointer        key;
-      gpointer        value;
-      GList          *ppd_item;
-      GList          *sort_list = NULL;
-      GList          *list_iter;
-      gchar          *name;
+  pp_ppd_catalog_sources_free (sources);
 
-      data->result = g_new0 (PPDList, 1);
-      data->result->num_of_manufacturers = g_hash_table_size (ppds_hash);
-      data->result->manufacturers = g_new0 (PPDManufacturerItem *, data->result->num_of_manufacturers);
+  return catalog;
+}
 
-      g_hash_table_iter_init (&iter, ppds_hash);
-      while (g_hash_table_iter_next (&iter, &key, &value))
-        {
-          sort_list = g_list_append (sort_list, g_strdup (key));
-        }
+static gpointer
+get_all_ppds_func (gpointer user_data)
+{
+  PpPPDCatalog *catalog;
+  GAPData      *data = (GAPData *) user_data;
+  GError       *error = NULL;
 
-      /* Sort list of manufacturers */
-      sort_list = g_list_sort (sort_list, (GCompareFunc) g_strcmp0);
+  catalog = pp_ppd_catalog_load (&error);
+  if (!catalog)
+    {
+      g_debug ("%s", error->message);
+      g_clear_error (&error);
 
-      /*
-       * Fill resulting list of lists (list of manufacturers where
-       * each item contains list of PPD names)
-       */
-      i = 0;
-      for (list_iter = sort_list; list_iter; list_iter = list_iter->next)
+      catalog = fetch_ppd_catalog ();
+      if (catalog && !pp_ppd_catalog_save (catalog, &error))
         {
-          name = (gchar *) list_iter->data;
-          value = g_hash_table_lookup (ppds_hash, name);
-
-          data->result->manufacturers[i] = g_new0 (PPDManufacturerItem, 1);
-          data->result->manufacturers[i]->manufacturer_name = g_strdup (name);
-          data->result->manufacturers[i]->manufacturer_display_name = g_strdup (g_hash_table_lookup (manufacturers_hash, name));
-          data->result->manufacturers[i]->num_of_ppds = g_list_length ((GList *) value);
-          data->result->manufacturers[i]->ppds = g_new0 (PPDName *, data->result->manufacturers[i]->num_of_ppds);
-
-          for (ppd_item = (GList *) value, j = 0; ppd_item; ppd_item = ppd_item->next, j++)
-            {
-              data->result->manufacturers[i]->ppds[j] = ppd_item->data;
-            }
-
-          g_list_free ((GList *) value);
-
-          i++;
+          g_warning ("Could not save the catalog of PPDs: %s", error->message);
+          g_clear_error (&error);
         }
+    }
 
-      g_list_free_full (sort_list, g_free);
-      g_hash_table_destroy (ppds_hash);
-      g_hash_table_destroy (manufacturers_hash);
+  if (catalog)
+    {
+      data->result = pp_ppd_catalog_get_ppd_list (catalog);
+      data->catalog = catalog;
     }
 
   get_all_ppds_cb (data);
@@ -3036,7 +3021,9 @@ get_all_ppds_func (gpointer user_data)
 }
 
 /*
- * Get names of all installed PPDs sorted by manufacturers names.
+ * Get names of all installed PPDs sorted by manufacturers names,
+ * and their catalog for looking up the driver of a device.
+ * The callback takes both.
  */
 void
 get_all_ppds_async (GCancellable *cancellable,
@@ -3169,6 +3156,87 @@ get_standard_manufacturers_name (gchar *name)
   return result;
 }
 
+/*
+ * The first PPD made for given device ID, or else whose name contains
+ * the model of the device. Its manufacturer is returned too, as the
+ * PPD may be listed under another name than the device reports.
+ */
+gchar *
+get_ppd_name_for_device (PpPPDCatalog  *catalog,
+                         const gchar   *device_id,
+                         const gchar   *make_and_model,
+                         gchar        **manufacturer)
+{
+  PpPPDCatalogEntry  entry;
+  GArray            *indices;
+  gchar             *mfg = NULL;
+  gchar             *mdl = NULL;
+  gchar             *standard_name;
+  gchar             *manufacturer_name = NULL;
+  gchar             *result = NULL;
+
+  if (manufacturer)
+    *manufacturer = NULL;
+
+  indices = pp_ppd_catalog_find_by_device_id (catalog, device_id);
+
+  if (indices->len == 0)
+    {
+      g_array_free (indices, TRUE);
+
+      if (device_id)
+        {
+          mfg = get_tag_value (device_id, "mfg");
+          if (!mfg)
+            mfg = get_tag_value (device_id, "manufacturer");
+
+          mdl = get_tag_value (device_id, "mdl");
+          if (!mdl)
+            mdl = get_tag_value (device_id, "model");
+        }
+
+      if (!mdl && make_and_model && make_and_model[0] != '\0')
+        mdl = g_strdup (make_and_model);
+
+      /* The catalog groups the PPDs by the normalized standard name */
+      if (mfg)
+        {
+          standard_name = get_standard_manufacturers_name (mfg);
+          manufacturer_name = normalize (standard_name ? standard_name : mfg);
+          g_free (standard_name);
+        }
+
+      if (mdl)
+        {
+          indices = pp_ppd_catalog_search (catalog, manufacturer_name, mdl);
+          if (indices->len == 0 && manufacturer_name)
+            {
+              g_array_free (indices, TRUE);
+              indices = pp_ppd_catalog_search (catalog, NULL, mdl);
+            }
+        }
+      else
+        {
+          indices = g_array_new (FALSE, FALSE, sizeof (guint));
+        }
+    }
+
+  if (indices->len > 0)
+    {
+      pp_ppd_catalog_get_ppd (catalog, g_array_index (indices, guint, 0), &entry);
+      result = g_strdup (entry.ppd_name);
+      if (manufacturer)
+        *manufacturer = g_strdup (entry.manufacturer_display_name);
+    }
+
+  g_array_free (indices, TRUE);
+  g_free (manufacturer_name);
+  g_free (mfg);
+  g_free (mdl);
+
+  return result;
+}
+
 typedef struct
 {
   gchar        *printer_name;
@@ -78,6 +78,9 @@ typedef struct
   gsize                 num_of_manufacturers;
 } PPDList;
 
+/* The indexed PPDs of the server, see pp-ppd-catalog.h */
+typedef struct _PpPPDCatalog PpPPDCatalog;
+
 typedef struct
 {
   GList *devices;
@@ -172,13 +175,19 @@ void        get_ppd_names_async (gchar        *printer_name,
                                  GPNCallback   callback,
                                  gpointer      user_data);
 
-typedef void (*GAPCallback) (PPDList  *ppds,
-                             gpointer  user_data);
+typedef void (*GAPCallback) (PPDList      *ppds,
+                             PpPPDCatalog *catalog,
+                             gpointer      user_data);
 
 void        get_all_ppds_async (GCancellable *cancellable,
                                 GAPCallback   callback,
                                 gpointer      user_data);
 
+gchar      *get_ppd_name_for_device (PpPPDCatalog  *catalog,
+                                     const gchar   *device_id,
+                                     const gchar   *make_and_model,
+                                     gchar        **manufacturer);
+
 PPDList    *ppd_list_copy (PPDList *list);
 void        ppd_list_free (PPDList *list);
 
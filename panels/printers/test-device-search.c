@@ -0,0 +1,310 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright 2013  Red Hat, Inc,
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Checks the keys under which the new printer dialog merges the devices
+ * found by several backends, their ranking, and the SNMP search against
+ * a stub backend found through CUPS_SERVERBIN.
+ *
+ * The devices of the local CUPS server come from cups-pk-helper's
+ * DevicesGet, which can't be pointed at a stub, so they aren't covered. */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "pp-device-keys.h"
+#include "pp-host.h"
+#include "pp-utils.h"
+
+static gchar *serverbin;
+
+static void
+assert_uri_key (const gchar *uri,
+                gboolean     with_port,
+                const gchar *expected)
+{
+  gchar *key;
+
+  key = pp_device_uri_key (uri, with_port);
+  g_assert_cmpstr (key, ==, expected);
+  g_free (key);
+}
+
+static void
+test_uri_key (void)
+{
+  assert_uri_key (NULL, TRUE, NULL);
+
+  /* Scheme and host aren't case sensitive, the path is */
+  assert_uri_key ("IPP://Printer.Local/printers/Office", TRUE,
+                  "uri:ipp://printer.local/printers/Office");
+
+  /* Trailing slash */
+  assert_uri_key ("ipp://printer.local/printers/office/", TRUE,
+                  "uri:ipp://printer.local/printers/office");
+
+  /* User info, with and without a port */
+  assert_uri_key ("ipp://john@printer.local/printers/office", TRUE,
+                  "uri:ipp://printer.local/printers/office");
+  assert_uri_key ("lpd://John@Printer.Local:516/queue", TRUE,
+                  "uri:lpd://printer.local:516/queue");
+
+  /* Default ports are the same as none */
+  assert_uri_key ("socket://printer.local:9100", TRUE,
+                  "uri:socket://printer.local");
+  assert_uri_key ("ipp://printer.local:631/printers/office", TRUE,
+                  "uri:ipp://printer.local/printers/office");
+
+  /* The queues on other ports are other devices... */
+  assert_uri_key ("socket://printer.local:9101", TRUE,
+                  "uri:socket://printer.local:9101");
+  assert_uri_key ("socket://printer.local:9102", TRUE,
+                  "uri:socket://printer.local:9102");
+
+  /* ...unless looked up by the port-less URIs of GroupPhysicalDevices */
+  assert_uri_key ("socket://printer.local:9101", FALSE,
+                  "uri:socket://printer.local");
+
+  /* The colons of IPv6 addresses */
+  assert_uri_key ("socket://[FE80::1]:9100", TRUE,
+                  "uri:socket://[fe80::1]");
+  assert_uri_key ("socket://[fe80::1]:9101", TRUE,
+                  "uri:socket://[fe80::1]:9101");
+  assert_uri_key ("socket://[fe80::1]:9101", FALSE,
+                  "uri:socket://[fe80::1]");
+
+  /* An @ in the path isn't user info */
+  assert_uri_key ("smb://server/queue@office", TRUE,
+                  "uri:smb://server/queue@office");
+
+  /* URIs without an authority are only compared as they are */
+  assert_uri_key ("hp:/usb/LaserJet?serial=ABC", TRUE,
+                  "uri:hp:/usb/LaserJet?serial=ABC");
+}
+
+static void
+test_id_key (void)
+{
+  gchar *key;
+
+  g_assert (pp_device_id_key (NULL) == NULL);
+
+  /* Without a serial number, all the devices of a model are equal */
+  g_assert (pp_device_id_key ("MFG:HP;MDL:LaserJet 4050;") == NULL);
+
+  key = pp_device_id_key ("MFG:HP;MDL:LaserJet 4050;SN:ABC123;");
+  g_assert_cmpstr (key, ==, "id:hp;laserjet 4050;abc123");
+  g_free (key);
+
+  key = pp_device_id_key ("MANUFACTURER:HP;MODEL:LaserJet 4050;SERN:abc123;");
+  g_assert_cmpstr (key, ==, "id:hp;laserjet 4050;abc123");
+  g_free (key);
+}
+
+static void
+test_rank (void)
+{
+  /* A device ID beats everything else */
+  g_assert_cmpint (pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_REMOTE_CUPS_SERVER), >,
+                   pp_device_rank (FALSE, FALSE, ACQUISITION_METHOD_DEFAULT_CUPS_SERVER));
+
+  /* Then a direct connection */
+  g_assert_cmpint (pp_device_rank (TRUE, FALSE, ACQUISITION_METHOD_REMOTE_CUPS_SERVER), >,
+                   pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_DEFAULT_CUPS_SERVER));
+
+  /* Then the backend */
+  g_assert_cmpint (pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_DEFAULT_CUPS_SERVER), >,
+                   pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_SNMP));
+  g_assert_cmpint (pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_SNMP), >,
+                   pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_REMOTE_CUPS_SERVER));
+  g_assert_cmpint (pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_REMOTE_CUPS_SERVER), >,
+                   pp_device_rank (TRUE, TRUE, ACQUISITION_METHOD_SAMBA));
+}
+
+static void
+write_snmp_backend (const gchar *script)
+{
+  GError *error = NULL;
+  gchar  *path;
+
+  path = g_build_filename (serverbin, "backend", "snmp", NULL);
+  g_file_set_contents (path, script, -1, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (g_chmod (path, 0755), ==, 0);
+  g_free (path);
+}
+
+static void
+snmp_devices_cb (GObject      *source_object,
+                 GAsyncResult *res,
+                 gpointer      user_data)
+{
+  GAsyncResult **result = user_data;
+
+  *result = g_object_ref (res);
+}
+
+static PpDevicesList *
+get_snmp_devices (GCancellable  *cancellable,
+                  guint          cancel_after,
+                  GError       **error)
+{
+  PpDevicesList *devices;
+  GAsyncResult  *result = NULL;
+  PpHost        *host;
+
+  host = pp_host_new ("printer.local", 0);
+  pp_host_get_snmp_devices_async (host, cancellable, snmp_devices_cb, &result);
+
+  if (cancel_after > 0)
+    {
+      g_usleep (cancel_after * G_TIME_SPAN_MILLISECOND);
+      g_cancellable_cancel (cancellable);
+    }
+
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  devices = pp_host_get_snmp_devices_finish (host, result, error);
+  g_object_unref (result);
+  g_object_unref (host);
+
+  return devices;
+}
+
+static void
+free_devices (PpDevicesList *devices)
+{
+  GList *iter;
+
+  for (iter = devices->devices; iter; iter = iter->next)
+    pp_print_device_free ((PpPrintDevice *) iter->data);
+  g_list_free (devices->devices);
+  g_free (devices);
+}
+
+static void
+test_snmp (void)
+{
+  PpPrintDevice *device;
+  PpDevicesList *devices;
+  GError        *error = NULL;
+
+  write_snmp_backend ("#!/bin/sh\n"
+                      "echo 'network socket://'$1':9101 \"HP LaserJet 4050\" "
+                      "\"Office printer\" \"MFG:HP;MDL:LaserJet 4050;SN:ABC123;\" "
+                      "\"Second floor\"'\n");
+
+  devices = get_snmp_devices (NULL, 0, &error);
+  g_assert_no_error (error);
+  g_assert (devices != NULL);
+  g_assert_cmpint (g_list_length (devices->devices), ==, 1);
+
+  device = devices->devices->data;
+  g_assert_cmpstr (device->device_class, ==, "network");
+  g_assert_cmpstr (device->device_uri, ==, "socket://printer.local:9101");
+  g_assert_cmpstr (device->device_make_and_model, ==, "HP LaserJet 4050");
+  g_assert_cmpstr (device->device_info, ==, "Office printer");
+  g_assert_cmpstr (device->device_name, ==, "Office-printer");
+  g_assert_cmpstr (device->device_id, ==, "MFG:HP;MDL:LaserJet 4050;SN:ABC123;");
+  g_assert_cmpstr (device->device_location, ==, "Second floor");
+  g_assert_cmpint (device->acquisition_method, ==, ACQUISITION_METHOD_SNMP);
+
+  free_devices (devices);
+}
+
+static void
+test_snmp_failure (void)
+{
+  PpDevicesList *devices;
+  GError        *error = NULL;
+
+  /* Nothing is found on a host without SNMP */
+  write_snmp_backend ("#!/bin/sh\n"
+                      "exit 1\n");
+
+  devices = get_snmp_devices (NULL, 0, &error);
+  g_assert_no_error (error);
+  g_assert (devices != NULL);
+  g_assert (devices->devices == NULL);
+
+  free_devices (devices);
+}
+
+static void
+test_snmp_cancel (void)
+{
+  PpDevicesList *devices;
+  GCancellable  *cancellable;
+  GError        *error = NULL;
+  gint64         start;
+
+  /* An unresponsive host mustn't hold the search up once it is
+   * given up on */
+  write_snmp_backend ("#!/bin/sh\n"
+                      "exec sleep 60\n");
+
+  cancellable = g_cancellable_new ();
+  start = g_get_monotonic_time ();
+
+  devices = get_snmp_devices (cancellable, 100, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert (devices == NULL);
+  g_assert_cmpint (g_get_monotonic_time () - start, <, 10 * G_TIME_SPAN_SECOND);
+
+  g_error_free (error);
+  g_object_unref (cancellable);
+}
+
+int
+main (int argc, char **argv)
+{
+  gchar *path;
+  int    ret;
+
+  g_test_init (&argc, &argv, NULL);
+
+  serverbin = g_dir_make_tmp ("test-device-search-XXXXXX", NULL);
+  g_assert (serverbin != NULL);
+  path = g_build_filename (serverbin, "backend", NULL);
+  g_mkdir (path, 0755);
+  g_setenv ("CUPS_SERVERBIN", serverbin, TRUE);
+
+  g_test_add_func ("/printers/device-search/uri-key", test_uri_key);
+  g_test_add_func ("/printers/device-search/id-key", test_id_key);
+  g_test_add_func ("/printers/device-search/rank", test_rank);
+  g_test_add_func ("/printers/device-search/snmp", test_snmp);
+  g_test_add_func ("/printers/device-search/snmp-failure", test_snmp_failure);
+  g_test_add_func ("/printers/device-search/snmp-cancel", test_snmp_cancel);
+
+  ret = g_test_run ();
+
+  g_free (path);
+  path = g_build_filename (serverbin, "backend", "snmp", NULL);
+  g_unlink (path);
+  g_free (path);
+  path = g_build_filename (serverbin, "backend", NULL);
+  g_rmdir (path);
+  g_free (path);
+  g_rmdir (serverbin);
+  g_free (serverbin);
+
+  return ret;
+}
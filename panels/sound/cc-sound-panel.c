@@ -73,6 +73,16 @@ cc_sound_panel_get_help_uri (CcPanel *panel)
   return "help:gnome-help/media#sound";
 }
 
+static void
+cc_sound_panel_set_active (CcPanel  *panel,
+                           gboolean  active)
+{
+        CcSoundPanel *self = CC_SOUND_PANEL (panel);
+
+        /* The input level meter keeps the microphone open */
+        gvc_mixer_dialog_set_monitoring (self->dialog, active);
+}
+
 static void
 cc_sound_panel_class_init (CcSoundPanelClass *klass)
 {
@@ -80,6 +90,7 @@ cc_sound_panel_class_init (CcSoundPanelClass *klass)
 	CcPanelClass *panel_class = CC_PANEL_CLASS (klass);
 
 	panel_class->get_help_uri = cc_sound_panel_get_help_uri;
+	panel_class->set_active = cc_sound_panel_set_active;
 
         object_class->finalize = cc_sound_panel_finalize;
         object_class->set_property = cc_sound_panel_set_property;
@@ -80,6 +80,10 @@ struct GvcMixerDialogPrivate
 
         gdouble          last_input_peak;
         guint            num_apps;
+
+        /* Source to monitor once the peak meter is unpaused */
+        gboolean         monitor_paused;
+        GvcMixerStream  *paused_source;
 };
 
 enum {
@@ -402,6 +406,11 @@ create_monitor_stream_for_source (GvcMixerDialog *dialog,
         if (stream == NULL) {
                 return;
         }
+        if (dialog->priv->monitor_paused) {
+                g_clear_object (&dialog->priv->paused_source);
+                dialog->priv->paused_source = g_object_ref (stream);
+                return;
+        }
         has_monitor = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (stream), "has-monitor"));
         if (has_monitor != FALSE) {
                 return;
@@ -462,6 +471,8 @@ stop_monitor_stream_for_source (GvcMixerDialog *dialog)
         int             res;
         GvcMixerStream *stream;
 
+        g_clear_object (&dialog->priv->paused_source);
+
         s = g_object_get_data (G_OBJECT (dialog->priv->input_level_bar), "pa_stream");
         if (s == NULL)
                 return;
@@ -1889,6 +1900,8 @@ gvc_mixer_dialog_dispose (GObject *object)
                 dialog->priv->bars = NULL;
         }
 
+        g_clear_object (&dialog->priv->paused_source);
+
         G_OBJECT_CLASS (gvc_mixer_dialog_parent_class)->dispose (object);
 }
 
@@ -1977,3 +1990,34 @@ gvc_mixer_dialog_set_page (GvcMixerDialog *self,
 
         return TRUE;
 }
+
+/* Pausing disconnects the peak detect stream, so that the input device
+ * isn't kept in use while the panel is hidden */
+void
+gvc_mixer_dialog_set_monitoring (GvcMixerDialog *dialog,
+                                 gboolean        monitoring)
+{
+        GvcMixerStream *stream;
+
+        g_return_if_fail (GVC_IS_MIXER_DIALOG (dialog));
+
+        if (dialog->priv->monitor_paused == !monitoring)
+                return;
+
+        if (monitoring) {
+                dialog->priv->monitor_paused = FALSE;
+                stream = dialog->priv->paused_source;
+                dialog->priv->paused_source = NULL;
+                create_monitor_stream_for_source (dialog, stream);
+                if (stream != NULL)
+                        g_object_unref (stream);
+        } else {
+                stream = g_object_get_data (G_OBJECT (dialog->priv->input_level_bar), "stream");
+                if (stream != NULL)
+                        g_object_ref (stream);
+                stop_monitor_stream_for_source (dialog);
+                dialog->priv->monitor_paused = TRUE;
+                dialog->priv->paused_source = stream;
+                gtk_adjustment_set_value (gvc_level_bar_get_peak_adjustment (GVC_LEVEL_BAR (dialog->priv->input_level_bar)), 0);
+        }
+}
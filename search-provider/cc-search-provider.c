@@ -39,6 +39,9 @@ struct _CcSearchProvider
   GObject parent;
 
   CcShellSearchProvider2 *skeleton;
+
+  /* State of the last query, reused by subsearches */
+  CcShellSearchQuery *query;
 };
 
 struct _CcSearchProviderClass
@@ -70,31 +73,100 @@ get_casefolded_terms (char **terms)
   return casefolded_terms;
 }
 
+static GtkTreeModel *
+get_model (void)
+{
+  CcSearchProviderApp *app;
+
+  app = cc_search_provider_app_get ();
+  return GTK_TREE_MODEL (cc_search_provider_app_get_model (app));
+}
+
+static CcShellSearchIndex *
+get_search_index (void)
+{
+  return cc_shell_model_get_search_index (CC_SHELL_MODEL (get_model ()));
+}
+
 static gboolean
-matches_all_terms (GtkTreeModel  *model,
-                   GtkTreeIter   *iter,
-                   char         **terms)
+matches_all_terms (CcShellSearchIndex  *index,
+                   guint                entry,
+                   char               **terms)
 {
   int i;
 
   for (i = 0; terms[i]; i++)
     {
-      if (!cc_shell_model_iter_matches_search (CC_SHELL_MODEL (model),
-                                               iter,
-                                               terms[i]))
+      if (!cc_shell_search_index_entry_matches (index, entry, terms[i]))
         return FALSE;
     }
 
   return TRUE;
 }
 
-static GtkTreeModel *
-get_model (void)
+static GPtrArray *
+get_result_ids (CcShellSearchIndex *index,
+                GArray             *matches)
 {
-  CcSearchProviderApp *app;
+  GPtrArray *results;
+  guint i;
+
+  /* The ids are owned by the index, which outlives the reply */
+  results = g_ptr_array_sized_new (matches->len + 1);
+  for (i = 0; i < matches->len; i++)
+    g_ptr_array_add (results,
+                     (gpointer) cc_shell_search_index_get_id (index,
+                                                              g_array_index (matches, guint, i)));
+  g_ptr_array_add (results, NULL);
 
-  app = cc_search_provider_app_get ();
-  return GTK_TREE_MODEL (cc_search_provider_app_get_model (app));
+  return results;
+}
+
+static CcShellSearchQuery *
+ensure_query (CcSearchProvider *self)
+{
+  /* The model is not available yet when the provider is created */
+  if (self->query == NULL)
+    self->query = cc_shell_search_query_new (get_search_index ());
+
+  return self->query;
+}
+
+static gboolean
+strv_contains (char       **strv,
+               const char  *str)
+{
+  guint i;
+
+  for (i = 0; strv[i]; i++)
+    {
+      if (g_str_equal (strv[i], str))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Whether the last query matched exactly @ids */
+static gboolean
+query_has_results (CcShellSearchQuery  *query,
+                   CcShellSearchIndex  *index,
+                   char               **ids)
+{
+  guint entry;
+  guint i;
+
+  if (g_strv_length (ids) != cc_shell_search_query_get_results (query)->len)
+    return FALSE;
+
+  for (i = 0; ids[i]; i++)
+    {
+      if (!cc_shell_search_index_lookup_id (index, ids[i], &entry) ||
+          !cc_shell_search_query_contains (query, entry))
+        return FALSE;
+    }
+
+  return TRUE;
 }
 
 static gboolean
@@ -103,37 +175,27 @@ handle_get_initial_result_set (CcShellSearchProvider2  *skeleton,
                                char                   **terms,
                                CcSearchProvider        *self)
 {
-  GtkTreeModel *model = get_model ();
-  GtkTreeIter iter;
+  CcShellSearchIndex *index = get_search_index ();
+  CcShellSearchQuery *query = ensure_query (self);
   GPtrArray *results;
-  gboolean ok;
   char **casefolded_terms;
-  char **results_as_strings;
 
   casefolded_terms = get_casefolded_terms (terms);
-  results = g_ptr_array_new ();
 
-  ok = gtk_tree_model_get_iter_first (model, &iter);
-  while (ok)
-    {
-      if (matches_all_terms (model, &iter, casefolded_terms))
-        {
-          g_ptr_array_add (results,
-                           gtk_tree_model_get_string_from_iter (model,
-                                                                &iter));
-        }
+  /* Settings are only loaded once someone searches */
+  cc_shell_model_load_settings (CC_SHELL_MODEL (get_model ()));
 
-      ok = gtk_tree_model_iter_next (model, &iter);
-    }
+  cc_shell_search_query_reset (query);
+  cc_shell_search_query_update (query, (const char * const *) casefolded_terms, NULL);
+
+  results = get_result_ids (index, cc_shell_search_query_get_results (query));
 
-  g_ptr_array_add (results, NULL);
-  results_as_strings = (char**) g_ptr_array_free (results, FALSE);
   cc_shell_search_provider2_complete_get_initial_result_set (skeleton,
                                                              invocation,
-                                                             (const char* const*) results_as_strings);
+                                                             (const char* const*) results->pdata);
 
   g_strfreev (casefolded_terms);
-  g_strfreev (results_as_strings);
+  g_ptr_array_unref (results);
   return TRUE;
 }
 
@@ -144,34 +206,68 @@ handle_get_subsearch_result_set (CcShellSearchProvider2  *skeleton,
                                  char                   **terms,
                                  CcSearchProvider        *self)
 {
-  GtkTreeModel *model = get_model ();
-  GtkTreeIter iter;
+  CcShellSearchIndex *index = get_search_index ();
+  CcShellSearchQuery *query = ensure_query (self);
+  GArray *matches;
   GPtrArray *results;
   char **casefolded_terms;
-  char **results_as_strings;
-  int i;
+  guint entry;
+  guint i;
 
   casefolded_terms = get_casefolded_terms (terms);
-  results = g_ptr_array_new ();
+  matches = g_array_new (FALSE, FALSE, sizeof (guint));
 
-  for (i = 0; previous_results[i]; i++)
+  if (*previous_results != NULL &&
+      query_has_results (query, index, previous_results))
     {
-      if (gtk_tree_model_get_iter_from_string (model, &iter,
-                                               previous_results[i]) &&
-          matches_all_terms (model, &iter, casefolded_terms))
+      GArray *ranked;
+
+      /* Narrow down the previous query, this only looks
+       * at the previous results when the terms got longer */
+      if (cc_shell_search_query_update (query,
+                                        (const char * const *) casefolded_terms,
+                                        NULL))
         {
-          g_ptr_array_add (results, g_strdup (previous_results[i]));
+          ranked = cc_shell_search_query_get_results (query);
+          g_array_append_vals (matches, ranked->data, ranked->len);
+        }
+      else
+        {
+          /* The terms changed in a way that could match other
+           * panels, keep the previous results only */
+          ranked = cc_shell_search_query_get_results (query);
+          for (i = 0; i < ranked->len; i++)
+            {
+              entry = g_array_index (ranked, guint, i);
+              if (strv_contains (previous_results,
+                                 cc_shell_search_index_get_id (index, entry)))
+                g_array_append_val (matches, entry);
+            }
         }
     }
+  else
+    {
+      for (i = 0; previous_results[i]; i++)
+        {
+          if (cc_shell_search_index_lookup_id (index, previous_results[i], &entry) &&
+              matches_all_terms (index, entry, casefolded_terms))
+            {
+              g_array_append_val (matches, entry);
+            }
+        }
 
-  g_ptr_array_add (results, NULL);
-  results_as_strings = (char**) g_ptr_array_free (results, FALSE);
+      cc_shell_search_index_rank (index, (const char * const *) casefolded_terms, matches);
+      cc_shell_search_query_reset (query);
+    }
+
+  results = get_result_ids (index, matches);
   cc_shell_search_provider2_complete_get_subsearch_result_set (skeleton,
                                                                invocation,
-                                                               (const char* const*) results_as_strings);
+                                                               (const char* const*) results->pdata);
 
   g_strfreev (casefolded_terms);
-  g_strfreev (results_as_strings);
+  g_array_unref (matches);
+  g_ptr_array_unref (results);
   return TRUE;
 }
 
@@ -185,25 +281,29 @@ handle_get_result_metas (CcShellSearchProvider2  *skeleton,
   GtkTreeIter iter;
   int i;
   GVariantBuilder builder;
-  GAppInfo *app;
-  const char *id;
-  char *name, *description, *escaped_description, *icon_string;
+  char *id, *panel, *name, *description, *escaped_description, *icon_string, *setting;
   GIcon *icon;
 
   g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
 
   for (i = 0; results[i]; i++)
     {
-      if (!gtk_tree_model_get_iter_from_string (model, &iter, results[i]))
+      if (!cc_shell_model_get_iter_for_id (CC_SHELL_MODEL (model), results[i], &iter))
         continue;
 
       gtk_tree_model_get (model, &iter,
-                          COL_APP, &app,
+                          COL_ID, &panel,
                           COL_NAME, &name,
                           COL_GICON, &icon,
                           COL_DESCRIPTION, &description,
+                          COL_SETTING, &setting,
                           -1);
-      id = g_app_info_get_id (app);
+      /* Settings are activated through their result id, panels
+       * through their desktop file */
+      if (setting)
+        id = g_strdup (results[i]);
+      else
+        id = cc_panel_loader_get_desktop_id (panel);
       icon_string = g_icon_to_string (icon);
       escaped_description = g_markup_escape_text (description, -1);
 
@@ -222,7 +322,9 @@ handle_get_result_metas (CcShellSearchProvider2  *skeleton,
       g_free (description);
       g_free (escaped_description);
       g_free (icon_string);
-      g_object_unref (app);
+      g_free (setting);
+      g_free (panel);
+      g_free (id);
       g_object_unref (icon);
     }
 
@@ -241,15 +343,54 @@ handle_activate_result (CcShellSearchProvider2  *skeleton,
                         CcSearchProvider        *self)
 {
   GdkAppLaunchContext *launch_context;
+  GtkTreeModel *model = get_model ();
+  GtkTreeIter iter;
   GAppInfo *app;
   GError *error;
+  char *panel, *setting;
 
   launch_context = gdk_display_get_app_launch_context (gdk_display_get_default ());
   gdk_app_launch_context_set_timestamp (launch_context, timestamp);
 
-  app = G_APP_INFO (g_desktop_app_info_new (identifier));
-
   error = NULL;
+  panel = setting = NULL;
+  if (cc_shell_model_get_iter_for_id (CC_SHELL_MODEL (model), identifier, &iter))
+    gtk_tree_model_get (model, &iter,
+                        COL_ID, &panel,
+                        COL_SETTING, &setting,
+                        -1);
+
+  if (setting)
+    {
+      char *command_line;
+
+      command_line = g_strdup_printf ("gnome-control-center %s " CC_SHELL_SETTING_ARGV_PREFIX "%s",
+                                      panel, setting);
+      app = g_app_info_create_from_commandline (command_line,
+                                                "gnome-control-center.desktop",
+                                                G_APP_INFO_CREATE_SUPPORTS_STARTUP_NOTIFICATION,
+                                                &error);
+      g_free (command_line);
+    }
+  else
+    {
+      app = G_APP_INFO (g_desktop_app_info_new (identifier));
+    }
+
+  g_free (panel);
+  g_free (setting);
+
+  if (!app)
+    {
+      if (error)
+        g_dbus_method_invocation_return_gerror (invocation, error);
+      else
+        g_dbus_method_invocation_return_error (invocation, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                               "No such result '%s'", identifier);
+      g_clear_error (&error);
+      return TRUE;
+    }
+
   if (!g_app_info_launch (app, NULL, G_APP_LAUNCH_CONTEXT (launch_context), &error))
     {
       g_dbus_method_invocation_return_gerror (invocation, error);
@@ -354,6 +495,7 @@ cc_search_provider_dispose (GObject *object)
   self = CC_SEARCH_PROVIDER (object);
 
   g_clear_object (&self->skeleton);
+  g_clear_pointer (&self->query, cc_shell_search_query_free);
 
   G_OBJECT_CLASS (cc_search_provider_parent_class)->dispose (object);
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Replays a recorded keystroke stream against the search index built from
+ * the panels' desktop files, and reports the time spent querying and
+ * ranking per keystroke.
+ *
+ * Usage: bench-search KEYSTROKES DESKTOP-FILE...
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "cc-shell-search-index.h"
+#include "cc-util.h"
+
+#define ITERATIONS 1000
+
+/* The source desktop files still carry intltool's leading underscore */
+static char *
+get_string (GKeyFile   *keyfile,
+            const char *key)
+{
+  char *value, *translatable_key;
+
+  value = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, key, NULL);
+  if (value)
+    return value;
+
+  translatable_key = g_strconcat ("_", key, NULL);
+  value = g_key_file_get_string (keyfile, G_KEY_FILE_DESKTOP_GROUP, translatable_key, NULL);
+  g_free (translatable_key);
+
+  return value;
+}
+
+static gboolean
+add_desktop_file (CcShellSearchIndex *index,
+                  const char         *path)
+{
+  GKeyFile *keyfile;
+  char *name, *comment, *keywords, *basename;
+  char *casefolded_name, *casefolded_comment;
+  char **split, **casefolded_keywords;
+  GError *error = NULL;
+  guint i, n;
+
+  keyfile = g_key_file_new ();
+  if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &error))
+    {
+      g_warning ("Failed to load '%s': %s", path, error->message);
+      g_error_free (error);
+      g_key_file_free (keyfile);
+      return FALSE;
+    }
+
+  name = get_string (keyfile, "Name");
+  comment = get_string (keyfile, "Comment");
+  keywords = get_string (keyfile, "Keywords");
+
+  split = g_strsplit (keywords ? keywords : "", ";", -1);
+  n = g_strv_length (split);
+  casefolded_keywords = g_new0 (char *, n + 1);
+  for (i = 0; i < n; i++)
+    casefolded_keywords[i] = cc_util_normalize_casefold_and_unaccent (split[i]);
+
+  casefolded_name = cc_util_normalize_casefold_and_unaccent (name);
+  casefolded_comment = cc_util_normalize_casefold_and_unaccent (comment);
+
+  basename = g_path_get_basename (path);
+  cc_shell_search_index_add (index, basename, casefolded_name, casefolded_comment,
+                             (const char * const *) casefolded_keywords);
+
+  g_free (basename);
+  g_free (casefolded_name);
+  g_free (casefolded_comment);
+  g_strfreev (casefolded_keywords);
+  g_strfreev (split);
+  g_free (name);
+  g_free (comment);
+  g_free (keywords);
+  g_key_file_free (keyfile);
+
+  return TRUE;
+}
+
+int main (int argc, char **argv)
+{
+  CcShellSearchIndex *index;
+  GArray *results;
+  GTimer *timer;
+  char *contents;
+  char **lines;
+  guint n_keystrokes = 0;
+  gdouble total = 0, worst = 0;
+  const char *worst_line = NULL;
+  int i;
+
+  if (argc < 3)
+    {
+      g_printerr ("Usage: %s KEYSTROKES DESKTOP-FILE...\n", argv[0]);
+      return 1;
+    }
+
+  if (!g_file_get_contents (argv[1], &contents, NULL, NULL))
+    {
+      g_warning ("Failed to load '%s'", argv[1]);
+      return 1;
+    }
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  timer = g_timer_new ();
+
+  index = cc_shell_search_index_new ();
+  for (i = 2; i < argc; i++)
+    add_desktop_file (index, argv[i]);
+
+  g_print ("Indexed %u panels in %.3f ms\n",
+           cc_shell_search_index_get_n_entries (index),
+           g_timer_elapsed (timer, NULL) * 1000);
+
+  results = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      char *filter;
+      char **terms;
+      gdouble elapsed;
+      int j;
+
+      if (*lines[i] == '#' || *lines[i] == '\0')
+        continue;
+
+      filter = cc_util_normalize_casefold_and_unaccent (lines[i]);
+      terms = g_strsplit (g_strstrip (filter), " ", -1);
+
+      g_timer_start (timer);
+      for (j = 0; j < ITERATIONS; j++)
+        {
+          cc_shell_search_index_query (index, (const char * const *) terms, results);
+          cc_shell_search_index_rank (index, (const char * const *) terms, results);
+        }
+      elapsed = g_timer_elapsed (timer, NULL) / ITERATIONS;
+
+      g_print ("%-24s %3u results, first: %-32s %8.2f µs\n",
+               lines[i], results->len,
+               results->len > 0 ? cc_shell_search_index_get_id (index, g_array_index (results, guint, 0)) : "-",
+               elapsed * G_USEC_PER_SEC);
+
+      total += elapsed;
+      if (elapsed > worst)
+        {
+          worst = elapsed;
+          worst_line = lines[i];
+        }
+      n_keystrokes++;
+
+      g_strfreev (terms);
+      g_free (filter);
+    }
+
+  if (n_keystrokes > 0)
+    g_print ("\n%u keystrokes, mean %.2f µs, worst %.2f µs ('%s')\n",
+             n_keystrokes,
+             total / n_keystrokes * G_USEC_PER_SEC,
+             worst * G_USEC_PER_SEC, worst_line);
+
+  g_array_unref (results);
+  cc_shell_search_index_free (index);
+  g_timer_destroy (timer);
+  g_strfreev (lines);
+
+  return 0;
+}
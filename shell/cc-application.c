@@ -27,8 +27,10 @@
 #include <libnotify/notify.h>
 
 #include "cc-application.h"
+#include "cc-debug-generated.h"
 #include "cc-panel-loader.h"
 #include "cc-shell-log.h"
+#include "cc-shell-timings.h"
 #include "cc-window.h"
 
 #ifdef HAVE_CHEESE
@@ -39,6 +41,7 @@
 struct _CcApplicationPrivate
 {
   CcWindow *window;
+  CcDebug  *debug;
 };
 
 G_DEFINE_TYPE (CcApplication, cc_application, GTK_TYPE_APPLICATION)
@@ -61,6 +64,7 @@ static gboolean show_help = FALSE;
 static gboolean show_help_gtk = FALSE;
 static gboolean show_help_all = FALSE;
 static gboolean list_panels = FALSE;
+static gboolean show_timings = FALSE;
 
 const GOptionEntry all_options[] = {
   { "version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK, option_version_cb, NULL, NULL },
@@ -68,6 +72,7 @@ const GOptionEntry all_options[] = {
   { "overview", 'o', 0, G_OPTION_ARG_NONE, &show_overview, N_("Show the overview"), NULL },
   { "search", 's', 0, G_OPTION_ARG_STRING, &search_str, N_("Search for the string"), "SEARCH" },
   { "list", 'l', 0, G_OPTION_ARG_NONE, &list_panels, N_("List possible panel names and exit"), NULL },
+  { "timings", 0, 0, G_OPTION_ARG_NONE, &show_timings, N_("Show how long startup and loading panels took, and exit"), NULL },
   { "help", 'h', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &show_help, N_("Show help options"), NULL },
   { "help-all", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &show_help_all, N_("Show help options"), NULL },
   { "help-gtk", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &show_help_gtk, N_("Show help options"), NULL },
@@ -109,6 +114,7 @@ cc_application_command_line (GApplication *application,
   verbose = FALSE;
   show_overview = FALSE;
   show_help = FALSE;
+  show_timings = FALSE;
   start_panels = NULL;
 
   argv = g_application_command_line_get_arguments (command_line, &argc);
@@ -160,6 +166,29 @@ cc_application_command_line (GApplication *application,
       return 0;
     }
 
+  if (show_timings)
+    {
+      guint i, n;
+
+      /* This runs in the primary instance, which has the timings;
+       * the output is sent back to the invoking process, so this
+       * also works to inspect an already running instance */
+      n = cc_shell_timings_get_n_records ();
+      for (i = 0; i < n; i++)
+        {
+          char *str;
+
+          str = cc_shell_timings_format_record (cc_shell_timings_get_record (i));
+          g_application_command_line_print (command_line, "%s\n", str);
+          g_free (str);
+        }
+
+      g_option_context_free (context);
+      g_strfreev (argv);
+
+      return 0;
+    }
+
 #ifdef HAVE_CHEESE
   cheese_gtk_init (&argc, &argv);
 #endif /* HAVE_CHEESE */
@@ -234,16 +263,36 @@ cc_application_activate (GApplication *application)
   cc_window_present (self->priv->window);
 }
 
+static void
+system_bus_ready_cb (GObject      *source_object,
+                     GAsyncResult *res,
+                     gpointer      user_data)
+{
+  GDBusConnection *connection;
+
+  connection = g_bus_get_finish (res, NULL);
+  if (connection == NULL)
+    return;
+
+  cc_shell_timings_watch_bus (connection);
+  g_object_unref (connection);
+}
+
 static void
 cc_application_startup (GApplication *application)
 {
   CcApplication *self = CC_APPLICATION (application);
+  CcShellTimingsSpan *span;
   GMenu *menu;
   GMenu *section;
   GSimpleAction *action;
 
+  span = cc_shell_timings_begin ("startup", NULL);
+
   G_APPLICATION_CLASS (cc_application_parent_class)->startup (application);
 
+  g_bus_get (G_BUS_TYPE_SYSTEM, NULL, system_bus_ready_cb, NULL);
+
 #ifdef HAVE_CHEESE
   if (gtk_clutter_init (NULL, NULL) != CLUTTER_INIT_SUCCESS)
     {
@@ -282,6 +331,56 @@ cc_application_startup (GApplication *application)
                                    "F1", "app.help", NULL);
 
   self->priv->window = cc_window_new (GTK_APPLICATION (application));
+
+  cc_shell_timings_end (span);
+}
+
+static gboolean
+handle_get_timings (CcDebug               *debug,
+                    GDBusMethodInvocation *invocation,
+                    gpointer               user_data)
+{
+  cc_debug_complete_get_timings (debug, invocation,
+                                 cc_shell_timings_to_variant ());
+
+  return TRUE;
+}
+
+static gboolean
+cc_application_dbus_register (GApplication    *application,
+                              GDBusConnection *connection,
+                              const gchar     *object_path,
+                              GError         **error)
+{
+  CcApplication *self = CC_APPLICATION (application);
+
+  if (!G_APPLICATION_CLASS (cc_application_parent_class)->dbus_register (application,
+                                                                        connection,
+                                                                        object_path,
+                                                                        error))
+    return FALSE;
+
+  cc_shell_timings_watch_bus (connection);
+
+  return g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (self->priv->debug),
+                                           connection, object_path, error);
+}
+
+static void
+cc_application_dbus_unregister (GApplication    *application,
+                                GDBusConnection *connection,
+                                const gchar     *object_path)
+{
+  CcApplication *self = CC_APPLICATION (application);
+  GDBusInterfaceSkeleton *skeleton;
+
+  skeleton = G_DBUS_INTERFACE_SKELETON (self->priv->debug);
+  if (g_dbus_interface_skeleton_has_connection (skeleton, connection))
+    g_dbus_interface_skeleton_unexport_from_connection (skeleton, connection);
+
+  G_APPLICATION_CLASS (cc_application_parent_class)->dbus_unregister (application,
+                                                                      connection,
+                                                                      object_path);
 }
 
 static GObject *
@@ -307,6 +406,10 @@ cc_application_constructor (GType type,
 static void
 cc_application_dispose (GObject *object)
 {
+  CcApplication *self = CC_APPLICATION (object);
+
+  g_clear_object (&self->priv->debug);
+
   G_OBJECT_CLASS (cc_application_parent_class)->dispose (object);
 }
 
@@ -317,6 +420,10 @@ cc_application_init (CcApplication *self)
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                             CC_TYPE_APPLICATION,
                                             CcApplicationPrivate);
+
+  self->priv->debug = cc_debug_skeleton_new ();
+  g_signal_connect (self->priv->debug, "handle-get-timings",
+                    G_CALLBACK (handle_get_timings), self);
 }
 
 
@@ -331,6 +438,8 @@ cc_application_class_init (CcApplicationClass *class)
   application_class->activate = cc_application_activate;
   application_class->startup = cc_application_startup;
   application_class->command_line = cc_application_command_line;
+  application_class->dbus_register = cc_application_dbus_register;
+  application_class->dbus_unregister = cc_application_dbus_unregister;
 
   g_type_class_add_private (class, sizeof (CcApplicationPrivate));
 }
@@ -25,6 +25,13 @@
 #include <gio/gdesktopappinfo.h>
 
 #include "cc-panel-loader.h"
+#include "cc-shell-panel-cache.h"
+#include "cc-shell-timings.h"
+#include "cc-util.h"
+
+/* Panels taking longer than this to construct get reported, in
+ * microseconds */
+#define SLOW_PANEL_LOAD_TIME (250 * 1000)
 
 #ifndef CC_PANEL_LOADER_NO_GTYPES
 
@@ -116,6 +123,18 @@ cc_panel_loader_get_panels (void)
   return g_list_reverse (l);
 }
 
+/**
+ * cc_panel_loader_get_desktop_id:
+ * @name: the name of a panel
+ *
+ * Returns: the id of the desktop file of the panel
+ */
+char *
+cc_panel_loader_get_desktop_id (const char *name)
+{
+  return g_strconcat ("gnome-", name, "-panel.desktop", NULL);
+}
+
 static int
 parse_categories (GDesktopAppInfo *app)
 {
@@ -149,20 +168,133 @@ parse_categories (GDesktopAppInfo *app)
   return retval;
 }
 
-void
-cc_panel_loader_fill_model (CcShellModel *model)
+static char *
+get_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gnome-control-center",
+                           "panels.cache", NULL);
+}
+
+/* The cache is shared by the shell and the search provider, and by
+ * different versions and builds of them */
+static char *
+get_cache_key (void)
+{
+  GString *key;
+  guint i;
+
+  key = g_string_new (VERSION);
+
+  for (i = 0; g_get_language_names ()[i] != NULL; i++)
+    g_string_append_printf (key, " %s", g_get_language_names ()[i]);
+
+  g_string_append_c (key, ';');
+  for (i = 0; i < G_N_ELEMENTS (all_panels); i++)
+    g_string_append_printf (key, " %s", all_panels[i].name);
+
+  return g_string_free (key, FALSE);
+}
+
+/* Adding a desktop file to any of the directories they are looked up in
+ * changes the mtime of that directory */
+static void
+add_application_dirs (GPtrArray *sources)
+{
+  const char * const *dirs;
+  guint i;
+
+  g_ptr_array_add (sources, g_build_filename (g_get_user_data_dir (), "applications", NULL));
+
+  dirs = g_get_system_data_dirs ();
+  for (i = 0; dirs[i] != NULL; i++)
+    g_ptr_array_add (sources, g_build_filename (dirs[i], "applications", NULL));
+}
+
+static void
+fill_model_from_cache (CcShellModel      *model,
+                       CcShellPanelCache *cache)
+{
+  guint i, n;
+
+  n = cc_shell_panel_cache_get_n_entries (cache);
+  for (i = 0; i < n; i++)
+    {
+      CcShellPanelCacheEntry entry;
+      GIcon *icon = NULL;
+      char **keywords;
+
+      cc_shell_panel_cache_get_entry (cache, i, &entry);
+      if (G_UNLIKELY (entry.category >= CC_CATEGORY_LAST))
+        continue;
+
+      if (*entry.icon != '\0')
+        icon = g_icon_new_for_string (entry.icon, NULL);
+
+      if (*entry.casefolded_keywords != '\0')
+        keywords = g_strsplit (entry.casefolded_keywords, "\n", -1);
+      else
+        keywords = g_new0 (char *, 1);
+
+      cc_shell_model_add_item (model, entry.category, entry.id,
+                               entry.name, entry.description, icon,
+                               entry.casefolded_name,
+                               entry.casefolded_description,
+                               (const char * const *) keywords);
+
+      g_strfreev (keywords);
+      if (icon)
+        g_object_unref (icon);
+    }
+}
+
+static char **
+get_casefolded_keywords (GDesktopAppInfo *app)
+{
+  const char * const * keywords;
+  char **casefolded_keywords;
+  int i, n;
+
+  keywords = g_desktop_app_info_get_keywords (app);
+  n = keywords ? g_strv_length ((char**) keywords) : 0;
+  casefolded_keywords = g_new (char*, n+1);
+
+  for (i = 0; i < n; i++)
+    casefolded_keywords[i] = cc_util_normalize_casefold_and_unaccent (keywords[i]);
+  casefolded_keywords[n] = NULL;
+
+  return casefolded_keywords;
+}
+
+static void
+fill_model_from_desktop_files (CcShellModel *model,
+                               const char   *cache_path,
+                               const char   *cache_key)
 {
+  GArray *entries;
+  GPtrArray *apps, *strings, *sources;
+  GError *error = NULL;
   int i;
 
+  entries = g_array_new (FALSE, FALSE, sizeof (CcShellPanelCacheEntry));
+  /* Keep everything the entries point to until the cache is written */
+  apps = g_ptr_array_new_with_free_func (g_object_unref);
+  strings = g_ptr_array_new_with_free_func (g_free);
+  sources = g_ptr_array_new_with_free_func (g_free);
+
+  add_application_dirs (sources);
+
   for (i = 0; i < G_N_ELEMENTS (all_panels); i++)
     {
+      CcShellPanelCacheEntry entry;
       GDesktopAppInfo *app;
       char *desktop_name;
+      char **keywords;
+      GIcon *icon;
       int category;
 
-      desktop_name = g_strconcat ("gnome-", all_panels[i].name,
-                                  "-panel.desktop", NULL);
+      desktop_name = cc_panel_loader_get_desktop_id (all_panels[i].name);
       app = g_desktop_app_info_new (desktop_name);
+      g_free (desktop_name);
 
       if (app == NULL)
         {
@@ -173,11 +305,89 @@ cc_panel_loader_fill_model (CcShellModel *model)
 
       category = parse_categories (app);
       if (G_UNLIKELY (category < 0))
-        continue;
+        {
+          g_object_unref (app);
+          continue;
+        }
+
+      g_ptr_array_add (apps, app);
+      g_ptr_array_add (sources, g_strdup (g_desktop_app_info_get_filename (app)));
+
+      icon = g_app_info_get_icon (G_APP_INFO (app));
+      keywords = get_casefolded_keywords (app);
+
+      entry.id = all_panels[i].name;
+      entry.category = category;
+      entry.name = g_app_info_get_name (G_APP_INFO (app));
+      entry.description = g_app_info_get_description (G_APP_INFO (app));
+      entry.icon = icon ? g_icon_to_string (icon) : NULL;
+      entry.casefolded_name = cc_util_normalize_casefold_and_unaccent (entry.name);
+      entry.casefolded_description = cc_util_normalize_casefold_and_unaccent (entry.description);
+      entry.casefolded_keywords = g_strjoinv ("\n", keywords);
+
+      g_ptr_array_add (strings, (char *) entry.icon);
+      g_ptr_array_add (strings, (char *) entry.casefolded_name);
+      g_ptr_array_add (strings, (char *) entry.casefolded_description);
+      g_ptr_array_add (strings, (char *) entry.casefolded_keywords);
+      g_array_append_val (entries, entry);
+
+      cc_shell_model_add_item (model, category, entry.id,
+                               entry.name, entry.description, icon,
+                               entry.casefolded_name,
+                               entry.casefolded_description,
+                               (const char * const *) keywords);
+
+      g_strfreev (keywords);
+    }
+
+  g_ptr_array_add (sources, NULL);
+
+  if (!cc_shell_panel_cache_write (cache_path, cache_key,
+                                   (const char * const *) sources->pdata,
+                                   (const CcShellPanelCacheEntry *) entries->data,
+                                   entries->len, &error))
+    {
+      g_debug ("Could not write the panel cache: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_ptr_array_unref (sources);
+  g_ptr_array_unref (strings);
+  g_ptr_array_unref (apps);
+  g_array_free (entries, TRUE);
+}
+
+void
+cc_panel_loader_fill_model (CcShellModel *model)
+{
+  CcShellTimingsSpan *span;
+  CcShellPanelCache *cache;
+  char *cache_path, *cache_key;
+  GError *error = NULL;
+
+  span = cc_shell_timings_begin ("fill-model", NULL);
+
+  cache_path = get_cache_path ();
+  cache_key = get_cache_key ();
 
-      cc_shell_model_add_item (model, category, G_APP_INFO (app), all_panels[i].name);
-      g_object_unref (app);
+  cache = cc_shell_panel_cache_open (cache_path, cache_key, &error);
+  if (cache != NULL)
+    {
+      fill_model_from_cache (model, cache);
+      cc_shell_panel_cache_free (cache);
     }
+  else
+    {
+      g_debug ("Not using the panel cache: %s", error->message);
+      g_error_free (error);
+
+      fill_model_from_desktop_files (model, cache_path, cache_key);
+    }
+
+  g_free (cache_path);
+  g_free (cache_key);
+
+  cc_shell_timings_end (span);
 }
 
 #ifndef CC_PANEL_LOADER_NO_GTYPES
@@ -203,16 +413,28 @@ cc_panel_loader_load_by_name (CcShell     *shell,
                               const char **argv)
 {
   GType (*get_type) (void);
+  CcShellTimingsSpan *span;
+  CcPanel *panel;
+  gint64 duration;
 
   ensure_panel_types ();
 
   get_type = g_hash_table_lookup (panel_types, name);
   g_return_val_if_fail (get_type != NULL, NULL);
 
-  return g_object_new (get_type (),
-                       "shell", shell,
-                       "argv", argv,
-                       NULL);
+  span = cc_shell_timings_begin ("load-panel", name);
+
+  panel = g_object_new (get_type (),
+                        "shell", shell,
+                        "argv", argv,
+                        NULL);
+
+  duration = cc_shell_timings_end (span);
+  if (duration > SLOW_PANEL_LOAD_TIME)
+    g_message ("Panel '%s' took %" G_GINT64_FORMAT " ms to load",
+               name, duration / 1000);
+
+  return panel;
 }
 
 #endif /* CC_PANEL_LOADER_NO_GTYPES */
@@ -220,6 +220,9 @@ static void
 cc_panel_init (CcPanel *panel)
 {
   panel->priv = CC_PANEL_GET_PRIVATE (panel);
+
+  /* Panels are shown as soon as they are created */
+  panel->priv->is_active = TRUE;
 }
 
 /**
@@ -257,3 +260,34 @@ cc_panel_get_help_uri (CcPanel *panel)
 
   return NULL;
 }
+
+/**
+ * cc_panel_set_active:
+ * @panel: A #CcPanel
+ * @active: whether the panel is shown
+ *
+ * Called by the shell when the panel is hidden but kept around for later
+ * use, and when it is shown again. Panels that poll or watch for changes
+ * should stop doing so while inactive, and refresh when activated.
+ */
+void
+cc_panel_set_active (CcPanel  *panel,
+                     gboolean  active)
+{
+  CcPanelClass *class = CC_PANEL_GET_CLASS (panel);
+
+  active = !!active;
+  if (panel->priv->is_active == active)
+    return;
+
+  panel->priv->is_active = active;
+
+  if (class->set_active)
+    class->set_active (panel, active);
+}
+
+gboolean
+cc_panel_get_active (CcPanel *panel)
+{
+  return panel->priv->is_active;
+}
@@ -77,6 +77,8 @@ struct _CcPanelClass
 
   GPermission * (* get_permission) (CcPanel *panel);
   const char  * (* get_help_uri)   (CcPanel *panel);
+  void          (* set_active)     (CcPanel *panel,
+                                    gboolean active);
 };
 
 GType        cc_panel_get_type         (void);
@@ -87,6 +89,10 @@ GPermission *cc_panel_get_permission   (CcPanel     *panel);
 
 const char  *cc_panel_get_help_uri     (CcPanel     *panel);
 
+void         cc_panel_set_active       (CcPanel     *panel,
+                                        gboolean     active);
+gboolean     cc_panel_get_active       (CcPanel     *panel);
+
 G_END_DECLS
 
 #endif /* __CC_PANEL_H */
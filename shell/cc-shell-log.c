@@ -25,6 +25,7 @@
 #include <glib/gstdio.h>
 
 #include "cc-shell-log.h"
+#include "cc-shell-timings.h"
 
 static int log_levels = G_LOG_LEVEL_CRITICAL |
                         G_LOG_LEVEL_ERROR    |
@@ -51,6 +52,21 @@ cc_shell_log_init (void)
         g_log_set_default_handler (cc_shell_log_default_handler, NULL);
 }
 
+static void
+cc_shell_log_timings (void)
+{
+        guint i, n;
+
+        n = cc_shell_timings_get_n_records ();
+        for (i = 0; i < n; i++) {
+                char *str;
+
+                str = cc_shell_timings_format_record (cc_shell_timings_get_record (i));
+                g_debug ("Timing: %s", str);
+                g_free (str);
+        }
+}
+
 void
 cc_shell_log_set_debug (gboolean debug)
 {
@@ -59,5 +75,8 @@ cc_shell_log_set_debug (gboolean debug)
                 g_setenv ("G_MESSAGES_DEBUG", "all", TRUE);
                 log_levels |= (G_LOG_LEVEL_DEBUG | G_LOG_LEVEL_INFO);
                 g_debug ("Enabling debugging");
+
+                /* Startup happened before we knew about debugging */
+                cc_shell_log_timings ();
         }
 }
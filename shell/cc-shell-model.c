@@ -19,30 +19,64 @@
  * Author: Thomas Wood <thos@gnome.org>
  */
 
+#include "config.h"
+
 #include <string.h>
 
-#include <gio/gdesktopappinfo.h>
+#include <glib/gi18n.h>
 
 #include "cc-shell-model.h"
+#include "cc-shell-settings-index.h"
 #include "cc-util.h"
 
-#define GNOME_SETTINGS_PANEL_ID_KEY "X-GNOME-Settings-Panel"
-#define GNOME_SETTINGS_PANEL_CATEGORY GNOME_SETTINGS_PANEL_ID_KEY
-#define GNOME_SETTINGS_PANEL_ID_KEYWORDS "Keywords"
+#define SETTINGS_INDEX_PATH GNOMECC_DATA_DIR "/settings-index"
+
+#define SHELL_MODEL_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), CC_TYPE_SHELL_MODEL, CcShellModelPrivate))
+
+struct _CcShellModelPrivate
+{
+  CcShellSearchIndex *index;
+
+  /* GtkTreeRowReference for each search index entry */
+  GPtrArray *rows;
 
+  gboolean settings_loaded;
+};
 
 G_DEFINE_TYPE (CcShellModel, cc_shell_model, GTK_TYPE_LIST_STORE)
 
+static void
+cc_shell_model_finalize (GObject *object)
+{
+  CcShellModelPrivate *priv = CC_SHELL_MODEL (object)->priv;
+
+  g_ptr_array_unref (priv->rows);
+  cc_shell_search_index_free (priv->index);
+
+  G_OBJECT_CLASS (cc_shell_model_parent_class)->finalize (object);
+}
+
 static void
 cc_shell_model_class_init (CcShellModelClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (CcShellModelPrivate));
+
+  object_class->finalize = cc_shell_model_finalize;
 }
 
 static void
 cc_shell_model_init (CcShellModel *self)
 {
-  GType types[] = {G_TYPE_STRING, G_TYPE_STRING, G_TYPE_APP_INFO, G_TYPE_STRING,
-                   G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_ICON, G_TYPE_STRV};
+  GType types[] = {G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                   G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_ICON, G_TYPE_STRV,
+                   G_TYPE_UINT, G_TYPE_STRING};
+
+  self->priv = SHELL_MODEL_PRIVATE (self);
+  self->priv->index = cc_shell_search_index_new ();
+  self->priv->rows = g_ptr_array_new_with_free_func ((GDestroyNotify) gtk_tree_row_reference_free);
 
   gtk_list_store_set_column_types (GTK_LIST_STORE (self),
                                    N_COLS, types);
@@ -57,88 +91,241 @@ cc_shell_model_new (void)
   return g_object_new (CC_TYPE_SHELL_MODEL, NULL);
 }
 
-static char **
-get_casefolded_keywords (GAppInfo *appinfo)
+static void
+track_row (CcShellModel *model,
+           GtkTreeIter  *iter)
 {
-  const char * const * keywords;
-  char **casefolded_keywords;
-  int i, n;
+  GtkTreePath *path;
 
-  keywords = g_desktop_app_info_get_keywords (G_DESKTOP_APP_INFO (appinfo));
-  n = keywords ? g_strv_length ((char**) keywords) : 0;
-  casefolded_keywords = g_new (char*, n+1);
-
-  for (i = 0; i < n; i++)
-    casefolded_keywords[i] = cc_util_normalize_casefold_and_unaccent (keywords[i]);
-  casefolded_keywords[n] = NULL;
-
-  return casefolded_keywords;
+  /* The store is sorted, keep track of the row as it moves */
+  path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), iter);
+  g_ptr_array_add (model->priv->rows,
+                   gtk_tree_row_reference_new (GTK_TREE_MODEL (model), path));
+  gtk_tree_path_free (path);
 }
 
+/**
+ * cc_shell_model_add_item:
+ * @model: a #CcShellModel
+ * @category: the category of the panel
+ * @id: the id of the panel
+ * @name: the name of the panel
+ * @description: the description of the panel
+ * @icon: the icon of the panel
+ * @casefolded_name: @name, as from cc_util_normalize_casefold_and_unaccent()
+ * @casefolded_description: @description, normalized the same way
+ * @casefolded_keywords: the keywords of the panel, normalized the same way
+ *
+ * Adds a panel to the model. The normalized strings are taken as is, so
+ * that they can come from the panel cache.
+ */
 void
-cc_shell_model_add_item (CcShellModel    *model,
-                         CcPanelCategory  category,
-                         GAppInfo        *appinfo,
-                         const char      *id)
+cc_shell_model_add_item (CcShellModel       *model,
+                         CcPanelCategory     category,
+                         const char         *id,
+                         const char         *name,
+                         const char         *description,
+                         GIcon              *icon,
+                         const char         *casefolded_name,
+                         const char         *casefolded_description,
+                         const char * const *casefolded_keywords)
 {
-  GIcon       *icon = g_app_info_get_icon (appinfo);
-  const gchar *name = g_app_info_get_name (appinfo);
-  const gchar *comment = g_app_info_get_description (appinfo);
-  char **keywords;
-  char *casefolded_name, *casefolded_description;
+  GtkTreeIter iter;
+  guint entry;
 
-  casefolded_name = cc_util_normalize_casefold_and_unaccent (name);
-  casefolded_description = cc_util_normalize_casefold_and_unaccent (comment);
-  keywords = get_casefolded_keywords (appinfo);
+  entry = cc_shell_search_index_add (model->priv->index, id,
+                                     casefolded_name,
+                                     casefolded_description,
+                                     casefolded_keywords);
 
-  gtk_list_store_insert_with_values (GTK_LIST_STORE (model), NULL, 0,
+  gtk_list_store_insert_with_values (GTK_LIST_STORE (model), &iter, 0,
                                      COL_NAME, name,
                                      COL_CASEFOLDED_NAME, casefolded_name,
-                                     COL_APP, appinfo,
                                      COL_ID, id,
                                      COL_CATEGORY, category,
-                                     COL_DESCRIPTION, comment,
+                                     COL_DESCRIPTION, description,
                                      COL_CASEFOLDED_DESCRIPTION, casefolded_description,
                                      COL_GICON, icon,
-                                     COL_KEYWORDS, keywords,
+                                     COL_KEYWORDS, casefolded_keywords,
+                                     COL_SEARCH_ENTRY, entry,
                                      -1);
 
+  track_row (model, &iter);
+}
+
+/* Removes the mnemonic underscores from a translated label */
+static char *
+strip_mnemonic (const char *label)
+{
+  GString *str;
+  const char *p;
+
+  str = g_string_sized_new (strlen (label));
+  for (p = label; *p != '\0'; p++)
+    {
+      if (*p == '_')
+        {
+          if (p[1] != '_')
+            continue;
+          p++;
+        }
+      g_string_append_c (str, *p);
+    }
+
+  /* "Label:" */
+  if (str->len > 0 && str->str[str->len - 1] == ':')
+    g_string_truncate (str, str->len - 1);
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+add_setting (CcShellModel *model,
+             const char   *panel,
+             const char   *widget,
+             const char   *label,
+             const char   *context)
+{
+  CcShellModelPrivate *priv = model->priv;
+  GtkTreeIter panel_iter, iter;
+  const char *translated;
+  char *name, *casefolded_name, *panel_name, *id;
+  GIcon *icon;
+  guint panel_entry, entry;
+
+  /* Panels not built in are not in the model */
+  if (!cc_shell_search_index_lookup_id (priv->index, panel, &panel_entry) ||
+      !cc_shell_model_get_iter_for_entry (model, panel_entry, &panel_iter))
+    return;
+
+  if (*context != '\0')
+    translated = g_dpgettext2 (GETTEXT_PACKAGE, context, label);
+  else
+    translated = dgettext (GETTEXT_PACKAGE, label);
+
+  name = strip_mnemonic (translated);
+  casefolded_name = cc_util_normalize_casefold_and_unaccent (name);
+  id = g_strconcat (panel, "/", widget, NULL);
+
+  gtk_tree_model_get (GTK_TREE_MODEL (model), &panel_iter,
+                      COL_NAME, &panel_name,
+                      COL_GICON, &icon,
+                      -1);
+
+  /* Settings are only found by their own label, not by their panel's */
+  entry = cc_shell_search_index_add (priv->index, id, casefolded_name, NULL, NULL);
+
+  gtk_list_store_insert_with_values (GTK_LIST_STORE (model), &iter, 0,
+                                     COL_NAME, name,
+                                     COL_CASEFOLDED_NAME, casefolded_name,
+                                     COL_ID, panel,
+                                     COL_CATEGORY, CC_CATEGORY_LAST,
+                                     COL_DESCRIPTION, panel_name,
+                                     COL_GICON, icon,
+                                     COL_SEARCH_ENTRY, entry,
+                                     COL_SETTING, widget,
+                                     -1);
+
+  track_row (model, &iter);
+
+  g_free (name);
   g_free (casefolded_name);
-  g_free (casefolded_description);
-  g_strfreev (keywords);
+  g_free (panel_name);
+  g_free (id);
+  g_clear_object (&icon);
 }
 
+/**
+ * cc_shell_model_load_settings:
+ * @model: a #CcShellModel
+ *
+ * Adds a row for each setting of the panels already in @model, as listed
+ * in the settings index generated at build time. Setting rows use
+ * %CC_CATEGORY_LAST as their category, the id of their panel as %COL_ID
+ * and the name of the widget to show as %COL_SETTING.
+ *
+ * Returns: %TRUE if rows were added, %FALSE if the settings were
+ * already loaded or could not be loaded
+ */
 gboolean
-cc_shell_model_iter_matches_search (CcShellModel *model,
-                                    GtkTreeIter  *iter,
-                                    const char   *term)
+cc_shell_model_load_settings (CcShellModel *model)
 {
-  gchar *name, *description;
-  gboolean result;
-  gchar **keywords;
-
-  gtk_tree_model_get (GTK_TREE_MODEL (model), iter,
-                      COL_CASEFOLDED_NAME, &name,
-                      COL_CASEFOLDED_DESCRIPTION, &description,
-                      COL_KEYWORDS, &keywords,
-                      -1);
+  CcShellSettingsIndex *index;
+  GError *error = NULL;
+  guint i, n;
 
-  result = (strstr (name, term) != NULL);
+  g_return_val_if_fail (CC_IS_SHELL_MODEL (model), FALSE);
 
-  if (!result && description)
-    result = (strstr (description, term) != NULL);
+  if (model->priv->settings_loaded)
+    return FALSE;
+  model->priv->settings_loaded = TRUE;
 
-  if (!result && keywords)
+  index = cc_shell_settings_index_open (SETTINGS_INDEX_PATH, &error);
+  if (index == NULL)
     {
-      gint i;
+      g_warning ("Could not load the settings index: %s", error->message);
+      g_error_free (error);
+      return FALSE;
+    }
 
-      for (i = 0; !result && keywords[i]; i++)
-        result = (strstr (keywords[i], term) == keywords[i]);
+  n = cc_shell_settings_index_get_n_records (index);
+  for (i = 0; i < n; i++)
+    {
+      const char *panel, *widget, *label, *context;
+
+      cc_shell_settings_index_get_record (index, i, &panel, &widget, &label, &context);
+      add_setting (model, panel, widget, label, context);
     }
 
-  g_free (name);
-  g_free (description);
-  g_strfreev (keywords);
+  cc_shell_settings_index_free (index);
+
+  return n > 0;
+}
+
+CcShellSearchIndex *
+cc_shell_model_get_search_index (CcShellModel *model)
+{
+  g_return_val_if_fail (CC_IS_SHELL_MODEL (model), NULL);
+
+  return model->priv->index;
+}
+
+gboolean
+cc_shell_model_get_iter_for_entry (CcShellModel *model,
+                                   guint         entry,
+                                   GtkTreeIter  *iter)
+{
+  GtkTreePath *path;
+  gboolean ret;
+
+  g_return_val_if_fail (CC_IS_SHELL_MODEL (model), FALSE);
+
+  if (entry >= model->priv->rows->len)
+    return FALSE;
+
+  path = gtk_tree_row_reference_get_path (g_ptr_array_index (model->priv->rows, entry));
+  if (path == NULL)
+    return FALSE;
+
+  ret = gtk_tree_model_get_iter (GTK_TREE_MODEL (model), iter, path);
+  gtk_tree_path_free (path);
+
+  return ret;
+}
+
+/* Panel rows are indexed by the panel id, setting rows by
+ * "panel-id/widget-name" */
+gboolean
+cc_shell_model_get_iter_for_id (CcShellModel *model,
+                                const char   *id,
+                                GtkTreeIter  *iter)
+{
+  guint entry;
+
+  g_return_val_if_fail (CC_IS_SHELL_MODEL (model), FALSE);
+
+  if (!cc_shell_search_index_lookup_id (model->priv->index, id, &entry))
+    return FALSE;
 
-  return result;
+  return cc_shell_model_get_iter_for_entry (model, entry, iter);
 }
@@ -24,6 +24,8 @@
 
 #include <gtk/gtk.h>
 
+#include "cc-shell-search-index.h"
+
 G_BEGIN_DECLS
 
 #define CC_TYPE_SHELL_MODEL cc_shell_model_get_type()
@@ -50,6 +52,11 @@ G_BEGIN_DECLS
 
 typedef struct _CcShellModel CcShellModel;
 typedef struct _CcShellModelClass CcShellModelClass;
+typedef struct _CcShellModelPrivate CcShellModelPrivate;
+
+/* Prefix of the panel argument selecting a setting, as in
+ * "gnome-control-center mouse setting:tap_to_click_toggle" */
+#define CC_SHELL_SETTING_ARGV_PREFIX "setting:"
 
 typedef enum {
   CC_CATEGORY_PERSONAL,
@@ -62,13 +69,14 @@ enum
 {
   COL_NAME,
   COL_CASEFOLDED_NAME,
-  COL_APP,
   COL_ID,
   COL_CATEGORY,
   COL_DESCRIPTION,
   COL_CASEFOLDED_DESCRIPTION,
   COL_GICON,
   COL_KEYWORDS,
+  COL_SEARCH_ENTRY,
+  COL_SETTING,
 
   N_COLS
 };
@@ -76,6 +84,8 @@ enum
 struct _CcShellModel
 {
   GtkListStore parent;
+
+  CcShellModelPrivate *priv;
 };
 
 struct _CcShellModelClass
@@ -87,14 +97,27 @@ GType cc_shell_model_get_type (void) G_GNUC_CONST;
 
 CcShellModel *cc_shell_model_new (void);
 
-void cc_shell_model_add_item (CcShellModel   *model,
-                              CcPanelCategory category,
-                              GAppInfo       *appinfo,
-                              const char     *id);
+void cc_shell_model_add_item (CcShellModel       *model,
+                              CcPanelCategory     category,
+                              const char         *id,
+                              const char         *name,
+                              const char         *description,
+                              GIcon              *icon,
+                              const char         *casefolded_name,
+                              const char         *casefolded_description,
+                              const char * const *casefolded_keywords);
+
+CcShellSearchIndex *cc_shell_model_get_search_index (CcShellModel *model);
+
+gboolean cc_shell_model_load_settings (CcShellModel *model);
+
+gboolean cc_shell_model_get_iter_for_entry (CcShellModel *model,
+                                            guint         entry,
+                                            GtkTreeIter  *iter);
 
-gboolean cc_shell_model_iter_matches_search (CcShellModel *model,
-                                             GtkTreeIter  *iter,
-                                             const char   *term);
+gboolean cc_shell_model_get_iter_for_id (CcShellModel *model,
+                                         const char   *id,
+                                         GtkTreeIter  *iter);
 
 G_END_DECLS
 
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "cc-shell-panel-cache.h"
+#include "cc-mapped-cache.h"
+
+struct _CcShellPanelCache
+{
+  GMappedFile              *file;
+  const CcPanelCacheRecord *records;
+  guint                     n_records;
+  const char               *strings;
+  guint32                   strings_size;
+};
+
+static gint64
+get_mtime (const char *path)
+{
+  GStatBuf buf;
+
+  if (g_stat (path, &buf) != 0)
+    return 0;
+
+  return buf.st_mtime;
+}
+
+static gboolean
+check_string (CcShellPanelCache *cache,
+              guint32            offset)
+{
+  return cc_mapped_cache_check_string (cache->strings_size, offset);
+}
+
+static gboolean
+check_sources (CcShellPanelCache        *cache,
+               const CcPanelCacheSource *sources,
+               guint                     n_sources)
+{
+  guint i;
+
+  for (i = 0; i < n_sources; i++)
+    {
+      if (!check_string (cache, sources[i].path) ||
+          get_mtime (cache->strings + sources[i].path) != sources[i].mtime)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+check_records (CcShellPanelCache *cache)
+{
+  guint i;
+
+  for (i = 0; i < cache->n_records; i++)
+    {
+      const CcPanelCacheRecord *record = &cache->records[i];
+
+      if (!check_string (cache, record->id) ||
+          !check_string (cache, record->name) ||
+          !check_string (cache, record->description) ||
+          !check_string (cache, record->icon) ||
+          !check_string (cache, record->casefolded_name) ||
+          !check_string (cache, record->casefolded_description) ||
+          !check_string (cache, record->casefolded_keywords))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * cc_shell_panel_cache_open:
+ * @path: the cache file
+ * @key: the key the cache must have been written with
+ * @error: return location for a #GError
+ *
+ * Returns: the cache, or %NULL if it is missing, invalid or out of date
+ */
+CcShellPanelCache *
+cc_shell_panel_cache_open (const char  *path,
+                           const char  *key,
+                           GError     **error)
+{
+  CcShellPanelCache *cache;
+  const CcPanelCacheHeader *header;
+  GMappedFile *file;
+  const char *contents;
+  gsize length;
+
+  file = g_mapped_file_new (path, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  contents = g_mapped_file_get_contents (file);
+  length = g_mapped_file_get_length (file);
+  header = (const CcPanelCacheHeader *) contents;
+
+  if (!cc_mapped_cache_check_magic (contents, length, sizeof (CcPanelCacheHeader),
+                                    CC_PANEL_CACHE_MAGIC) ||
+      !cc_mapped_cache_check_array (length, header->sources_offset, header->n_sources,
+                                    sizeof (CcPanelCacheSource), sizeof (gint64)) ||
+      !cc_mapped_cache_check_array (length, header->records_offset, header->n_records,
+                                    sizeof (CcPanelCacheRecord), sizeof (guint32)) ||
+      !cc_mapped_cache_check_strings (contents, length,
+                                      header->strings_offset, header->strings_size))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Invalid panel cache '%s'", path);
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  cache = g_slice_new0 (CcShellPanelCache);
+  cache->file = file;
+  cache->records = (const CcPanelCacheRecord *) (contents + header->records_offset);
+  cache->n_records = header->n_records;
+  cache->strings = contents + header->strings_offset;
+  cache->strings_size = header->strings_size;
+
+  if (!check_records (cache) || !check_string (cache, header->key))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Invalid panel cache '%s'", path);
+      cc_shell_panel_cache_free (cache);
+      return NULL;
+    }
+
+  if (strcmp (cache->strings + header->key, key) != 0 ||
+      !check_sources (cache,
+                      (const CcPanelCacheSource *) (contents + header->sources_offset),
+                      header->n_sources))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Panel cache '%s' is out of date", path);
+      cc_shell_panel_cache_free (cache);
+      return NULL;
+    }
+
+  return cache;
+}
+
+void
+cc_shell_panel_cache_free (CcShellPanelCache *cache)
+{
+  if (cache == NULL)
+    return;
+
+  g_mapped_file_unref (cache->file);
+  g_slice_free (CcShellPanelCache, cache);
+}
+
+guint
+cc_shell_panel_cache_get_n_entries (CcShellPanelCache *cache)
+{
+  return cache->n_records;
+}
+
+/**
+ * cc_shell_panel_cache_get_entry:
+ * @cache: a #CcShellPanelCache
+ * @entry: the index of the entry
+ * @out: (out caller-allocates): the entry, with strings owned by @cache
+ */
+void
+cc_shell_panel_cache_get_entry (CcShellPanelCache      *cache,
+                                guint                   entry,
+                                CcShellPanelCacheEntry *out)
+{
+  const CcPanelCacheRecord *r;
+
+  g_return_if_fail (entry < cache->n_records);
+
+  r = &cache->records[entry];
+
+  out->id = cache->strings + r->id;
+  out->category = r->category;
+  out->name = cache->strings + r->name;
+  out->description = cache->strings + r->description;
+  out->icon = cache->strings + r->icon;
+  out->casefolded_name = cache->strings + r->casefolded_name;
+  out->casefolded_description = cache->strings + r->casefolded_description;
+  out->casefolded_keywords = cache->strings + r->casefolded_keywords;
+}
+
+/**
+ * cc_shell_panel_cache_write:
+ * @path: the cache file
+ * @key: the key to open the cache with
+ * @sources: the files which invalidate the cache when they change
+ * @entries: the entries to write
+ * @n_entries: the number of entries
+ * @error: return location for a #GError
+ *
+ * Atomically replaces the cache file, so that processes which have the
+ * previous one mapped are not affected.
+ */
+gboolean
+cc_shell_panel_cache_write (const char                   *path,
+                            const char                   *key,
+                            const char * const           *sources,
+                            const CcShellPanelCacheEntry *entries,
+                            guint                         n_entries,
+                            GError                      **error)
+{
+  CcPanelCacheHeader header;
+  GArray *source_array, *records;
+  CcStringPool pool;
+  GString *output;
+  char *dir;
+  gboolean ret;
+  guint i;
+
+  source_array = g_array_new (FALSE, TRUE, sizeof (CcPanelCacheSource));
+  records = g_array_sized_new (FALSE, TRUE, sizeof (CcPanelCacheRecord), n_entries);
+  cc_string_pool_init (&pool);
+
+  for (i = 0; sources[i] != NULL; i++)
+    {
+      CcPanelCacheSource source;
+
+      memset (&source, 0, sizeof (source));
+      source.path = cc_string_pool_add (&pool, sources[i]);
+      source.mtime = get_mtime (sources[i]);
+      g_array_append_val (source_array, source);
+    }
+
+  for (i = 0; i < n_entries; i++)
+    {
+      const CcShellPanelCacheEntry *entry = &entries[i];
+      CcPanelCacheRecord record;
+
+      record.id = cc_string_pool_add (&pool, entry->id);
+      record.category = entry->category;
+      record.name = cc_string_pool_add (&pool, entry->name);
+      record.description = cc_string_pool_add (&pool, entry->description);
+      record.icon = cc_string_pool_add (&pool, entry->icon);
+      record.casefolded_name = cc_string_pool_add (&pool, entry->casefolded_name);
+      record.casefolded_description = cc_string_pool_add (&pool, entry->casefolded_description);
+      record.casefolded_keywords = cc_string_pool_add (&pool, entry->casefolded_keywords);
+      g_array_append_val (records, record);
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, CC_PANEL_CACHE_MAGIC, sizeof (header.magic));
+  header.key = cc_string_pool_add (&pool, key);
+  header.n_sources = source_array->len;
+  header.sources_offset = sizeof (header);
+  header.n_records = records->len;
+  header.records_offset = header.sources_offset + source_array->len * sizeof (CcPanelCacheSource);
+  header.strings_offset = header.records_offset + records->len * sizeof (CcPanelCacheRecord);
+  header.strings_size = pool.strings->len;
+
+  output = g_string_new_len ((const char *) &header, sizeof (header));
+  g_string_append_len (output, source_array->data, source_array->len * sizeof (CcPanelCacheSource));
+  g_string_append_len (output, records->data, records->len * sizeof (CcPanelCacheRecord));
+  g_string_append_len (output, pool.strings->str, pool.strings->len);
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0700);
+  g_free (dir);
+
+  ret = g_file_set_contents (path, output->str, output->len, error);
+
+  g_string_free (output, TRUE);
+  cc_string_pool_clear (&pool);
+  g_array_free (records, TRUE);
+  g_array_free (source_array, TRUE);
+
+  return ret;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CC_SHELL_PANEL_CACHE_H
+#define _CC_SHELL_PANEL_CACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The panel cache holds what the shell and the search provider need from
+ * the panels' desktop files, with the names, descriptions and keywords
+ * already normalized. It is written to the user cache directory the first
+ * time the desktop files are read and mapped as is afterwards:
+ *
+ *   CcPanelCacheHeader
+ *   CcPanelCacheSource[n_sources]
+ *   CcPanelCacheRecord[n_records]
+ *   string pool, starting with an empty string
+ *
+ * The cache is only valid for the key it was written with, which covers
+ * the version and the languages, and as long as none of the sources, the
+ * desktop files and the directories they are looked up in, changed. All
+ * offsets are in bytes, strings are referenced by their offset in the
+ * pool, and the file uses the byte order of the machine it was written on. */
+
+#define CC_PANEL_CACHE_MAGIC "CCPANEL1"
+
+typedef struct {
+  gchar   magic[8];
+  guint32 key;
+  guint32 n_sources;
+  guint32 sources_offset;
+  guint32 n_records;
+  guint32 records_offset;
+  guint32 strings_offset;
+  guint32 strings_size;
+  guint32 padding;
+} CcPanelCacheHeader;
+
+typedef struct {
+  guint32 path;
+  guint32 padding;
+  gint64  mtime; /* 0 if the file did not exist */
+} CcPanelCacheSource;
+
+typedef struct {
+  guint32 id;
+  guint32 category;
+  guint32 name;
+  guint32 description;
+  guint32 icon;                   /* as from g_icon_to_string() */
+  guint32 casefolded_name;
+  guint32 casefolded_description;
+  guint32 casefolded_keywords;    /* separated by newlines */
+} CcPanelCacheRecord;
+
+typedef struct {
+  const char *id;
+  guint       category;
+  const char *name;
+  const char *description;
+  const char *icon;
+  const char *casefolded_name;
+  const char *casefolded_description;
+  const char *casefolded_keywords;
+} CcShellPanelCacheEntry;
+
+typedef struct _CcShellPanelCache CcShellPanelCache;
+
+CcShellPanelCache *cc_shell_panel_cache_open          (const char                   *path,
+                                                       const char                   *key,
+                                                       GError                      **error);
+void               cc_shell_panel_cache_free          (CcShellPanelCache            *cache);
+guint              cc_shell_panel_cache_get_n_entries (CcShellPanelCache            *cache);
+void               cc_shell_panel_cache_get_entry     (CcShellPanelCache            *cache,
+                                                       guint                         entry,
+                                                       CcShellPanelCacheEntry       *out);
+
+gboolean           cc_shell_panel_cache_write         (const char                   *path,
+                                                       const char                   *key,
+                                                       const char * const           *sources,
+                                                       const CcShellPanelCacheEntry *entries,
+                                                       guint                         n_entries,
+                                                       GError                      **error);
+
+G_END_DECLS
+
+#endif /* _CC_SHELL_PANEL_CACHE_H */
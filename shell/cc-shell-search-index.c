@@ -0,0 +1,989 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+
+#include "cc-shell-search-index.h"
+
+/* The index keeps two posting tables, each mapping a string to the sorted
+ * list of entries containing it:
+ *
+ *  - grams: every substring of up to CC_SHELL_SEARCH_INDEX_GRAM_LEN
+ *    characters of the casefolded name and description, so that short
+ *    terms are a single lookup and longer ones only need to verify the
+ *    candidates sharing all of their trigrams;
+ *  - prefixes: every prefix of every casefolded keyword, since keywords
+ *    only ever match at their start.
+ *
+ * Entries are numbered in the order they are added, which keeps each
+ * posting list sorted without any extra work.
+ *
+ * Matching entries are then ranked by how well each term matches: an exact
+ * name beats a name prefix, which beats a keyword prefix, a substring of the
+ * name and finally a substring of the description. Terms found close to
+ * each other in the same field get a bonus. */
+
+#define SCORE_EXACT_NAME              1000
+#define SCORE_NAME_PREFIX              600
+#define SCORE_NAME_WORD_PREFIX         500
+#define SCORE_KEYWORD_PREFIX           400
+#define SCORE_NAME_SUBSTRING           250
+#define SCORE_DESCRIPTION_WORD_PREFIX  150
+#define SCORE_DESCRIPTION_SUBSTRING    100
+#define SCORE_PROXIMITY_MAX             50
+
+typedef struct
+{
+  char  *id;
+  char  *name;
+  char  *description;
+  char **keywords;
+} IndexEntry;
+
+struct _CcShellSearchIndex
+{
+  GArray     *entries;
+  GHashTable *ids;
+  GHashTable *grams;
+  GHashTable *prefixes;
+
+  /* Last computed score of each entry, used while ranking */
+  GArray     *scores;
+};
+
+CcShellSearchIndex *
+cc_shell_search_index_new (void)
+{
+  CcShellSearchIndex *index;
+
+  index = g_slice_new0 (CcShellSearchIndex);
+  index->entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+  index->ids = g_hash_table_new (g_str_hash, g_str_equal);
+  index->grams = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, (GDestroyNotify) g_array_unref);
+  index->prefixes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, (GDestroyNotify) g_array_unref);
+  index->scores = g_array_new (FALSE, TRUE, sizeof (guint));
+
+  return index;
+}
+
+void
+cc_shell_search_index_free (CcShellSearchIndex *index)
+{
+  guint i;
+
+  if (index == NULL)
+    return;
+
+  for (i = 0; i < index->entries->len; i++)
+    {
+      IndexEntry *entry = &g_array_index (index->entries, IndexEntry, i);
+
+      g_free (entry->id);
+      g_free (entry->name);
+      g_free (entry->description);
+      g_strfreev (entry->keywords);
+    }
+
+  g_array_unref (index->entries);
+  g_hash_table_destroy (index->ids);
+  g_hash_table_destroy (index->grams);
+  g_hash_table_destroy (index->prefixes);
+  g_array_unref (index->scores);
+
+  g_slice_free (CcShellSearchIndex, index);
+}
+
+static void
+posting_add (GHashTable *table,
+             const char *key,
+             gsize       len,
+             guint       entry)
+{
+  GArray *postings;
+  char *str;
+
+  str = g_strndup (key, len);
+  postings = g_hash_table_lookup (table, str);
+  if (postings == NULL)
+    {
+      postings = g_array_new (FALSE, FALSE, sizeof (guint));
+      g_hash_table_insert (table, str, postings);
+    }
+  else
+    {
+      g_free (str);
+    }
+
+  /* Entries are added in increasing order, so a duplicate
+   * can only ever be the last element */
+  if (postings->len > 0 &&
+      g_array_index (postings, guint, postings->len - 1) == entry)
+    return;
+
+  g_array_append_val (postings, entry);
+}
+
+static void
+index_grams (GHashTable *table,
+             const char *str,
+             guint       entry)
+{
+  const char *p, *end;
+  int n;
+
+  if (str == NULL)
+    return;
+
+  for (p = str; *p != '\0'; p = g_utf8_next_char (p))
+    {
+      end = p;
+      for (n = 0; n < CC_SHELL_SEARCH_INDEX_GRAM_LEN && *end != '\0'; n++)
+        {
+          end = g_utf8_next_char (end);
+          posting_add (table, p, end - p, entry);
+        }
+    }
+}
+
+static void
+index_prefixes (GHashTable *table,
+                const char *str,
+                guint       entry)
+{
+  const char *end;
+
+  if (str == NULL)
+    return;
+
+  for (end = str; *end != '\0'; )
+    {
+      end = g_utf8_next_char (end);
+      posting_add (table, str, end - str, entry);
+    }
+}
+
+guint
+cc_shell_search_index_add (CcShellSearchIndex *index,
+                           const char         *id,
+                           const char         *casefolded_name,
+                           const char         *casefolded_description,
+                           const char * const *casefolded_keywords)
+{
+  IndexEntry entry;
+  guint n, i;
+
+  g_return_val_if_fail (index != NULL, 0);
+  g_return_val_if_fail (id != NULL, 0);
+
+  n = index->entries->len;
+
+  entry.id = g_strdup (id);
+  entry.name = g_strdup (casefolded_name ? casefolded_name : "");
+  entry.description = g_strdup (casefolded_description);
+  entry.keywords = g_strdupv ((char **) casefolded_keywords);
+  g_array_append_val (index->entries, entry);
+  g_array_set_size (index->scores, index->entries->len);
+
+  g_hash_table_insert (index->ids, entry.id, GUINT_TO_POINTER (n + 1));
+
+  index_grams (index->grams, entry.name, n);
+  index_grams (index->grams, entry.description, n);
+  for (i = 0; entry.keywords && entry.keywords[i]; i++)
+    index_prefixes (index->prefixes, entry.keywords[i], n);
+
+  return n;
+}
+
+guint
+cc_shell_search_index_get_n_entries (CcShellSearchIndex *index)
+{
+  return index->entries->len;
+}
+
+const char *
+cc_shell_search_index_get_id (CcShellSearchIndex *index,
+                              guint               entry)
+{
+  g_return_val_if_fail (entry < index->entries->len, NULL);
+
+  return g_array_index (index->entries, IndexEntry, entry).id;
+}
+
+gboolean
+cc_shell_search_index_lookup_id (CcShellSearchIndex *index,
+                                 const char         *id,
+                                 guint              *entry)
+{
+  guint n;
+
+  n = GPOINTER_TO_UINT (g_hash_table_lookup (index->ids, id));
+  if (n == 0)
+    return FALSE;
+
+  if (entry)
+    *entry = n - 1;
+  return TRUE;
+}
+
+/* Where a term matched in an entry, used as a hint when the term grows */
+typedef struct
+{
+  guint16 field;
+  guint16 offset;
+} TermMatch;
+
+#define FIELD_NAME        0
+#define FIELD_DESCRIPTION 1
+#define FIELD_KEYWORD     2 /* + keyword number */
+
+static const char *
+entry_get_field (IndexEntry *e,
+                 guint       field)
+{
+  if (field == FIELD_NAME)
+    return e->name;
+  if (field == FIELD_DESCRIPTION)
+    return e->description;
+  if (e->keywords == NULL)
+    return NULL;
+  /* keywords are NULL terminated, so out of range fields fail */
+  if (field - FIELD_KEYWORD >= g_strv_length (e->keywords))
+    return NULL;
+  return e->keywords[field - FIELD_KEYWORD];
+}
+
+static gboolean
+entry_match (IndexEntry      *e,
+             const char      *term,
+             const TermMatch *hint,
+             TermMatch       *match)
+{
+  const char *p;
+  int i;
+
+  /* A longer term most often still matches where its prefix did */
+  if (hint != NULL)
+    {
+      p = entry_get_field (e, hint->field);
+      if (p != NULL && strlen (p) >= hint->offset &&
+          g_str_has_prefix (p + hint->offset, term))
+        {
+          if (match)
+            *match = *hint;
+          return TRUE;
+        }
+    }
+
+  p = strstr (e->name, term);
+  if (p != NULL)
+    {
+      if (match)
+        {
+          match->field = FIELD_NAME;
+          match->offset = p - e->name;
+        }
+      return TRUE;
+    }
+
+  p = e->description ? strstr (e->description, term) : NULL;
+  if (p != NULL)
+    {
+      if (match)
+        {
+          match->field = FIELD_DESCRIPTION;
+          match->offset = p - e->description;
+        }
+      return TRUE;
+    }
+
+  for (i = 0; e->keywords && e->keywords[i]; i++)
+    {
+      if (g_str_has_prefix (e->keywords[i], term))
+        {
+          if (match)
+            {
+              match->field = FIELD_KEYWORD + i;
+              match->offset = 0;
+            }
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+gboolean
+cc_shell_search_index_entry_matches (CcShellSearchIndex *index,
+                                     guint               entry,
+                                     const char         *term)
+{
+  g_return_val_if_fail (entry < index->entries->len, FALSE);
+
+  return entry_match (&g_array_index (index->entries, IndexEntry, entry),
+                      term, NULL, NULL);
+}
+
+/* Keeps in @dest only the entries also present in @other */
+static void
+intersect_into (GArray *dest,
+                GArray *other)
+{
+  guint i = 0, j = 0, k = 0;
+
+  while (i < dest->len && j < other->len)
+    {
+      guint a = g_array_index (dest, guint, i);
+      guint b = g_array_index (other, guint, j);
+
+      if (a < b)
+        i++;
+      else if (a > b)
+        j++;
+      else
+        {
+          g_array_index (dest, guint, k++) = a;
+          i++;
+          j++;
+        }
+    }
+
+  g_array_set_size (dest, k);
+}
+
+/* Adds to @dest the entries of @other it does not contain yet */
+static void
+union_into (GArray *dest,
+            GArray *other,
+            GArray *tmp)
+{
+  guint i = 0, j = 0;
+
+  g_array_set_size (tmp, 0);
+
+  while (i < dest->len || j < other->len)
+    {
+      guint a = i < dest->len ? g_array_index (dest, guint, i) : G_MAXUINT;
+      guint b = j < other->len ? g_array_index (other, guint, j) : G_MAXUINT;
+
+      if (a <= b)
+        {
+          g_array_append_val (tmp, a);
+          i++;
+          if (a == b)
+            j++;
+        }
+      else
+        {
+          g_array_append_val (tmp, b);
+          j++;
+        }
+    }
+
+  g_array_set_size (dest, 0);
+  g_array_append_vals (dest, tmp->data, tmp->len);
+}
+
+static void
+query_substring (CcShellSearchIndex *index,
+                 const char         *term,
+                 GArray             *results)
+{
+  GArray *postings;
+  const char *p, *end;
+  char gram[CC_SHELL_SEARCH_INDEX_GRAM_LEN * 6 + 1];
+  gboolean first;
+  guint i, k;
+  int n;
+
+  if (g_utf8_strlen (term, -1) <= CC_SHELL_SEARCH_INDEX_GRAM_LEN)
+    {
+      postings = g_hash_table_lookup (index->grams, term);
+      if (postings)
+        g_array_append_vals (results, postings->data, postings->len);
+      return;
+    }
+
+  /* Only entries sharing every trigram of the term can contain it */
+  first = TRUE;
+  for (p = term; *p != '\0'; p = g_utf8_next_char (p))
+    {
+      end = p;
+      for (n = 0; n < CC_SHELL_SEARCH_INDEX_GRAM_LEN && *end != '\0'; n++)
+        end = g_utf8_next_char (end);
+      if (n < CC_SHELL_SEARCH_INDEX_GRAM_LEN)
+        break;
+
+      memcpy (gram, p, end - p);
+      gram[end - p] = '\0';
+
+      postings = g_hash_table_lookup (index->grams, gram);
+      if (postings == NULL)
+        {
+          g_array_set_size (results, 0);
+          return;
+        }
+
+      if (first)
+        {
+          g_array_append_vals (results, postings->data, postings->len);
+          first = FALSE;
+        }
+      else
+        {
+          intersect_into (results, postings);
+        }
+
+      if (results->len == 0)
+        return;
+    }
+
+  /* ...but sharing them does not mean they are contiguous */
+  for (i = 0, k = 0; i < results->len; i++)
+    {
+      guint entry = g_array_index (results, guint, i);
+      IndexEntry *e = &g_array_index (index->entries, IndexEntry, entry);
+
+      if (strstr (e->name, term) != NULL ||
+          (e->description && strstr (e->description, term) != NULL))
+        g_array_index (results, guint, k++) = entry;
+    }
+  g_array_set_size (results, k);
+}
+
+static void
+query_term (CcShellSearchIndex *index,
+            const char         *term,
+            GArray             *results,
+            GArray             *tmp)
+{
+  GArray *postings;
+
+  g_array_set_size (results, 0);
+
+  query_substring (index, term, results);
+
+  postings = g_hash_table_lookup (index->prefixes, term);
+  if (postings)
+    union_into (results, postings, tmp);
+}
+
+void
+cc_shell_search_index_query (CcShellSearchIndex *index,
+                             const char * const *terms,
+                             GArray             *results)
+{
+  GArray *term_results, *tmp;
+  gboolean first = TRUE;
+  guint i;
+
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (results != NULL);
+
+  g_array_set_size (results, 0);
+
+  term_results = g_array_new (FALSE, FALSE, sizeof (guint));
+  tmp = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (i = 0; terms && terms[i]; i++)
+    {
+      /* Empty terms match everything */
+      if (*terms[i] == '\0')
+        continue;
+
+      query_term (index, terms[i], term_results, tmp);
+
+      if (first)
+        {
+          g_array_append_vals (results, term_results->data, term_results->len);
+          first = FALSE;
+        }
+      else
+        {
+          intersect_into (results, term_results);
+        }
+
+      if (results->len == 0)
+        break;
+    }
+
+  if (first)
+    {
+      for (i = 0; i < index->entries->len; i++)
+        g_array_append_val (results, i);
+    }
+
+  g_array_unref (term_results);
+  g_array_unref (tmp);
+}
+
+gboolean
+cc_shell_search_index_results_contain (GArray *results,
+                                       guint   entry)
+{
+  guint lo = 0, hi = results->len;
+
+  while (lo < hi)
+    {
+      guint mid = (lo + hi) / 2;
+      guint value = g_array_index (results, guint, mid);
+
+      if (value == entry)
+        return TRUE;
+      else if (value < entry)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+is_word_start (const char *str,
+               const char *p)
+{
+  const char *prev;
+
+  if (p == str)
+    return TRUE;
+
+  prev = g_utf8_prev_char (p);
+  return !g_unichar_isalnum (g_utf8_get_char (prev));
+}
+
+/* Finds @term in @str, preferring an occurrence at the start of a word.
+ * Returns the byte offset of the match or -1 */
+static gssize
+find_term (const char *str,
+           const char *term,
+           gboolean   *word_start)
+{
+  const char *p, *first;
+
+  *word_start = FALSE;
+
+  if (str == NULL)
+    return -1;
+
+  first = p = strstr (str, term);
+  while (p != NULL)
+    {
+      if (is_word_start (str, p))
+        {
+          *word_start = TRUE;
+          return p - str;
+        }
+      p = strstr (g_utf8_next_char (p), term);
+    }
+
+  return first ? first - str : -1;
+}
+
+/* Whether @name is exactly the terms separated by single spaces */
+static gboolean
+name_equals_terms (const char         *name,
+                   const char * const *terms)
+{
+  const char *p = name;
+  gboolean first = TRUE;
+  guint i;
+
+  for (i = 0; terms[i]; i++)
+    {
+      gsize len;
+
+      if (*terms[i] == '\0')
+        continue;
+
+      if (!first)
+        {
+          if (*p != ' ')
+            return FALSE;
+          p++;
+        }
+      first = FALSE;
+
+      len = strlen (terms[i]);
+      if (strncmp (p, terms[i], len) != 0)
+        return FALSE;
+      p += len;
+    }
+
+  return !first && *p == '\0';
+}
+
+static guint
+proximity_bonus (gssize previous_end,
+                 gssize position)
+{
+  gssize distance;
+
+  if (previous_end < 0 || position < 0)
+    return 0;
+
+  distance = ABS (position - previous_end);
+  return distance < SCORE_PROXIMITY_MAX ? SCORE_PROXIMITY_MAX - distance : 0;
+}
+
+guint
+cc_shell_search_index_score (CcShellSearchIndex *index,
+                             guint               entry,
+                             const char * const *terms)
+{
+  IndexEntry *e;
+  gssize name_end = -1, description_end = -1;
+  guint score = 0;
+  guint i;
+
+  g_return_val_if_fail (entry < index->entries->len, 0);
+
+  e = &g_array_index (index->entries, IndexEntry, entry);
+
+  if (name_equals_terms (e->name, terms))
+    return SCORE_EXACT_NAME * g_strv_length ((char **) terms);
+
+  for (i = 0; terms[i]; i++)
+    {
+      const char *term = terms[i];
+      gssize name_pos, description_pos;
+      gboolean name_word, description_word;
+      guint term_score = 0;
+      gsize len;
+      int k;
+
+      if (*term == '\0')
+        continue;
+
+      len = strlen (term);
+      name_pos = find_term (e->name, term, &name_word);
+      description_pos = find_term (e->description, term, &description_word);
+
+      if (name_pos == 0 && e->name[len] == '\0')
+        term_score = SCORE_EXACT_NAME;
+      else if (name_pos == 0)
+        term_score = SCORE_NAME_PREFIX;
+      else if (name_word)
+        term_score = SCORE_NAME_WORD_PREFIX;
+
+      if (term_score < SCORE_KEYWORD_PREFIX)
+        {
+          for (k = 0; e->keywords && e->keywords[k]; k++)
+            {
+              if (g_str_has_prefix (e->keywords[k], term))
+                {
+                  term_score = SCORE_KEYWORD_PREFIX;
+                  break;
+                }
+            }
+        }
+
+      if (term_score == 0 && name_pos >= 0)
+        term_score = SCORE_NAME_SUBSTRING;
+      else if (term_score == 0 && description_word)
+        term_score = SCORE_DESCRIPTION_WORD_PREFIX;
+      else if (term_score == 0 && description_pos >= 0)
+        term_score = SCORE_DESCRIPTION_SUBSTRING;
+
+      score += term_score;
+      score += proximity_bonus (name_end, name_pos);
+      score += proximity_bonus (description_end, description_pos);
+
+      name_end = name_pos >= 0 ? name_pos + (gssize) len : -1;
+      description_end = description_pos >= 0 ? description_pos + (gssize) len : -1;
+    }
+
+  return score;
+}
+
+static gint
+compare_ranked_entries (gconstpointer a,
+                        gconstpointer b,
+                        gpointer      user_data)
+{
+  CcShellSearchIndex *index = user_data;
+  guint entry_a = *(const guint *) a;
+  guint entry_b = *(const guint *) b;
+  guint score_a, score_b;
+
+  score_a = g_array_index (index->scores, guint, entry_a);
+  score_b = g_array_index (index->scores, guint, entry_b);
+
+  if (score_a != score_b)
+    return score_a > score_b ? -1 : 1;
+
+  return g_strcmp0 (g_array_index (index->entries, IndexEntry, entry_a).name,
+                    g_array_index (index->entries, IndexEntry, entry_b).name);
+}
+
+void
+cc_shell_search_index_rank (CcShellSearchIndex *index,
+                            const char * const *terms,
+                            GArray             *results)
+{
+  guint i;
+
+  g_return_if_fail (index != NULL);
+  g_return_if_fail (results != NULL);
+
+  for (i = 0; i < results->len; i++)
+    {
+      guint entry = g_array_index (results, guint, i);
+
+      g_array_index (index->scores, guint, entry) =
+        cc_shell_search_index_score (index, entry, terms);
+    }
+
+  g_array_sort_with_data (results, compare_ranked_entries, index);
+}
+
+guint
+cc_shell_search_index_get_score (CcShellSearchIndex *index,
+                                 guint               entry)
+{
+  g_return_val_if_fail (entry < index->scores->len, 0);
+
+  return g_array_index (index->scores, guint, entry);
+}
+
+/* CcShellSearchQuery keeps the state of the query being typed: the
+ * entries matching all of its terms, and where each term matched in each
+ * of them. When every previous term is a prefix of one of the new terms,
+ * the new matches can only be a subset of the previous ones, so only the
+ * previous candidates are re-checked, starting where their terms matched. */
+
+struct _CcShellSearchQuery
+{
+  CcShellSearchIndex *index;
+
+  gboolean  valid;
+  char    **terms;
+  guint     n_terms;
+  GArray   *candidates; /* sorted entries */
+  GArray   *matches;    /* TermMatch, n_terms per candidate */
+  GArray   *ranked;     /* candidates, best first */
+};
+
+CcShellSearchQuery *
+cc_shell_search_query_new (CcShellSearchIndex *index)
+{
+  CcShellSearchQuery *query;
+
+  g_return_val_if_fail (index != NULL, NULL);
+
+  query = g_slice_new0 (CcShellSearchQuery);
+  query->index = index;
+  query->terms = g_new0 (char *, 1);
+  query->candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+  query->matches = g_array_new (FALSE, FALSE, sizeof (TermMatch));
+  query->ranked = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return query;
+}
+
+void
+cc_shell_search_query_free (CcShellSearchQuery *query)
+{
+  if (query == NULL)
+    return;
+
+  g_strfreev (query->terms);
+  g_array_unref (query->candidates);
+  g_array_unref (query->matches);
+  g_array_unref (query->ranked);
+
+  g_slice_free (CcShellSearchQuery, query);
+}
+
+void
+cc_shell_search_query_reset (CcShellSearchQuery *query)
+{
+  query->valid = FALSE;
+  g_strfreev (query->terms);
+  query->terms = g_new0 (char *, 1);
+  query->n_terms = 0;
+  g_array_set_size (query->candidates, 0);
+  g_array_set_size (query->matches, 0);
+  g_array_set_size (query->ranked, 0);
+}
+
+static char **
+dup_non_empty_terms (const char * const *terms)
+{
+  GPtrArray *array;
+  guint i;
+
+  array = g_ptr_array_new ();
+  for (i = 0; terms && terms[i]; i++)
+    {
+      if (*terms[i] != '\0')
+        g_ptr_array_add (array, g_strdup (terms[i]));
+    }
+  g_ptr_array_add (array, NULL);
+
+  return (char **) g_ptr_array_free (array, FALSE);
+}
+
+/* For each new term, finds a previous term it extends, or -1 */
+static gboolean
+get_extended_terms (CcShellSearchQuery  *query,
+                    char               **terms,
+                    gint                *extends)
+{
+  gboolean *extended;
+  gboolean ret = TRUE;
+  guint i, j;
+
+  extended = g_newa (gboolean, query->n_terms + 1);
+  memset (extended, 0, sizeof (gboolean) * (query->n_terms + 1));
+
+  for (i = 0; terms[i]; i++)
+    {
+      extends[i] = -1;
+      for (j = 0; j < query->n_terms; j++)
+        {
+          if (g_str_has_prefix (terms[i], query->terms[j]))
+            {
+              if (extends[i] < 0)
+                extends[i] = j;
+              extended[j] = TRUE;
+            }
+        }
+    }
+
+  for (j = 0; j < query->n_terms; j++)
+    ret = ret && extended[j];
+
+  return ret;
+}
+
+gboolean
+cc_shell_search_query_update (CcShellSearchQuery *query,
+                              const char * const *terms,
+                              GArray             *removed)
+{
+  char **new_terms;
+  guint n_new;
+  gint *extends;
+  gboolean narrowing;
+  GArray *candidates, *matches;
+  guint i, t;
+
+  g_return_val_if_fail (query != NULL, FALSE);
+
+  new_terms = dup_non_empty_terms (terms);
+  n_new = g_strv_length (new_terms);
+  extends = g_new (gint, n_new + 1);
+
+  narrowing = query->valid && get_extended_terms (query, new_terms, extends);
+
+  if (removed)
+    g_array_set_size (removed, 0);
+
+  candidates = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+                                  narrowing ? query->candidates->len : 0);
+  matches = g_array_new (FALSE, FALSE, sizeof (TermMatch));
+
+  if (narrowing)
+    {
+      for (i = 0; i < query->candidates->len; i++)
+        {
+          guint entry = g_array_index (query->candidates, guint, i);
+          IndexEntry *e = &g_array_index (query->index->entries, IndexEntry, entry);
+          guint n_matches = matches->len;
+          gboolean ok = TRUE;
+
+          for (t = 0; ok && t < n_new; t++)
+            {
+              const TermMatch *hint = NULL;
+              TermMatch match;
+
+              if (extends[t] >= 0)
+                hint = &g_array_index (query->matches, TermMatch,
+                                       i * query->n_terms + extends[t]);
+
+              ok = entry_match (e, new_terms[t], hint, &match);
+              if (ok)
+                g_array_append_val (matches, match);
+            }
+
+          if (ok)
+            {
+              g_array_append_val (candidates, entry);
+            }
+          else
+            {
+              g_array_set_size (matches, n_matches);
+              if (removed)
+                g_array_append_val (removed, entry);
+            }
+        }
+    }
+  else
+    {
+      cc_shell_search_index_query (query->index, (const char * const *) new_terms,
+                                   candidates);
+
+      for (i = 0; i < candidates->len; i++)
+        {
+          guint entry = g_array_index (candidates, guint, i);
+          IndexEntry *e = &g_array_index (query->index->entries, IndexEntry, entry);
+
+          for (t = 0; t < n_new; t++)
+            {
+              TermMatch match = { 0, 0 };
+
+              entry_match (e, new_terms[t], NULL, &match);
+              g_array_append_val (matches, match);
+            }
+        }
+    }
+
+  g_strfreev (query->terms);
+  query->terms = new_terms;
+  query->n_terms = n_new;
+  g_array_unref (query->candidates);
+  query->candidates = candidates;
+  g_array_unref (query->matches);
+  query->matches = matches;
+  query->valid = TRUE;
+
+  g_array_set_size (query->ranked, 0);
+  g_array_append_vals (query->ranked, candidates->data, candidates->len);
+  cc_shell_search_index_rank (query->index, (const char * const *) new_terms,
+                              query->ranked);
+
+  g_free (extends);
+
+  return narrowing;
+}
+
+gboolean
+cc_shell_search_query_contains (CcShellSearchQuery *query,
+                                guint               entry)
+{
+  return cc_shell_search_index_results_contain (query->candidates, entry);
+}
+
+GArray *
+cc_shell_search_query_get_results (CcShellSearchQuery *query)
+{
+  return query->ranked;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CC_SHELL_SEARCH_INDEX_H
+#define _CC_SHELL_SEARCH_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Maximum length, in characters, of the n-grams indexed for the name and
+ * description of each entry. Terms up to this length are answered by a
+ * single lookup, longer terms intersect the postings of their trigrams. */
+#define CC_SHELL_SEARCH_INDEX_GRAM_LEN 3
+
+typedef struct _CcShellSearchIndex CcShellSearchIndex;
+typedef struct _CcShellSearchQuery CcShellSearchQuery;
+
+CcShellSearchIndex *cc_shell_search_index_new            (void);
+void                cc_shell_search_index_free           (CcShellSearchIndex  *index);
+
+guint               cc_shell_search_index_add            (CcShellSearchIndex  *index,
+                                                          const char          *id,
+                                                          const char          *casefolded_name,
+                                                          const char          *casefolded_description,
+                                                          const char * const  *casefolded_keywords);
+
+guint               cc_shell_search_index_get_n_entries  (CcShellSearchIndex  *index);
+const char         *cc_shell_search_index_get_id         (CcShellSearchIndex  *index,
+                                                          guint                entry);
+gboolean            cc_shell_search_index_lookup_id      (CcShellSearchIndex  *index,
+                                                          const char          *id,
+                                                          guint               *entry);
+
+gboolean            cc_shell_search_index_entry_matches  (CcShellSearchIndex  *index,
+                                                          guint                entry,
+                                                          const char          *term);
+void                cc_shell_search_index_query          (CcShellSearchIndex  *index,
+                                                          const char * const  *terms,
+                                                          GArray              *results);
+
+gboolean            cc_shell_search_index_results_contain (GArray             *results,
+                                                           guint               entry);
+
+guint               cc_shell_search_index_score          (CcShellSearchIndex  *index,
+                                                          guint                entry,
+                                                          const char * const  *terms);
+void                cc_shell_search_index_rank           (CcShellSearchIndex  *index,
+                                                          const char * const  *terms,
+                                                          GArray              *results);
+guint               cc_shell_search_index_get_score      (CcShellSearchIndex  *index,
+                                                          guint                entry);
+
+CcShellSearchQuery *cc_shell_search_query_new            (CcShellSearchIndex  *index);
+void                cc_shell_search_query_free           (CcShellSearchQuery  *query);
+void                cc_shell_search_query_reset          (CcShellSearchQuery  *query);
+gboolean            cc_shell_search_query_update         (CcShellSearchQuery  *query,
+                                                          const char * const  *terms,
+                                                          GArray              *removed);
+gboolean            cc_shell_search_query_contains       (CcShellSearchQuery  *query,
+                                                          guint                entry);
+GArray             *cc_shell_search_query_get_results    (CcShellSearchQuery  *query);
+
+G_END_DECLS
+
+#endif /* _CC_SHELL_SEARCH_INDEX_H */
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+
+#include "cc-shell-settings-index.h"
+#include "cc-mapped-cache.h"
+
+struct _CcShellSettingsIndex
+{
+  GMappedFile                 *file;
+  const CcSettingsIndexRecord *records;
+  guint                        n_records;
+  const char                  *strings;
+  guint32                      strings_size;
+};
+
+static gboolean
+check_string (CcShellSettingsIndex *index,
+              guint32               offset)
+{
+  return cc_mapped_cache_check_string (index->strings_size, offset);
+}
+
+CcShellSettingsIndex *
+cc_shell_settings_index_open (const char  *path,
+                              GError     **error)
+{
+  CcShellSettingsIndex *index;
+  const CcSettingsIndexHeader *header;
+  GMappedFile *file;
+  const char *contents;
+  gsize length;
+  guint i;
+
+  file = g_mapped_file_new (path, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  contents = g_mapped_file_get_contents (file);
+  length = g_mapped_file_get_length (file);
+  header = (const CcSettingsIndexHeader *) contents;
+
+  if (!cc_mapped_cache_check_magic (contents, length, sizeof (CcSettingsIndexHeader),
+                                    CC_SETTINGS_INDEX_MAGIC) ||
+      !cc_mapped_cache_check_array (length, header->records_offset, header->n_records,
+                                    sizeof (CcSettingsIndexRecord), sizeof (guint32)) ||
+      !cc_mapped_cache_check_strings (contents, length,
+                                      header->strings_offset, header->strings_size))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                   "Invalid settings index '%s'", path);
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  index = g_slice_new0 (CcShellSettingsIndex);
+  index->file = file;
+  index->records = (const CcSettingsIndexRecord *) (contents + header->records_offset);
+  index->n_records = header->n_records;
+  index->strings = contents + header->strings_offset;
+  index->strings_size = header->strings_size;
+
+  for (i = 0; i < index->n_records; i++)
+    {
+      const CcSettingsIndexRecord *record = &index->records[i];
+
+      if (!check_string (index, record->panel) ||
+          !check_string (index, record->widget) ||
+          !check_string (index, record->label) ||
+          !check_string (index, record->context))
+        {
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                       "Invalid record %u in settings index '%s'", i, path);
+          cc_shell_settings_index_free (index);
+          return NULL;
+        }
+    }
+
+  return index;
+}
+
+void
+cc_shell_settings_index_free (CcShellSettingsIndex *index)
+{
+  if (index == NULL)
+    return;
+
+  g_mapped_file_unref (index->file);
+  g_slice_free (CcShellSettingsIndex, index);
+}
+
+guint
+cc_shell_settings_index_get_n_records (CcShellSettingsIndex *index)
+{
+  return index->n_records;
+}
+
+void
+cc_shell_settings_index_get_record (CcShellSettingsIndex  *index,
+                                    guint                  record,
+                                    const char           **panel,
+                                    const char           **widget,
+                                    const char           **label,
+                                    const char           **context)
+{
+  const CcSettingsIndexRecord *r;
+
+  g_return_if_fail (record < index->n_records);
+
+  r = &index->records[record];
+
+  if (panel)
+    *panel = index->strings + r->panel;
+  if (widget)
+    *widget = index->strings + r->widget;
+  if (label)
+    *label = index->strings + r->label;
+  if (context)
+    *context = index->strings + r->context;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CC_SHELL_SETTINGS_INDEX_H
+#define _CC_SHELL_SETTINGS_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The settings index lists the labels of the panels' GtkBuilder files along
+ * with the panel and the widget they belong to. It is generated at build
+ * time by gen-settings-index and mapped as is at runtime:
+ *
+ *   CcSettingsIndexHeader
+ *   CcSettingsIndexRecord[n_records]
+ *   string pool, starting with an empty string
+ *
+ * All offsets are in bytes, strings are referenced by their offset in the
+ * pool, and the file uses the byte order of the machine it was built on. */
+
+#define CC_SETTINGS_INDEX_MAGIC "CCSETIX1"
+
+typedef struct {
+  gchar   magic[8];
+  guint32 n_records;
+  guint32 records_offset;
+  guint32 strings_offset;
+  guint32 strings_size;
+} CcSettingsIndexHeader;
+
+typedef struct {
+  guint32 panel;
+  guint32 widget;
+  guint32 label;
+  guint32 context; /* msgctxt of the label, or the empty string */
+} CcSettingsIndexRecord;
+
+typedef struct _CcShellSettingsIndex CcShellSettingsIndex;
+
+CcShellSettingsIndex *cc_shell_settings_index_open          (const char            *path,
+                                                             GError               **error);
+void                  cc_shell_settings_index_free          (CcShellSettingsIndex  *index);
+guint                 cc_shell_settings_index_get_n_records (CcShellSettingsIndex  *index);
+void                  cc_shell_settings_index_get_record    (CcShellSettingsIndex  *index,
+                                                             guint                  record,
+                                                             const char           **panel,
+                                                             const char           **widget,
+                                                             const char           **label,
+                                                             const char           **context);
+
+G_END_DECLS
+
+#endif /* _CC_SHELL_SETTINGS_INDEX_H */
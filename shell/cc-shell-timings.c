@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "cc-shell-timings.h"
+
+struct _CcShellTimingsSpan
+{
+  const char *name;
+  char       *detail;
+  gint64      start;
+  gint        n_dbus_calls;
+};
+
+static CcShellTimingsRecord records[CC_SHELL_TIMINGS_MAX_RECORDS];
+/* Number of records ever added, the oldest ones get overwritten */
+static guint n_records;
+
+static gint64 origin;
+
+/* Incremented from the D-Bus worker thread */
+static volatile gint n_dbus_calls;
+
+static GPollFunc default_poll;
+static gint64 dispatch_start;
+/* The last step which ended, to blame for a stall */
+static char *stall_hint;
+
+static gint64
+get_time (void)
+{
+  if (G_UNLIKELY (origin == 0))
+    origin = g_get_monotonic_time ();
+
+  return g_get_monotonic_time () - origin;
+}
+
+char *
+cc_shell_timings_format_record (const CcShellTimingsRecord *record)
+{
+  return g_strdup_printf ("+%.1f ms %s%s%s: %.1f ms, %u D-Bus calls",
+                          record->start / 1000.0,
+                          record->name,
+                          record->detail ? " " : "",
+                          record->detail ? record->detail : "",
+                          record->duration / 1000.0,
+                          record->n_dbus_calls);
+}
+
+static void
+add_record (const char *name,
+            const char *detail,
+            gint64      start,
+            gint64      duration,
+            guint       dbus_calls)
+{
+  CcShellTimingsRecord *record;
+  char *str;
+
+  record = &records[n_records % CC_SHELL_TIMINGS_MAX_RECORDS];
+  g_free (record->detail);
+
+  record->name = name;
+  record->detail = g_strdup (detail);
+  record->start = start;
+  record->duration = duration;
+  record->n_dbus_calls = dbus_calls;
+  n_records++;
+
+  str = cc_shell_timings_format_record (record);
+  g_debug ("Timing: %s", str);
+  g_free (str);
+}
+
+static gint
+timed_poll (GPollFD *fds,
+            guint    n_fds,
+            gint     timeout)
+{
+  gint64 now;
+  gint ret;
+
+  /* Everything since the previous poll was spent dispatching */
+  now = get_time ();
+  if (dispatch_start > 0 && now - dispatch_start > CC_SHELL_TIMINGS_STALL_THRESHOLD)
+    add_record (CC_SHELL_TIMINGS_STALL, stall_hint,
+                dispatch_start, now - dispatch_start, 0);
+  g_clear_pointer (&stall_hint, g_free);
+
+  ret = default_poll (fds, n_fds, timeout);
+  dispatch_start = get_time ();
+
+  return ret;
+}
+
+/**
+ * cc_shell_timings_init:
+ *
+ * Starts the clock, and the detection of main loop stalls on the default
+ * main context.
+ */
+void
+cc_shell_timings_init (void)
+{
+  if (default_poll != NULL)
+    return;
+
+  get_time ();
+
+  default_poll = g_main_context_get_poll_func (NULL);
+  g_main_context_set_poll_func (NULL, timed_poll);
+}
+
+static GDBusMessage *
+count_method_calls (GDBusConnection *connection,
+                    GDBusMessage    *message,
+                    gboolean         incoming,
+                    gpointer         user_data)
+{
+  if (!incoming &&
+      g_dbus_message_get_message_type (message) == G_DBUS_MESSAGE_TYPE_METHOD_CALL &&
+      (g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED) == 0)
+    g_atomic_int_inc (&n_dbus_calls);
+
+  return message;
+}
+
+/**
+ * cc_shell_timings_watch_bus:
+ * @connection: a #GDBusConnection
+ *
+ * Counts the method calls sent on @connection in the records.
+ */
+void
+cc_shell_timings_watch_bus (GDBusConnection *connection)
+{
+  g_dbus_connection_add_filter (connection, count_method_calls, NULL, NULL);
+}
+
+/**
+ * cc_shell_timings_begin:
+ * @name: a static string naming the step
+ * @detail: (allow-none): what the step is about, such as the panel id
+ *
+ * Returns: the span to pass to cc_shell_timings_end() once the step is done
+ */
+CcShellTimingsSpan *
+cc_shell_timings_begin (const char *name,
+                        const char *detail)
+{
+  CcShellTimingsSpan *span;
+
+  span = g_slice_new (CcShellTimingsSpan);
+  span->name = name;
+  span->detail = g_strdup (detail);
+  span->n_dbus_calls = g_atomic_int_get (&n_dbus_calls);
+  span->start = get_time ();
+
+  return span;
+}
+
+/**
+ * cc_shell_timings_end:
+ * @span: a span returned by cc_shell_timings_begin()
+ *
+ * Records the step and frees @span.
+ *
+ * Returns: the duration of the step, in microseconds
+ */
+gint64
+cc_shell_timings_end (CcShellTimingsSpan *span)
+{
+  gint64 duration;
+
+  duration = get_time () - span->start;
+  add_record (span->name, span->detail, span->start, duration,
+              g_atomic_int_get (&n_dbus_calls) - span->n_dbus_calls);
+
+  g_free (stall_hint);
+  if (span->detail)
+    stall_hint = g_strdup_printf ("after %s %s", span->name, span->detail);
+  else
+    stall_hint = g_strdup_printf ("after %s", span->name);
+
+  g_free (span->detail);
+  g_slice_free (CcShellTimingsSpan, span);
+
+  return duration;
+}
+
+guint
+cc_shell_timings_get_n_records (void)
+{
+  return MIN (n_records, CC_SHELL_TIMINGS_MAX_RECORDS);
+}
+
+/**
+ * cc_shell_timings_get_record:
+ * @i: the index of the record, from the oldest one still kept
+ *
+ * Returns: the record, valid until the next one gets added
+ */
+const CcShellTimingsRecord *
+cc_shell_timings_get_record (guint i)
+{
+  guint n = cc_shell_timings_get_n_records ();
+
+  g_return_val_if_fail (i < n, NULL);
+
+  return &records[(n_records - n + i) % CC_SHELL_TIMINGS_MAX_RECORDS];
+}
+
+/**
+ * cc_shell_timings_to_variant:
+ *
+ * Returns: (transfer floating): the records, as an array of
+ * (name, detail, start, duration, D-Bus calls)
+ */
+GVariant *
+cc_shell_timings_to_variant (void)
+{
+  GVariantBuilder builder;
+  guint i, n;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssxxu)"));
+
+  n = cc_shell_timings_get_n_records ();
+  for (i = 0; i < n; i++)
+    {
+      const CcShellTimingsRecord *record = cc_shell_timings_get_record (i);
+
+      g_variant_builder_add (&builder, "(ssxxu)",
+                             record->name,
+                             record->detail ? record->detail : "",
+                             record->start,
+                             record->duration,
+                             record->n_dbus_calls);
+    }
+
+  return g_variant_builder_end (&builder);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _CC_SHELL_TIMINGS_H
+#define _CC_SHELL_TIMINGS_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Timings of the expensive steps of the shell (startup, filling the model,
+ * constructing and showing panels) are kept in a ring buffer of the last
+ * CC_SHELL_TIMINGS_MAX_RECORDS records. Iterations of the main loop taking
+ * longer than CC_SHELL_TIMINGS_STALL_THRESHOLD are recorded as well, along
+ * with the step that ended last during the stall.
+ *
+ * All functions must be called from the main thread. */
+
+#define CC_SHELL_TIMINGS_MAX_RECORDS 256
+
+/* In microseconds */
+#define CC_SHELL_TIMINGS_STALL_THRESHOLD (50 * 1000)
+
+#define CC_SHELL_TIMINGS_STALL "main-loop-stall"
+
+typedef struct {
+  const char *name;
+  char       *detail;
+  gint64      start;        /* microseconds since cc_shell_timings_init() */
+  gint64      duration;     /* microseconds */
+  guint       n_dbus_calls; /* method calls sent while the step ran */
+} CcShellTimingsRecord;
+
+typedef struct _CcShellTimingsSpan CcShellTimingsSpan;
+
+void                        cc_shell_timings_init          (void);
+void                        cc_shell_timings_watch_bus     (GDBusConnection *connection);
+
+CcShellTimingsSpan         *cc_shell_timings_begin         (const char      *name,
+                                                            const char      *detail);
+gint64                      cc_shell_timings_end           (CcShellTimingsSpan *span);
+
+guint                       cc_shell_timings_get_n_records (void);
+const CcShellTimingsRecord *cc_shell_timings_get_record    (guint            i);
+
+char                       *cc_shell_timings_format_record (const CcShellTimingsRecord *record);
+GVariant                   *cc_shell_timings_to_variant    (void);
+
+G_END_DECLS
+
+#endif /* _CC_SHELL_TIMINGS_H */
@@ -40,6 +40,7 @@
 #include "cc-shell-category-view.h"
 #include "cc-shell-model.h"
 #include "cc-panel-loader.h"
+#include "cc-shell-timings.h"
 #include "cc-util.h"
 
 static void     cc_shell_iface_init         (CcShellInterface      *iface);
@@ -65,6 +66,22 @@ G_DEFINE_TYPE_WITH_CODE (CcWindow, cc_window, GTK_TYPE_APPLICATION_WINDOW,
 #define SEARCH_PAGE "_search"
 #define OVERVIEW_PAGE "_overview"
 
+/* Panels are kept around once hidden, so that going back to one of the
+ * recently used ones does not construct it again. The cache is bounded
+ * both by the number of panels and by their estimated size, which is
+ * derived from the number of widgets they contain. */
+#define PANEL_CACHE_MAX_PANELS 4
+#define PANEL_CACHE_MAX_COST (24 * 1024 * 1024)
+#define PANEL_CACHE_WIDGET_COST (32 * 1024)
+
+typedef struct {
+  char      *id;
+  GtkWidget *box;
+  CcPanel   *panel;
+  GPtrArray *custom_widgets;
+  gsize      cost;
+} CachedPanel;
+
 typedef enum {
 	SMALL_SCREEN_UNSET,
 	SMALL_SCREEN_TRUE,
@@ -89,11 +106,19 @@ struct _CcWindowPrivate
 
   GPtrArray  *custom_widgets;
 
+  /* hidden panels, most recently used first */
+  GQueue     *panel_cache;
+  GHashTable *panel_cache_links;
+  gsize       panel_cache_cost;
+
   GtkListStore *store;
 
   GtkTreeModel *search_filter;
+  GtkTreeModel *search_sort;
   GtkWidget *search_view;
   gchar *filter_string;
+  CcShellSearchQuery *search_query;
+  GArray *search_removed;
 
   CcPanel *active_panel;
 
@@ -134,6 +159,133 @@ get_icon_name_from_g_icon (GIcon *gicon)
   return NULL;
 }
 
+static void
+count_widgets (GtkWidget *widget,
+               gpointer   user_data)
+{
+  guint *n_widgets = user_data;
+
+  (*n_widgets)++;
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget), count_widgets, n_widgets);
+}
+
+static gsize
+estimate_panel_cost (GtkWidget *box)
+{
+  guint n_widgets = 0;
+
+  count_widgets (box, &n_widgets);
+
+  return n_widgets * PANEL_CACHE_WIDGET_COST;
+}
+
+static void
+cached_panel_free (CachedPanel *cached)
+{
+  g_free (cached->id);
+  g_ptr_array_unref (cached->custom_widgets);
+  g_slice_free (CachedPanel, cached);
+}
+
+static void
+evict_cached_panel (CcWindow *self)
+{
+  CcWindowPrivate *priv = self->priv;
+  CachedPanel *cached;
+
+  cached = g_queue_pop_tail (priv->panel_cache);
+  g_hash_table_remove (priv->panel_cache_links, cached->id);
+  priv->panel_cache_cost -= cached->cost;
+
+  g_debug ("Evicting panel '%s' from the cache", cached->id);
+
+  gtk_container_remove (GTK_CONTAINER (priv->stack), cached->box);
+  cached_panel_free (cached);
+}
+
+/* Takes the header widgets of the current panel out of the header bar */
+static GPtrArray *
+take_custom_widgets (CcWindow *self)
+{
+  CcWindowPrivate *priv = self->priv;
+  GPtrArray *widgets;
+  guint i;
+
+  for (i = 0; i < priv->custom_widgets->len; i++)
+    gtk_container_remove (GTK_CONTAINER (priv->top_right_box),
+                          g_ptr_array_index (priv->custom_widgets, i));
+
+  widgets = priv->custom_widgets;
+  priv->custom_widgets = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+
+  return widgets;
+}
+
+static void
+restore_custom_widgets (CcWindow  *self,
+                        GPtrArray *widgets)
+{
+  guint i;
+
+  for (i = 0; i < widgets->len; i++)
+    cc_shell_embed_widget_in_header (CC_SHELL (self),
+                                     g_ptr_array_index (widgets, i));
+  g_ptr_array_unref (widgets);
+}
+
+/* Keeps a hidden panel and its header widgets around for later use.
+ * Takes ownership of @custom_widgets. */
+static void
+cache_panel (CcWindow    *self,
+             const gchar *id,
+             GtkWidget   *box,
+             GPtrArray   *custom_widgets)
+{
+  CcWindowPrivate *priv = self->priv;
+  CachedPanel *cached;
+
+  cached = g_slice_new (CachedPanel);
+  cached->id = g_strdup (id);
+  cached->box = box;
+  cached->panel = CC_PANEL (gtk_bin_get_child (GTK_BIN (box)));
+  cached->custom_widgets = custom_widgets;
+  cached->cost = estimate_panel_cost (box);
+
+  /* the stack is homogeneous, don't let hidden panels size it */
+  gtk_widget_hide (box);
+
+  g_queue_push_head (priv->panel_cache, cached);
+  g_hash_table_insert (priv->panel_cache_links, cached->id, priv->panel_cache->head);
+  priv->panel_cache_cost += cached->cost;
+
+  /* Always keep the most recent panel, however big it is */
+  while (priv->panel_cache->length > PANEL_CACHE_MAX_PANELS ||
+         (priv->panel_cache_cost > PANEL_CACHE_MAX_COST &&
+          priv->panel_cache->length > 1))
+    evict_cached_panel (self);
+}
+
+static CachedPanel *
+take_cached_panel (CcWindow    *self,
+                   const gchar *id)
+{
+  CcWindowPrivate *priv = self->priv;
+  CachedPanel *cached;
+  GList *link;
+
+  link = g_hash_table_lookup (priv->panel_cache_links, id);
+  if (link == NULL)
+    return NULL;
+
+  cached = link->data;
+  g_hash_table_remove (priv->panel_cache_links, id);
+  g_queue_delete_link (priv->panel_cache, link);
+  priv->panel_cache_cost -= cached->cost;
+
+  return cached;
+}
+
 static gboolean
 activate_panel (CcWindow           *self,
                 const gchar        *id,
@@ -142,24 +294,45 @@ activate_panel (CcWindow           *self,
                 GIcon              *gicon)
 {
   CcWindowPrivate *priv = self->priv;
+  CcShellTimingsSpan *span;
+  CachedPanel *cached;
   GtkWidget *box;
   const gchar *icon_name;
 
   if (!id)
     return FALSE;
 
-  priv->current_panel = GTK_WIDGET (cc_panel_loader_load_by_name (CC_SHELL (self), id, argv));
-  cc_shell_set_active_panel (CC_SHELL (self), CC_PANEL (priv->current_panel));
-  gtk_widget_show (priv->current_panel);
+  span = cc_shell_timings_begin ("activate-panel", id);
 
-  gtk_lock_button_set_permission (GTK_LOCK_BUTTON (priv->lock_button),
-                                  cc_panel_get_permission (CC_PANEL (priv->current_panel)));
+  cached = take_cached_panel (self, id);
+  if (cached)
+    {
+      g_debug ("Reusing cached panel '%s'", id);
+
+      priv->current_panel = GTK_WIDGET (cached->panel);
+      box = cached->box;
+      restore_custom_widgets (self, cached->custom_widgets);
+      cached->custom_widgets = NULL;
+      g_free (cached->id);
+      g_slice_free (CachedPanel, cached);
+
+      g_object_set (G_OBJECT (priv->current_panel), "argv", argv, NULL);
+      cc_panel_set_active (CC_PANEL (priv->current_panel), TRUE);
+    }
+  else
+    {
+      priv->current_panel = GTK_WIDGET (cc_panel_loader_load_by_name (CC_SHELL (self), id, argv));
+      gtk_widget_show (priv->current_panel);
 
-  box = gtk_alignment_new (0, 0, 1, 1);
+      box = gtk_alignment_new (0, 0, 1, 1);
+      gtk_container_add (GTK_CONTAINER (box), priv->current_panel);
+      gd_stack_add_named (GD_STACK (priv->stack), box, id);
+    }
 
-  gtk_container_add (GTK_CONTAINER (box), priv->current_panel);
+  cc_shell_set_active_panel (CC_SHELL (self), CC_PANEL (priv->current_panel));
 
-  gd_stack_add_named (GD_STACK (priv->stack), box, id);
+  gtk_lock_button_set_permission (GTK_LOCK_BUTTON (priv->lock_button),
+                                  cc_panel_get_permission (CC_PANEL (priv->current_panel)));
 
   /* switch to the new panel */
   gtk_widget_show (box);
@@ -175,6 +348,8 @@ activate_panel (CcWindow           *self,
 
   priv->current_panel_box = box;
 
+  cc_shell_timings_end (span);
+
   return TRUE;
 }
 
@@ -219,7 +394,11 @@ shell_show_overview_page (CcWindow *self)
   gd_stack_set_visible_child_name (GD_STACK (priv->stack), OVERVIEW_PAGE);
 
   if (priv->current_panel_box)
-    gtk_container_remove (GTK_CONTAINER (priv->stack), priv->current_panel_box);
+    {
+      cc_panel_set_active (CC_PANEL (priv->current_panel), FALSE);
+      cache_panel (self, priv->current_panel_id, priv->current_panel_box,
+                   take_custom_widgets (self));
+    }
   priv->current_panel = NULL;
   priv->current_panel_box = NULL;
   g_clear_pointer (&priv->current_panel_id, g_free);
@@ -231,6 +410,8 @@ shell_show_overview_page (CcWindow *self)
   /* clear the search text */
   g_free (priv->filter_string);
   priv->filter_string = g_strdup ("");
+  if (priv->search_query)
+    cc_shell_search_query_reset (priv->search_query);
   gtk_entry_set_text (GTK_ENTRY (priv->search_entry), "");
   gtk_widget_grab_focus (priv->search_entry);
 
@@ -557,24 +738,86 @@ model_filter_func (GtkTreeModel    *model,
                    GtkTreeIter     *iter,
                    CcWindowPrivate *priv)
 {
-  char **terms, **t;
-  gboolean matches;
+  guint entry;
 
   if (!priv->filter_string)
     return FALSE;
 
+  gtk_tree_model_get (model, iter, COL_SEARCH_ENTRY, &entry, -1);
+
+  return cc_shell_search_query_contains (priv->search_query, entry);
+}
+
+static gint
+search_sort_func (GtkTreeModel    *model,
+                  GtkTreeIter     *a,
+                  GtkTreeIter     *b,
+                  CcWindowPrivate *priv)
+{
+  CcShellSearchIndex *index;
+  guint entry_a, entry_b;
+  guint score_a, score_b;
+
+  index = cc_shell_model_get_search_index (CC_SHELL_MODEL (priv->store));
+
+  gtk_tree_model_get (model, a, COL_SEARCH_ENTRY, &entry_a, -1);
+  gtk_tree_model_get (model, b, COL_SEARCH_ENTRY, &entry_b, -1);
+
+  score_a = cc_shell_search_index_get_score (index, entry_a);
+  score_b = cc_shell_search_index_get_score (index, entry_b);
+
+  if (score_a != score_b)
+    return score_a > score_b ? -1 : 1;
+
+  /* Keep the store's alphabetical order for equal scores */
+  return 0;
+}
+
+static void
+refilter_search (CcWindowPrivate *priv)
+{
+  char **terms;
+  gboolean narrowed;
+  guint i;
+
+  /* The settings of each panel are only needed once searching */
+  if (cc_shell_model_load_settings (CC_SHELL_MODEL (priv->store)))
+    cc_shell_search_query_reset (priv->search_query);
+
   terms = g_strsplit (priv->filter_string, " ", -1);
-  for (t = terms; *t; t++)
+  narrowed = cc_shell_search_query_update (priv->search_query,
+                                           (const char * const *) terms,
+                                           priv->search_removed);
+  g_strfreev (terms);
+
+  if (narrowed)
     {
-      matches = cc_shell_model_iter_matches_search (CC_SHELL_MODEL (model),
-                                                    iter,
-                                                    *t);
-      if (!matches)
-        break;
+      /* Only the rows that stopped matching need to be hidden */
+      for (i = 0; i < priv->search_removed->len; i++)
+        {
+          GtkTreeIter iter;
+          GtkTreePath *path;
+
+          if (!cc_shell_model_get_iter_for_entry (CC_SHELL_MODEL (priv->store),
+                                                  g_array_index (priv->search_removed, guint, i),
+                                                  &iter))
+            continue;
+
+          path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->store), &iter);
+          gtk_tree_model_row_changed (GTK_TREE_MODEL (priv->store), path, &iter);
+          gtk_tree_path_free (path);
+        }
+    }
+  else
+    {
+      gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->search_filter));
     }
-  g_strfreev (terms);
 
-  return matches;
+  /* Rows already visible may have a new score; setting the
+   * default sort function again forces a resort */
+  gtk_tree_sortable_set_default_sort_func (GTK_TREE_SORTABLE (priv->search_sort),
+                                           (GtkTreeIterCompareFunc) search_sort_func,
+                                           priv, NULL);
 }
 
 static gboolean
@@ -618,7 +861,7 @@ search_entry_changed_cb (GtkEntry *entry,
     }
   else
     {
-      gtk_tree_model_filter_refilter (GTK_TREE_MODEL_FILTER (priv->search_filter));
+      refilter_search (priv);
       gd_stack_set_visible_child_name (GD_STACK (priv->stack), SEARCH_PAGE);
     }
 }
@@ -671,6 +914,7 @@ on_search_row_activated (GtkTreeView       *treeview,
   GtkTreeModel *model;
   GtkTreeIter   iter;
   char         *id = NULL;
+  char         *setting = NULL;
 
   selection = gtk_tree_view_get_selection (treeview);
 
@@ -679,14 +923,28 @@ on_search_row_activated (GtkTreeView       *treeview,
 
   gtk_tree_model_get (model, &iter,
                       COL_ID, &id,
+                      COL_SETTING, &setting,
                       -1);
 
-  if (id)
-    cc_window_set_active_panel_from_id (CC_SHELL (shell), id, NULL, NULL);
+  if (id && setting)
+    {
+      const char *argv[] = { NULL, NULL };
+      char *arg;
+
+      arg = g_strconcat (CC_SHELL_SETTING_ARGV_PREFIX, setting, NULL);
+      argv[0] = arg;
+      cc_window_set_active_panel_from_id (CC_SHELL (shell), id, argv, NULL);
+      g_free (arg);
+    }
+  else if (id)
+    {
+      cc_window_set_active_panel_from_id (CC_SHELL (shell), id, NULL, NULL);
+    }
 
   gtk_tree_selection_unselect_all (selection);
 
   g_free (id);
+  g_free (setting);
 }
 
 static gboolean
@@ -751,11 +1009,17 @@ setup_search (CcWindow *shell)
                                           model_filter_func,
                                           priv, NULL);
 
+  /* and order the results by relevance */
+  priv->search_sort = gtk_tree_model_sort_new_with_model (priv->search_filter);
+  gtk_tree_sortable_set_default_sort_func (GTK_TREE_SORTABLE (priv->search_sort),
+                                           (GtkTreeIterCompareFunc) search_sort_func,
+                                           priv, NULL);
+
   /* set up the search view */
   priv->search_view = search_view = gtk_tree_view_new ();
   gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (search_view), FALSE);
   gtk_tree_view_set_model (GTK_TREE_VIEW (search_view),
-                           GTK_TREE_MODEL (priv->search_filter));
+                           GTK_TREE_MODEL (priv->search_sort));
 
   renderer = gtk_cell_renderer_pixbuf_new ();
   g_object_set (renderer,
@@ -798,6 +1062,8 @@ setup_search (CcWindow *shell)
                     G_CALLBACK (on_search_button_press_event), shell);
 
   priv->filter_string = g_strdup ("");
+  priv->search_query = cc_shell_search_query_new (cc_shell_model_get_search_index (CC_SHELL_MODEL (priv->store)));
+  priv->search_removed = g_array_new (FALSE, FALSE, sizeof (guint));
 
   gtk_widget_show (priv->search_view);
 }
@@ -930,6 +1196,58 @@ _shell_embed_widget_in_header (CcShell      *shell,
   g_ptr_array_add (priv->custom_widgets, g_object_ref (widget));
 }
 
+static GtkWidget *
+find_buildable (GtkWidget  *widget,
+                const char *name)
+{
+  GList *children, *l;
+  GtkWidget *found = NULL;
+
+  if (g_strcmp0 (gtk_buildable_get_name (GTK_BUILDABLE (widget)), name) == 0)
+    return widget;
+
+  if (!GTK_IS_CONTAINER (widget))
+    return NULL;
+
+  children = gtk_container_get_children (GTK_CONTAINER (widget));
+  for (l = children; l != NULL && found == NULL; l = l->next)
+    found = find_buildable (l->data, name);
+  g_list_free (children);
+
+  return found;
+}
+
+/* Shows and focuses the widget named @setting in the panel's GtkBuilder
+ * file, switching notebook pages on the way if needed */
+static void
+show_setting (CcWindow   *self,
+              const char *setting)
+{
+  GtkWidget *widget, *child, *parent;
+
+  widget = find_buildable (self->priv->current_panel, setting);
+  if (widget == NULL)
+    {
+      g_debug ("Could not find setting '%s' in panel '%s'",
+               setting, self->priv->current_panel_id);
+      return;
+    }
+
+  for (child = widget, parent = gtk_widget_get_parent (widget);
+       parent != NULL && child != self->priv->current_panel;
+       child = parent, parent = gtk_widget_get_parent (parent))
+    {
+      if (GTK_IS_NOTEBOOK (parent))
+        gtk_notebook_set_current_page (GTK_NOTEBOOK (parent),
+                                       gtk_notebook_page_num (GTK_NOTEBOOK (parent), child));
+    }
+
+  if (gtk_widget_get_can_focus (widget))
+    gtk_widget_grab_focus (widget);
+  else
+    gtk_widget_child_focus (widget, GTK_DIR_TAB_FORWARD);
+}
+
 /* CcShell implementation */
 static gboolean
 cc_window_set_active_panel_from_id (CcShell      *shell,
@@ -938,77 +1256,72 @@ cc_window_set_active_panel_from_id (CcShell      *shell,
                                     GError      **err)
 {
   GtkTreeIter iter;
-  gboolean iter_valid;
   gchar *name = NULL;
   GIcon *gicon = NULL;
   CcWindowPrivate *priv = CC_WINDOW (shell)->priv;
-  GtkWidget *old_panel;
+  GtkWidget *old_panel, *old_panel_box;
+  GPtrArray *old_widgets;
+  const char *setting = NULL;
+
+  /* The setting to show is for us, not for the panel */
+  if (argv && argv[0] && g_str_has_prefix (argv[0], CC_SHELL_SETTING_ARGV_PREFIX))
+    {
+      setting = argv[0] + strlen (CC_SHELL_SETTING_ARGV_PREFIX);
+      argv++;
+    }
 
   /* When loading the same panel again, just set the argv */
   if (g_strcmp0 (priv->current_panel_id, start_id) == 0)
     {
       g_object_set (G_OBJECT (priv->current_panel), "argv", argv, NULL);
+      if (setting)
+        show_setting (CC_WINDOW (shell), setting);
       return TRUE;
     }
 
-  /* clear any custom widgets */
-  _shell_remove_all_custom_widgets (priv);
-
-  iter_valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->store),
-                                              &iter);
-
   /* find the details for this item */
-  while (iter_valid)
+  if (!cc_shell_model_get_iter_for_id (CC_SHELL_MODEL (priv->store), start_id, &iter))
     {
-      gchar *id;
-
-      gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
-                          COL_NAME, &name,
-                          COL_GICON, &gicon,
-                          COL_ID, &id,
-                          -1);
+      g_warning ("Could not find settings panel \"%s\"", start_id);
+      return TRUE;
+    }
 
-      if (id && !strcmp (id, start_id))
-        {
-          g_free (id);
-          break;
-        }
-      else
-        {
-          g_free (id);
-          g_free (name);
-          if (gicon)
-            g_object_unref (gicon);
-
-          name = NULL;
-          id = NULL;
-          gicon = NULL;
-        }
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
+                      COL_NAME, &name,
+                      COL_GICON, &gicon,
+                      -1);
 
-      iter_valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->store),
-                                             &iter);
-    }
+  old_panel = priv->current_panel;
+  old_panel_box = priv->current_panel_box;
 
-  old_panel = priv->current_panel_box;
+  /* the new panel may embed its own widgets in the header */
+  old_widgets = take_custom_widgets (CC_WINDOW (shell));
+  if (old_panel)
+    cc_panel_set_active (CC_PANEL (old_panel), FALSE);
 
-  if (!name)
-    {
-      g_warning ("Could not find settings panel \"%s\"", start_id);
-    }
-  else if (activate_panel (CC_WINDOW (shell), start_id, argv,
-                           name, gicon) == FALSE)
+  if (activate_panel (CC_WINDOW (shell), start_id, argv,
+                      name, gicon) == FALSE)
     {
       /* Failed to activate the panel for some reason,
        * let's keep the old panel around instead */
+      if (old_panel)
+        cc_panel_set_active (CC_PANEL (old_panel), TRUE);
+      restore_custom_widgets (CC_WINDOW (shell), old_widgets);
     }
   else
     {
-      /* Successful activation */
+      /* Successful activation, keep the old panel for later */
+      if (old_panel_box)
+        cache_panel (CC_WINDOW (shell), priv->current_panel_id,
+                     old_panel_box, old_widgets);
+      else
+        g_ptr_array_unref (old_widgets);
+
       g_free (priv->current_panel_id);
       priv->current_panel_id = g_strdup (start_id);
 
-      if (old_panel)
-        gtk_container_remove (GTK_CONTAINER (priv->stack), old_panel);
+      if (setting)
+        show_setting (CC_WINDOW (shell), setting);
     }
 
   g_free (name);
@@ -1114,7 +1427,16 @@ cc_window_dispose (GObject *object)
       priv->custom_widgets = NULL;
     }
 
+  /* the cached panels are destroyed along with the stack */
+  g_clear_pointer (&priv->panel_cache_links, g_hash_table_destroy);
+  if (priv->panel_cache)
+    {
+      g_queue_free_full (priv->panel_cache, (GDestroyNotify) cached_panel_free);
+      priv->panel_cache = NULL;
+    }
+
   g_clear_object (&priv->store);
+  g_clear_object (&priv->search_sort);
   g_clear_object (&priv->search_filter);
   g_clear_object (&priv->active_panel);
 
@@ -1133,6 +1455,9 @@ cc_window_finalize (GObject *object)
   CcWindowPrivate *priv = CC_WINDOW (object)->priv;
 
   g_free (priv->filter_string);
+  cc_shell_search_query_free (priv->search_query);
+  if (priv->search_removed)
+    g_array_unref (priv->search_removed);
 
   G_OBJECT_CLASS (cc_window_parent_class)->finalize (object);
 }
@@ -1481,6 +1806,9 @@ cc_window_init (CcWindow *self)
   /* keep a list of custom widgets to unload on panel change */
   priv->custom_widgets = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 
+  priv->panel_cache = g_queue_new ();
+  priv->panel_cache_links = g_hash_table_new (g_str_hash, g_str_equal);
+
   stack_page_notify_cb (GD_STACK (priv->stack), NULL, self);
 }
 
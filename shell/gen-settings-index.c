@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2013 Red Hat, Inc.
+ *
+ * The Control Center is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * The Control Center is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with the Control Center; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/* Walks the GtkBuilder files listed in a manifest and writes the settings
+ * index read by CcShellModel, see cc-shell-settings-index.h.
+ *
+ * Usage: gen-settings-index OUTPUT SRCDIR MANIFEST
+ *
+ * Each line of the manifest holds a panel id and the path of one of its
+ * .ui files, relative to SRCDIR.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "cc-shell-settings-index.h"
+#include "cc-mapped-cache.h"
+
+typedef struct {
+  char *id;
+  char *label;
+  char *context;
+  char *mnemonic_widget;
+} UiObject;
+
+typedef struct {
+  const char *panel;
+  GQueue     *objects;
+  char       *property;
+  char       *context;
+  GString    *text;
+} ParseData;
+
+static GArray       *records;
+static CcStringPool  pool;
+static GHashTable   *seen;
+
+static void
+ui_object_free (UiObject *object)
+{
+  g_free (object->id);
+  g_free (object->label);
+  g_free (object->context);
+  g_free (object->mnemonic_widget);
+  g_slice_free (UiObject, object);
+}
+
+static void
+add_record (const char *panel,
+            UiObject   *object)
+{
+  CcSettingsIndexRecord record;
+  const char *widget;
+  char *key;
+
+  widget = object->mnemonic_widget ? object->mnemonic_widget : object->id;
+
+  /* Nothing to search for, or nothing to jump to */
+  if (object->label == NULL || widget == NULL)
+    return;
+
+  g_strstrip (object->label);
+  if (*object->label == '\0' || strchr (object->label, '<') != NULL)
+    return;
+
+  /* Keep a single label per widget, and a single widget per label */
+  key = g_strdup_printf ("%s\n%s", panel, widget);
+  if (g_hash_table_contains (seen, key))
+    {
+      g_free (key);
+      return;
+    }
+  g_hash_table_add (seen, key);
+
+  key = g_strdup_printf ("%s\n\n%s", panel, object->label);
+  if (g_hash_table_contains (seen, key))
+    {
+      g_free (key);
+      return;
+    }
+  g_hash_table_add (seen, key);
+
+  record.panel = cc_string_pool_add (&pool, panel);
+  record.widget = cc_string_pool_add (&pool, widget);
+  record.label = cc_string_pool_add (&pool, object->label);
+  record.context = cc_string_pool_add (&pool, object->context);
+  g_array_append_val (records, record);
+}
+
+static void
+start_element (GMarkupParseContext  *context,
+               const gchar          *element_name,
+               const gchar         **attribute_names,
+               const gchar         **attribute_values,
+               gpointer              user_data,
+               GError              **error)
+{
+  ParseData *data = user_data;
+  int i;
+
+  if (g_str_equal (element_name, "object"))
+    {
+      UiObject *object;
+
+      object = g_slice_new0 (UiObject);
+      for (i = 0; attribute_names[i]; i++)
+        {
+          if (g_str_equal (attribute_names[i], "id"))
+            object->id = g_strdup (attribute_values[i]);
+        }
+      g_queue_push_head (data->objects, object);
+    }
+  else if (g_str_equal (element_name, "property") &&
+           !g_queue_is_empty (data->objects))
+    {
+      const char *name = NULL, *msgctxt = NULL;
+      gboolean translatable = FALSE;
+
+      for (i = 0; attribute_names[i]; i++)
+        {
+          if (g_str_equal (attribute_names[i], "name"))
+            name = attribute_values[i];
+          else if (g_str_equal (attribute_names[i], "translatable"))
+            translatable = g_str_equal (attribute_values[i], "yes");
+          else if (g_str_equal (attribute_names[i], "context"))
+            msgctxt = attribute_values[i];
+        }
+
+      if (g_strcmp0 (name, "label") == 0 && translatable)
+        {
+          data->property = g_strdup (name);
+          data->context = g_strdup (msgctxt);
+        }
+      else if (g_strcmp0 (name, "mnemonic_widget") == 0)
+        {
+          data->property = g_strdup (name);
+        }
+
+      g_string_truncate (data->text, 0);
+    }
+}
+
+static void
+end_element (GMarkupParseContext  *context,
+             const gchar          *element_name,
+             gpointer              user_data,
+             GError              **error)
+{
+  ParseData *data = user_data;
+
+  if (g_str_equal (element_name, "object"))
+    {
+      UiObject *object;
+
+      object = g_queue_pop_head (data->objects);
+      add_record (data->panel, object);
+      ui_object_free (object);
+    }
+  else if (g_str_equal (element_name, "property") && data->property)
+    {
+      UiObject *object = g_queue_peek_head (data->objects);
+
+      if (g_str_equal (data->property, "label"))
+        {
+          g_free (object->label);
+          object->label = g_strdup (data->text->str);
+          g_free (object->context);
+          object->context = data->context;
+          data->context = NULL;
+        }
+      else
+        {
+          g_free (object->mnemonic_widget);
+          object->mnemonic_widget = g_strdup (data->text->str);
+        }
+
+      g_clear_pointer (&data->property, g_free);
+    }
+}
+
+static void
+text (GMarkupParseContext  *context,
+      const gchar          *text,
+      gsize                 text_len,
+      gpointer              user_data,
+      GError              **error)
+{
+  ParseData *data = user_data;
+
+  if (data->property)
+    g_string_append_len (data->text, text, text_len);
+}
+
+static const GMarkupParser parser = {
+  start_element,
+  end_element,
+  text,
+  NULL,
+  NULL
+};
+
+static gboolean
+parse_ui_file (const char  *panel,
+               const char  *path,
+               GError     **error)
+{
+  GMarkupParseContext *context;
+  ParseData data;
+  char *contents;
+  gsize length;
+  gboolean ret;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return FALSE;
+
+  memset (&data, 0, sizeof (data));
+  data.panel = panel;
+  data.objects = g_queue_new ();
+  data.text = g_string_new (NULL);
+
+  context = g_markup_parse_context_new (&parser, 0, &data, NULL);
+  ret = g_markup_parse_context_parse (context, contents, length, error) &&
+        g_markup_parse_context_end_parse (context, error);
+
+  g_markup_parse_context_free (context);
+  g_queue_free_full (data.objects, (GDestroyNotify) ui_object_free);
+  g_string_free (data.text, TRUE);
+  g_free (data.property);
+  g_free (data.context);
+  g_free (contents);
+
+  return ret;
+}
+
+int main (int argc, char **argv)
+{
+  CcSettingsIndexHeader header;
+  GString *output;
+  char *manifest;
+  char **lines;
+  GError *error = NULL;
+  int i;
+
+  if (argc != 4)
+    {
+      g_printerr ("Usage: %s OUTPUT SRCDIR MANIFEST\n", argv[0]);
+      return 1;
+    }
+
+  if (!g_file_get_contents (argv[3], &manifest, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  records = g_array_new (FALSE, FALSE, sizeof (CcSettingsIndexRecord));
+  cc_string_pool_init (&pool);
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  lines = g_strsplit (manifest, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      char **fields;
+      char *path;
+
+      g_strstrip (lines[i]);
+      if (*lines[i] == '#' || *lines[i] == '\0')
+        continue;
+
+      fields = g_strsplit_set (lines[i], " \t", 2);
+      if (g_strv_length (fields) != 2)
+        {
+          g_printerr ("Invalid manifest line '%s'\n", lines[i]);
+          return 1;
+        }
+
+      path = g_build_filename (argv[2], g_strstrip (fields[1]), NULL);
+      if (!parse_ui_file (fields[0], path, &error))
+        {
+          g_printerr ("Failed to parse '%s': %s\n", path, error->message);
+          return 1;
+        }
+
+      g_free (path);
+      g_strfreev (fields);
+    }
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, CC_SETTINGS_INDEX_MAGIC, sizeof (header.magic));
+  header.n_records = records->len;
+  header.records_offset = sizeof (header);
+  header.strings_offset = header.records_offset + records->len * sizeof (CcSettingsIndexRecord);
+  header.strings_size = pool.strings->len;
+
+  output = g_string_new_len ((const char *) &header, sizeof (header));
+  g_string_append_len (output, records->data, records->len * sizeof (CcSettingsIndexRecord));
+  g_string_append_len (output, pool.strings->str, pool.strings->len);
+
+  if (!g_file_set_contents (argv[1], output->str, output->len, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  g_string_free (output, TRUE);
+  g_strfreev (lines);
+  g_free (manifest);
+
+  return 0;
+}
@@ -31,6 +31,7 @@
 #endif
 
 #include "cc-application.h"
+#include "cc-shell-timings.h"
 
 int
 main (int argc, char **argv)
@@ -38,6 +39,8 @@ main (int argc, char **argv)
   GtkApplication *application;
   int status;
 
+  cc_shell_timings_init ();
+
   bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
   bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
   textdomain (GETTEXT_PACKAGE);